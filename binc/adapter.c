@@ -22,12 +22,16 @@
  */
 
 #include "adapter.h"
+#include "adapter_internal.h"
 #include "device.h"
 #include "device_internal.h"
+#include "characteristic_internal.h"
 #include "logger.h"
 #include "utility.h"
 #include "advertisement.h"
 #include "application.h"
+#include "scan_filter.h"
+#include "address_set.h"
 
 static const char *const TAG = "Adapter";
 static const char *const BLUEZ_DBUS = "org.bluez";
@@ -36,6 +40,9 @@ static const char *const INTERFACE_DEVICE = "org.bluez.Device1";
 static const char *const INTERFACE_OBJECT_MANAGER = "org.freedesktop.DBus.ObjectManager";
 static const char *const INTERFACE_GATT_MANAGER = "org.bluez.GattManager1";
 static const char *const INTERFACE_PROPERTIES = "org.freedesktop.DBus.Properties";
+static const char *const INTERFACE_SERVICE = "org.bluez.GattService1";
+static const char *const INTERFACE_CHARACTERISTIC = "org.bluez.GattCharacteristic1";
+static const char *const INTERFACE_DESCRIPTOR = "org.bluez.GattDescriptor1";
 
 static const char *const METHOD_START_DISCOVERY = "StartDiscovery";
 static const char *const METHOD_STOP_DISCOVERY = "StopDiscovery";
@@ -47,15 +54,28 @@ static const char *const ADAPTER_PROPERTY_DISCOVERING = "Discovering";
 static const char *const ADAPTER_PROPERTY_ADDRESS = "Address";
 static const char *const ADAPTER_PROPERTY_DISCOVERABLE = "Discoverable";
 
+static const char *const DEVICE_PROPERTY_CONNECTED = "Connected";
+static const char *const DEVICE_PROPERTY_PAIRED = "Paired";
 static const char *const DEVICE_PROPERTY_RSSI = "RSSI";
 static const char *const DEVICE_PROPERTY_UUIDS = "UUIDs";
 static const char *const DEVICE_PROPERTY_MANUFACTURER_DATA = "ManufacturerData";
 static const char *const DEVICE_PROPERTY_SERVICE_DATA = "ServiceData";
 
+static const char *const CHARACTERISTIC_PROPERTY_VALUE = "Value";
+
 static const char *const SIGNAL_PROPERTIES_CHANGED = "PropertiesChanged";
 
 static const guint MAC_ADDRESS_LENGTH = 17;
 
+#define DEVICE_CACHE_SWEEP_INTERVAL_MS 5000
+#define REMOVE_DEVICE_PIPELINE_DEPTH 8
+
+#define DEVICE_PATH_BUFFER_SIZE 64
+
+// Updates of these properties are reported as discovery results
+#define DISCOVERY_RESULT_PROPERTIES (BINC_DEVICE_PROPERTY_RSSI | BINC_DEVICE_PROPERTY_MANUFACTURER_DATA | \
+                                     BINC_DEVICE_PROPERTY_SERVICE_DATA)
+
 static const char *discovery_state_names[] = {
         [BINC_DISCOVERY_STOPPED] = "stopped",
         [BINC_DISCOVERY_STARTED] = "started",
@@ -65,7 +85,7 @@ static const char *discovery_state_names[] = {
 
 typedef struct binc_discovery_filter {
     short rssi;
-    GPtrArray *services;
+    GPtrArray *services; // Owned, holds interned uuids
     const char *pattern;
 } DiscoveryFilter;
 
@@ -79,28 +99,64 @@ struct binc_adapter {
     DiscoveryFilter discovery_filter;
 
     GDBusConnection *connection;  // Borrowed
-    guint device_prop_changed;
-    guint adapter_prop_changed;
     guint iface_added;
     guint iface_removed;
 
     AdapterDiscoveryResultCallback discoveryResultCallback;
+    AdapterDiscoveryBatchCallback discoveryBatchCallback;
+    DiscoveryPolicy discovery_policy;
+    guint discovery_generation; // Counts discovery sessions, devices are reported afresh in every session
+    GPtrArray *discovery_batch; // Owned, borrowed devices waiting for the batch callback
+    guint discovery_batch_timeout;
+    GPtrArray *discovery_held; // Owned, borrowed devices whose result is held back by min_interval_ms
+    guint discovery_held_timeout;
+    gint64 discovery_held_due; // Monotonic time the held results timeout fires
+    ScanFilter *scan_filter; // Owned
+    AddressSet *scan_filter_rejected; // Owned, devices whose whole advertisement the scan filter rejected
+    const AddressSet *address_allowlist; // Borrowed
+    const AddressSet *address_denylist; // Borrowed
     AdapterDiscoveryStateChangeCallback discoveryStateCallback;
     AdapterPoweredStateChangeCallback poweredStateCallback;
     RemoteCentralConnectionStateCallback centralStateCallback;
     void *user_data; // Borrowed
-    GHashTable *devices_cache; // Owned
+    GHashTable *devices_cache; // Owned, keys are borrowed device paths
+    guint device_cache_max_devices;
+    guint device_cache_idle_ttl_seconds;
+    gsize device_cache_max_bytes;
+    gboolean device_cache_remove_from_bluez;
+    guint device_cache_sweep_timeout;
+    guint device_cache_sweep_idle;
+    AdapterDeviceEvictedCallback deviceEvictedCallback;
+    AdapterDeviceChangedCallback deviceChangedCallback;
+    GQueue device_removals; // Owned paths waiting for RemoveDevice
+    guint device_removals_in_flight;
+    GCancellable *cancellable; // Owned, cancels the calls whose replies would use the adapter once it is freed
+    GHashTable *gatt_objects; // Owned, device path -> (object path -> interfaces and properties)
+    const char *gatt_cache_directory; // Owned
 
     Advertisement *advertisement; // Borrowed
 };
 
+/*
+ * Routes the PropertiesChanged signals of one connection to its adapters. Signals are dispatched on the thread that
+ * registered the first adapter of the connection, so all adapters on a connection must live on the same thread.
+ */
+typedef struct binc_properties_router {
+    GDBusConnection *connection; // Borrowed
+    guint subscription;
+    GHashTable *adapters_by_path; // Borrowed adapters
+} PropertiesRouter;
+
+// Routers by connection, guarded by the lock since adapters on different connections may live on different threads
+static GHashTable *routers = NULL;
+G_LOCK_DEFINE_STATIC(routers);
+
+static void unregister_adapter(Adapter *adapter);
+
 static void remove_signal_subscribers(Adapter *adapter) {
     g_assert(adapter != NULL);
 
-    g_dbus_connection_signal_unsubscribe(adapter->connection, adapter->device_prop_changed);
-    adapter->device_prop_changed = 0;
-    g_dbus_connection_signal_unsubscribe(adapter->connection, adapter->adapter_prop_changed);
-    adapter->device_prop_changed = 0;
+    unregister_adapter(adapter);
     g_dbus_connection_signal_unsubscribe(adapter->connection, adapter->iface_added);
     adapter->iface_added = 0;
     g_dbus_connection_signal_unsubscribe(adapter->connection, adapter->iface_removed);
@@ -110,10 +166,6 @@ static void remove_signal_subscribers(Adapter *adapter) {
 static void free_discovery_filter(Adapter *adapter) {
     g_assert(adapter != NULL);
 
-    for (guint i = 0; i < adapter->discovery_filter.services->len; i++) {
-        char *uuid_filter = g_ptr_array_index(adapter->discovery_filter.services, i);
-        g_free(uuid_filter);
-    }
     g_ptr_array_free(adapter->discovery_filter.services, TRUE);
     adapter->discovery_filter.services = NULL;
 
@@ -131,18 +183,62 @@ void binc_adapter_free(Adapter *adapter) {
         adapter->discovery_filter.services = NULL;
     }
 
+    if (adapter->device_cache_sweep_timeout != 0) {
+        binc_source_remove(adapter->device_cache_sweep_timeout);
+        adapter->device_cache_sweep_timeout = 0;
+    }
+
+    if (adapter->device_cache_sweep_idle != 0) {
+        binc_source_remove(adapter->device_cache_sweep_idle);
+        adapter->device_cache_sweep_idle = 0;
+    }
+    g_queue_clear_full(&adapter->device_removals, g_free);
+    g_cancellable_cancel(adapter->cancellable);
+
+    // Drop the batch first, freeing the devices would otherwise remove them from it one by one
+    if (adapter->discovery_batch_timeout != 0) {
+        binc_source_remove(adapter->discovery_batch_timeout);
+        adapter->discovery_batch_timeout = 0;
+    }
+    g_ptr_array_free(adapter->discovery_batch, TRUE);
+    adapter->discovery_batch = NULL;
+    if (adapter->discovery_held_timeout != 0) {
+        binc_source_remove(adapter->discovery_held_timeout);
+        adapter->discovery_held_timeout = 0;
+    }
+    g_ptr_array_free(adapter->discovery_held, TRUE);
+    adapter->discovery_held = NULL;
+
     if (adapter->devices_cache != NULL) {
         g_hash_table_destroy(adapter->devices_cache);
         adapter->devices_cache = NULL;
     }
 
+    if (adapter->scan_filter != NULL) {
+        binc_scan_filter_free(adapter->scan_filter);
+        adapter->scan_filter = NULL;
+    }
+    binc_address_set_free(adapter->scan_filter_rejected);
+    adapter->scan_filter_rejected = NULL;
+
+    if (adapter->gatt_objects != NULL) {
+        g_hash_table_destroy(adapter->gatt_objects);
+        adapter->gatt_objects = NULL;
+    }
+
     g_free((char *) adapter->path);
     adapter->path = NULL;
 
     g_free((char *) adapter->address);
     adapter->address = NULL;
 
+    g_free((char *) adapter->gatt_cache_directory);
+    adapter->gatt_cache_directory = NULL;
+
     adapter->connection = NULL;
+
+    g_object_unref(adapter->cancellable);
+    adapter->cancellable = NULL;
     g_free(adapter);
 }
 
@@ -186,32 +282,22 @@ static void binc_internal_set_discovery_state(Adapter *adapter, DiscoveryState d
     g_assert(adapter != NULL);
     if (adapter->discovery_state == discovery_state) return;
 
+    if (discovery_state == BINC_DISCOVERY_STARTED) {
+        adapter->discovery_generation++;
+    }
     adapter->discovery_state = discovery_state;
     if (adapter->discoveryStateCallback != NULL) {
         adapter->discoveryStateCallback(adapter, adapter->discovery_state, NULL);
     }
 }
 
-static void binc_internal_adapter_changed(__attribute__((unused)) GDBusConnection *conn,
-                                          __attribute__((unused)) const gchar *sender,
-                                          __attribute__((unused)) const gchar *path,
-                                          __attribute__((unused)) const gchar *interface,
-                                          __attribute__((unused)) const gchar *signal,
-                                          GVariant *parameters,
-                                          void *user_data) {
-
-    GVariantIter *properties_changed = NULL;
-    GVariantIter *properties_invalidated = NULL;
-    const char *iface = NULL;
+static void binc_internal_adapter_changed(Adapter *adapter, GVariant *changed_properties) {
     const char *property_name = NULL;
     GVariant *property_value = NULL;
+    GVariantIter iter;
 
-    Adapter *adapter = (Adapter *) user_data;
-    g_assert(adapter != NULL);
-
-    g_assert(g_str_equal(g_variant_get_type_string(parameters), "(sa{sv}as)"));
-    g_variant_get(parameters, "(&sa{sv}as)", &iface, &properties_changed, &properties_invalidated);
-    while (g_variant_iter_loop(properties_changed, "{&sv}", &property_name, &property_value)) {
+    g_variant_iter_init(&iter, changed_properties);
+    while (g_variant_iter_loop(&iter, "{&sv}", &property_name, &property_value)) {
         if (g_str_equal(property_name, ADAPTER_PROPERTY_POWERED)) {
             adapter->powered = g_variant_get_boolean(property_value);
             if (adapter->poweredStateCallback != NULL) {
@@ -229,12 +315,6 @@ static void binc_internal_adapter_changed(__attribute__((unused)) GDBusConnectio
             adapter->discoverable = g_variant_get_boolean(property_value);
         }
     }
-
-    if (properties_changed != NULL)
-        g_variant_iter_free(properties_changed);
-
-    if (properties_invalidated != NULL)
-        g_variant_iter_free(properties_invalidated);
 }
 
 static gboolean binc_g_str_has_prefix(const char* name, const char* pattern)
@@ -263,8 +343,8 @@ static gboolean matches_discovery_filter(Adapter *adapter, Device *device) {
         if (count == 0) return TRUE;
 
         for (guint i = 0; i < count; i++) {
-            const char *uuid_filter = g_ptr_array_index(services_filter, i);
-            if (binc_device_has_service(device, uuid_filter)) {
+            const Uuid *uuid_filter = g_ptr_array_index(services_filter, i);
+            if (binc_device_has_service_uuid(device, uuid_filter)) {
                 return TRUE;
             }
         }
@@ -273,6 +353,78 @@ static gboolean matches_discovery_filter(Adapter *adapter, Device *device) {
     return TRUE;
 }
 
+static gboolean is_first_discovery_report(const Adapter *adapter, const DiscoveryReport *report) {
+    return report->generation != adapter->discovery_generation || report->time == 0;
+}
+
+static gboolean matches_discovery_policy(const Adapter *adapter, Device *device) {
+    const DiscoveryPolicy *policy = &adapter->discovery_policy;
+    const DiscoveryReport *report = binc_device_get_discovery_report(device);
+
+    // Devices are always reported the first time in a discovery session
+    if (is_first_discovery_report(adapter, report)) return TRUE;
+    if (!policy->suppress_unchanged) return TRUE;
+
+    if (binc_device_get_payload_hash(device) != report->payload_hash) return TRUE;
+    return policy->rssi_delta > 0 && (guint) ABS(binc_device_get_rssi(device) - report->rssi) >= policy->rssi_delta;
+}
+
+static gboolean binc_internal_deliver_discovery_batch(gpointer user_data) {
+    Adapter *adapter = (Adapter *) user_data;
+    GPtrArray *batch = adapter->discovery_batch;
+    if (batch->len == 0) {
+        adapter->discovery_batch_timeout = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    // Devices are only removed from the cache from the main loop, so the batch stays valid during the callback
+    if (adapter->discoveryBatchCallback != NULL) {
+        adapter->discoveryBatchCallback(adapter, (Device *const *) batch->pdata, batch->len);
+    }
+    for (guint i = 0; i < batch->len; i++) {
+        binc_device_get_discovery_report(g_ptr_array_index(batch, i))->pending = FALSE;
+    }
+    g_ptr_array_set_size(batch, 0);
+    return G_SOURCE_CONTINUE;
+}
+
+static void deliver_discovery_result(Adapter *adapter, Device *device);
+
+static gboolean binc_internal_deliver_held_results(gpointer user_data) {
+    Adapter *adapter = (Adapter *) user_data;
+    adapter->discovery_held_timeout = 0;
+
+    // Swap the held devices out first, the ones that are not due yet are held again
+    GPtrArray *held = adapter->discovery_held;
+    adapter->discovery_held = g_ptr_array_new();
+    for (guint i = 0; i < held->len; i++) {
+        Device *device = g_ptr_array_index(held, i);
+        binc_device_get_discovery_report(device)->held = FALSE;
+        if (adapter->discovery_state == BINC_DISCOVERY_STARTED) {
+            deliver_discovery_result(adapter, device);
+        }
+    }
+    g_ptr_array_free(held, TRUE);
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Hold back a result that arrived within min_interval_ms of the previous one. It is delivered with the state the
+ * device has once the interval expired, so the last update is never lost.
+ */
+static void binc_internal_hold_discovery_result(Adapter *adapter, Device *device, gint64 due, gint64 now) {
+    binc_device_get_discovery_report(device)->held = TRUE;
+    g_ptr_array_add(adapter->discovery_held, device);
+
+    if (adapter->discovery_held_timeout != 0 && adapter->discovery_held_due <= due) return;
+    if (adapter->discovery_held_timeout != 0) {
+        binc_source_remove(adapter->discovery_held_timeout);
+    }
+    guint delay_ms = (guint) ((due - now + G_TIME_SPAN_MILLISECOND - 1) / G_TIME_SPAN_MILLISECOND);
+    adapter->discovery_held_due = due;
+    adapter->discovery_held_timeout = binc_timeout_add(delay_ms, binc_internal_deliver_held_results, adapter);
+}
+
 static void deliver_discovery_result(Adapter *adapter, Device *device) {
     g_assert(adapter != NULL);
     g_assert(device != NULL);
@@ -281,12 +433,334 @@ static void deliver_discovery_result(Adapter *adapter, Device *device) {
         // Double check if the device matches the discovery filter
         if (!matches_discovery_filter(adapter, device)) return;
 
-        if (adapter->discoveryResultCallback != NULL) {
+        DiscoveryReport *report = binc_device_get_discovery_report(device);
+        if (report->pending || report->held) return;
+        if (!matches_discovery_policy(adapter, device)) return;
+
+        gint64 now = g_get_monotonic_time();
+        gint64 due = report->time + (gint64) adapter->discovery_policy.min_interval_ms * G_TIME_SPAN_MILLISECOND;
+        if (!is_first_discovery_report(adapter, report) && now < due) {
+            binc_internal_hold_discovery_result(adapter, device, due, now);
+            return;
+        }
+
+        report->generation = adapter->discovery_generation;
+        report->time = now;
+        report->rssi = binc_device_get_rssi(device);
+        if (adapter->discovery_policy.suppress_unchanged) {
+            report->payload_hash = binc_device_get_payload_hash(device);
+        }
+
+        if (adapter->discovery_policy.batch_interval_ms > 0 && adapter->discoveryBatchCallback != NULL) {
+            report->pending = TRUE;
+            g_ptr_array_add(adapter->discovery_batch, device);
+            if (adapter->discovery_batch_timeout == 0) {
+                adapter->discovery_batch_timeout = binc_timeout_add(adapter->discovery_policy.batch_interval_ms,
+                                                                    binc_internal_deliver_discovery_batch, adapter);
+            }
+        } else if (adapter->discoveryResultCallback != NULL) {
             adapter->discoveryResultCallback(adapter, device);
         }
     }
 }
 
+static void binc_internal_free_cached_device(Device *device) {
+    DiscoveryReport *report = binc_device_get_discovery_report(device);
+    Adapter *adapter = binc_device_get_adapter(device);
+    if (report->pending && adapter->discovery_batch != NULL) {
+        g_ptr_array_remove_fast(adapter->discovery_batch, device);
+    }
+    if (report->held && adapter->discovery_held != NULL) {
+        g_ptr_array_remove_fast(adapter->discovery_held, device);
+    }
+    binc_device_free(device);
+}
+
+static gboolean is_gatt_interface(const char *interface_name) {
+    return g_str_equal(interface_name, INTERFACE_SERVICE) ||
+           g_str_equal(interface_name, INTERFACE_CHARACTERISTIC) ||
+           g_str_equal(interface_name, INTERFACE_DESCRIPTOR);
+}
+
+/*
+ * Returns the length of the path of the device a GATT object belongs to, or 0 if object_path is not below a device
+ */
+static gsize gatt_object_device_path_length(const Adapter *adapter, const char *object_path) {
+    size_t adapter_path_length = strlen(adapter->path);
+    if (strncmp(object_path, adapter->path, adapter_path_length) != 0 ||
+        object_path[adapter_path_length] != '/') {
+        return 0;
+    }
+
+    const char *device_end = strchr(object_path + adapter_path_length + 1, '/');
+    if (device_end == NULL) return 0;
+    return (gsize) (device_end - object_path);
+}
+
+static char *gatt_object_device_path(const Adapter *adapter, const char *object_path) {
+    gsize length = gatt_object_device_path_length(adapter, object_path);
+    return length > 0 ? g_strndup(object_path, length) : NULL;
+}
+
+static void binc_internal_gatt_object_added(Adapter *adapter, const char *object_path, GVariant *interfaces) {
+    char *device_path = gatt_object_device_path(adapter, object_path);
+    if (device_path == NULL) return;
+
+    GHashTable *objects = g_hash_table_lookup(adapter->gatt_objects, device_path);
+    if (objects == NULL) {
+        objects = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_variant_unref);
+        g_hash_table_insert(adapter->gatt_objects, g_strdup(device_path), objects);
+    }
+
+    // BlueZ adds each GATT object with all of its interfaces at once
+    g_hash_table_insert(objects, g_strdup(object_path), g_variant_ref(interfaces));
+
+    Device *device = g_hash_table_lookup(adapter->devices_cache, device_path);
+    if (device != NULL) {
+        binc_device_gatt_object_added(device, object_path, interfaces);
+    }
+    g_free(device_path);
+}
+
+static void binc_internal_gatt_object_removed(Adapter *adapter, const char *object_path) {
+    char *device_path = gatt_object_device_path(adapter, object_path);
+    if (device_path == NULL) return;
+
+    GHashTable *objects = g_hash_table_lookup(adapter->gatt_objects, device_path);
+    if (objects != NULL) {
+        g_hash_table_remove(objects, object_path);
+        if (g_hash_table_size(objects) == 0) {
+            g_hash_table_remove(adapter->gatt_objects, device_path);
+        }
+    }
+
+    Device *device = g_hash_table_lookup(adapter->devices_cache, device_path);
+    if (device != NULL) {
+        binc_device_gatt_object_removed(device, object_path);
+    }
+    g_free(device_path);
+}
+
+/*
+ * Merge a PropertiesChanged signal into the mirrored object, so a tree collected later does not pick up a stale
+ * Notifying or MTU. Value is left out, it changes with every notification and is never taken from the mirror.
+ */
+static void binc_internal_gatt_object_changed(Adapter *adapter, const char *object_path, const char *interface_name,
+                                              GVariant *changed_properties, GVariant *invalidated_properties) {
+    const char *property_name = NULL;
+    GVariant *property_value = NULL;
+    GVariantIter iter;
+
+    gboolean relevant = g_variant_n_children(invalidated_properties) > 0;
+    g_variant_iter_init(&iter, changed_properties);
+    while (!relevant && g_variant_iter_next(&iter, "{&sv}", &property_name, &property_value)) {
+        relevant = !g_str_equal(property_name, CHARACTERISTIC_PROPERTY_VALUE);
+        g_variant_unref(property_value);
+    }
+    if (!relevant) return;
+
+    char *device_path = gatt_object_device_path(adapter, object_path);
+    if (device_path == NULL) return;
+
+    GHashTable *objects = g_hash_table_lookup(adapter->gatt_objects, device_path);
+    g_free(device_path);
+    GVariant *interfaces = objects != NULL ? g_hash_table_lookup(objects, object_path) : NULL;
+    if (interfaces == NULL) return;
+
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sa{sv}}"));
+
+    const char *name = NULL;
+    GVariant *properties = NULL;
+    GVariantIter interfaces_iter;
+    g_variant_iter_init(&interfaces_iter, interfaces);
+    while (g_variant_iter_loop(&interfaces_iter, "{&s@a{sv}}", &name, &properties)) {
+        if (!g_str_equal(name, interface_name)) {
+            g_variant_builder_add(&builder, "{s@a{sv}}", name, properties);
+            continue;
+        }
+
+        GVariantDict dict;
+        g_variant_dict_init(&dict, properties);
+        g_variant_iter_init(&iter, changed_properties);
+        while (g_variant_iter_loop(&iter, "{&sv}", &property_name, &property_value)) {
+            if (!g_str_equal(property_name, CHARACTERISTIC_PROPERTY_VALUE)) {
+                g_variant_dict_insert_value(&dict, property_name, property_value);
+            }
+        }
+        g_variant_iter_init(&iter, invalidated_properties);
+        while (g_variant_iter_next(&iter, "&s", &property_name)) {
+            g_variant_dict_remove(&dict, property_name);
+        }
+        g_variant_builder_add(&builder, "{s@a{sv}}", name, g_variant_dict_end(&dict));
+    }
+
+    g_hash_table_insert(objects, g_strdup(object_path), g_variant_ref_sink(g_variant_builder_end(&builder)));
+}
+
+GHashTable *binc_adapter_get_gatt_objects(const Adapter *adapter, const char *device_path) {
+    g_assert(adapter != NULL);
+    g_assert(device_path != NULL);
+
+    return g_hash_table_lookup(adapter->gatt_objects, device_path);
+}
+
+static void binc_internal_remove_device_cb(GObject *source_object,
+                                           GAsyncResult *res,
+                                           gpointer user_data);
+
+/*
+ * Keep a few RemoveDevice calls in flight, so evicting many devices neither floods bluetoothd nor waits per device
+ */
+static void binc_internal_pump_device_removals(Adapter *adapter) {
+    while (adapter->device_removals_in_flight < REMOVE_DEVICE_PIPELINE_DEPTH &&
+           !g_queue_is_empty(&adapter->device_removals)) {
+        char *path = g_queue_pop_head(&adapter->device_removals);
+        adapter->device_removals_in_flight++;
+        g_dbus_connection_call(adapter->connection,
+                               BLUEZ_DBUS,
+                               adapter->path,
+                               INTERFACE_ADAPTER,
+                               METHOD_REMOVE_DEVICE,
+                               g_variant_new("(o)", path),
+                               NULL,
+                               G_DBUS_CALL_FLAGS_NONE,
+                               -1,
+                               adapter->cancellable,
+                               (GAsyncReadyCallback) binc_internal_remove_device_cb,
+                               adapter);
+        g_free(path);
+    }
+}
+
+static void binc_internal_remove_device_cb(GObject *source_object,
+                                           GAsyncResult *res,
+                                           gpointer user_data) {
+    GError *error = NULL;
+    GVariant *value = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), res, &error);
+    if (value != NULL) {
+        g_variant_unref(value);
+    }
+
+    // The adapter was freed
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_clear_error(&error);
+        return;
+    }
+
+    Adapter *adapter = (Adapter *) user_data;
+    g_assert(adapter != NULL);
+
+    if (error != NULL) {
+        log_debug(TAG, "failed to remove evicted device (error %d: %s)", error->code, error->message);
+        g_clear_error(&error);
+    }
+
+    adapter->device_removals_in_flight--;
+    binc_internal_pump_device_removals(adapter);
+}
+
+static gboolean is_evictable(const Device *device) {
+    return binc_device_get_connection_state(device) == BINC_DISCONNECTED &&
+           binc_device_get_bonding_state(device) == BINC_BOND_NONE &&
+           !binc_device_get_paired(device) &&
+           !binc_device_get_auto_reconnect(device);
+}
+
+static gint compare_last_seen(gconstpointer a, gconstpointer b) {
+    gint64 last_seen_a = binc_device_get_last_seen(*(Device *const *) a);
+    gint64 last_seen_b = binc_device_get_last_seen(*(Device *const *) b);
+    return (last_seen_a > last_seen_b) - (last_seen_a < last_seen_b);
+}
+
+static void binc_internal_evict_device(Adapter *adapter, Device *device) {
+    const char *path = binc_device_get_path(device);
+    log_debug(TAG, "evicting %s", path);
+
+    if (adapter->deviceEvictedCallback != NULL) {
+        adapter->deviceEvictedCallback(adapter, device);
+    }
+
+    if (adapter->device_cache_remove_from_bluez) {
+        g_queue_push_tail(&adapter->device_removals, g_strdup(path));
+    }
+    g_hash_table_remove(adapter->gatt_objects, path);
+    g_hash_table_remove(adapter->devices_cache, path);
+}
+
+/*
+ * Evict idle devices first, then the least recently seen ones until the cache is back under 90% of its limits,
+ * so a sweep is not needed again for every new device
+ */
+static void binc_internal_sweep_device_cache(Adapter *adapter) {
+    gint64 now = g_get_monotonic_time();
+    gint64 ttl = (gint64) adapter->device_cache_idle_ttl_seconds * G_USEC_PER_SEC;
+    guint count = g_hash_table_size(adapter->devices_cache);
+    gsize bytes = 0;
+
+    GPtrArray *candidates = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, adapter->devices_cache);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        Device *device = (Device *) value;
+        bytes += binc_device_get_memory_size(device);
+        if (is_evictable(device)) {
+            g_ptr_array_add(candidates, device);
+        }
+    }
+    g_ptr_array_sort(candidates, compare_last_seen);
+
+    guint max_devices = adapter->device_cache_max_devices > 0 ? adapter->device_cache_max_devices / 10 * 9 : G_MAXUINT;
+    gsize max_bytes = adapter->device_cache_max_bytes > 0 ? adapter->device_cache_max_bytes / 10 * 9 : G_MAXSIZE;
+    gboolean over_limit = (adapter->device_cache_max_devices > 0 && count > adapter->device_cache_max_devices) ||
+                          (adapter->device_cache_max_bytes > 0 && bytes > adapter->device_cache_max_bytes);
+
+    guint evicted = 0;
+    for (guint i = 0; i < candidates->len; i++) {
+        Device *device = g_ptr_array_index(candidates, i);
+        gboolean expired = ttl > 0 && now - binc_device_get_last_seen(device) > ttl;
+        gboolean needs_room = over_limit && (count > max_devices || bytes > max_bytes);
+        if (!expired && !needs_room) break;
+
+        bytes -= MIN(bytes, binc_device_get_memory_size(device));
+        count--;
+        evicted++;
+        binc_internal_evict_device(adapter, device);
+    }
+    g_ptr_array_free(candidates, TRUE);
+
+    if (evicted > 0) {
+        log_debug(TAG, "evicted %u devices, %u left", evicted, count);
+        binc_internal_pump_device_removals(adapter);
+    }
+}
+
+static gboolean binc_internal_device_cache_sweep_timeout(gpointer user_data) {
+    Adapter *adapter = (Adapter *) user_data;
+    binc_internal_sweep_device_cache(adapter);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean binc_internal_device_cache_sweep_idle(gpointer user_data) {
+    Adapter *adapter = (Adapter *) user_data;
+    adapter->device_cache_sweep_idle = 0;
+    binc_internal_sweep_device_cache(adapter);
+    return G_SOURCE_REMOVE;
+}
+
+static void binc_internal_add_device(Adapter *adapter, Device *device) {
+    // The key is borrowed from the device, a device path never changes
+    g_hash_table_replace(adapter->devices_cache, (gpointer) binc_device_get_path(device), device);
+
+    // Sweep from the main loop, the caller may still use devices that would be evicted
+    if (adapter->device_cache_max_devices > 0 &&
+        g_hash_table_size(adapter->devices_cache) > adapter->device_cache_max_devices &&
+        adapter->device_cache_sweep_idle == 0) {
+        adapter->device_cache_sweep_idle = binc_idle_add(binc_internal_device_cache_sweep_idle, adapter);
+    }
+}
+
 static void binc_internal_device_disappeared(__attribute__((unused)) GDBusConnection *conn,
                                              __attribute__((unused)) const gchar *sender_name,
                                              __attribute__((unused)) const gchar *object_path,
@@ -310,6 +784,14 @@ static void binc_internal_device_disappeared(__attribute__((unused)) GDBusConnec
             if (g_hash_table_lookup(adapter->devices_cache, object) != NULL) {
                 g_hash_table_remove(adapter->devices_cache, object);
             }
+            g_hash_table_remove(adapter->gatt_objects, object);
+
+            guint64 address = 0;
+            if (binc_address_parse_path(object, &address)) {
+                binc_address_set_remove(adapter->scan_filter_rejected, address);
+            }
+        } else if (is_gatt_interface(interface_name)) {
+            binc_internal_gatt_object_removed(adapter, object);
         }
     }
 
@@ -317,6 +799,113 @@ static void binc_internal_device_disappeared(__attribute__((unused)) GDBusConnec
         g_variant_iter_free(interfaces);
 }
 
+static gboolean is_address_allowed(const Adapter *adapter, guint64 address) {
+    if (adapter->address_allowlist != NULL && !binc_address_set_contains(adapter->address_allowlist, address)) {
+        return FALSE;
+    }
+    return adapter->address_denylist == NULL || !binc_address_set_contains(adapter->address_denylist, address);
+}
+
+static gboolean is_device_in_use(GVariant *properties) {
+    gboolean value = FALSE;
+    if (g_variant_lookup(properties, DEVICE_PROPERTY_CONNECTED, "b", &value) && value) return TRUE;
+    return g_variant_lookup(properties, DEVICE_PROPERTY_PAIRED, "b", &value) && value;
+}
+
+/*
+ * Run the scan filter on all properties of a device and remember a rejection by address, so later updates of the
+ * device are dropped without running the filter, allocating a Device or asking BlueZ for its properties
+ */
+static gboolean binc_internal_check_scan_filter(Adapter *adapter, const char *path, GVariant *properties) {
+    gboolean matches = binc_scan_filter_matches(adapter->scan_filter, path, properties);
+    guint64 address = 0;
+    if (binc_address_parse_path(path, &address)) {
+        if (matches) {
+            binc_address_set_remove(adapter->scan_filter_rejected, address);
+        } else {
+            binc_address_set_add(adapter->scan_filter_rejected, address);
+        }
+    }
+    return matches;
+}
+
+static gboolean has_advertisement_data(GVariant *properties) {
+    GVariant *value = g_variant_lookup_value(properties, DEVICE_PROPERTY_MANUFACTURER_DATA, NULL);
+    if (value == NULL) {
+        value = g_variant_lookup_value(properties, DEVICE_PROPERTY_SERVICE_DATA, NULL);
+    }
+    if (value == NULL) return FALSE;
+
+    g_variant_unref(value);
+    return TRUE;
+}
+
+/*
+ * Decides on the path and raw properties whether a new device is worth a Device. The address lists come first as
+ * they only need the path. Connected and paired devices are always accepted, the application is using them.
+ *
+ * @param partial TRUE if properties only holds the changed properties, a device the scan filter can't decide on then
+ * is accepted and checked again once all its properties are known. A device the filter rejected before is only
+ * checked again when its advertisement data changed.
+ */
+static gboolean accepts_new_device(Adapter *adapter, const char *path, GVariant *properties, gboolean partial) {
+    guint64 address = 0;
+    gboolean has_address = binc_address_parse_path(path, &address);
+    if (has_address && !is_address_allowed(adapter, address)) {
+        return is_device_in_use(properties);
+    }
+
+    if (adapter->scan_filter == NULL) return TRUE;
+
+    // Devices in use are checked too, so their discovery results are filtered once they are not in use anymore
+    if (!partial) return binc_internal_check_scan_filter(adapter, path, properties) || is_device_in_use(properties);
+    if (is_device_in_use(properties)) return TRUE;
+
+    if (has_address && binc_address_set_contains(adapter->scan_filter_rejected, address) &&
+        !has_advertisement_data(properties)) {
+        return FALSE;
+    }
+
+    ScanFilterResult result = binc_scan_filter_check_changed(adapter->scan_filter, path, properties);
+    if (has_address && result == BINC_SCAN_FILTER_NO_MATCH) {
+        binc_address_set_add(adapter->scan_filter_rejected, address);
+    } else if (has_address && result == BINC_SCAN_FILTER_MATCH) {
+        binc_address_set_remove(adapter->scan_filter_rejected, address);
+    }
+    return result != BINC_SCAN_FILTER_NO_MATCH;
+}
+
+/*
+ * The address lists and the scan filter applied to a device that already exists, with the same exemption for devices
+ * in use. The address comes from the path as the Address property may not have arrived yet. The device holds its
+ * whole advertisement, so the filter only runs again when the advertisement data changed and the last verdict is
+ * used for the other updates.
+ */
+static gboolean accepts_discovery_result(Adapter *adapter, const Device *device, DevicePropertyFlags changed) {
+    if (binc_device_get_connection_state(device) != BINC_DISCONNECTED ||
+        binc_device_get_bonding_state(device) == BINC_BONDED ||
+        binc_device_get_paired(device)) {
+        return TRUE;
+    }
+
+    const char *path = binc_device_get_path(device);
+    guint64 address = 0;
+    gboolean has_address = binc_address_parse_path(path, &address);
+    if (has_address && !is_address_allowed(adapter, address)) {
+        return FALSE;
+    }
+
+    if (adapter->scan_filter == NULL) return TRUE;
+
+    if (changed & (BINC_DEVICE_PROPERTY_MANUFACTURER_DATA | BINC_DEVICE_PROPERTY_SERVICE_DATA)) {
+        GVariant *properties = binc_device_get_advertisement_properties(device);
+        gboolean matches = binc_internal_check_scan_filter(adapter, path, properties);
+        g_variant_unref(properties);
+        return matches;
+    }
+    return !has_address || !binc_address_set_contains(adapter->scan_filter_rejected, address);
+}
+
 static void binc_internal_device_appeared(__attribute__((unused)) GDBusConnection *conn,
                                           __attribute__((unused)) const gchar *sender_name,
                                           __attribute__((unused)) const gchar *object_path,
@@ -336,20 +925,16 @@ static void binc_internal_device_appeared(__attribute__((unused)) GDBusConnectio
     g_assert(g_str_equal(g_variant_get_type_string(parameters), "(oa{sa{sv}})"));
     g_variant_get(parameters, "(&oa{sa{sv}})", &object, &interfaces);
     while (g_variant_iter_loop(interfaces, "{&s@a{sv}}", &interface_name, &properties)) {
-        if (g_str_equal(interface_name, INTERFACE_DEVICE)) {
-            Device *device = binc_device_create(object, adapter);
+        if (is_gatt_interface(interface_name)) {
+            GVariant *all_interfaces = g_variant_get_child_value(parameters, 1);
+            binc_internal_gatt_object_added(adapter, object, all_interfaces);
+            g_variant_unref(all_interfaces);
+        } else if (g_str_equal(interface_name, INTERFACE_DEVICE)) {
+            if (!accepts_new_device(adapter, object, properties, FALSE)) continue;
 
-            char *property_name = NULL;
-            GVariantIter iter;
-            GVariant *property_value = NULL;
-            g_variant_iter_init(&iter, properties);
-            while (g_variant_iter_loop(&iter, "{&sv}", &property_name, &property_value)) {
-                binc_internal_device_update_property(device, property_name, property_value);
-            }
-
-            g_hash_table_insert(adapter->devices_cache,
-                                g_strdup(binc_device_get_path(device)),
-                                device);
+            Device *device = binc_device_create(object, adapter);
+            binc_internal_device_update_properties(device, properties, NULL);
+            binc_internal_add_device(adapter, device);
 
             if (adapter->discovery_state == BINC_DISCOVERY_STARTED && binc_device_get_connection_state(device) == BINC_DISCONNECTED) {
                 deliver_discovery_result(adapter, device);
@@ -370,40 +955,53 @@ static void binc_internal_device_appeared(__attribute__((unused)) GDBusConnectio
         g_variant_iter_free(interfaces);
 }
 
-static void binc_internal_device_getall_properties_cb(__attribute__((unused)) GObject *source_object,
+typedef struct binc_getall_call {
+    Adapter *adapter; // Borrowed
+    char *path; // Owned
+} GetAllCall;
+
+static void binc_internal_device_getall_properties_cb(GObject *source_object,
                                                       GAsyncResult *res,
                                                       gpointer user_data) {
 
-    Device *device = (Device *) user_data;
-    g_assert(device != NULL);
+    GetAllCall *call = (GetAllCall *) user_data;
+    g_assert(call != NULL);
 
     GError *error = NULL;
-    GVariant *result = g_dbus_connection_call_finish(binc_device_get_dbus_connection(device), res, &error);
+    GVariant *result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), res, &error);
 
     if (error != NULL) {
         log_debug(TAG, "failed to call '%s' (error %d: %s)", "GetAll", error->code, error->message);
         g_clear_error(&error);
     }
 
-    if (result != NULL) {
-        GVariantIter *iter = NULL;
-        const char *property_name = NULL;
-        GVariant *property_value = NULL;
-
+    // Look the device up again since it may have been evicted meanwhile, a cancelled call means the adapter is gone
+    Device *device = result != NULL ? g_hash_table_lookup(call->adapter->devices_cache, call->path) : NULL;
+    if (device != NULL) {
         g_assert(g_str_equal(g_variant_get_type_string(result), "(a{sv})"));
-        g_variant_get(result, "(a{sv})", &iter);
-        while (g_variant_iter_loop(iter, "{&sv}", &property_name, &property_value)) {
-            binc_internal_device_update_property(device, property_name, property_value);
+        GVariant *properties = g_variant_get_child_value(result, 0);
+
+        // The device was created on changed properties only, so decide on all of them now
+        Adapter *adapter = call->adapter;
+        if (accepts_new_device(adapter, call->path, properties, FALSE)) {
+            binc_internal_device_update_properties(device, properties, NULL);
+        } else {
+            g_hash_table_remove(adapter->devices_cache, call->path);
         }
+        g_variant_unref(properties);
+    }
 
-        if (iter != NULL) {
-            g_variant_iter_free(iter);
-        }
+    if (result != NULL) {
         g_variant_unref(result);
     }
+    g_free(call->path);
+    g_free(call);
 }
 
 static void binc_internal_device_getall_properties(Adapter *adapter, Device *device) {
+    GetAllCall *call = g_new0(GetAllCall, 1);
+    call->adapter = adapter;
+    call->path = g_strdup(binc_device_get_path(device));
     g_dbus_connection_call(adapter->connection,
                            BLUEZ_DBUS,
                            binc_device_get_path(device),
@@ -413,48 +1011,28 @@ static void binc_internal_device_getall_properties(Adapter *adapter, Device *dev
                            G_VARIANT_TYPE("(a{sv})"),
                            G_DBUS_CALL_FLAGS_NONE,
                            -1,
-                           NULL,
+                           adapter->cancellable,
                            (GAsyncReadyCallback) binc_internal_device_getall_properties_cb,
-                           device);
+                           call);
 }
 
 
-static void binc_internal_device_changed(__attribute__((unused)) GDBusConnection *conn,
-                                         __attribute__((unused)) const gchar *sender,
-                                         const gchar *path,
-                                         __attribute__((unused)) const gchar *interface,
-                                         __attribute__((unused)) const gchar *signal,
-                                         GVariant *parameters,
-                                         void *user_data) {
-
-    GVariantIter *properties_changed = NULL;
-    GVariantIter *properties_invalidated = NULL;
-    const char *iface = NULL;
-    const char *property_name = NULL;
-    GVariant *property_value = NULL;
-
-    Adapter *adapter = (Adapter *) user_data;
-    g_assert(adapter != NULL);
-
+static void binc_internal_device_changed(Adapter *adapter, const char *path, GVariant *changed_properties) {
     Device *device = g_hash_table_lookup(adapter->devices_cache, path);
     if (device == NULL) {
+        if (!accepts_new_device(adapter, path, changed_properties, TRUE)) return;
+
         device = binc_device_create(path, adapter);
-        g_hash_table_insert(adapter->devices_cache, g_strdup(binc_device_get_path(device)), device);
+        binc_internal_add_device(adapter, device);
         binc_internal_device_getall_properties(adapter, device);
     } else {
-        gboolean isDiscoveryResult = FALSE;
+        binc_device_set_last_seen(device, g_get_monotonic_time());
         ConnectionState oldState = binc_device_get_connection_state(device);
-        g_assert(g_str_equal(g_variant_get_type_string(parameters), "(sa{sv}as)"));
-        g_variant_get(parameters, "(&sa{sv}as)", &iface, &properties_changed, &properties_invalidated);
-        while (g_variant_iter_loop(properties_changed, "{&sv}", &property_name, &property_value)) {
-            binc_internal_device_update_property(device, property_name, property_value);
-            if (g_str_equal(property_name, DEVICE_PROPERTY_RSSI) ||
-                g_str_equal(property_name, DEVICE_PROPERTY_MANUFACTURER_DATA) ||
-                g_str_equal(property_name, DEVICE_PROPERTY_SERVICE_DATA)) {
-                isDiscoveryResult = TRUE;
-            }
-        }
-        if (adapter->discovery_state == BINC_DISCOVERY_STARTED && isDiscoveryResult) {
+        DevicePropertyFlags present = BINC_DEVICE_PROPERTY_NONE;
+        DevicePropertyFlags changed = binc_internal_device_update_properties(device, changed_properties, &present);
+        gboolean isDiscoveryResult = (present & DISCOVERY_RESULT_PROPERTIES) != 0;
+        if (adapter->discovery_state == BINC_DISCOVERY_STARTED && isDiscoveryResult &&
+            accepts_discovery_result(adapter, device, changed)) {
             deliver_discovery_result(adapter, device);
         }
 
@@ -470,37 +1048,150 @@ static void binc_internal_device_changed(__attribute__((unused)) GDBusConnection
                 }
             }
         }
+
+        // The callbacks above may have removed the device
+        device = g_hash_table_lookup(adapter->devices_cache, path);
+        if (device != NULL && changed != BINC_DEVICE_PROPERTY_NONE && adapter->deviceChangedCallback != NULL) {
+            adapter->deviceChangedCallback(adapter, device, changed);
+        }
     }
+}
 
-    if (properties_changed != NULL)
-        g_variant_iter_free(properties_changed);
+/*
+ * Returns the device that object_path belongs to, without allocating since this runs for every notification
+ */
+static Device *binc_internal_get_device_of_object(const Adapter *adapter, const char *object_path) {
+    char buffer[DEVICE_PATH_BUFFER_SIZE];
+    gsize length = gatt_object_device_path_length(adapter, object_path);
+    if (length == 0) return NULL;
+
+    if (length < sizeof(buffer)) {
+        memcpy(buffer, object_path, length);
+        buffer[length] = '\0';
+        return g_hash_table_lookup(adapter->devices_cache, buffer);
+    }
 
-    if (properties_invalidated != NULL)
-        g_variant_iter_free(properties_invalidated);
+    char *device_path = g_strndup(object_path, length);
+    Device *device = g_hash_table_lookup(adapter->devices_cache, device_path);
+    g_free(device_path);
+    return device;
+}
+
+/*
+ * Returns the length of the adapter part of path, e.g. '/org/bluez/hci0', or 0 if there is none
+ */
+static gsize adapter_path_length(const char *path) {
+    guint slashes = 0;
+    for (gsize i = 0; path[i] != '\0'; i++) {
+        if (path[i] == '/' && ++slashes == 4) return i;
+    }
+    return slashes == 3 ? strlen(path) : 0;
+}
+
+static Adapter *binc_internal_get_adapter_of_object(const PropertiesRouter *router, const char *object_path) {
+    gsize length = adapter_path_length(object_path);
+    if (length == 0) return NULL;
+    if (object_path[length] == '\0') return g_hash_table_lookup(router->adapters_by_path, object_path);
+
+    char *adapter_path = g_strndup(object_path, length);
+    Adapter *adapter = g_hash_table_lookup(router->adapters_by_path, adapter_path);
+    g_free(adapter_path);
+    return adapter;
+}
+
+static void binc_internal_properties_changed(__attribute__((unused)) GDBusConnection *conn,
+                                             __attribute__((unused)) const gchar *sender,
+                                             const gchar *path,
+                                             __attribute__((unused)) const gchar *interface,
+                                             __attribute__((unused)) const gchar *signal,
+                                             GVariant *parameters,
+                                             void *user_data) {
+
+    const char *iface = NULL;
+    GVariant *changed_properties = NULL;
+    GVariant *invalidated_properties = NULL;
+
+    PropertiesRouter *router = (PropertiesRouter *) user_data;
+    Adapter *adapter = binc_internal_get_adapter_of_object(router, path);
+    if (adapter == NULL) return;
+
+    g_assert(g_str_equal(g_variant_get_type_string(parameters), "(sa{sv}as)"));
+    g_variant_get(parameters, "(&s@a{sv}@as)", &iface, &changed_properties, &invalidated_properties);
+
+    if (g_str_equal(iface, INTERFACE_CHARACTERISTIC)) {
+        binc_internal_gatt_object_changed(adapter, path, iface, changed_properties, invalidated_properties);
+        Device *device = binc_internal_get_device_of_object(adapter, path);
+        Characteristic *characteristic = device != NULL ? binc_device_get_characteristic_by_path(device, path) : NULL;
+        if (characteristic != NULL) {
+            binc_characteristic_handle_properties_changed(characteristic, changed_properties);
+        }
+    } else if (g_str_equal(iface, INTERFACE_DEVICE)) {
+        binc_internal_device_changed(adapter, path, changed_properties);
+    } else if (g_str_equal(iface, INTERFACE_ADAPTER) && g_str_equal(path, adapter->path)) {
+        binc_internal_adapter_changed(adapter, changed_properties);
+    }
+
+    g_variant_unref(changed_properties);
+    g_variant_unref(invalidated_properties);
+}
+
+static void free_router(gpointer user_data) {
+    PropertiesRouter *router = (PropertiesRouter *) user_data;
+    g_hash_table_destroy(router->adapters_by_path);
+    g_free(router);
+}
+
+/*
+ * All adapters on a connection share one PropertiesChanged subscription, so every signal is matched and parsed once
+ */
+static void register_adapter(Adapter *adapter) {
+    G_LOCK(routers);
+    if (routers == NULL) {
+        routers = g_hash_table_new(g_direct_hash, g_direct_equal);
+    }
+
+    PropertiesRouter *router = g_hash_table_lookup(routers, adapter->connection);
+    if (router == NULL) {
+        router = g_new0(PropertiesRouter, 1);
+        router->connection = adapter->connection;
+        router->adapters_by_path = g_hash_table_new(g_str_hash, g_str_equal);
+        router->subscription = g_dbus_connection_signal_subscribe(adapter->connection,
+                                                                  BLUEZ_DBUS,
+                                                                  INTERFACE_PROPERTIES,
+                                                                  SIGNAL_PROPERTIES_CHANGED,
+                                                                  NULL,
+                                                                  NULL,
+                                                                  G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                  binc_internal_properties_changed,
+                                                                  router,
+                                                                  free_router);
+        g_hash_table_insert(routers, adapter->connection, router);
+    }
+    g_hash_table_insert(router->adapters_by_path, (gpointer) adapter->path, adapter);
+    G_UNLOCK(routers);
+}
+
+static void unregister_adapter(Adapter *adapter) {
+    G_LOCK(routers);
+    PropertiesRouter *router = routers != NULL ? g_hash_table_lookup(routers, adapter->connection) : NULL;
+    if (router != NULL) {
+        g_hash_table_remove(router->adapters_by_path, adapter->path);
+        if (g_hash_table_size(router->adapters_by_path) == 0) {
+            // The router is freed by the subscription, once no signal can be dispatched to it anymore
+            g_hash_table_remove(routers, adapter->connection);
+            g_dbus_connection_signal_unsubscribe(router->connection, router->subscription);
+        }
+    }
+
+    if (routers != NULL && g_hash_table_size(routers) == 0) {
+        g_hash_table_destroy(routers);
+        routers = NULL;
+    }
+    G_UNLOCK(routers);
 }
 
 static void setup_signal_subscribers(Adapter *adapter) {
-    adapter->device_prop_changed = g_dbus_connection_signal_subscribe(adapter->connection,
-                                                                      BLUEZ_DBUS,
-                                                                      INTERFACE_PROPERTIES,
-                                                                      SIGNAL_PROPERTIES_CHANGED,
-                                                                      NULL,
-                                                                      INTERFACE_DEVICE,
-                                                                      G_DBUS_SIGNAL_FLAGS_NONE,
-                                                                      binc_internal_device_changed,
-                                                                      adapter,
-                                                                      NULL);
-
-    adapter->adapter_prop_changed = g_dbus_connection_signal_subscribe(adapter->connection,
-                                                                       BLUEZ_DBUS,
-                                                                       INTERFACE_PROPERTIES,
-                                                                       SIGNAL_PROPERTIES_CHANGED,
-                                                                       adapter->path,
-                                                                       INTERFACE_ADAPTER,
-                                                                       G_DBUS_SIGNAL_FLAGS_NONE,
-                                                                       binc_internal_adapter_changed,
-                                                                       adapter,
-                                                                       NULL);
+    register_adapter(adapter);
 
     adapter->iface_added = g_dbus_connection_signal_subscribe(adapter->connection,
                                                               BLUEZ_DBUS,
@@ -545,8 +1236,16 @@ static Adapter *binc_adapter_create(GDBusConnection *connection, const char *pat
     adapter->connection = connection;
     adapter->path = g_strdup(path);
     adapter->discovery_filter.rssi = -255;
+    adapter->discovery_policy.duplicate_data = TRUE;
+    adapter->discovery_batch = g_ptr_array_new();
+    adapter->discovery_held = g_ptr_array_new();
+    adapter->scan_filter_rejected = binc_address_set_create();
     adapter->devices_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                                   g_free, (GDestroyNotify) binc_device_free);
+                                                   NULL, (GDestroyNotify) binc_internal_free_cached_device);
+    adapter->gatt_objects = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  g_free, (GDestroyNotify) g_hash_table_destroy);
+    g_queue_init(&adapter->device_removals);
+    adapter->cancellable = g_cancellable_new();
     adapter->user_data = NULL;
     setup_signal_subscribers(adapter);
     return adapter;
@@ -567,12 +1266,7 @@ static Adapter *binc_internal_get_adapter_by_path(GPtrArray *adapters, const cha
     return NULL;
 }
 
-GPtrArray *binc_adapter_find_all(GDBusConnection *dbusConnection) {
-    g_assert(dbusConnection != NULL);
-
-    GPtrArray *binc_adapters = g_ptr_array_new();
-    log_debug(TAG, "finding adapters");
-
+static GVariant *get_managed_objects(GDBusConnection *dbusConnection) {
     GError *error = NULL;
     GVariant *result = g_dbus_connection_call_sync(dbusConnection,
                                                    BLUEZ_DBUS,
@@ -586,6 +1280,21 @@ GPtrArray *binc_adapter_find_all(GDBusConnection *dbusConnection) {
                                                    NULL,
                                                    &error);
 
+    if (error != NULL) {
+        log_error(TAG, "Error GetManagedObjects: %s", error->message);
+        g_clear_error(&error);
+    }
+    return result;
+}
+
+/*
+ * Create the adapters with the given name, or all adapters if name is NULL, together with their devices
+ */
+static GPtrArray *binc_internal_find_adapters(GDBusConnection *dbusConnection, const char *name) {
+    GPtrArray *binc_adapters = g_ptr_array_new();
+    log_debug(TAG, "finding adapters");
+
+    GVariant *result = get_managed_objects(dbusConnection);
     if (result) {
         GVariantIter *iter;
         const char *object_path;
@@ -601,6 +1310,8 @@ GPtrArray *binc_adapter_find_all(GDBusConnection *dbusConnection) {
             g_variant_iter_init(&iter2, ifaces_and_properties);
             while (g_variant_iter_loop(&iter2, "{&s@a{sv}}", &interface_name, &properties)) {
                 if (g_str_equal(interface_name, INTERFACE_ADAPTER)) {
+                    if (name != NULL && !g_str_equal(strrchr(object_path, '/') + 1, name)) continue;
+
                     Adapter *adapter = binc_adapter_create(dbusConnection, object_path);
                     char *property_name;
                     GVariantIter iter3;
@@ -620,17 +1331,17 @@ GPtrArray *binc_adapter_find_all(GDBusConnection *dbusConnection) {
                     g_ptr_array_add(binc_adapters, adapter);
                 } else if (g_str_equal(interface_name, INTERFACE_DEVICE)) {
                     Adapter *adapter = binc_internal_get_adapter_by_path(binc_adapters, object_path);
-                    Device *device = binc_device_create(object_path, adapter);
-                    g_hash_table_insert(adapter->devices_cache, g_strdup(binc_device_get_path(device)), device);
+                    if (adapter == NULL) continue;
 
-                    char *property_name;
-                    GVariantIter iter4;
-                    GVariant *property_value;
-                    g_variant_iter_init(&iter4, properties);
-                    while (g_variant_iter_loop(&iter4, "{&sv}", &property_name, &property_value)) {
-                        binc_internal_device_update_property(device, property_name, property_value);
-                    }
+                    Device *device = binc_device_create(object_path, adapter);
+                    binc_internal_add_device(adapter, device);
+                    binc_internal_device_update_properties(device, properties, NULL);
                     log_debug(TAG, "found device %s '%s'", object_path, binc_device_get_name(device));
+                } else if (is_gatt_interface(interface_name)) {
+                    Adapter *adapter = binc_internal_get_adapter_by_path(binc_adapters, object_path);
+                    if (adapter != NULL) {
+                        binc_internal_gatt_object_added(adapter, object_path, ifaces_and_properties);
+                    }
                 }
             }
         }
@@ -641,15 +1352,42 @@ GPtrArray *binc_adapter_find_all(GDBusConnection *dbusConnection) {
         g_variant_unref(result);
     }
 
-    if (error != NULL) {
-        log_error(TAG, "Error GetManagedObjects: %s", error->message);
-        g_clear_error(&error);
-    }
-
     log_debug(TAG, "found %d adapter%s", binc_adapters->len, binc_adapters->len > 1 ? "s" : "");
     return binc_adapters;
 }
 
+GPtrArray *binc_adapter_find_all(GDBusConnection *dbusConnection) {
+    g_assert(dbusConnection != NULL);
+    return binc_internal_find_adapters(dbusConnection, NULL);
+}
+
+GPtrArray *binc_adapter_find_all_names(GDBusConnection *dbusConnection) {
+    g_assert(dbusConnection != NULL);
+
+    GPtrArray *names = g_ptr_array_new_with_free_func(g_free);
+    GVariant *result = get_managed_objects(dbusConnection);
+    if (result) {
+        GVariantIter *iter;
+        const char *object_path;
+        GVariant *ifaces_and_properties;
+
+        g_variant_get(result, "(a{oa{sa{sv}}})", &iter);
+        while (g_variant_iter_loop(iter, "{&o@a{sa{sv}}}", &object_path, &ifaces_and_properties)) {
+            GVariant *properties = g_variant_lookup_value(ifaces_and_properties, INTERFACE_ADAPTER, NULL);
+            if (properties != NULL) {
+                g_ptr_array_add(names, g_strdup(strrchr(object_path, '/') + 1));
+                g_variant_unref(properties);
+            }
+        }
+
+        if (iter != NULL) {
+            g_variant_iter_free(iter);
+        }
+        g_variant_unref(result);
+    }
+    return names;
+}
+
 Adapter *binc_adapter_get_default(GDBusConnection *dbusConnection) {
     g_assert(dbusConnection != NULL);
 
@@ -672,19 +1410,13 @@ Adapter *binc_adapter_get(GDBusConnection *dbusConnection, const char *name) {
     g_assert(dbusConnection != NULL);
     g_assert(name != NULL && strlen(name) > 0);
 
+    // Only the adapter asked for is created, so devices of other adapters are not loaded at all
     Adapter *result = NULL;
-    GPtrArray *adapters = binc_adapter_find_all(dbusConnection);
+    GPtrArray *adapters = binc_internal_find_adapters(dbusConnection, name);
     if (adapters->len > 0) {
-        for (guint i = 0; i < adapters->len; i++) {
-            Adapter *adapter = g_ptr_array_index(adapters, i);
-            if (g_str_equal(binc_adapter_get_name(adapter), name)) {
-                result = adapter;
-            } else {
-                binc_adapter_free(g_ptr_array_index(adapters, i));
-            }
-        }
-        g_ptr_array_free(adapters, TRUE);
+        result = g_ptr_array_index(adapters, 0);
     }
+    g_ptr_array_free(adapters, TRUE);
     return result;
 }
 
@@ -827,7 +1559,8 @@ void binc_adapter_set_discovery_filter(Adapter *adapter, short rssi_threshold, c
     GVariantBuilder *arguments = g_variant_builder_new(G_VARIANT_TYPE_VARDICT);
     g_variant_builder_add(arguments, "{sv}", "Transport", g_variant_new_string("le"));
     g_variant_builder_add(arguments, "{sv}", DEVICE_PROPERTY_RSSI, g_variant_new_int16(rssi_threshold));
-    g_variant_builder_add(arguments, "{sv}", "DuplicateData", g_variant_new_boolean(TRUE));
+    g_variant_builder_add(arguments, "{sv}", "DuplicateData",
+                          g_variant_new_boolean(adapter->discovery_policy.duplicate_data));
 
     if (pattern != NULL) {
         g_variant_builder_add(arguments, "{sv}", "Pattern", g_variant_new_string(pattern));
@@ -836,10 +1569,10 @@ void binc_adapter_set_discovery_filter(Adapter *adapter, short rssi_threshold, c
     if (service_uuids != NULL && service_uuids->len > 0) {
         GVariantBuilder *uuids = g_variant_builder_new(G_VARIANT_TYPE_STRING_ARRAY);
         for (guint i = 0; i < service_uuids->len; i++) {
-            char *uuid = g_ptr_array_index(service_uuids, i);
-            g_assert(g_uuid_string_is_valid(uuid));
-            g_variant_builder_add(uuids, "s", uuid);
-            g_ptr_array_add(adapter->discovery_filter.services, g_strdup(uuid));
+            const Uuid *uuid = binc_uuid_intern_string(g_ptr_array_index(service_uuids, i));
+            g_assert(uuid != NULL);
+            g_variant_builder_add(uuids, "s", binc_uuid_get_string(uuid));
+            g_ptr_array_add(adapter->discovery_filter.services, (gpointer) uuid);
         }
         g_variant_builder_add(arguments, "{sv}", DEVICE_PROPERTY_UUIDS, g_variant_builder_end(uuids));
         g_variant_builder_unref(uuids);
@@ -919,6 +1652,63 @@ void binc_adapter_set_discovery_cb(Adapter *adapter, AdapterDiscoveryResultCallb
     adapter->discoveryResultCallback = callback;
 }
 
+void binc_adapter_set_discovery_batch_cb(Adapter *adapter, AdapterDiscoveryBatchCallback callback) {
+    g_assert(adapter != NULL);
+    adapter->discoveryBatchCallback = callback;
+}
+
+void binc_adapter_set_discovery_policy(Adapter *adapter, const DiscoveryPolicy *policy) {
+    g_assert(adapter != NULL);
+    g_assert(policy != NULL);
+
+    adapter->discovery_policy = *policy;
+
+    // Results that were waiting are delivered with the next batch, or right away when there are no batches anymore
+    if (policy->batch_interval_ms == 0 && adapter->discovery_batch_timeout != 0) {
+        binc_source_remove(adapter->discovery_batch_timeout);
+        adapter->discovery_batch_timeout = 0;
+        binc_internal_deliver_discovery_batch(adapter);
+    }
+
+    // Held results are checked against the new minimum interval
+    if (adapter->discovery_held_timeout != 0) {
+        binc_source_remove(adapter->discovery_held_timeout);
+        binc_internal_deliver_held_results(adapter);
+    }
+}
+
+void binc_adapter_set_scan_filter(Adapter *adapter, ScanFilter *filter) {
+    g_assert(adapter != NULL);
+
+    if (adapter->scan_filter != NULL) {
+        binc_scan_filter_free(adapter->scan_filter);
+    }
+    adapter->scan_filter = filter;
+
+    // Devices that were already created are checked on the advertisement they hold
+    binc_address_set_clear(adapter->scan_filter_rejected);
+    if (filter == NULL) return;
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, adapter->devices_cache);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        GVariant *properties = binc_device_get_advertisement_properties((Device *) value);
+        binc_internal_check_scan_filter(adapter, (const char *) key, properties);
+        g_variant_unref(properties);
+    }
+}
+
+void binc_adapter_set_address_allowlist(Adapter *adapter, const AddressSet *allowlist) {
+    g_assert(adapter != NULL);
+    adapter->address_allowlist = allowlist;
+}
+
+void binc_adapter_set_address_denylist(Adapter *adapter, const AddressSet *denylist) {
+    g_assert(adapter != NULL);
+    adapter->address_denylist = denylist;
+}
+
 void binc_adapter_set_discovery_state_cb(Adapter *adapter, AdapterDiscoveryStateChangeCallback callback) {
     g_assert(adapter != NULL);
     g_assert(callback != NULL);
@@ -1151,3 +1941,48 @@ void *binc_adapter_get_user_data(const Adapter *adapter) {
     g_assert(adapter != NULL);
     return adapter->user_data;
 }
+
+void binc_adapter_set_gatt_cache_directory(Adapter *adapter, const char *directory) {
+    g_assert(adapter != NULL);
+
+    g_free((char *) adapter->gatt_cache_directory);
+    adapter->gatt_cache_directory = g_strdup(directory);
+}
+
+void binc_adapter_set_device_cache_limits(Adapter *adapter, guint max_devices, guint idle_ttl_seconds,
+                                          gsize max_bytes) {
+    g_assert(adapter != NULL);
+
+    adapter->device_cache_max_devices = max_devices;
+    adapter->device_cache_idle_ttl_seconds = idle_ttl_seconds;
+    adapter->device_cache_max_bytes = max_bytes;
+
+    gboolean limited = max_devices > 0 || idle_ttl_seconds > 0 || max_bytes > 0;
+    if (limited && adapter->device_cache_sweep_timeout == 0) {
+        adapter->device_cache_sweep_timeout = binc_timeout_add(DEVICE_CACHE_SWEEP_INTERVAL_MS,
+                                                               binc_internal_device_cache_sweep_timeout, adapter);
+    } else if (!limited && adapter->device_cache_sweep_timeout != 0) {
+        binc_source_remove(adapter->device_cache_sweep_timeout);
+        adapter->device_cache_sweep_timeout = 0;
+    }
+}
+
+void binc_adapter_set_device_cache_remove_from_bluez(Adapter *adapter, gboolean remove) {
+    g_assert(adapter != NULL);
+    adapter->device_cache_remove_from_bluez = remove;
+}
+
+void binc_adapter_set_device_evicted_cb(Adapter *adapter, AdapterDeviceEvictedCallback callback) {
+    g_assert(adapter != NULL);
+    adapter->deviceEvictedCallback = callback;
+}
+
+void binc_adapter_set_device_changed_cb(Adapter *adapter, AdapterDeviceChangedCallback callback) {
+    g_assert(adapter != NULL);
+    adapter->deviceChangedCallback = callback;
+}
+
+const char *binc_adapter_get_gatt_cache_directory(const Adapter *adapter) {
+    g_assert(adapter != NULL);
+    return adapter->gatt_cache_directory;
+}
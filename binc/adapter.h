@@ -26,6 +26,7 @@
 
 #include <gio/gio.h>
 #include "forward_decl.h"
+#include "device.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -37,12 +38,45 @@ typedef enum DiscoveryState {
 
 typedef void (*AdapterDiscoveryResultCallback)(Adapter *adapter, Device *device);
 
+/*
+ * Called once per batch interval with the devices that had a discovery result since the last batch. The devices
+ * are borrowed and the array is only valid during the call.
+ */
+typedef void (*AdapterDiscoveryBatchCallback)(Adapter *adapter, Device *const *devices, guint count);
+
+/**
+ * How discovery results are delivered, see binc_adapter_set_discovery_policy(). All zero except duplicate_data
+ * reports every advertisement, which is the default.
+ */
+typedef struct binc_discovery_policy {
+    // Minimum time between two results for the same device, 0 for no minimum. Updates within it are reported after it
+    guint min_interval_ms;
+    // Only report a device again when its name, manufacturer data or service data changed
+    gboolean suppress_unchanged;
+    // With suppress_unchanged, still report a device when its RSSI moved this much, 0 to ignore RSSI changes
+    guint rssi_delta;
+    // Collect results and hand them to the batch callback once per interval, 0 to report them one by one
+    guint batch_interval_ms;
+    // Ask BlueZ to report every advertisement instead of only changed ones, used by the next discovery filter
+    gboolean duplicate_data;
+} DiscoveryPolicy;
+
 typedef void (*AdapterDiscoveryStateChangeCallback)(Adapter *adapter, DiscoveryState state, const GError *error);
 
 typedef void (*AdapterPoweredStateChangeCallback)(Adapter *adapter, gboolean state);
 
 typedef void (*RemoteCentralConnectionStateCallback)(Adapter *adapter, Device *device);
 
+/*
+ * Called right before an evicted device is freed, so the application can drop its references to it
+ */
+typedef void (*AdapterDeviceEvictedCallback)(Adapter *adapter, Device *device);
+
+/*
+ * Called when properties of a known device changed value, with a flag for each of them
+ */
+typedef void (*AdapterDeviceChangedCallback)(Adapter *adapter, Device *device, DevicePropertyFlags changed);
+
 
 Adapter *binc_adapter_get_default(GDBusConnection *dbusConnection);
 
@@ -50,6 +84,13 @@ Adapter *binc_adapter_get(GDBusConnection *dbusConnection, const char *name);
 
 GPtrArray *binc_adapter_find_all(GDBusConnection *dbusConnection);
 
+/**
+ * Get the names of all adapters, e.g. 'hci0', without creating them
+ *
+ * @return array of names, free with g_ptr_array_free()
+ */
+GPtrArray *binc_adapter_find_all_names(GDBusConnection *dbusConnection);
+
 void binc_adapter_free(Adapter *adapter);
 
 void binc_adapter_start_discovery(Adapter *adapter);
@@ -90,6 +131,38 @@ gboolean binc_adapter_get_powered_state(const Adapter *adapter);
 
 void binc_adapter_set_discovery_cb(Adapter *adapter, AdapterDiscoveryResultCallback callback);
 
+/**
+ * Throttle, deduplicate and/or batch discovery results, so the cost of scanning follows the changes instead of the
+ * number of advertisements. The policy applies to both the discovery callback and the batch callback.
+ */
+void binc_adapter_set_discovery_policy(Adapter *adapter, const DiscoveryPolicy *policy);
+
+/**
+ * Get the discovery results in batches, when the policy has a batch interval. Replaces the discovery callback then.
+ */
+void binc_adapter_set_discovery_batch_cb(Adapter *adapter, AdapterDiscoveryBatchCallback callback);
+
+/**
+ * Only create devices that match the filter, checked on the D-Bus properties before any Device is allocated.
+ * Devices that are connected or paired are always created. The adapter takes ownership of the filter and frees the
+ * previous one, NULL removes the filter. Devices that were already created are kept, but their discovery results are
+ * only reported while the advertisement they hold matches the filter.
+ */
+void binc_adapter_set_scan_filter(Adapter *adapter, ScanFilter *filter);
+
+/**
+ * Only create devices whose address is in the allowlist, checked on the object path before anything else. Devices
+ * that are connected or paired are always created. The set is borrowed and may be changed at any time on the
+ * thread of the adapter, also while discovering. Devices that were already created are kept, but they are no
+ * longer reported as discovery results when their address isn't allowed anymore. NULL removes the allowlist.
+ */
+void binc_adapter_set_address_allowlist(Adapter *adapter, const AddressSet *allowlist);
+
+/**
+ * Ignore devices whose address is in the denylist, like binc_adapter_set_address_allowlist()
+ */
+void binc_adapter_set_address_denylist(Adapter *adapter, const AddressSet *denylist);
+
 void binc_adapter_set_discovery_state_cb(Adapter *adapter, AdapterDiscoveryStateChangeCallback callback);
 
 void binc_adapter_set_powered_state_cb(Adapter *adapter, AdapterPoweredStateChangeCallback callback);
@@ -112,6 +185,40 @@ void binc_adapter_set_user_data(Adapter *adapter, void *user_data);
 
 void *binc_adapter_get_user_data(const Adapter *adapter);
 
+/**
+ * Store the GATT tree of connected devices in 'directory' so it can be restored immediately on the next connection.
+ * Pass NULL to disable the cache, which is the default.
+ */
+void binc_adapter_set_gatt_cache_directory(Adapter *adapter, const char *directory);
+
+const char *binc_adapter_get_gatt_cache_directory(const Adapter *adapter);
+
+/**
+ * Bound the number of devices the adapter keeps. Devices that are connected, bonded or set to auto-reconnect are
+ * never evicted. The cache is checked every few seconds and whenever it grows beyond max_devices. Pass 0 to disable a
+ * limit, which is the default for all of them.
+ *
+ * @param max_devices maximum number of devices, the least recently seen ones are evicted first
+ * @param idle_ttl_seconds evict devices that have not been seen for this long
+ * @param max_bytes memory budget for all devices, as estimated by the library
+ */
+void binc_adapter_set_device_cache_limits(Adapter *adapter, guint max_devices, guint idle_ttl_seconds,
+                                          gsize max_bytes);
+
+/**
+ * Also remove evicted devices from BlueZ, so bluetoothd doesn't keep them either. Off by default.
+ */
+void binc_adapter_set_device_cache_remove_from_bluez(Adapter *adapter, gboolean remove);
+
+void binc_adapter_set_device_evicted_cb(Adapter *adapter, AdapterDeviceEvictedCallback callback);
+
+/**
+ * Get called back when the properties of a device change, instead of comparing its properties on every discovery
+ * result. Updates that repeat the current value are not reported, manufacturer and service data included, so
+ * BINC_DEVICE_PROPERTY_MANUFACTURER_DATA and BINC_DEVICE_PROPERTY_SERVICE_DATA signal a changed payload.
+ */
+void binc_adapter_set_device_changed_cb(Adapter *adapter, AdapterDeviceChangedCallback callback);
+
 #ifdef __cplusplus
 }
 #endif
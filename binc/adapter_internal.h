@@ -0,0 +1,37 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_ADAPTER_INTERNAL_H
+#define BINC_ADAPTER_INTERNAL_H
+
+#include "adapter.h"
+
+/**
+ * Get the GATT objects BlueZ exports for a device, as kept up to date from the InterfacesAdded and
+ * InterfacesRemoved signals. Maps each object path to its 'a{sa{sv}}' interfaces and properties.
+ *
+ * @return the objects, owned by the adapter, or NULL if the device has no GATT objects
+ */
+GHashTable *binc_adapter_get_gatt_objects(const Adapter *adapter, const char *device_path);
+
+#endif //BINC_ADAPTER_INTERNAL_H
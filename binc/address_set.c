@@ -0,0 +1,235 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include "address_set.h"
+
+// Addresses are 48 bit, so these values can't collide with them
+#define EMPTY_SLOT G_MAXUINT64
+#define REMOVED_SLOT (G_MAXUINT64 - 1)
+#define MAX_ADDRESS G_GUINT64_CONSTANT(0xFFFFFFFFFFFF)
+
+#define MIN_CAPACITY 16
+#define MIN_BLOOM_ADDRESSES 1024
+#define BLOOM_BITS_PER_ADDRESS 10
+#define BLOOM_HASHES 3
+
+struct binc_address_set {
+    guint64 *slots; // Owned, linear probing
+    guint capacity; // Power of 2
+    guint size;
+    guint used; // Addresses plus removed slots
+    guint64 *bloom; // Owned, NULL when not used
+    guint bloom_bits; // Power of 2
+    guint bloom_addresses; // Number of addresses the filter is sized for
+    guint bloom_stale; // Removed addresses that still have their bits set
+};
+
+static guint64 address_hash(guint64 address) {
+    address ^= address >> 33;
+    address *= G_GUINT64_CONSTANT(0xff51afd7ed558ccd);
+    address ^= address >> 33;
+    address *= G_GUINT64_CONSTANT(0xc4ceb9fe1a85ec53);
+    address ^= address >> 33;
+    return address;
+}
+
+static void bloom_add(AddressSet *set, guint64 hash) {
+    // Derive the bit positions from two halves of one hash
+    guint32 position = (guint32) hash;
+    guint32 step = (guint32) (hash >> 32) | 1;
+    for (guint i = 0; i < BLOOM_HASHES; i++) {
+        guint bit = position & (set->bloom_bits - 1);
+        set->bloom[bit / 64] |= G_GUINT64_CONSTANT(1) << (bit % 64);
+        position += step;
+    }
+}
+
+static gboolean bloom_contains(const AddressSet *set, guint64 hash) {
+    guint32 position = (guint32) hash;
+    guint32 step = (guint32) (hash >> 32) | 1;
+    for (guint i = 0; i < BLOOM_HASHES; i++) {
+        guint bit = position & (set->bloom_bits - 1);
+        if (!(set->bloom[bit / 64] & (G_GUINT64_CONSTANT(1) << (bit % 64)))) return FALSE;
+        position += step;
+    }
+    return TRUE;
+}
+
+static void bloom_rebuild(AddressSet *set, guint addresses) {
+    guint bits = 64;
+    while (bits / BLOOM_BITS_PER_ADDRESS < addresses) {
+        bits <<= 1;
+    }
+
+    g_free(set->bloom);
+    set->bloom = g_new0(guint64, bits / 64);
+    set->bloom_bits = bits;
+    set->bloom_addresses = bits / BLOOM_BITS_PER_ADDRESS;
+    set->bloom_stale = 0;
+    for (guint i = 0; i < set->capacity; i++) {
+        if (set->slots[i] < REMOVED_SLOT) {
+            bloom_add(set, address_hash(set->slots[i]));
+        }
+    }
+}
+
+static void allocate_slots(AddressSet *set, guint capacity) {
+    set->slots = g_new(guint64, capacity);
+    memset(set->slots, 0xFF, capacity * sizeof(guint64));
+    set->capacity = capacity;
+    set->used = 0;
+    set->size = 0;
+}
+
+static void insert_slot(AddressSet *set, guint64 address, guint64 hash) {
+    guint index = (guint) hash & (set->capacity - 1);
+    while (set->slots[index] != EMPTY_SLOT) {
+        index = (index + 1) & (set->capacity - 1);
+    }
+    set->slots[index] = address;
+    set->used++;
+    set->size++;
+}
+
+static void resize(AddressSet *set) {
+    // Keep the table at most half full after a resize, which also drops the removed slots
+    guint capacity = MIN_CAPACITY;
+    while (capacity < (set->size + 1) * 2) {
+        capacity <<= 1;
+    }
+
+    guint64 *slots = set->slots;
+    guint old_capacity = set->capacity;
+    allocate_slots(set, capacity);
+    for (guint i = 0; i < old_capacity; i++) {
+        if (slots[i] < REMOVED_SLOT) {
+            insert_slot(set, slots[i], address_hash(slots[i]));
+        }
+    }
+    g_free(slots);
+}
+
+AddressSet *binc_address_set_create(void) {
+    AddressSet *set = g_new0(AddressSet, 1);
+    allocate_slots(set, MIN_CAPACITY);
+    return set;
+}
+
+void binc_address_set_free(AddressSet *set) {
+    g_assert(set != NULL);
+
+    g_free(set->slots);
+    set->slots = NULL;
+    g_free(set->bloom);
+    set->bloom = NULL;
+    g_free(set);
+}
+
+gboolean binc_address_set_add(AddressSet *set, guint64 address) {
+    g_assert(set != NULL);
+    g_assert(address <= MAX_ADDRESS);
+
+    if (binc_address_set_contains(set, address)) return FALSE;
+
+    // Keep at least a quarter of the slots empty, so probing stays short and always ends
+    if ((set->used + 1) * 4 > set->capacity * 3) {
+        resize(set);
+    }
+
+    guint64 hash = address_hash(address);
+    insert_slot(set, address, hash);
+    if (set->bloom != NULL) {
+        if (set->size > set->bloom_addresses) {
+            bloom_rebuild(set, set->size * 2);
+        } else {
+            bloom_add(set, hash);
+        }
+    }
+    return TRUE;
+}
+
+gboolean binc_address_set_remove(AddressSet *set, guint64 address) {
+    g_assert(set != NULL);
+
+    guint index = (guint) address_hash(address) & (set->capacity - 1);
+    while (set->slots[index] != EMPTY_SLOT) {
+        if (set->slots[index] == address) {
+            set->slots[index] = REMOVED_SLOT;
+            set->size--;
+
+            // Bloom filters can't forget, so rebuild once the stale bits start to cost lookups
+            if (set->bloom != NULL && ++set->bloom_stale > set->size / 2 + MIN_CAPACITY) {
+                bloom_rebuild(set, set->bloom_addresses);
+            }
+            return TRUE;
+        }
+        index = (index + 1) & (set->capacity - 1);
+    }
+    return FALSE;
+}
+
+gboolean binc_address_set_contains(const AddressSet *set, guint64 address) {
+    g_assert(set != NULL);
+
+    if (set->size == 0) return FALSE;
+
+    guint64 hash = address_hash(address);
+    if (set->bloom != NULL && !bloom_contains(set, hash)) return FALSE;
+
+    guint index = (guint) hash & (set->capacity - 1);
+    while (set->slots[index] != EMPTY_SLOT) {
+        if (set->slots[index] == address) return TRUE;
+        index = (index + 1) & (set->capacity - 1);
+    }
+    return FALSE;
+}
+
+void binc_address_set_clear(AddressSet *set) {
+    g_assert(set != NULL);
+
+    g_free(set->slots);
+    allocate_slots(set, MIN_CAPACITY);
+    if (set->bloom != NULL) {
+        bloom_rebuild(set, MIN_BLOOM_ADDRESSES);
+    }
+}
+
+guint binc_address_set_get_size(const AddressSet *set) {
+    g_assert(set != NULL);
+    return set->size;
+}
+
+void binc_address_set_use_bloom_filter(AddressSet *set, gboolean use) {
+    g_assert(set != NULL);
+
+    if (use) {
+        bloom_rebuild(set, MAX(set->size * 2, MIN_BLOOM_ADDRESSES));
+    } else {
+        g_free(set->bloom);
+        set->bloom = NULL;
+        set->bloom_bits = 0;
+        set->bloom_addresses = 0;
+        set->bloom_stale = 0;
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_ADDRESS_SET_H
+#define BINC_ADDRESS_SET_H
+
+#include <glib.h>
+#include "forward_decl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Set of 48 bit Bluetooth addresses, see binc_address_parse(), stored inline in an open addressing hash table so
+ * even large sets need no allocation per address. Optionally a Bloom filter in front of the table rejects most
+ * addresses that are not in the set without touching the table, which keeps lookups in the CPU cache for sets of
+ * tens of thousands of addresses. Not thread safe, use and change a set on one thread only.
+ */
+
+AddressSet *binc_address_set_create(void);
+
+void binc_address_set_free(AddressSet *set);
+
+/**
+ * @return TRUE if the address was added, FALSE if it was already in the set
+ */
+gboolean binc_address_set_add(AddressSet *set, guint64 address);
+
+/**
+ * @return TRUE if the address was removed, FALSE if it was not in the set
+ */
+gboolean binc_address_set_remove(AddressSet *set, guint64 address);
+
+gboolean binc_address_set_contains(const AddressSet *set, guint64 address);
+
+void binc_address_set_clear(AddressSet *set);
+
+guint binc_address_set_get_size(const AddressSet *set);
+
+/**
+ * Put a Bloom filter in front of the set, sized for its current contents and resized as it grows. Worth it for
+ * large sets that are mostly queried with addresses they don't contain, like an allowlist.
+ */
+void binc_address_set_use_bloom_filter(AddressSet *set, gboolean use);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BINC_ADDRESS_SET_H
@@ -123,16 +123,16 @@ struct binc_application {
 
 typedef struct binc_local_service {
     char *path;
-    char *uuid;
+    const char *uuid; // Interned
     guint registration_id;
     GHashTable *characteristics;
     Application *application;
 } LocalService;
 
 typedef struct local_characteristic {
-    char *service_uuid;
+    const char *service_uuid; // Interned
     char *service_path;
-    char *uuid;
+    const char *uuid; // Interned
     char *path;
     guint registration_id;
     GByteArray *value;
@@ -146,9 +146,9 @@ typedef struct local_characteristic {
 typedef struct local_descriptor {
     char *path;
     char *char_path;
-    char *uuid;
-    char *char_uuid;
-    char *service_uuid;
+    const char *uuid; // Interned
+    const char *char_uuid; // Interned
+    const char *service_uuid; // Interned
     guint registration_id;
     GByteArray *value;
     guint permissions;
@@ -181,13 +181,10 @@ static void binc_local_desc_free(LocalDescriptor *localDescriptor) {
     g_free(localDescriptor->char_path);
     localDescriptor->char_path = NULL;
 
-    g_free(localDescriptor->uuid);
     localDescriptor->uuid = NULL;
 
-    g_free(localDescriptor->char_uuid);
     localDescriptor->char_uuid = NULL;
 
-    g_free(localDescriptor->service_uuid);
     localDescriptor->service_uuid = NULL;
 
     if (localDescriptor->flags != NULL) {
@@ -225,10 +222,8 @@ static void binc_local_char_free(LocalCharacteristic *localCharacteristic) {
     g_free(localCharacteristic->path);
     localCharacteristic->path = NULL;
 
-    g_free(localCharacteristic->uuid);
     localCharacteristic->uuid = NULL;
 
-    g_free(localCharacteristic->service_uuid);
     localCharacteristic->service_uuid = NULL;
 
     g_free(localCharacteristic->service_path);
@@ -264,7 +259,6 @@ void binc_local_service_free(LocalService *localService) {
     g_free(localService->path);
     localService->path = NULL;
 
-    g_free(localService->uuid);
     localService->uuid = NULL;
 
     g_free(localService);
@@ -577,9 +571,9 @@ Application *binc_create_application(const Adapter *adapter) {
     Application *application = g_new0(Application, 1);
     application->connection = binc_adapter_get_dbus_connection(adapter);
     application->path = g_strdup("/org/bluez/bincapplication");
-    application->services = g_hash_table_new_full(g_str_hash,
-                                                  g_str_equal,
-                                                  g_free,
+    application->services = g_hash_table_new_full(g_direct_hash,
+                                                  g_direct_equal,
+                                                  NULL,
                                                   (GDestroyNotify) binc_local_service_free);
 
     binc_application_publish(application, adapter);
@@ -615,9 +609,27 @@ void binc_application_free(Application *application) {
 
 static const GDBusInterfaceVTable service_table = {};
 
+static const char *intern_uuid(const char *uuid) {
+    const Uuid *interned = binc_uuid_intern_string(uuid);
+    return interned != NULL ? binc_uuid_get_string(interned) : NULL;
+}
+
+/*
+ * Find the interned form of uuid without interning it, a uuid that is not in the pool was never registered
+ */
+static const char *lookup_uuid(const char *uuid) {
+    Uuid parsed;
+    if (uuid == NULL || !binc_uuid_parse(uuid, &parsed)) return NULL;
+
+    const Uuid *interned = binc_uuid_lookup(&parsed);
+    return interned != NULL ? binc_uuid_get_string(interned) : NULL;
+}
+
 int binc_application_add_service(Application *application, const char *service_uuid) {
     g_return_val_if_fail (application != NULL, EINVAL);
-    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
+
+    const char *uuid = intern_uuid(service_uuid);
+    g_return_val_if_fail (uuid != NULL, EINVAL);
 
     GError *error = NULL;
     GDBusNodeInfo *info = g_dbus_node_info_new_for_xml(service_xml, &error);
@@ -628,18 +640,18 @@ int binc_application_add_service(Application *application, const char *service_u
     }
 
     LocalService *localService = g_new0(LocalService, 1);
-    localService->uuid = g_strdup(service_uuid);
+    localService->uuid = uuid;
     localService->application = application;
     localService->characteristics = g_hash_table_new_full(
-            g_str_hash,
-            g_str_equal,
-            g_free,
+            g_direct_hash,
+            g_direct_equal,
+            NULL,
             (GDestroyNotify) binc_local_char_free);
     localService->path = g_strdup_printf(
             "%s/service%d",
             application->path,
             g_hash_table_size(application->services));
-    g_hash_table_insert(application->services, g_strdup(service_uuid), localService);
+    g_hash_table_insert(application->services, (gpointer) uuid, localService);
 
     localService->registration_id = g_dbus_connection_register_object(application->connection,
                                                                       localService->path,
@@ -653,7 +665,7 @@ int binc_application_add_service(Application *application, const char *service_u
     if (localService->registration_id == 0) {
         log_debug(TAG, "failed to publish local service");
         log_debug(TAG, "Error %s", error->message);
-        g_hash_table_remove(application->services, service_uuid);
+        g_hash_table_remove(application->services, uuid);
         binc_local_service_free(localService);
         g_clear_error(&error);
         return EINVAL;
@@ -666,9 +678,10 @@ int binc_application_add_service(Application *application, const char *service_u
 
 static LocalService *binc_application_get_service(const Application *application, const char *service_uuid) {
     g_return_val_if_fail (application != NULL, NULL);
-    g_return_val_if_fail (is_valid_uuid(service_uuid), NULL);
 
-    return g_hash_table_lookup(application->services, service_uuid);
+    const char *uuid = lookup_uuid(service_uuid);
+    if (uuid == NULL) return NULL;
+    return g_hash_table_lookup(application->services, uuid);
 }
 
 static GList *permissions2Flags(const guint permissions) {
@@ -735,9 +748,11 @@ static int binc_characteristic_set_value(const Application *application, LocalCh
     g_return_val_if_fail (characteristic != NULL, EINVAL);
     g_return_val_if_fail (byteArray != NULL, EINVAL);
 
-    GString *byteArrayStr = g_byte_array_as_hex(byteArray);
-    log_debug(TAG, "set value <%s> to <%s>", byteArrayStr->str, characteristic->uuid);
-    g_string_free(byteArrayStr, TRUE);
+    if (log_is_enabled(LOG_DEBUG)) {
+        GString *byteArrayStr = g_byte_array_as_hex(byteArray);
+        log_debug(TAG, "set value <%s> to <%s>", byteArrayStr->str, characteristic->uuid);
+        g_string_free(byteArrayStr, TRUE);
+    }
 
     if (characteristic->value != NULL) {
         g_byte_array_free(characteristic->value, TRUE);
@@ -758,9 +773,11 @@ static int binc_descriptor_set_value(const Application *application, LocalDescri
     g_return_val_if_fail (descriptor != NULL, EINVAL);
     g_return_val_if_fail (byteArray != NULL, EINVAL);
 
-    GString *byteArrayStr = g_byte_array_as_hex(byteArray);
-    log_debug(TAG, "set value <%s> to <%s>", byteArrayStr->str, descriptor->uuid);
-    g_string_free(byteArrayStr, TRUE);
+    if (log_is_enabled(LOG_DEBUG)) {
+        GString *byteArrayStr = g_byte_array_as_hex(byteArray);
+        log_debug(TAG, "set value <%s> to <%s>", byteArrayStr->str, descriptor->uuid);
+        g_string_free(byteArrayStr, TRUE);
+    }
 
     if (descriptor->value != NULL) {
         g_byte_array_free(descriptor->value, TRUE);
@@ -779,12 +796,13 @@ static LocalCharacteristic *get_local_characteristic(const Application *applicat
                                                      const char *char_uuid) {
 
     g_return_val_if_fail (application != NULL, NULL);
-    g_return_val_if_fail (is_valid_uuid(service_uuid), NULL);
-    g_return_val_if_fail (is_valid_uuid(char_uuid), NULL);
+
+    const char *uuid = lookup_uuid(char_uuid);
+    if (uuid == NULL) return NULL;
 
     LocalService *service = binc_application_get_service(application, service_uuid);
     if (service != NULL) {
-        return g_hash_table_lookup(service->characteristics, char_uuid);
+        return g_hash_table_lookup(service->characteristics, uuid);
     }
     return NULL;
 }
@@ -793,13 +811,13 @@ static LocalDescriptor *get_local_descriptor(const Application *application, con
                                              const char *char_uuid, const char *desc_uuid) {
 
     g_return_val_if_fail (application != NULL, NULL);
-    g_return_val_if_fail (is_valid_uuid(service_uuid), NULL);
-    g_return_val_if_fail (is_valid_uuid(char_uuid), NULL);
-    g_return_val_if_fail (is_valid_uuid(desc_uuid), NULL);
+
+    const char *uuid = lookup_uuid(desc_uuid);
+    if (uuid == NULL) return NULL;
 
     LocalCharacteristic *characteristic = get_local_characteristic(application, service_uuid, char_uuid);
     if (characteristic != NULL) {
-        return g_hash_table_lookup(characteristic->descriptors, desc_uuid);
+        return g_hash_table_lookup(characteristic->descriptors, uuid);
     }
     return NULL;
 }
@@ -893,7 +911,6 @@ static const GDBusInterfaceVTable descriptor_table = {
 int binc_application_add_descriptor(Application *application, const char *service_uuid,
                                     const char *char_uuid, const char *desc_uuid, guint permissions) {
     g_return_val_if_fail (application != NULL, EINVAL);
-    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
 
     LocalCharacteristic *localCharacteristic = get_local_characteristic(application, service_uuid, char_uuid);
     if (localCharacteristic == NULL) {
@@ -901,6 +918,9 @@ int binc_application_add_descriptor(Application *application, const char *servic
         return EINVAL;
     }
 
+    const char *uuid = intern_uuid(desc_uuid);
+    g_return_val_if_fail (uuid != NULL, EINVAL);
+
     GError *error = NULL;
     GDBusNodeInfo *info = g_dbus_node_info_new_for_xml(descriptor_xml, &error);
     if (error) {
@@ -910,16 +930,16 @@ int binc_application_add_descriptor(Application *application, const char *servic
     }
 
     LocalDescriptor *localDescriptor = g_new0(LocalDescriptor, 1);
-    localDescriptor->uuid = g_strdup(desc_uuid);
+    localDescriptor->uuid = uuid;
     localDescriptor->application = application;
     localDescriptor->char_path = g_strdup(localCharacteristic->path);
-    localDescriptor->char_uuid = g_strdup(char_uuid);
-    localDescriptor->service_uuid = g_strdup(service_uuid);
+    localDescriptor->char_uuid = localCharacteristic->uuid;
+    localDescriptor->service_uuid = localCharacteristic->service_uuid;
     localDescriptor->flags = permissions2Flags(permissions);
     localDescriptor->path = g_strdup_printf("%s/desc%d",
                                             localCharacteristic->path,
                                             g_hash_table_size(localCharacteristic->descriptors));
-    g_hash_table_insert(localCharacteristic->descriptors, g_strdup(desc_uuid), localDescriptor);
+    g_hash_table_insert(localCharacteristic->descriptors, (gpointer) uuid, localDescriptor);
 
     // Register characteristic
     localDescriptor->registration_id = g_dbus_connection_register_object(application->connection,
@@ -935,7 +955,7 @@ int binc_application_add_descriptor(Application *application, const char *servic
         log_debug(TAG, "failed to publish local characteristic");
         log_debug(TAG, "Error %s", error->message);
         g_clear_error(&error);
-        g_hash_table_remove(localCharacteristic->descriptors, desc_uuid);
+        g_hash_table_remove(localCharacteristic->descriptors, uuid);
         return EINVAL;
     }
 
@@ -950,8 +970,6 @@ int binc_application_set_char_value(const Application *application, const char *
     g_return_val_if_fail (service_uuid != NULL, EINVAL);
     g_return_val_if_fail (char_uuid != NULL, EINVAL);
     g_return_val_if_fail (byteArray != NULL, EINVAL);
-    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
-    g_return_val_if_fail (is_valid_uuid(char_uuid), EINVAL);
 
     LocalCharacteristic *characteristic = get_local_characteristic(application, service_uuid, char_uuid);
     if (characteristic == NULL) {
@@ -969,8 +987,6 @@ int binc_application_set_desc_value(const Application *application, const char *
     g_return_val_if_fail (service_uuid != NULL, EINVAL);
     g_return_val_if_fail (char_uuid != NULL, EINVAL);
     g_return_val_if_fail (byteArray != NULL, EINVAL);
-    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
-    g_return_val_if_fail (is_valid_uuid(char_uuid), EINVAL);
 
     LocalDescriptor *descriptor = get_local_descriptor(application, service_uuid, char_uuid, desc_uuid);
     if (descriptor == NULL) {
@@ -987,8 +1003,6 @@ GByteArray *binc_application_get_char_value(const Application *application, cons
     g_return_val_if_fail (application != NULL, NULL);
     g_return_val_if_fail (service_uuid != NULL, NULL);
     g_return_val_if_fail (char_uuid != NULL, NULL);
-    g_return_val_if_fail (g_uuid_string_is_valid(service_uuid), NULL);
-    g_return_val_if_fail (g_uuid_string_is_valid(char_uuid), NULL);
 
     LocalCharacteristic *characteristic = get_local_characteristic(application, service_uuid, char_uuid);
     if (characteristic != NULL) {
@@ -1142,8 +1156,6 @@ int binc_application_add_characteristic(Application *application, const char *se
                                         const char *char_uuid, guint permissions) {
 
     g_return_val_if_fail (application != NULL, EINVAL);
-    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
-    g_return_val_if_fail (is_valid_uuid(char_uuid), EINVAL);
 
     LocalService *localService = binc_application_get_service(application, service_uuid);
     if (localService == NULL) {
@@ -1151,6 +1163,9 @@ int binc_application_add_characteristic(Application *application, const char *se
         return EINVAL;
     }
 
+    const char *uuid = intern_uuid(char_uuid);
+    g_return_val_if_fail (uuid != NULL, EINVAL);
+
     GError *error = NULL;
     GDBusNodeInfo *info = NULL;
     info = g_dbus_node_info_new_for_xml(characteristic_xml, &error);
@@ -1161,9 +1176,9 @@ int binc_application_add_characteristic(Application *application, const char *se
     }
 
     LocalCharacteristic *characteristic = g_new0(LocalCharacteristic, 1);
-    characteristic->service_uuid = g_strdup(service_uuid);
+    characteristic->service_uuid = localService->uuid;
     characteristic->service_path = g_strdup(localService->path);
-    characteristic->uuid = g_strdup(char_uuid);
+    characteristic->uuid = uuid;
     characteristic->permissions = permissions;
     characteristic->flags = permissions2Flags(permissions);
     characteristic->value = NULL;
@@ -1172,11 +1187,11 @@ int binc_application_add_characteristic(Application *application, const char *se
                                            localService->path,
                                            g_hash_table_size(localService->characteristics));
     characteristic->descriptors = g_hash_table_new_full(
-            g_str_hash,
-            g_str_equal,
-            g_free,
+            g_direct_hash,
+            g_direct_equal,
+            NULL,
             (GDestroyNotify) binc_local_desc_free);
-    g_hash_table_insert(localService->characteristics, g_strdup(char_uuid), characteristic);
+    g_hash_table_insert(localService->characteristics, (gpointer) uuid, characteristic);
 
     // Register characteristic
     characteristic->registration_id = g_dbus_connection_register_object(application->connection,
@@ -1192,7 +1207,7 @@ int binc_application_add_characteristic(Application *application, const char *se
         log_debug(TAG, "failed to publish local characteristic");
         log_debug(TAG, "Error %s", error->message);
         g_clear_error(&error);
-        g_hash_table_remove(localService->characteristics, char_uuid);
+        g_hash_table_remove(localService->characteristics, uuid);
         return EINVAL;
     }
 
@@ -1252,8 +1267,6 @@ int binc_application_notify(const Application *application, const char *service_
 
     g_return_val_if_fail (application != NULL, EINVAL);
     g_return_val_if_fail (byteArray != NULL, EINVAL);
-    g_return_val_if_fail (is_valid_uuid(service_uuid), EINVAL);
-    g_return_val_if_fail (is_valid_uuid(char_uuid), EINVAL);
 
     LocalCharacteristic *characteristic = get_local_characteristic(application, service_uuid, char_uuid);
     if (characteristic == NULL) {
@@ -1265,9 +1278,11 @@ int binc_application_notify(const Application *application, const char *service_
                                                        byteArray->data,
                                                        byteArray->len,
                                                        sizeof(guint8));
-    GVariantBuilder *properties_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
-    g_variant_builder_add(properties_builder, "{sv}", "Value", valueVariant);
-    GVariantBuilder *invalidated_builder = g_variant_builder_new(G_VARIANT_TYPE("as"));
+    GVariantBuilder properties_builder;
+    g_variant_builder_init(&properties_builder, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&properties_builder, "{sv}", "Value", valueVariant);
+    GVariantBuilder invalidated_builder;
+    g_variant_builder_init(&invalidated_builder, G_VARIANT_TYPE("as"));
 
     GError *error = NULL;
     gboolean result = g_dbus_connection_emit_signal(application->connection,
@@ -1277,12 +1292,9 @@ int binc_application_notify(const Application *application, const char *service_
                                                     "PropertiesChanged",
                                                     g_variant_new("(sa{sv}as)",
                                                                   "org.bluez.GattCharacteristic1",
-                                                                  properties_builder, invalidated_builder),
+                                                                  &properties_builder, &invalidated_builder),
                                                     &error);
 
-    g_variant_builder_unref(invalidated_builder);
-    g_variant_builder_unref(properties_builder);
-
     if (result != TRUE) {
         if (error != NULL) {
             log_debug(TAG, "error emitting signal: %s", error->message);
@@ -1291,17 +1303,17 @@ int binc_application_notify(const Application *application, const char *service_
         return EINVAL;
     }
 
-    GString *byteArrayStr = g_byte_array_as_hex(byteArray);
-    log_debug(TAG, "notified <%s> on <%s>", byteArrayStr->str, characteristic->uuid);
-    g_string_free(byteArrayStr, TRUE);
+    if (log_is_enabled(LOG_DEBUG)) {
+        GString *byteArrayStr = g_byte_array_as_hex(byteArray);
+        log_debug(TAG, "notified <%s> on <%s>", byteArrayStr->str, characteristic->uuid);
+        g_string_free(byteArrayStr, TRUE);
+    }
     return 0;
 }
 
 gboolean binc_application_char_is_notifying(const Application *application, const char *service_uuid,
                                             const char *char_uuid) {
     g_return_val_if_fail (application != NULL, FALSE);
-    g_return_val_if_fail (is_valid_uuid(service_uuid), FALSE);
-    g_return_val_if_fail (is_valid_uuid(char_uuid), FALSE);
 
     LocalCharacteristic *characteristic = get_local_characteristic(application, service_uuid, char_uuid);
     if (characteristic == NULL) {
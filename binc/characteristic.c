@@ -21,10 +21,18 @@
  *
  */
 
+#include <gio/gunixfdlist.h>
+#include <glib-unix.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
 #include "characteristic.h"
 #include "logger.h"
 #include "utility.h"
 #include "device_internal.h"
+#include "operation_internal.h"
+#include "long_value.h"
+#include "notification_ring.h"
 
 static const char *const TAG = "Characteristic";
 static const char *const INTERFACE_CHARACTERISTIC = "org.bluez.GattCharacteristic1";
@@ -34,32 +42,57 @@ static const char *const CHARACTERISTIC_METHOD_READ_VALUE = "ReadValue";
 static const char *const CHARACTERISTIC_METHOD_WRITE_VALUE = "WriteValue";
 static const char *const CHARACTERISTIC_METHOD_STOP_NOTIFY = "StopNotify";
 static const char *const CHARACTERISTIC_METHOD_START_NOTIFY = "StartNotify";
+static const char *const CHARACTERISTIC_METHOD_ACQUIRE_NOTIFY = "AcquireNotify";
+static const char *const CHARACTERISTIC_METHOD_ACQUIRE_WRITE = "AcquireWrite";
 static const char *const CHARACTERISTIC_PROPERTY_NOTIFYING = "Notifying";
 static const char *const CHARACTERISTIC_PROPERTY_VALUE = "Value";
 
-typedef struct binc_write_data {
-    GVariant *value;
-    Characteristic *characteristic;
-} WriteData;
+static const char *const BLUEZ_ERROR_NOT_SUPPORTED = "org.bluez.Error.NotSupported";
+
+/*
+ * Context of a D-Bus call. When the call was made for a queued operation, the operation is asked first whether the
+ * characteristic still exists, see binc_operation_complete(). Every call holds the characteristic, so a characteristic
+ * that is freed while calls are pending is only released when the last reply is in.
+ */
+typedef struct binc_char_call {
+    Characteristic *characteristic; // Borrowed
+    Operation *operation; // Borrowed, NULL for direct calls
+    GVariant *value; // Owned, the value being written
+} CharCall;
 
 struct binc_characteristic {
     Device *device; // Borrowed
     Service *service; // Borrowed
     GDBusConnection *connection; // Borrowed
     const char *path; // Owned
-    const char *uuid; // Owned
+    const Uuid *uuid; // Interned
     const char *service_path; // Owned
     gboolean notifying;
     GList *flags; // Owned
     guint properties;
     GList *descriptors; // Owned
     guint mtu;
-
-    guint characteristic_prop_changed;
+    OperationPriority priority;
+    GCancellable *cancellable; // Owned, cancels the direct calls when the characteristic is freed
+    guint holds; // Pending calls and running socket dispatches, a freed characteristic is released by the last one
+    gboolean freed; // Freed while held
+
+    gboolean listening; // Handle PropertiesChanged signals, only while notifying to skip Value updates after reads
+    gboolean acquiring_notify;
+    int notify_fd;
+    guint notify_fd_watch;
+    GByteArray *notify_buffer; // Owned
+    NotificationRing *notify_ring; // Borrowed
+    gboolean acquiring_write;
+    int write_fd;
+    guint write_fd_watch;
+    guint write_mtu;
+    WriteChannelState write_channel_state;
     OnNotifyingStateChangedCallback notify_state_callback;
     OnReadCallback on_read_callback;
     OnWriteCallback on_write_callback;
     OnNotifyCallback on_notify_callback;
+    OnWriteChannelStateChangedCallback on_write_channel_callback;
 };
 
 Characteristic *binc_characteristic_create(Device *device, const char *path) {
@@ -72,16 +105,49 @@ Characteristic *binc_characteristic_create(Device *device, const char *path) {
     characteristic->connection = binc_device_get_dbus_connection(device);
     characteristic->path = g_strdup(path);
     characteristic->mtu = 23;
+    characteristic->priority = BINC_PRIORITY_NORMAL;
+    characteristic->notify_fd = -1;
+    characteristic->write_fd = -1;
+    characteristic->write_channel_state = BINC_WRITE_CHANNEL_CLOSED;
+    characteristic->cancellable = g_cancellable_new();
     return characteristic;
 }
 
+static void binc_internal_release_notify_fd(Characteristic *characteristic) {
+    if (characteristic->notify_fd_watch != 0) {
+        binc_source_remove(characteristic->notify_fd_watch);
+        characteristic->notify_fd_watch = 0;
+    }
+
+    if (characteristic->notify_fd >= 0) {
+        close(characteristic->notify_fd);
+        characteristic->notify_fd = -1;
+    }
+
+    if (characteristic->notify_buffer != NULL) {
+        g_byte_array_free(characteristic->notify_buffer, TRUE);
+        characteristic->notify_buffer = NULL;
+    }
+}
+
+static void binc_internal_release_write_fd(Characteristic *characteristic) {
+    if (characteristic->write_fd_watch != 0) {
+        binc_source_remove(characteristic->write_fd_watch);
+        characteristic->write_fd_watch = 0;
+    }
+
+    if (characteristic->write_fd >= 0) {
+        close(characteristic->write_fd);
+        characteristic->write_fd = -1;
+    }
+    characteristic->write_mtu = 0;
+}
+
 void binc_characteristic_free(Characteristic *characteristic) {
     g_assert(characteristic != NULL);
 
-    if (characteristic->characteristic_prop_changed != 0) {
-        g_dbus_connection_signal_unsubscribe(characteristic->connection, characteristic->characteristic_prop_changed);
-        characteristic->characteristic_prop_changed = 0;
-    }
+    binc_internal_release_notify_fd(characteristic);
+    binc_internal_release_write_fd(characteristic);
 
     if (characteristic->flags != NULL) {
         g_list_free_full(characteristic->flags, g_free);
@@ -93,7 +159,6 @@ void binc_characteristic_free(Characteristic *characteristic) {
         characteristic->descriptors = NULL;
     }
 
-    g_free((char *) characteristic->uuid);
     characteristic->uuid = NULL;
 
     g_free((char *) characteristic->path);
@@ -105,6 +170,16 @@ void binc_characteristic_free(Characteristic *characteristic) {
     characteristic->device = NULL;
     characteristic->connection = NULL;
     characteristic->service = NULL;
+    characteristic->notify_ring = NULL;
+
+    // Replies of pending calls still refer to the characteristic, the last one releases it
+    if (characteristic->holds > 0) {
+        characteristic->freed = TRUE;
+        g_cancellable_cancel(characteristic->cancellable);
+        return;
+    }
+
+    g_object_unref(characteristic->cancellable);
     g_free(characteristic);
 }
 
@@ -122,7 +197,7 @@ char *binc_characteristic_to_string(const Characteristic *characteristic) {
 
     char *result = g_strdup_printf(
             "Characteristic{uuid='%s', flags='%s', properties=%d, service_uuid='%s, mtu=%d'}",
-            characteristic->uuid,
+            binc_characteristic_get_uuid(characteristic),
             flags->str,
             characteristic->properties,
             binc_service_get_uuid(characteristic->service),
@@ -132,30 +207,83 @@ char *binc_characteristic_to_string(const Characteristic *characteristic) {
     return result;
 }
 
-static void binc_internal_char_read_cb(__attribute__((unused)) GObject *source_object,
-                                       GAsyncResult *res,
-                                       gpointer user_data) {
+/*
+ * Release a hold taken by incrementing characteristic->holds
+ *
+ * @return FALSE if the characteristic was freed while it was held, it must not be touched then
+ */
+static gboolean binc_internal_char_release(Characteristic *characteristic) {
+    g_assert(characteristic->holds > 0);
+    characteristic->holds--;
+    if (!characteristic->freed) return TRUE;
+
+    if (characteristic->holds == 0) {
+        g_object_unref(characteristic->cancellable);
+        g_free(characteristic);
+    }
+    return FALSE;
+}
+
+static CharCall *binc_internal_char_call_create(Characteristic *characteristic, Operation *operation) {
+    CharCall *call = g_new0(CharCall, 1);
+    call->characteristic = characteristic;
+    call->operation = operation;
+    characteristic->holds++;
+    return call;
+}
+
+/*
+ * Free the call context and release its hold on the characteristic
+ *
+ * @return FALSE if the characteristic was freed while the call was pending, it must not be touched then
+ */
+static gboolean binc_internal_char_call_release(CharCall *call) {
+    Characteristic *characteristic = call->characteristic;
+    if (call->value != NULL) {
+        g_variant_unref(call->value);
+    }
+    g_free(call);
+    return binc_internal_char_release(characteristic);
+}
+
+static GCancellable *binc_internal_char_call_cancellable(const CharCall *call) {
+    if (call->operation != NULL) {
+        return binc_operation_get_cancellable(call->operation);
+    }
+    return call->characteristic->cancellable;
+}
+
+/*
+ * Hand the result to the operation the call was made for, if any
+ *
+ * @return TRUE if the result was consumed, the characteristic must not be touched then
+ */
+static gboolean binc_internal_char_call_complete(const CharCall *call, const GByteArray *byteArray,
+                                                 const GError *error) {
+    return call->operation != NULL && binc_operation_complete(call->operation, byteArray, error);
+}
+
+static void binc_internal_char_read_cb(GObject *source_object, GAsyncResult *res, gpointer user_data) {
     GError *error = NULL;
-    GByteArray *byteArray = NULL;
+    GByteArray view;
+    const GByteArray *byteArray = NULL;
     GVariant *innerArray = NULL;
-    Characteristic *characteristic = (Characteristic *) user_data;
-    g_assert(characteristic != NULL);
+    CharCall *call = (CharCall *) user_data;
+    g_assert(call != NULL);
 
-    GVariant *value = g_dbus_connection_call_finish(characteristic->connection, res, &error);
+    GVariant *value = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), res, &error);
     if (value != NULL) {
         g_assert(g_str_equal(g_variant_get_type_string(value), "(ay)"));
         innerArray = g_variant_get_child_value(value, 0);
-        byteArray = g_variant_get_byte_array(innerArray);
+        byteArray = g_variant_get_byte_array_view(innerArray, &view);
     }
 
-    if (characteristic->on_read_callback != NULL) {
+    Characteristic *characteristic = call->characteristic;
+    gboolean consumed = binc_internal_char_call_complete(call, byteArray, error);
+    if (binc_internal_char_call_release(call) && !consumed && characteristic->on_read_callback != NULL) {
         characteristic->on_read_callback(characteristic->device, characteristic, byteArray, error);
     }
 
-    if (byteArray != NULL) {
-        g_byte_array_free(byteArray, FALSE);
-    }
-
     if (innerArray != NULL) {
         g_variant_unref(innerArray);
     }
@@ -171,11 +299,11 @@ static void binc_internal_char_read_cb(__attribute__((unused)) GObject *source_o
     }
 }
 
-void binc_characteristic_read(Characteristic *characteristic) {
+void binc_characteristic_read_operation(Characteristic *characteristic, Operation *operation) {
     g_assert(characteristic != NULL);
     g_assert((characteristic->properties & GATT_CHR_PROP_READ) > 0);
 
-    log_debug(TAG, "reading <%s>", characteristic->uuid);
+    log_debug(TAG, "reading <%s>", binc_characteristic_get_uuid(characteristic));
 
     guint16 offset = 0;
     GVariantBuilder *builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
@@ -183,6 +311,7 @@ void binc_characteristic_read(Characteristic *characteristic) {
     GVariant *options = g_variant_builder_end(builder);
     g_variant_builder_unref(builder);
 
+    CharCall *call = binc_internal_char_call_create(characteristic, operation);
     g_dbus_connection_call(characteristic->connection,
                            BLUEZ_DBUS,
                            characteristic->path,
@@ -192,36 +321,33 @@ void binc_characteristic_read(Characteristic *characteristic) {
                            G_VARIANT_TYPE("(ay)"),
                            G_DBUS_CALL_FLAGS_NONE,
                            -1,
-                           NULL,
+                           binc_internal_char_call_cancellable(call),
                            (GAsyncReadyCallback) binc_internal_char_read_cb,
-                           characteristic);
+                           call);
 }
 
-static void binc_internal_char_write_cb(__attribute__((unused)) GObject *source_object,
-                                        GAsyncResult *res,
-                                        gpointer user_data) {
-    WriteData *writeData = (WriteData*) user_data;
-    Characteristic *characteristic = writeData->characteristic;
-    g_assert(characteristic != NULL);
+void binc_characteristic_read(Characteristic *characteristic) {
+    binc_characteristic_read_operation(characteristic, NULL);
+}
 
-    GByteArray *byteArray = NULL;
-    GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(characteristic->connection, res, &error);
+static void binc_internal_char_write_cb(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+    CharCall *call = (CharCall *) user_data;
+    g_assert(call != NULL);
 
-    if (writeData->value != NULL) {
-        byteArray = g_variant_get_byte_array(writeData->value);
-    }
-
-    if (characteristic->on_write_callback != NULL) {
+    GByteArray view;
+    GError *error = NULL;
+    GVariant *value = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), res, &error);
+    // Releasing the call drops its value, keep the written bytes alive until they are delivered
+    GVariant *written = g_variant_ref(call->value);
+    const GByteArray *byteArray = g_variant_get_byte_array_view(written, &view);
+
+    Characteristic *characteristic = call->characteristic;
+    gboolean consumed = binc_internal_char_call_complete(call, byteArray, error);
+    if (binc_internal_char_call_release(call) && !consumed && characteristic->on_write_callback != NULL) {
         characteristic->on_write_callback(characteristic->device, characteristic, byteArray, error);
     }
 
-    if (byteArray != NULL) {
-        g_byte_array_free(byteArray, FALSE);
-    }
-    g_variant_unref(writeData->value);
-    g_free(writeData);
-
+    g_variant_unref(written);
     if (value != NULL) {
         g_variant_unref(value);
     }
@@ -233,21 +359,23 @@ static void binc_internal_char_write_cb(__attribute__((unused)) GObject *source_
     }
 }
 
-void binc_characteristic_write(Characteristic *characteristic, const GByteArray *byteArray, WriteType writeType) {
+void binc_characteristic_write_operation(Characteristic *characteristic, const GByteArray *byteArray,
+                                         WriteType writeType, Operation *operation) {
     g_assert(characteristic != NULL);
     g_assert(byteArray != NULL);
     g_assert(byteArray->len > 0);
     g_assert(binc_characteristic_supports_write(characteristic, writeType));
 
-    GString *byteArrayStr = g_byte_array_as_hex(byteArray);
-    log_debug(TAG, "writing <%s> to <%s>", byteArrayStr->str, characteristic->uuid);
-    g_string_free(byteArrayStr, TRUE);
+    if (log_is_enabled(LOG_DEBUG)) {
+        GString *byteArrayStr = g_byte_array_as_hex(byteArray);
+        log_debug(TAG, "writing <%s> to <%s>", byteArrayStr->str, binc_characteristic_get_uuid(characteristic));
+        g_string_free(byteArrayStr, TRUE);
+    }
 
     GVariant *value = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, byteArray->data, byteArray->len, sizeof(guint8));
 
-    WriteData *writeData = g_new0(WriteData, 1);
-    writeData->value = g_variant_ref(value);
-    writeData->characteristic = characteristic;
+    CharCall *call = binc_internal_char_call_create(characteristic, operation);
+    call->value = g_variant_ref(value);
 
     guint16 offset = 0;
     const char *writeTypeString = writeType == WITH_RESPONSE ? "request" : "command";
@@ -266,80 +394,148 @@ void binc_characteristic_write(Characteristic *characteristic, const GByteArray
                            NULL,
                            G_DBUS_CALL_FLAGS_NONE,
                            -1,
-                           NULL,
+                           binc_internal_char_call_cancellable(call),
                            (GAsyncReadyCallback) binc_internal_char_write_cb,
-                           writeData);
+                           call);
+}
+
+void binc_characteristic_write(Characteristic *characteristic, const GByteArray *byteArray, WriteType writeType) {
+    binc_characteristic_write_operation(characteristic, byteArray, writeType, NULL);
 }
 
-static void binc_internal_signal_characteristic_changed(__attribute__((unused)) GDBusConnection *conn,
-                                                        __attribute__((unused)) const gchar *sender,
-                                                        __attribute__((unused)) const gchar *path,
-                                                        __attribute__((unused)) const gchar *interface,
-                                                        __attribute__((unused)) const gchar *signal,
-                                                        GVariant *parameters,
-                                                        void *user_data) {
+static void binc_internal_char_read_long_cb(const GByteArray *byteArray, const GError *error, gpointer user_data) {
+    CharCall *call = (CharCall *) user_data;
+    g_assert(call != NULL);
+
+    Characteristic *characteristic = call->characteristic;
+    const GByteArray *value = error == NULL ? byteArray : NULL;
+    gboolean consumed = binc_internal_char_call_complete(call, value, error);
+    if (binc_internal_char_call_release(call) && !consumed) {
+        log_debug(TAG, "read %u bytes from <%s>", byteArray->len, binc_characteristic_get_uuid(characteristic));
+        if (characteristic->on_read_callback != NULL) {
+            characteristic->on_read_callback(characteristic->device, characteristic, value, error);
+        }
+    }
+}
 
-    Characteristic *characteristic = (Characteristic *) user_data;
+void binc_characteristic_read_long_operation(Characteristic *characteristic, guint expected_length,
+                                             Operation *operation) {
     g_assert(characteristic != NULL);
+    g_assert((characteristic->properties & GATT_CHR_PROP_READ) > 0);
+
+    log_debug(TAG, "reading long <%s>", binc_characteristic_get_uuid(characteristic));
+    CharCall *call = binc_internal_char_call_create(characteristic, operation);
+    binc_long_value_read(characteristic->connection, characteristic->path, INTERFACE_CHARACTERISTIC,
+                         characteristic->mtu, expected_length, binc_internal_char_call_cancellable(call),
+                         binc_internal_char_read_long_cb, call);
+}
+
+void binc_characteristic_read_long(Characteristic *characteristic, guint expected_length) {
+    binc_characteristic_read_long_operation(characteristic, expected_length, NULL);
+}
+
+static void binc_internal_char_write_long_cb(const GByteArray *byteArray, const GError *error, gpointer user_data) {
+    CharCall *call = (CharCall *) user_data;
+    g_assert(call != NULL);
+
+    Characteristic *characteristic = call->characteristic;
+    gboolean consumed = binc_internal_char_call_complete(call, byteArray, error);
+    if (binc_internal_char_call_release(call) && !consumed) {
+        log_debug(TAG, "wrote %u bytes to <%s>", byteArray->len, binc_characteristic_get_uuid(characteristic));
+        if (characteristic->on_write_callback != NULL) {
+            characteristic->on_write_callback(characteristic->device, characteristic, byteArray, error);
+        }
+    }
+}
+
+void binc_characteristic_write_long_operation(Characteristic *characteristic, const GByteArray *byteArray,
+                                              Operation *operation) {
+    g_assert(characteristic != NULL);
+    g_assert(byteArray != NULL);
+    g_assert(byteArray->len > 0);
+    g_assert(binc_characteristic_supports_write(characteristic, WITH_RESPONSE));
+
+    log_debug(TAG, "writing long value of %u bytes to <%s>", byteArray->len,
+              binc_characteristic_get_uuid(characteristic));
+    CharCall *call = binc_internal_char_call_create(characteristic, operation);
+    binc_long_value_write(characteristic->connection, characteristic->path, INTERFACE_CHARACTERISTIC, byteArray,
+                          "request", binc_internal_char_call_cancellable(call), binc_internal_char_write_long_cb,
+                          call);
+}
+
+void binc_characteristic_write_long(Characteristic *characteristic, const GByteArray *byteArray) {
+    binc_characteristic_write_long_operation(characteristic, byteArray, NULL);
+}
+
+static void binc_internal_deliver_notification(Characteristic *characteristic, const GByteArray *byteArray) {
+    if (characteristic->notify_ring != NULL) {
+        if (!binc_notification_ring_push(characteristic->notify_ring, byteArray, g_get_real_time())) {
+            log_debug(TAG, "notification ring full, dropped notification on <%s>",
+                      binc_characteristic_get_uuid(characteristic));
+        }
+        return;
+    }
+
+    if (characteristic->on_notify_callback != NULL) {
+        characteristic->on_notify_callback(characteristic->device, characteristic, byteArray);
+    }
+}
+
+void binc_characteristic_handle_properties_changed(Characteristic *characteristic, GVariant *changed_properties) {
+    g_assert(characteristic != NULL);
+    g_assert(changed_properties != NULL);
+
+    if (!characteristic->listening) return;
 
-    GVariantIter *properties_changed = NULL;
-    GVariantIter *properties_invalidated = NULL;
-    const char *iface = NULL;
     const char *property_name = NULL;
     GVariant *property_value = NULL;
+    GVariantIter iter;
 
-    g_assert(g_str_equal(g_variant_get_type_string(parameters), "(sa{sv}as)"));
-    g_variant_get(parameters, "(&sa{sv}as)", &iface, &properties_changed, &properties_invalidated);
-    while (g_variant_iter_loop(properties_changed, "{&sv}", &property_name, &property_value)) {
+    g_variant_iter_init(&iter, changed_properties);
+    while (g_variant_iter_loop(&iter, "{&sv}", &property_name, &property_value)) {
         if (g_str_equal(property_name, CHARACTERISTIC_PROPERTY_NOTIFYING)) {
             characteristic->notifying = g_variant_get_boolean(property_value);
-            log_debug(TAG, "notifying %s <%s>", characteristic->notifying ? "true" : "false", characteristic->uuid);
+            log_debug(TAG, "notifying %s <%s>", characteristic->notifying ? "true" : "false",
+                      binc_characteristic_get_uuid(characteristic));
 
             if (characteristic->notify_state_callback != NULL) {
                 characteristic->notify_state_callback(characteristic->device, characteristic, NULL);
             }
 
             if (characteristic->notifying == FALSE) {
-                if (characteristic->characteristic_prop_changed != 0) {
-                    g_dbus_connection_signal_unsubscribe(characteristic->connection,
-                                                         characteristic->characteristic_prop_changed);
-                    characteristic->characteristic_prop_changed = 0;
-                }
+                characteristic->listening = FALSE;
             }
         } else if (g_str_equal(property_name, CHARACTERISTIC_PROPERTY_VALUE)) {
-            GByteArray *byteArray = g_variant_get_byte_array(property_value);
-            GString *result = g_byte_array_as_hex(byteArray);
-            log_debug(TAG, "notification <%s> on <%s>", result->str, characteristic->uuid);
-            g_string_free(result, TRUE);
-
-            if (characteristic->on_notify_callback != NULL) {
-                characteristic->on_notify_callback(characteristic->device, characteristic, byteArray);
+            GByteArray view;
+            const GByteArray *byteArray = g_variant_get_byte_array_view(property_value, &view);
+            if (log_is_enabled(LOG_DEBUG)) {
+                GString *result = g_byte_array_as_hex(byteArray);
+                log_debug(TAG, "notification <%s> on <%s>", result->str, binc_characteristic_get_uuid(characteristic));
+                g_string_free(result, TRUE);
             }
-            g_byte_array_free(byteArray, FALSE);
-        }
-    }
 
-    if (properties_changed != NULL) {
-        g_variant_iter_free(properties_changed);
-    }
-    if (properties_invalidated != NULL) {
-        g_variant_iter_free(properties_invalidated);
+            binc_internal_deliver_notification(characteristic, byteArray);
+        }
     }
 }
 
-static void binc_internal_char_start_notify_cb(__attribute__((unused)) GObject *source_object,
-                                               GAsyncResult *res,
-                                               gpointer user_data) {
-
-    Characteristic *characteristic = (Characteristic *) user_data;
-    g_assert(characteristic != NULL);
+static void binc_internal_char_start_notify_cb(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+    CharCall *call = (CharCall *) user_data;
+    g_assert(call != NULL);
 
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(characteristic->connection, res, &error);
+    GVariant *value = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), res, &error);
     if (value != NULL) {
         g_variant_unref(value);
     }
 
+    Characteristic *characteristic = call->characteristic;
+    gboolean consumed = binc_internal_char_call_complete(call, NULL, error);
+    if (!binc_internal_char_call_release(call) || consumed) {
+        g_clear_error(&error);
+        return;
+    }
+
     if (error != NULL) {
         log_debug(TAG, "failed to call '%s' (error %d: %s)", CHARACTERISTIC_METHOD_START_NOTIFY, error->code,
                   error->message);
@@ -351,27 +547,18 @@ static void binc_internal_char_start_notify_cb(__attribute__((unused)) GObject *
 }
 
 static void register_for_properties_changed_signal(Characteristic *characteristic) {
-    if (characteristic->characteristic_prop_changed == 0) {
-        characteristic->characteristic_prop_changed = g_dbus_connection_signal_subscribe(characteristic->connection,
-                                                                                         BLUEZ_DBUS,
-                                                                                         "org.freedesktop.DBus.Properties",
-                                                                                         "PropertiesChanged",
-                                                                                         characteristic->path,
-                                                                                         INTERFACE_CHARACTERISTIC,
-                                                                                         G_DBUS_SIGNAL_FLAGS_NONE,
-                                                                                         binc_internal_signal_characteristic_changed,
-                                                                                         characteristic,
-                                                                                         NULL);
-    }
+    // The adapter routes the signals of this characteristic here, see binc_characteristic_handle_properties_changed
+    characteristic->listening = TRUE;
 }
 
-void binc_characteristic_start_notify(Characteristic *characteristic) {
+void binc_characteristic_start_notify_operation(Characteristic *characteristic, Operation *operation) {
     g_assert(characteristic != NULL);
     g_assert(binc_characteristic_supports_notify(characteristic));
 
-    log_debug(TAG, "start notify for <%s>", characteristic->uuid);
+    log_debug(TAG, "start notify for <%s>", binc_characteristic_get_uuid(characteristic));
     register_for_properties_changed_signal(characteristic);
 
+    CharCall *call = binc_internal_char_call_create(characteristic, operation);
     g_dbus_connection_call(characteristic->connection,
                            BLUEZ_DBUS,
                            characteristic->path,
@@ -381,21 +568,396 @@ void binc_characteristic_start_notify(Characteristic *characteristic) {
                            NULL,
                            G_DBUS_CALL_FLAGS_NONE,
                            -1,
-                           NULL,
+                           binc_internal_char_call_cancellable(call),
                            (GAsyncReadyCallback) binc_internal_char_start_notify_cb,
-                           characteristic);
+                           call);
 }
 
-static void binc_internal_char_stop_notify_cb(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+void binc_characteristic_start_notify(Characteristic *characteristic) {
+    binc_characteristic_start_notify_operation(characteristic, NULL);
+}
+
+static gboolean binc_internal_notify_fd_cb(gint fd, GIOCondition condition, gpointer user_data) {
     Characteristic *characteristic = (Characteristic *) user_data;
     g_assert(characteristic != NULL);
 
+    if (condition & G_IO_IN) {
+        // Drain every packet that is queued up so a burst costs a single main loop wakeup
+        GByteArray *byteArray = characteristic->notify_buffer;
+        const guint capacity = byteArray->len;
+        while (TRUE) {
+            ssize_t bytes_read = read(fd, byteArray->data, capacity);
+            if (bytes_read > 0) {
+                g_byte_array_set_size(byteArray, (guint) bytes_read);
+
+                // The callback may stop notifying, acquire again or free the characteristic
+                characteristic->holds++;
+                binc_internal_deliver_notification(characteristic, byteArray);
+                if (!binc_internal_char_release(characteristic)) return G_SOURCE_REMOVE;
+                if (characteristic->notify_fd != fd || characteristic->notify_buffer != byteArray) {
+                    return G_SOURCE_REMOVE;
+                }
+
+                g_byte_array_set_size(byteArray, capacity);
+                continue;
+            }
+
+            if (bytes_read < 0 && errno == EINTR) continue;
+            if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+
+            // Either an error or the remote end closed the socket
+            condition |= G_IO_HUP;
+            break;
+        }
+    }
+
+    if (condition & (G_IO_HUP | G_IO_ERR | G_IO_NVAL)) {
+        log_debug(TAG, "acquired notify closed for <%s>", binc_characteristic_get_uuid(characteristic));
+        characteristic->notify_fd_watch = 0;
+        binc_internal_release_notify_fd(characteristic);
+        characteristic->notifying = FALSE;
+        if (characteristic->notify_state_callback != NULL) {
+            characteristic->notify_state_callback(characteristic->device, characteristic, NULL);
+        }
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void binc_internal_char_acquire_notify_cb(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+    CharCall *call = (CharCall *) user_data;
+    g_assert(call != NULL);
+
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(characteristic->connection, res, &error);
+    GUnixFDList *fd_list = NULL;
+    GVariant *value = g_dbus_connection_call_with_unix_fd_list_finish(G_DBUS_CONNECTION(source_object), &fd_list,
+                                                                      res, &error);
+    int fd = -1;
+    guint16 mtu = 0;
     if (value != NULL) {
+        gint32 fd_index = 0;
+        g_variant_get(value, "(hq)", &fd_index, &mtu);
+        fd = g_unix_fd_list_get(fd_list, fd_index, &error);
         g_variant_unref(value);
     }
 
+    if (fd_list != NULL) {
+        g_object_unref(fd_list);
+    }
+
+    Characteristic *characteristic = call->characteristic;
+    gboolean consumed = binc_internal_char_call_complete(call, NULL, error);
+    if (!binc_internal_char_call_release(call)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        g_clear_error(&error);
+        return;
+    }
+    characteristic->acquiring_notify = FALSE;
+
+    // Retried or dropped by the operation queue
+    if (consumed) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        g_clear_error(&error);
+        return;
+    }
+
+    if (error != NULL) {
+        log_debug(TAG, "failed to call '%s' (error %d: %s)", CHARACTERISTIC_METHOD_ACQUIRE_NOTIFY, error->code,
+                  error->message);
+
+        // BlueZ refuses a second socket, the one acquired before is still good
+        if (characteristic->notify_fd >= 0) {
+            g_clear_error(&error);
+            return;
+        }
+
+        // Not every characteristic can be acquired (e.g. indications), so fall back to regular notifications
+        char *remote_error = g_dbus_error_get_remote_error(error);
+        gboolean not_supported = remote_error != NULL && g_str_equal(remote_error, BLUEZ_ERROR_NOT_SUPPORTED);
+        g_free(remote_error);
+        if (not_supported) {
+            g_clear_error(&error);
+            binc_characteristic_start_notify(characteristic);
+            return;
+        }
+
+        if (characteristic->notify_state_callback != NULL) {
+            characteristic->notify_state_callback(characteristic->device, characteristic, error);
+        }
+        g_clear_error(&error);
+        return;
+    }
+
+    g_unix_set_fd_nonblocking(fd, TRUE, NULL);
+    binc_internal_release_notify_fd(characteristic);
+    characteristic->notify_fd = fd;
+    characteristic->mtu = mtu;
+    characteristic->notify_buffer = g_byte_array_sized_new(mtu);
+    g_byte_array_set_size(characteristic->notify_buffer, mtu);
+    characteristic->notify_fd_watch = binc_unix_fd_add(fd, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                                       binc_internal_notify_fd_cb, characteristic);
+
+    log_debug(TAG, "acquired notify for <%s> (mtu %d)", binc_characteristic_get_uuid(characteristic), mtu);
+    characteristic->notifying = TRUE;
+    if (characteristic->notify_state_callback != NULL) {
+        characteristic->notify_state_callback(characteristic->device, characteristic, NULL);
+    }
+}
+
+void binc_characteristic_acquire_notify_operation(Characteristic *characteristic, Operation *operation) {
+    g_assert(characteristic != NULL);
+    g_assert(binc_characteristic_supports_notify(characteristic));
+
+    // A queued operation always makes its call, the reply completes the operation
+    if (operation == NULL && (characteristic->notify_fd >= 0 || characteristic->acquiring_notify)) return;
+
+    log_debug(TAG, "acquire notify for <%s>", binc_characteristic_get_uuid(characteristic));
+
+    GVariantBuilder *builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+    GVariant *options = g_variant_builder_end(builder);
+    g_variant_builder_unref(builder);
+
+    characteristic->acquiring_notify = TRUE;
+    CharCall *call = binc_internal_char_call_create(characteristic, operation);
+    g_dbus_connection_call_with_unix_fd_list(characteristic->connection,
+                                             BLUEZ_DBUS,
+                                             characteristic->path,
+                                             INTERFACE_CHARACTERISTIC,
+                                             CHARACTERISTIC_METHOD_ACQUIRE_NOTIFY,
+                                             g_variant_new("(@a{sv})", options),
+                                             G_VARIANT_TYPE("(hq)"),
+                                             G_DBUS_CALL_FLAGS_NONE,
+                                             -1,
+                                             NULL,
+                                             binc_internal_char_call_cancellable(call),
+                                             (GAsyncReadyCallback) binc_internal_char_acquire_notify_cb,
+                                             call);
+}
+
+void binc_characteristic_acquire_notify(Characteristic *characteristic) {
+    binc_characteristic_acquire_notify_operation(characteristic, NULL);
+}
+
+gboolean binc_characteristic_is_notify_acquired(const Characteristic *characteristic) {
+    g_assert(characteristic != NULL);
+    return characteristic->notify_fd >= 0;
+}
+
+static void binc_internal_set_write_channel_state(Characteristic *characteristic, WriteChannelState state,
+                                                  const GError *error) {
+    WriteChannelState old_state = characteristic->write_channel_state;
+    characteristic->write_channel_state = state;
+    if (characteristic->on_write_channel_callback != NULL && (state != old_state || error != NULL)) {
+        characteristic->on_write_channel_callback(characteristic->device, characteristic, state, error);
+    }
+}
+
+static gboolean binc_internal_write_fd_cb(gint fd, GIOCondition condition, gpointer user_data);
+
+static void binc_internal_watch_write_fd(Characteristic *characteristic, GIOCondition condition) {
+    if (characteristic->write_fd_watch != 0) {
+        binc_source_remove(characteristic->write_fd_watch);
+    }
+    characteristic->write_fd_watch = binc_unix_fd_add(characteristic->write_fd, condition | G_IO_HUP | G_IO_ERR,
+                                                      binc_internal_write_fd_cb, characteristic);
+}
+
+static gboolean binc_internal_write_fd_cb(gint fd, GIOCondition condition, gpointer user_data) {
+    Characteristic *characteristic = (Characteristic *) user_data;
+    g_assert(characteristic != NULL);
+
+    if (condition & (G_IO_HUP | G_IO_ERR | G_IO_NVAL)) {
+        log_debug(TAG, "acquired write closed for <%s>", binc_characteristic_get_uuid(characteristic));
+        characteristic->write_fd_watch = 0;
+        binc_internal_release_write_fd(characteristic);
+        binc_internal_set_write_channel_state(characteristic, BINC_WRITE_CHANNEL_CLOSED, NULL);
+        return G_SOURCE_REMOVE;
+    }
+
+    if (condition & G_IO_OUT) {
+        // Socket buffer drained, stop polling for writability and tell the app it can continue
+        characteristic->write_fd_watch = 0;
+        binc_internal_watch_write_fd(characteristic, 0);
+        binc_internal_set_write_channel_state(characteristic, BINC_WRITE_CHANNEL_OPEN, NULL);
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void binc_internal_char_acquire_write_cb(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+    CharCall *call = (CharCall *) user_data;
+    g_assert(call != NULL);
+
+    GError *error = NULL;
+    GUnixFDList *fd_list = NULL;
+    GVariant *value = g_dbus_connection_call_with_unix_fd_list_finish(G_DBUS_CONNECTION(source_object), &fd_list,
+                                                                      res, &error);
+    int fd = -1;
+    guint16 mtu = 0;
+    if (value != NULL) {
+        gint32 fd_index = 0;
+        g_variant_get(value, "(hq)", &fd_index, &mtu);
+        fd = g_unix_fd_list_get(fd_list, fd_index, &error);
+        g_variant_unref(value);
+    }
+
+    if (fd_list != NULL) {
+        g_object_unref(fd_list);
+    }
+
+    Characteristic *characteristic = call->characteristic;
+    gboolean consumed = binc_internal_char_call_complete(call, NULL, error);
+    if (!binc_internal_char_call_release(call)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        g_clear_error(&error);
+        return;
+    }
+    characteristic->acquiring_write = FALSE;
+
+    // Retried or dropped by the operation queue
+    if (consumed) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        g_clear_error(&error);
+        return;
+    }
+
+    if (error != NULL) {
+        log_debug(TAG, "failed to call '%s' (error %d: %s)", CHARACTERISTIC_METHOD_ACQUIRE_WRITE, error->code,
+                  error->message);
+
+        // BlueZ refuses a second socket, the one acquired before is still good
+        if (characteristic->write_fd >= 0) {
+            g_clear_error(&error);
+            return;
+        }
+
+        binc_internal_set_write_channel_state(characteristic, BINC_WRITE_CHANNEL_CLOSED, error);
+        g_clear_error(&error);
+        return;
+    }
+
+    g_unix_set_fd_nonblocking(fd, TRUE, NULL);
+    binc_internal_release_write_fd(characteristic);
+    characteristic->write_fd = fd;
+
+    // The MTU handed out is the ATT MTU, an ATT write command header takes 3 bytes of it
+    characteristic->write_mtu = mtu > 3 ? mtu - 3u : 0;
+    binc_internal_watch_write_fd(characteristic, 0);
+
+    log_debug(TAG, "acquired write for <%s> (mtu %d)", binc_characteristic_get_uuid(characteristic), mtu);
+    binc_internal_set_write_channel_state(characteristic, BINC_WRITE_CHANNEL_OPEN, NULL);
+}
+
+void binc_characteristic_acquire_write_operation(Characteristic *characteristic, Operation *operation) {
+    g_assert(characteristic != NULL);
+    g_assert(binc_characteristic_supports_write(characteristic, WITHOUT_RESPONSE));
+
+    // A queued operation always makes its call, the reply completes the operation
+    if (operation == NULL && (characteristic->write_fd >= 0 || characteristic->acquiring_write)) return;
+
+    log_debug(TAG, "acquire write for <%s>", binc_characteristic_get_uuid(characteristic));
+
+    GVariantBuilder *builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+    GVariant *options = g_variant_builder_end(builder);
+    g_variant_builder_unref(builder);
+
+    characteristic->acquiring_write = TRUE;
+    CharCall *call = binc_internal_char_call_create(characteristic, operation);
+    g_dbus_connection_call_with_unix_fd_list(characteristic->connection,
+                                             BLUEZ_DBUS,
+                                             characteristic->path,
+                                             INTERFACE_CHARACTERISTIC,
+                                             CHARACTERISTIC_METHOD_ACQUIRE_WRITE,
+                                             g_variant_new("(@a{sv})", options),
+                                             G_VARIANT_TYPE("(hq)"),
+                                             G_DBUS_CALL_FLAGS_NONE,
+                                             -1,
+                                             NULL,
+                                             binc_internal_char_call_cancellable(call),
+                                             (GAsyncReadyCallback) binc_internal_char_acquire_write_cb,
+                                             call);
+}
+
+void binc_characteristic_acquire_write(Characteristic *characteristic) {
+    binc_characteristic_acquire_write_operation(characteristic, NULL);
+}
+
+void binc_characteristic_release_write(Characteristic *characteristic) {
+    g_assert(characteristic != NULL);
+
+    if (characteristic->write_fd < 0) return;
+
+    log_debug(TAG, "releasing acquired write for <%s>", binc_characteristic_get_uuid(characteristic));
+    binc_internal_release_write_fd(characteristic);
+    binc_internal_set_write_channel_state(characteristic, BINC_WRITE_CHANNEL_CLOSED, NULL);
+}
+
+int binc_characteristic_write_acquired(Characteristic *characteristic, const GByteArray *byteArray) {
+    g_assert(characteristic != NULL);
+    g_assert(byteArray != NULL);
+
+    if (characteristic->write_fd < 0) return ENOTCONN;
+    if (byteArray->len > characteristic->write_mtu) return EMSGSIZE;
+    if (characteristic->write_channel_state == BINC_WRITE_CHANNEL_BLOCKED) return EAGAIN;
+
+    while (TRUE) {
+        ssize_t bytes_written = send(characteristic->write_fd, byteArray->data, byteArray->len,
+                                     MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (bytes_written >= 0) return 0;
+        if (errno == EINTR) continue;
+        break;
+    }
+
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        // Apply backpressure until the socket becomes writable again
+        binc_internal_watch_write_fd(characteristic, G_IO_OUT);
+        binc_internal_set_write_channel_state(characteristic, BINC_WRITE_CHANNEL_BLOCKED, NULL);
+        return EAGAIN;
+    }
+
+    int result = errno;
+    log_debug(TAG, "failed to write to acquired socket of <%s> (error %d: %s)",
+              binc_characteristic_get_uuid(characteristic), result, g_strerror(result));
+    return result;
+}
+
+WriteChannelState binc_characteristic_get_write_channel_state(const Characteristic *characteristic) {
+    g_assert(characteristic != NULL);
+    return characteristic->write_channel_state;
+}
+
+guint binc_characteristic_get_write_channel_mtu(const Characteristic *characteristic) {
+    g_assert(characteristic != NULL);
+    return characteristic->write_mtu;
+}
+
+static void binc_internal_char_stop_notify_cb(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+    CharCall *call = (CharCall *) user_data;
+    g_assert(call != NULL);
+
+    GError *error = NULL;
+    GVariant *value = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), res, &error);
+    if (value != NULL) {
+        g_variant_unref(value);
+    }
+
+    Characteristic *characteristic = call->characteristic;
+    gboolean consumed = binc_internal_char_call_complete(call, NULL, error);
+    if (!binc_internal_char_call_release(call) || consumed) {
+        g_clear_error(&error);
+        return;
+    }
+
     if (error != NULL) {
         log_debug(TAG, "failed to call '%s' (error %d: %s)", CHARACTERISTIC_METHOD_STOP_NOTIFY, error->code,
                   error->message);
@@ -406,11 +968,36 @@ static void binc_internal_char_stop_notify_cb(GObject *source_object, GAsyncResu
     }
 }
 
-void binc_characteristic_stop_notify(Characteristic *characteristic) {
+static gboolean binc_internal_char_release_notify_done(gpointer user_data) {
+    CharCall *call = (CharCall *) user_data;
+    Characteristic *characteristic = call->characteristic;
+    gboolean consumed = binc_internal_char_call_complete(call, NULL, NULL);
+    if (binc_internal_char_call_release(call) && !consumed && characteristic->notify_state_callback != NULL) {
+        characteristic->notify_state_callback(characteristic->device, characteristic, NULL);
+    }
+    return FALSE;
+}
+
+void binc_characteristic_stop_notify_operation(Characteristic *characteristic, Operation *operation) {
     g_assert(characteristic != NULL);
     g_assert((characteristic->properties & GATT_CHR_PROP_INDICATE) > 0 ||
              (characteristic->properties & GATT_CHR_PROP_NOTIFY) > 0);
 
+    binc_device_forget_notify(characteristic->device, characteristic);
+
+    // Closing an acquired socket is all it takes for BlueZ to stop notifying
+    if (characteristic->notify_fd >= 0) {
+        log_debug(TAG, "releasing acquired notify for <%s>", binc_characteristic_get_uuid(characteristic));
+        binc_internal_release_notify_fd(characteristic);
+        characteristic->notifying = FALSE;
+
+        // Finished from the main loop like a D-Bus reply, so callers never get reentered
+        binc_idle_add(binc_internal_char_release_notify_done,
+                      binc_internal_char_call_create(characteristic, operation));
+        return;
+    }
+
+    CharCall *call = binc_internal_char_call_create(characteristic, operation);
     g_dbus_connection_call(characteristic->connection,
                            BLUEZ_DBUS,
                            characteristic->path,
@@ -420,9 +1007,13 @@ void binc_characteristic_stop_notify(Characteristic *characteristic) {
                            NULL,
                            G_DBUS_CALL_FLAGS_NONE,
                            -1,
-                           NULL,
+                           binc_internal_char_call_cancellable(call),
                            (GAsyncReadyCallback) binc_internal_char_stop_notify_cb,
-                           characteristic);
+                           call);
+}
+
+void binc_characteristic_stop_notify(Characteristic *characteristic) {
+    binc_characteristic_stop_notify_operation(characteristic, NULL);
 }
 
 void binc_characteristic_set_read_cb(Characteristic *characteristic, OnReadCallback callback) {
@@ -443,6 +1034,13 @@ void binc_characteristic_set_notify_cb(Characteristic *characteristic, OnNotifyC
     characteristic->on_notify_callback = callback;
 }
 
+void binc_characteristic_set_write_channel_state_cb(Characteristic *characteristic,
+                                                    OnWriteChannelStateChangedCallback callback) {
+    g_assert(characteristic != NULL);
+    g_assert(callback != NULL);
+    characteristic->on_write_channel_callback = callback;
+}
+
 void binc_characteristic_set_notifying_state_change_cb(Characteristic *characteristic,
                                                        OnNotifyingStateChangedCallback callback) {
     g_assert(characteristic != NULL);
@@ -461,6 +1059,11 @@ void binc_characteristic_set_notifying(Characteristic *characteristic, gboolean
 }
 
 const char *binc_characteristic_get_uuid(const Characteristic *characteristic) {
+    g_assert(characteristic != NULL);
+    return characteristic->uuid != NULL ? binc_uuid_get_string(characteristic->uuid) : NULL;
+}
+
+const Uuid *binc_characteristic_get_uuid_value(const Characteristic *characteristic) {
     g_assert(characteristic != NULL);
     return characteristic->uuid;
 }
@@ -469,8 +1072,8 @@ void binc_characteristic_set_uuid(Characteristic *characteristic, const char *uu
     g_assert(characteristic != NULL);
     g_assert(uuid != NULL);
 
-    g_free((char *) characteristic->uuid);
-    characteristic->uuid = g_strdup(uuid);
+    characteristic->uuid = binc_uuid_intern_string(uuid);
+    g_assert(characteristic->uuid != NULL);
 }
 
 void binc_characteristic_set_mtu(Characteristic *characteristic, guint mtu) {
@@ -494,6 +1097,11 @@ void binc_characteristic_set_service(Characteristic *characteristic, Service *se
     characteristic->service = service;
 }
 
+const char *binc_characteristic_get_path(const Characteristic *characteristic) {
+    g_assert(characteristic != NULL);
+    return characteristic->path;
+}
+
 const char *binc_characteristic_get_service_path(const Characteristic *characteristic) {
     g_assert(characteristic != NULL);
     return characteristic->service_path;
@@ -592,16 +1200,32 @@ void binc_characteristic_add_descriptor(Characteristic *characteristic, Descript
     characteristic->descriptors = g_list_append(characteristic->descriptors, descriptor);
 }
 
+void binc_characteristic_remove_descriptor(Characteristic *characteristic, Descriptor *descriptor) {
+    g_assert(characteristic != NULL);
+    g_assert(descriptor != NULL);
+
+    characteristic->descriptors = g_list_remove(characteristic->descriptors, descriptor);
+}
+
 Descriptor *binc_characteristic_get_descriptor(const Characteristic *characteristic, const char* desc_uuid) {
     g_assert(characteristic != NULL);
-    g_assert(is_valid_uuid(desc_uuid));
 
-    if (characteristic->descriptors != NULL) {
-        for (GList *iterator = characteristic->descriptors; iterator; iterator = iterator->next) {
-            Descriptor *descriptor = (Descriptor *) iterator->data;
-            if (g_str_equal(desc_uuid, binc_descriptor_get_uuid(descriptor))) {
-                return descriptor;
-            }
+    Uuid uuid;
+    if (!binc_uuid_parse(desc_uuid, &uuid)) return NULL;
+    return binc_characteristic_get_descriptor_by_uuid(characteristic, &uuid);
+}
+
+Descriptor *binc_characteristic_get_descriptor_by_uuid(const Characteristic *characteristic, const Uuid *desc_uuid) {
+    g_assert(characteristic != NULL);
+    g_assert(desc_uuid != NULL);
+
+    const Uuid *interned = binc_uuid_lookup(desc_uuid);
+    if (interned == NULL) return NULL;
+
+    for (GList *iterator = characteristic->descriptors; iterator; iterator = iterator->next) {
+        Descriptor *descriptor = (Descriptor *) iterator->data;
+        if (binc_descriptor_get_uuid_value(descriptor) == interned) {
+            return descriptor;
         }
     }
     return NULL;
@@ -611,3 +1235,18 @@ GList *binc_characteristic_get_descriptors(const Characteristic *characteristic)
     g_assert(characteristic != NULL);
     return characteristic->descriptors;
 }
+
+void binc_characteristic_set_priority(Characteristic *characteristic, OperationPriority priority) {
+    g_assert(characteristic != NULL);
+    characteristic->priority = priority;
+}
+
+OperationPriority binc_characteristic_get_priority(const Characteristic *characteristic) {
+    g_assert(characteristic != NULL);
+    return characteristic->priority;
+}
+
+void binc_characteristic_set_notify_ring(Characteristic *characteristic, NotificationRing *ring) {
+    g_assert(characteristic != NULL);
+    characteristic->notify_ring = ring;
+}
@@ -27,6 +27,9 @@
 #include <gio/gio.h>
 #include "service.h"
 #include "forward_decl.h"
+#include "operation.h"
+#include "notification_ring.h"
+#include "uuid.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -65,29 +68,101 @@ typedef enum WriteType {
     WITH_RESPONSE = 0, WITHOUT_RESPONSE = 1
 } WriteType;
 
+typedef enum WriteChannelState {
+    BINC_WRITE_CHANNEL_CLOSED = 0, BINC_WRITE_CHANNEL_OPEN = 1, BINC_WRITE_CHANNEL_BLOCKED = 2
+} WriteChannelState;
+
 typedef void (*OnNotifyingStateChangedCallback)(Device *device, Characteristic *characteristic, const GError *error);
 
+/*
+ * The byteArray passed to notify, read and write callbacks points directly into the received message. It is only
+ * valid during the callback and must not be resized, referenced or freed. Copy it if you need to keep the value.
+ */
 typedef void (*OnNotifyCallback)(Device *device, Characteristic *characteristic, const GByteArray *byteArray);
 
 typedef void (*OnReadCallback)(Device *device, Characteristic *characteristic, const GByteArray *byteArray, const GError *error);
 
 typedef void (*OnWriteCallback)(Device *device, Characteristic *characteristic, const GByteArray *byteArray, const GError *error);
 
+typedef void (*OnWriteChannelStateChangedCallback)(Device *device, Characteristic *characteristic,
+                                                   WriteChannelState state, const GError *error);
+
 
 void binc_characteristic_read(Characteristic *characteristic);
 
 void binc_characteristic_write(Characteristic *characteristic, const GByteArray *byteArray, WriteType writeType);
 
+/**
+ * Read a value that may be longer than a single ATT payload. Reads are repeated at increasing offsets until the
+ * whole value has been received and the OnReadCallback is called once with the complete value.
+ *
+ * @param characteristic the characteristic to read. Must support read.
+ * @param expected_length size hint used to preallocate the result, or 0 if unknown
+ */
+void binc_characteristic_read_long(Characteristic *characteristic, guint expected_length);
+
+/**
+ * Write a value that may be longer than a single ATT payload. The value is written in chunks at increasing offsets
+ * and the OnWriteCallback is called once when all chunks have been written or when a chunk failed.
+ *
+ * @param characteristic the characteristic to write. Must support WITH_RESPONSE writes.
+ * @param byteArray the value to write. Values longer than 65535 bytes fail with G_IO_ERROR_INVALID_ARGUMENT.
+ */
+void binc_characteristic_write_long(Characteristic *characteristic, const GByteArray *byteArray);
+
 void binc_characteristic_start_notify(Characteristic *characteristic);
 
 void binc_characteristic_stop_notify(Characteristic *characteristic);
 
+/**
+ * Start notifications using AcquireNotify. Notifications are then read directly from a socket handed out by BlueZ
+ * instead of arriving as PropertiesChanged signals over the DBus. Falls back to StartNotify if BlueZ does not support
+ * acquiring the characteristic. Use binc_characteristic_stop_notify() to release the socket again. Does nothing if the
+ * characteristic is already acquired or being acquired. The call is made right away, use binc_device_acquire_notify()
+ * to go through the device's operation queue instead.
+ *
+ * @param characteristic the characteristic to acquire. Must support notify.
+ */
+void binc_characteristic_acquire_notify(Characteristic *characteristic);
+
+gboolean binc_characteristic_is_notify_acquired(const Characteristic *characteristic);
+
+/**
+ * Open a persistent write-without-response channel using AcquireWrite.
+ *
+ * The OnWriteChannelStateChangedCallback is called with BINC_WRITE_CHANNEL_OPEN once the channel is ready.
+ * While acquired, BlueZ rejects regular WriteValue calls on this characteristic. The call is made right away, use
+ * binc_device_acquire_write() to go through the device's operation queue instead.
+ *
+ * @param characteristic the characteristic to acquire. Must support WITHOUT_RESPONSE writes.
+ */
+void binc_characteristic_acquire_write(Characteristic *characteristic);
+
+void binc_characteristic_release_write(Characteristic *characteristic);
+
+/**
+ * Write a single frame on an acquired write channel without blocking
+ *
+ * @param characteristic the characteristic with an acquired write channel
+ * @param byteArray the frame to send, at most binc_characteristic_get_write_channel_mtu() bytes
+ * @return 0 on success, EAGAIN if the socket buffer is full, EMSGSIZE if the frame is too large,
+ * ENOTCONN if the channel is not open or another errno value on failure. After EAGAIN the channel is
+ * BINC_WRITE_CHANNEL_BLOCKED until the callback reports BINC_WRITE_CHANNEL_OPEN again.
+ */
+int binc_characteristic_write_acquired(Characteristic *characteristic, const GByteArray *byteArray);
+
+WriteChannelState binc_characteristic_get_write_channel_state(const Characteristic *characteristic);
+
+guint binc_characteristic_get_write_channel_mtu(const Characteristic *characteristic);
+
 Service *binc_characteristic_get_service(const Characteristic *characteristic);
 
 Device *binc_characteristic_get_device(const Characteristic *characteristic);
 
 const char *binc_characteristic_get_uuid(const Characteristic *characteristic);
 
+const Uuid *binc_characteristic_get_uuid_value(const Characteristic *characteristic);
+
 GList *binc_characteristic_get_flags(const Characteristic *characteristic);
 
 guint binc_characteristic_get_properties(const Characteristic *characteristic);
@@ -102,8 +177,28 @@ gboolean binc_characteristic_supports_notify(const Characteristic *characteristi
 
 Descriptor *binc_characteristic_get_descriptor(const Characteristic *characteristic, const char *desc_uuid);
 
+Descriptor *binc_characteristic_get_descriptor_by_uuid(const Characteristic *characteristic, const Uuid *desc_uuid);
+
 GList *binc_characteristic_get_descriptors(const Characteristic *characteristic);
 
+/**
+ * Store notifications in a ring buffer instead of calling the OnNotifyCallback, so that a consumer thread can drain
+ * them in batches. While a ring is set the OnNotifyCallback is not called at all, also not for notifications the ring
+ * drops because it is full. The ring is not owned by the characteristic. Pass NULL to go back to the OnNotifyCallback.
+ *
+ * @param characteristic the characteristic
+ * @param ring the ring to store notifications in, or NULL
+ */
+void binc_characteristic_set_notify_ring(Characteristic *characteristic, NotificationRing *ring);
+
+/**
+ * Set the priority lane used when operations on this characteristic are issued through the Device.
+ * Defaults to BINC_PRIORITY_NORMAL.
+ */
+void binc_characteristic_set_priority(Characteristic *characteristic, OperationPriority priority);
+
+OperationPriority binc_characteristic_get_priority(const Characteristic *characteristic);
+
 /**
  * Get a string representation of the characteristic
  * @param characteristic
@@ -40,6 +40,9 @@ void binc_characteristic_set_write_cb(Characteristic *characteristic, OnWriteCal
 
 void binc_characteristic_set_notify_cb(Characteristic *characteristic, OnNotifyCallback callback);
 
+void binc_characteristic_set_write_channel_state_cb(Characteristic *characteristic,
+                                                    OnWriteChannelStateChangedCallback callback);
+
 void binc_characteristic_set_notifying_state_change_cb(Characteristic *characteristic,
                                                        OnNotifyingStateChangedCallback callback);
 
@@ -55,10 +58,41 @@ void binc_characteristic_set_mtu(Characteristic *characteristic, guint mtu);
 
 void binc_characteristic_set_notifying(Characteristic *characteristic, gboolean notifying);
 
+const char *binc_characteristic_get_path(const Characteristic *characteristic);
+
 const char *binc_characteristic_get_service_path(const Characteristic *characteristic);
 
+/**
+ * Handle the changed properties of a PropertiesChanged signal on the GattCharacteristic1 interface
+ */
+void binc_characteristic_handle_properties_changed(Characteristic *characteristic, GVariant *changed_properties);
+
 void binc_characteristic_add_descriptor(Characteristic *characteristic, Descriptor *descriptor);
 
+void binc_characteristic_remove_descriptor(Characteristic *characteristic, Descriptor *descriptor);
+
+/*
+ * Make the D-Bus call for a queued operation, its result is reported through binc_operation_complete() first
+ */
+void binc_characteristic_read_operation(Characteristic *characteristic, Operation *operation);
+
+void binc_characteristic_read_long_operation(Characteristic *characteristic, guint expected_length,
+                                             Operation *operation);
+
+void binc_characteristic_write_operation(Characteristic *characteristic, const GByteArray *byteArray,
+                                         WriteType writeType, Operation *operation);
+
+void binc_characteristic_write_long_operation(Characteristic *characteristic, const GByteArray *byteArray,
+                                              Operation *operation);
+
+void binc_characteristic_start_notify_operation(Characteristic *characteristic, Operation *operation);
+
+void binc_characteristic_stop_notify_operation(Characteristic *characteristic, Operation *operation);
+
+void binc_characteristic_acquire_notify_operation(Characteristic *characteristic, Operation *operation);
+
+void binc_characteristic_acquire_write_operation(Characteristic *characteristic, Operation *operation);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,397 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include "connection_manager.h"
+#include "adapter.h"
+#include "logger.h"
+#include "operation_internal.h"
+#include "utility.h"
+
+static const char *const TAG = "ConnectionManager";
+
+static const char *const BLUEZ_ERROR_FAILED = "org.bluez.Error.Failed";
+static const char *const BLUEZ_ERROR_IN_PROGRESS = "org.bluez.Error.InProgress";
+static const char *const BLUEZ_ERROR_NOT_READY = "org.bluez.Error.NotReady";
+static const char *const BLUEZ_ERROR_ALREADY_CONNECTED = "org.bluez.Error.AlreadyConnected";
+
+#define DEFAULT_MAX_ATTEMPTS 3
+#define DEFAULT_INITIAL_BACKOFF_MS 1000
+#define DEFAULT_MAX_BACKOFF_MS 30000
+#define DEFAULT_ATTEMPT_TIMEOUT_MS 10000
+
+typedef enum ConnectRequestState {
+    CONNECT_QUEUED = 0, CONNECT_ATTEMPTING = 1, CONNECT_BACKING_OFF = 2
+} ConnectRequestState;
+
+typedef struct binc_connect_request {
+    ConnectionManager *manager; // Borrowed, NULL once the manager is freed while an attempt is in progress
+    char *path; // Owned, the device is looked up again for every attempt since it may be removed meanwhile
+    OperationPriority priority;
+    ConnectRequestState state;
+    guint attempts;
+    gint64 queued_at; // Monotonic time in microseconds, 0 after the first attempt
+    guint backoff_timeout;
+    GCancellable *cancellable; // Owned, only during an attempt
+    OnConnectCallback callback;
+    void *user_data;
+} ConnectRequest;
+
+struct binc_connection_manager {
+    Adapter *adapter; // Borrowed
+    guint max_concurrent;
+    guint max_attempts;
+    guint initial_backoff_ms;
+    guint max_backoff_ms;
+    guint attempt_timeout_ms;
+    GQueue lanes[BINC_PRIORITY_LANES]; // Queued requests per priority
+    GHashTable *requests; // Owned, device path -> ConnectRequest
+    guint attempting;
+    guint pump_idle;
+    guint holds; // Pumps and callbacks that are running, a manager freed meanwhile is released by the last one
+    gboolean freed;
+    ConnectionManagerStats stats;
+};
+
+static void binc_internal_connect_request_free(ConnectRequest *request) {
+    if (request->backoff_timeout != 0) {
+        binc_source_remove(request->backoff_timeout);
+        request->backoff_timeout = 0;
+    }
+    g_clear_object(&request->cancellable);
+    g_free(request->path);
+    request->path = NULL;
+    g_free(request);
+}
+
+ConnectionManager *binc_connection_manager_create(Adapter *adapter, guint max_concurrent) {
+    g_assert(adapter != NULL);
+    g_assert(max_concurrent > 0);
+
+    ConnectionManager *manager = g_new0(ConnectionManager, 1);
+    manager->adapter = adapter;
+    manager->max_concurrent = max_concurrent;
+    manager->max_attempts = DEFAULT_MAX_ATTEMPTS;
+    manager->initial_backoff_ms = DEFAULT_INITIAL_BACKOFF_MS;
+    manager->max_backoff_ms = DEFAULT_MAX_BACKOFF_MS;
+    manager->attempt_timeout_ms = DEFAULT_ATTEMPT_TIMEOUT_MS;
+    for (guint i = 0; i < BINC_PRIORITY_LANES; i++) {
+        g_queue_init(&manager->lanes[i]);
+    }
+    manager->requests = g_hash_table_new(g_str_hash, g_str_equal);
+    return manager;
+}
+
+/*
+ * Let go of a hold on the manager
+ *
+ * @return FALSE if the manager was freed meanwhile, it must not be touched then
+ */
+static gboolean binc_internal_connection_manager_release(ConnectionManager *manager) {
+    manager->holds--;
+    if (manager->freed && manager->holds == 0) {
+        g_free(manager);
+        return FALSE;
+    }
+    return !manager->freed;
+}
+
+void binc_connection_manager_free(ConnectionManager *manager) {
+    g_assert(manager != NULL);
+    g_assert(!manager->freed);
+
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, manager->requests);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        ConnectRequest *request = (ConnectRequest *) value;
+        if (request->state == CONNECT_ATTEMPTING) {
+            // The connect callback still refers to the request, so it frees the request when it arrives
+            request->manager = NULL;
+            request->callback = NULL;
+            g_cancellable_cancel(request->cancellable);
+        } else {
+            binc_internal_connect_request_free(request);
+        }
+    }
+    g_hash_table_destroy(manager->requests);
+    manager->requests = NULL;
+
+    for (guint i = 0; i < BINC_PRIORITY_LANES; i++) {
+        g_queue_clear(&manager->lanes[i]);
+    }
+
+    if (manager->pump_idle != 0) {
+        binc_source_remove(manager->pump_idle);
+        manager->pump_idle = 0;
+    }
+
+    manager->adapter = NULL;
+
+    // Freed from a callback, the manager is released once the callback returns
+    if (manager->holds > 0) {
+        manager->freed = TRUE;
+        return;
+    }
+    g_free(manager);
+}
+
+void binc_connection_manager_set_retry_policy(ConnectionManager *manager, guint max_attempts,
+                                              guint initial_backoff_ms, guint max_backoff_ms) {
+    g_assert(manager != NULL);
+    g_assert(max_attempts > 0);
+    g_assert(initial_backoff_ms <= max_backoff_ms);
+
+    manager->max_attempts = max_attempts;
+    manager->initial_backoff_ms = initial_backoff_ms;
+    manager->max_backoff_ms = max_backoff_ms;
+}
+
+void binc_connection_manager_set_attempt_timeout(ConnectionManager *manager, guint timeout_ms) {
+    g_assert(manager != NULL);
+    manager->attempt_timeout_ms = timeout_ms;
+}
+
+/*
+ * Finish a request and call it back. The callback may free the manager.
+ *
+ * @return FALSE if the manager was freed by the callback
+ */
+static gboolean binc_internal_connect_request_finish(ConnectRequest *request, Device *device, const GError *error) {
+    ConnectionManager *manager = request->manager;
+    g_hash_table_remove(manager->requests, request->path);
+
+    if (error == NULL) {
+        manager->stats.successes++;
+    } else {
+        manager->stats.failures++;
+    }
+
+    manager->holds++;
+    if (request->callback != NULL) {
+        request->callback(device, error, request->user_data);
+    }
+    binc_internal_connect_request_free(request);
+    return binc_internal_connection_manager_release(manager);
+}
+
+static gboolean is_transient_error(const GError *error) {
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT) ||
+        g_error_matches(error, G_IO_ERROR, G_IO_ERROR_BUSY) ||
+        g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_NO_REPLY)) {
+        return TRUE;
+    }
+
+    char *remote_error = g_dbus_error_get_remote_error(error);
+    gboolean result = remote_error != NULL && (g_str_equal(remote_error, BLUEZ_ERROR_FAILED) ||
+                                               g_str_equal(remote_error, BLUEZ_ERROR_IN_PROGRESS) ||
+                                               g_str_equal(remote_error, BLUEZ_ERROR_NOT_READY));
+    g_free(remote_error);
+    return result;
+}
+
+static gboolean is_already_connected(const GError *error) {
+    char *remote_error = g_dbus_error_get_remote_error(error);
+    gboolean result = remote_error != NULL && g_str_equal(remote_error, BLUEZ_ERROR_ALREADY_CONNECTED);
+    g_free(remote_error);
+    return result;
+}
+
+/*
+ * Exponential backoff with jitter, so requests that failed together don't retry together
+ */
+static guint binc_internal_backoff_ms(const ConnectionManager *manager, guint attempts) {
+    guint backoff = manager->initial_backoff_ms;
+    for (guint i = 1; i < attempts && backoff < manager->max_backoff_ms; i++) {
+        backoff *= 2;
+    }
+    backoff = MIN(backoff, manager->max_backoff_ms);
+    return backoff / 2 + (guint) g_random_int_range(0, (gint32) (backoff / 2) + 1);
+}
+
+static void binc_internal_connection_manager_schedule_pump(ConnectionManager *manager);
+
+static gboolean binc_internal_backoff_expired(gpointer user_data) {
+    ConnectRequest *request = (ConnectRequest *) user_data;
+    ConnectionManager *manager = request->manager;
+
+    request->backoff_timeout = 0;
+    request->state = CONNECT_QUEUED;
+    g_queue_push_tail(&manager->lanes[request->priority], request);
+    binc_internal_connection_manager_schedule_pump(manager);
+    return G_SOURCE_REMOVE;
+}
+
+static void binc_internal_attempt_cb(Device *device, const GError *error, void *user_data) {
+    ConnectRequest *request = (ConnectRequest *) user_data;
+    ConnectionManager *manager = request->manager;
+    g_clear_object(&request->cancellable);
+
+    if (manager == NULL) {
+        binc_internal_connect_request_free(request);
+        return;
+    }
+
+    manager->attempting--;
+    if (error != NULL && is_already_connected(error)) {
+        error = NULL;
+    }
+
+    if (error != NULL && is_transient_error(error) && request->attempts < manager->max_attempts) {
+        guint backoff = binc_internal_backoff_ms(manager, request->attempts);
+        log_debug(TAG, "retrying %s in %u ms (error %d: %s)", request->path, backoff, error->code, error->message);
+        manager->stats.retries++;
+        request->state = CONNECT_BACKING_OFF;
+        request->backoff_timeout = binc_timeout_add(backoff, binc_internal_backoff_expired, request);
+    } else if (!binc_internal_connect_request_finish(request, device, error)) {
+        return;
+    }
+
+    binc_internal_connection_manager_schedule_pump(manager);
+}
+
+static void binc_internal_start_attempt(ConnectionManager *manager, ConnectRequest *request) {
+    Device *device = binc_adapter_get_device_by_path(manager->adapter, request->path);
+    if (device == NULL) {
+        GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "device %s was removed", request->path);
+        binc_internal_connect_request_finish(request, NULL, error);
+        g_error_free(error);
+        return;
+    }
+
+    if (binc_device_get_connection_state(device) == BINC_CONNECTED) {
+        binc_internal_connect_request_finish(request, device, NULL);
+        return;
+    }
+
+    if (request->queued_at != 0) {
+        manager->stats.total_wait_ms += (guint64) (g_get_monotonic_time() - request->queued_at) / 1000;
+        request->queued_at = 0;
+    }
+
+    request->attempts++;
+    request->state = CONNECT_ATTEMPTING;
+    request->cancellable = g_cancellable_new();
+    manager->attempting++;
+    manager->stats.attempts++;
+    binc_device_connect_with_callback(device, binc_internal_attempt_cb, request, manager->attempt_timeout_ms,
+                                      request->cancellable);
+}
+
+static ConnectRequest *binc_internal_next_request(ConnectionManager *manager) {
+    for (guint i = 0; i < BINC_PRIORITY_LANES; i++) {
+        ConnectRequest *request = g_queue_pop_head(&manager->lanes[i]);
+        if (request != NULL) return request;
+    }
+    return NULL;
+}
+
+static gboolean binc_internal_connection_manager_pump(gpointer user_data) {
+    ConnectionManager *manager = (ConnectionManager *) user_data;
+    manager->pump_idle = 0;
+
+    // Attempts may finish right away and call back, which may free the manager
+    manager->holds++;
+    while (!manager->freed && manager->attempting < manager->max_concurrent) {
+        ConnectRequest *request = binc_internal_next_request(manager);
+        if (request == NULL) break;
+
+        binc_internal_start_attempt(manager, request);
+    }
+    binc_internal_connection_manager_release(manager);
+    return FALSE;
+}
+
+/*
+ * Requests are started from the main loop, so callers never get called back before they return
+ */
+static void binc_internal_connection_manager_schedule_pump(ConnectionManager *manager) {
+    if (manager->pump_idle == 0) {
+        manager->pump_idle = binc_idle_add(binc_internal_connection_manager_pump, manager);
+    }
+}
+
+gboolean binc_connection_manager_connect(ConnectionManager *manager, Device *device, OperationPriority priority,
+                                         OnConnectCallback callback, void *user_data) {
+    g_assert(manager != NULL);
+    g_assert(device != NULL);
+    g_assert(priority < BINC_PRIORITY_LANES);
+
+    const char *path = binc_device_get_path(device);
+    if (g_hash_table_contains(manager->requests, path)) return FALSE;
+
+    ConnectRequest *request = g_new0(ConnectRequest, 1);
+    request->manager = manager;
+    request->path = g_strdup(path);
+    request->priority = priority;
+    request->state = CONNECT_QUEUED;
+    request->queued_at = g_get_monotonic_time();
+    request->callback = callback;
+    request->user_data = user_data;
+    g_hash_table_insert(manager->requests, request->path, request);
+    g_queue_push_tail(&manager->lanes[priority], request);
+
+    binc_internal_connection_manager_schedule_pump(manager);
+    return TRUE;
+}
+
+gboolean binc_connection_manager_cancel(ConnectionManager *manager, const Device *device) {
+    g_assert(manager != NULL);
+    g_assert(device != NULL);
+
+    ConnectRequest *request = g_hash_table_lookup(manager->requests, binc_device_get_path(device));
+    if (request == NULL) return FALSE;
+
+    // An attempt in progress finishes through its callback with G_IO_ERROR_CANCELLED
+    if (request->state == CONNECT_ATTEMPTING) {
+        g_cancellable_cancel(request->cancellable);
+        return TRUE;
+    }
+
+    if (request->state == CONNECT_QUEUED) {
+        g_queue_remove(&manager->lanes[request->priority], request);
+    }
+
+    GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED, "connect request cancelled");
+    binc_internal_connect_request_finish(request, (Device *) device, error);
+    g_error_free(error);
+    return TRUE;
+}
+
+gboolean binc_connection_manager_is_pending(const ConnectionManager *manager, const Device *device) {
+    g_assert(manager != NULL);
+    g_assert(device != NULL);
+    return g_hash_table_contains(manager->requests, binc_device_get_path(device));
+}
+
+void binc_connection_manager_get_stats(const ConnectionManager *manager, ConnectionManagerStats *stats) {
+    g_assert(manager != NULL);
+    g_assert(stats != NULL);
+
+    *stats = manager->stats;
+    stats->queued = 0;
+    for (guint i = 0; i < BINC_PRIORITY_LANES; i++) {
+        stats->queued += manager->lanes[i].length;
+    }
+    stats->connecting = manager->attempting;
+    stats->backing_off = g_hash_table_size(manager->requests) - stats->queued - stats->connecting;
+}
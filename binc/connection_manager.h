@@ -0,0 +1,112 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_CONNECTION_MANAGER_H
+#define BINC_CONNECTION_MANAGER_H
+
+#include <gio/gio.h>
+#include "forward_decl.h"
+#include "device.h"
+#include "operation.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Queues connect requests for the devices of one adapter. Requests are started in priority order, at most
+ * max_concurrent at a time, since controllers only handle a few connection attempts at once. Attempts that fail with
+ * a transient error are retried after a jittered exponential backoff.
+ */
+
+typedef struct binc_connection_manager_stats {
+    guint queued; // Requests waiting for a free slot
+    guint connecting; // Attempts in progress
+    guint backing_off; // Requests waiting to be retried
+    guint64 attempts; // Connect attempts started
+    guint64 retries; // Attempts that failed with a transient error and were retried
+    guint64 successes;
+    guint64 failures; // Requests that finally failed, including cancelled ones
+    guint64 total_wait_ms; // Time requests spent queued before their first attempt
+} ConnectionManagerStats;
+
+/**
+ * Create a connection manager
+ *
+ * @param adapter the adapter whose devices are connected
+ * @param max_concurrent maximum number of connection attempts in progress at the same time
+ * @return the connection manager, free with binc_connection_manager_free()
+ */
+ConnectionManager *binc_connection_manager_create(Adapter *adapter, guint max_concurrent);
+
+/**
+ * Free the connection manager. Attempts in progress are aborted and no more callbacks are called. May be called
+ * from an OnConnectCallback of this manager.
+ */
+void binc_connection_manager_free(ConnectionManager *manager);
+
+/**
+ * Set the retry policy. The default is 3 attempts, starting with a 1 second backoff up to 30 seconds.
+ *
+ * @param max_attempts total number of attempts per request, including the first one
+ * @param initial_backoff_ms backoff before the first retry, doubled for every next retry
+ * @param max_backoff_ms upper limit for the backoff
+ */
+void binc_connection_manager_set_retry_policy(ConnectionManager *manager, guint max_attempts,
+                                              guint initial_backoff_ms, guint max_backoff_ms);
+
+/**
+ * Set the deadline of a single connection attempt. The default is 10 seconds, 0 waits as long as BlueZ does.
+ */
+void binc_connection_manager_set_attempt_timeout(ConnectionManager *manager, guint timeout_ms);
+
+/**
+ * Queue a connect request. The ConnectionStateChangedCallback of the device is called as usual for every attempt.
+ * Requests are started from the main loop, so the callback is never called before this returns.
+ *
+ * @param device the device to connect to
+ * @param priority requests in a higher priority lane are started first
+ * @param callback called once with NULL when connected, or with the last error. The device is NULL if it was removed
+ * while the request was pending. May be NULL.
+ * @param user_data passed to the callback
+ * @return FALSE if a request for this device is already pending
+ */
+gboolean binc_connection_manager_connect(ConnectionManager *manager, Device *device, OperationPriority priority,
+                                         OnConnectCallback callback, void *user_data);
+
+/**
+ * Cancel a pending request. Its callback is called with G_IO_ERROR_CANCELLED.
+ *
+ * @return FALSE if there was no pending request for this device
+ */
+gboolean binc_connection_manager_cancel(ConnectionManager *manager, const Device *device);
+
+gboolean binc_connection_manager_is_pending(const ConnectionManager *manager, const Device *device);
+
+void binc_connection_manager_get_stats(const ConnectionManager *manager, ConnectionManagerStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BINC_CONNECTION_MANAGER_H
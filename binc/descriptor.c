@@ -29,8 +29,10 @@
 
 #include "descriptor.h"
 #include "device_internal.h"
+#include "operation_internal.h"
 #include "utility.h"
 #include "logger.h"
+#include "long_value.h"
 
 static const char *const TAG = "Descriptor";
 
@@ -45,8 +47,11 @@ struct binc_descriptor {
     GDBusConnection *connection; // Borrowed
     const char *path; // Owned
     const char *char_path; // Owned
-    const char *uuid; // Owned
+    const Uuid *uuid; // Interned
     GList *flags; // Owned
+    GCancellable *cancellable; // Owned, cancels the direct calls when the descriptor is freed
+    guint calls_pending;
+    gboolean freed; // Freed while calls were pending, waiting for their replies
 
     OnDescReadCallback on_read_cb;
     OnDescWriteCallback on_write_cb;
@@ -61,6 +66,7 @@ Descriptor *binc_descriptor_create(Device *device, const char *path) {
     descriptor->device = device;
     descriptor->connection = binc_device_get_dbus_connection(device);
     descriptor->path = g_strdup(path);
+    descriptor->cancellable = g_cancellable_new();
     return descriptor;
 }
 
@@ -72,7 +78,6 @@ void binc_descriptor_free(Descriptor *descriptor) {
         descriptor->flags = NULL;
     }
 
-    g_free((char *) descriptor->uuid);
     descriptor->uuid = NULL;
     g_free((char *) descriptor->path);
     descriptor->path = NULL;
@@ -82,6 +87,15 @@ void binc_descriptor_free(Descriptor *descriptor) {
     descriptor->characteristic = NULL;
     descriptor->device = NULL;
     descriptor->connection = NULL;
+
+    // Replies of pending calls still refer to the descriptor, the last one releases it
+    if (descriptor->calls_pending > 0) {
+        descriptor->freed = TRUE;
+        g_cancellable_cancel(descriptor->cancellable);
+        return;
+    }
+
+    g_object_unref(descriptor->cancellable);
     g_free(descriptor);
 }
 
@@ -99,7 +113,7 @@ const char *binc_descriptor_to_string(const Descriptor *descriptor) {
 
     char *result = g_strdup_printf(
             "Descriptor{uuid='%s', flags='%s', properties=%d, char_uuid='%s'}",
-            descriptor->uuid,
+            binc_descriptor_get_uuid(descriptor),
             flags->str,
             0,
             binc_characteristic_get_uuid(descriptor->characteristic));
@@ -110,10 +124,9 @@ const char *binc_descriptor_to_string(const Descriptor *descriptor) {
 
 void binc_descriptor_set_uuid(Descriptor *descriptor, const char *uuid) {
     g_assert(descriptor != NULL);
-    g_assert(is_valid_uuid(uuid));
 
-    g_free((char *) descriptor->uuid);
-    descriptor->uuid = g_strdup(uuid);
+    descriptor->uuid = binc_uuid_intern_string(uuid);
+    g_assert(descriptor->uuid != NULL);
 }
 
 void binc_descriptor_set_char_path(Descriptor *descriptor, const char *path) {
@@ -124,12 +137,22 @@ void binc_descriptor_set_char_path(Descriptor *descriptor, const char *path) {
     descriptor->char_path = g_strdup(path);
 }
 
+const char *binc_descriptor_get_path(const Descriptor *descriptor) {
+    g_assert(descriptor != NULL);
+    return descriptor->path;
+}
+
 const char *binc_descriptor_get_char_path(const Descriptor *descriptor) {
     g_assert(descriptor != NULL);
     return descriptor->char_path;
 }
 
 const char *binc_descriptor_get_uuid(const Descriptor *descriptor) {
+    g_assert(descriptor != NULL);
+    return descriptor->uuid != NULL ? binc_uuid_get_string(descriptor->uuid) : NULL;
+}
+
+const Uuid *binc_descriptor_get_uuid_value(const Descriptor *descriptor) {
     g_assert(descriptor != NULL);
     return descriptor->uuid;
 }
@@ -151,28 +174,77 @@ void binc_descriptor_set_flags(Descriptor *descriptor, GList *flags) {
     descriptor->flags = flags;
 }
 
+/*
+ * Context of a D-Bus call, see the one of characteristics
+ */
+typedef struct binc_desc_call {
+    Descriptor *descriptor; // Borrowed
+    Operation *operation; // Borrowed, NULL for direct calls
+    GVariant *value; // Owned, the value being written
+} DescCall;
+
+static DescCall *binc_internal_desc_call_create(Descriptor *descriptor, Operation *operation) {
+    DescCall *call = g_new0(DescCall, 1);
+    call->descriptor = descriptor;
+    call->operation = operation;
+    descriptor->calls_pending++;
+    return call;
+}
+
+/*
+ * @return FALSE if the descriptor was freed while the call was pending, it must not be touched then
+ */
+static gboolean binc_internal_desc_call_release(DescCall *call) {
+    Descriptor *descriptor = call->descriptor;
+    if (call->value != NULL) {
+        g_variant_unref(call->value);
+    }
+    g_free(call);
+
+    g_assert(descriptor->calls_pending > 0);
+    descriptor->calls_pending--;
+    if (!descriptor->freed) return TRUE;
+
+    if (descriptor->calls_pending == 0) {
+        g_object_unref(descriptor->cancellable);
+        g_free(descriptor);
+    }
+    return FALSE;
+}
+
+static GCancellable *binc_internal_desc_call_cancellable(const DescCall *call) {
+    if (call->operation != NULL) {
+        return binc_operation_get_cancellable(call->operation);
+    }
+    return call->descriptor->cancellable;
+}
+
+static gboolean binc_internal_desc_call_complete(const DescCall *call, const GByteArray *byteArray,
+                                                 const GError *error) {
+    return call->operation != NULL && binc_operation_complete(call->operation, byteArray, error);
+}
+
 static void binc_internal_descriptor_read_cb(GObject *source_object, GAsyncResult *res, gpointer user_data) {
     GError *error = NULL;
-    GByteArray *byteArray = NULL;
+    GByteArray view;
+    const GByteArray *byteArray = NULL;
     GVariant *innerArray = NULL;
-    Descriptor *descriptor = (Descriptor *) user_data;
-    g_assert(descriptor != NULL);
+    DescCall *call = (DescCall *) user_data;
+    g_assert(call != NULL);
 
-    GVariant *value = g_dbus_connection_call_finish(descriptor->connection, res, &error);
+    GVariant *value = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), res, &error);
     if (value != NULL) {
         g_assert(g_str_equal(g_variant_get_type_string(value), "(ay)"));
         innerArray = g_variant_get_child_value(value, 0);
-        byteArray = g_variant_get_byte_array(innerArray);
+        byteArray = g_variant_get_byte_array_view(innerArray, &view);
     }
 
-    if (descriptor->on_read_cb != NULL) {
+    Descriptor *descriptor = call->descriptor;
+    gboolean consumed = binc_internal_desc_call_complete(call, byteArray, error);
+    if (binc_internal_desc_call_release(call) && !consumed && descriptor->on_read_cb != NULL) {
         descriptor->on_read_cb(descriptor->device, descriptor, byteArray, error);
     }
 
-    if (byteArray != NULL) {
-        g_byte_array_free(byteArray, FALSE);
-    }
-
     if (innerArray != NULL) {
         g_variant_unref(innerArray);
     }
@@ -188,10 +260,10 @@ static void binc_internal_descriptor_read_cb(GObject *source_object, GAsyncResul
     }
 }
 
-void binc_descriptor_read(Descriptor *descriptor) {
+void binc_descriptor_read_operation(Descriptor *descriptor, Operation *operation) {
     g_assert(descriptor != NULL);
 
-    log_debug(TAG, "reading <%s>", descriptor->uuid);
+    log_debug(TAG, "reading <%s>", binc_descriptor_get_uuid(descriptor));
 
     guint16 offset = 0;
     GVariantBuilder *builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
@@ -199,6 +271,7 @@ void binc_descriptor_read(Descriptor *descriptor) {
     GVariant *options = g_variant_builder_end(builder);
     g_variant_builder_unref(builder);
 
+    DescCall *call = binc_internal_desc_call_create(descriptor, operation);
     g_dbus_connection_call(descriptor->connection,
                            BLUEZ_DBUS,
                            descriptor->path,
@@ -208,39 +281,33 @@ void binc_descriptor_read(Descriptor *descriptor) {
                            G_VARIANT_TYPE("(ay)"),
                            G_DBUS_CALL_FLAGS_NONE,
                            -1,
-                           NULL,
+                           binc_internal_desc_call_cancellable(call),
                            (GAsyncReadyCallback) binc_internal_descriptor_read_cb,
-                           descriptor);
+                           call);
 }
 
-typedef struct binc_desc_write_data {
-    GVariant *value;
-    Descriptor *descriptor;
-} WriteDescData;
+void binc_descriptor_read(Descriptor *descriptor) {
+    binc_descriptor_read_operation(descriptor, NULL);
+}
 
 static void binc_internal_descriptor_write_cb(GObject *source_object, GAsyncResult *res, gpointer user_data) {
-    WriteDescData *writeData = (WriteDescData *) user_data;
-    Descriptor *descriptor = writeData->descriptor;
-    g_assert(descriptor != NULL);
+    DescCall *call = (DescCall *) user_data;
+    g_assert(call != NULL);
 
-    GByteArray *byteArray = NULL;
+    GByteArray view;
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(descriptor->connection, res, &error);
-
-    if (writeData->value != NULL) {
-        byteArray = g_variant_get_byte_array(writeData->value);
-    }
-
-    if (descriptor->on_write_cb != NULL) {
+    GVariant *value = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), res, &error);
+    // Releasing the call drops its value, keep the written bytes alive until they are delivered
+    GVariant *written = g_variant_ref(call->value);
+    const GByteArray *byteArray = g_variant_get_byte_array_view(written, &view);
+
+    Descriptor *descriptor = call->descriptor;
+    gboolean consumed = binc_internal_desc_call_complete(call, byteArray, error);
+    if (binc_internal_desc_call_release(call) && !consumed && descriptor->on_write_cb != NULL) {
         descriptor->on_write_cb(descriptor->device, descriptor, byteArray, error);
     }
 
-    if (byteArray != NULL) {
-        g_byte_array_free(byteArray, FALSE);
-    }
-    g_variant_unref(writeData->value);
-    g_free(writeData);
-
+    g_variant_unref(written);
     if (value != NULL) {
         g_variant_unref(value);
     }
@@ -252,20 +319,21 @@ static void binc_internal_descriptor_write_cb(GObject *source_object, GAsyncResu
     }
 }
 
-void binc_descriptor_write(Descriptor *descriptor, const GByteArray *byteArray) {
+void binc_descriptor_write_operation(Descriptor *descriptor, const GByteArray *byteArray, Operation *operation) {
     g_assert(descriptor != NULL);
     g_assert(byteArray != NULL);
     g_assert(byteArray->len > 0);
 
-    GString *byteArrayStr = g_byte_array_as_hex(byteArray);
-    log_debug(TAG, "writing <%s> to <%s>", byteArrayStr->str, descriptor->uuid);
-    g_string_free(byteArrayStr, TRUE);
+    if (log_is_enabled(LOG_DEBUG)) {
+        GString *byteArrayStr = g_byte_array_as_hex(byteArray);
+        log_debug(TAG, "writing <%s> to <%s>", byteArrayStr->str, binc_descriptor_get_uuid(descriptor));
+        g_string_free(byteArrayStr, TRUE);
+    }
 
     GVariant *value = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, byteArray->data, byteArray->len, sizeof(guint8));
 
-    WriteDescData *writeData = g_new0(WriteDescData, 1);
-    writeData->value = g_variant_ref(value);
-    writeData->descriptor = descriptor;
+    DescCall *call = binc_internal_desc_call_create(descriptor, operation);
+    call->value = g_variant_ref(value);
 
     guint16 offset = 0;
     GVariantBuilder *builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
@@ -282,9 +350,62 @@ void binc_descriptor_write(Descriptor *descriptor, const GByteArray *byteArray)
                            NULL,
                            G_DBUS_CALL_FLAGS_NONE,
                            -1,
-                           NULL,
+                           binc_internal_desc_call_cancellable(call),
                            (GAsyncReadyCallback) binc_internal_descriptor_write_cb,
-                           writeData);
+                           call);
+}
+
+void binc_descriptor_write(Descriptor *descriptor, const GByteArray *byteArray) {
+    binc_descriptor_write_operation(descriptor, byteArray, NULL);
+}
+
+static void binc_internal_descriptor_read_long_cb(const GByteArray *byteArray, const GError *error,
+                                                  gpointer user_data) {
+    DescCall *call = (DescCall *) user_data;
+    g_assert(call != NULL);
+
+    Descriptor *descriptor = call->descriptor;
+    if (!binc_internal_desc_call_release(call)) return;
+
+    const GByteArray *value = error == NULL ? byteArray : NULL;
+    log_debug(TAG, "read %u bytes from <%s>", byteArray->len, binc_descriptor_get_uuid(descriptor));
+    if (descriptor->on_read_cb != NULL) {
+        descriptor->on_read_cb(descriptor->device, descriptor, value, error);
+    }
+}
+
+void binc_descriptor_read_long(Descriptor *descriptor, guint expected_length) {
+    g_assert(descriptor != NULL);
+
+    log_debug(TAG, "reading long <%s>", binc_descriptor_get_uuid(descriptor));
+    binc_long_value_read(descriptor->connection, descriptor->path, INTERFACE_DESCRIPTOR,
+                         binc_device_get_mtu(descriptor->device), expected_length, descriptor->cancellable,
+                         binc_internal_descriptor_read_long_cb, binc_internal_desc_call_create(descriptor, NULL));
+}
+
+static void binc_internal_descriptor_write_long_cb(const GByteArray *byteArray, const GError *error,
+                                                   gpointer user_data) {
+    DescCall *call = (DescCall *) user_data;
+    g_assert(call != NULL);
+
+    Descriptor *descriptor = call->descriptor;
+    if (!binc_internal_desc_call_release(call)) return;
+
+    log_debug(TAG, "wrote %u bytes to <%s>", byteArray->len, binc_descriptor_get_uuid(descriptor));
+    if (descriptor->on_write_cb != NULL) {
+        descriptor->on_write_cb(descriptor->device, descriptor, byteArray, error);
+    }
+}
+
+void binc_descriptor_write_long(Descriptor *descriptor, const GByteArray *byteArray) {
+    g_assert(descriptor != NULL);
+    g_assert(byteArray != NULL);
+    g_assert(byteArray->len > 0);
+
+    log_debug(TAG, "writing long value of %u bytes to <%s>", byteArray->len, binc_descriptor_get_uuid(descriptor));
+    binc_long_value_write(descriptor->connection, descriptor->path, INTERFACE_DESCRIPTOR, byteArray, NULL,
+                          descriptor->cancellable, binc_internal_descriptor_write_long_cb,
+                          binc_internal_desc_call_create(descriptor, NULL));
 }
 
 void binc_descriptor_set_read_cb(Descriptor *descriptor, OnDescReadCallback callback) {
@@ -26,6 +26,7 @@
 
 #include <gio/gio.h>
 #include "forward_decl.h"
+#include "uuid.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,8 +40,20 @@ void binc_descriptor_read(Descriptor *descriptor);
 
 void binc_descriptor_write(Descriptor *descriptor, const GByteArray *byteArray);
 
+/**
+ * Read a descriptor value that may be longer than a single ATT payload, see binc_characteristic_read_long()
+ */
+void binc_descriptor_read_long(Descriptor *descriptor, guint expected_length);
+
+/**
+ * Write a descriptor value that may be longer than a single ATT payload, see binc_characteristic_write_long()
+ */
+void binc_descriptor_write_long(Descriptor *descriptor, const GByteArray *byteArray);
+
 const char *binc_descriptor_get_uuid(const Descriptor *descriptor);
 
+const Uuid *binc_descriptor_get_uuid_value(const Descriptor *descriptor);
+
 const char *binc_descriptor_to_string(const Descriptor *descriptor);
 
 Characteristic *binc_descriptor_get_char(const Descriptor *descriptor);
@@ -42,6 +42,15 @@ void binc_descriptor_set_char(Descriptor *descriptor, Characteristic *characteri
 
 void binc_descriptor_set_flags(Descriptor *descriptor, GList *flags);
 
+const char *binc_descriptor_get_path(const Descriptor *descriptor);
+
 const char *binc_descriptor_get_char_path(const Descriptor *descriptor);
 
+/*
+ * Make the D-Bus call for a queued operation, its result is reported through binc_operation_complete() first
+ */
+void binc_descriptor_read_operation(Descriptor *descriptor, Operation *operation);
+
+void binc_descriptor_write_operation(Descriptor *descriptor, const GByteArray *byteArray, Operation *operation);
+
 #endif //BINC_DESCRIPTOR_INTERNAL_H
@@ -24,11 +24,14 @@
 #include <gio/gio.h>
 #include "logger.h"
 #include "device.h"
+#include "device_internal.h"
 #include "utility.h"
 #include "service_internal.h"
 #include "characteristic_internal.h"
-#include "adapter.h"
+#include "adapter_internal.h"
 #include "descriptor_internal.h"
+#include "operation_internal.h"
+#include "gatt_cache.h"
 
 static const char *const TAG = "Device";
 static const char *const BLUEZ_DBUS = "org.bluez";
@@ -38,24 +41,21 @@ static const char *const DEVICE_METHOD_CONNECT = "Connect";
 static const char *const DEVICE_METHOD_PAIR = "Pair";
 static const char *const DEVICE_METHOD_DISCONNECT = "Disconnect";
 
-static const char *const DEVICE_PROPERTY_ADDRESS = "Address";
-static const char *const DEVICE_PROPERTY_ADDRESS_TYPE = "AddressType";
-static const char *const DEVICE_PROPERTY_ALIAS = "Alias";
-static const char *const DEVICE_PROPERTY_NAME = "Name";
-static const char *const DEVICE_PROPERTY_PAIRED = "Paired";
-static const char *const DEVICE_PROPERTY_RSSI = "RSSI";
-static const char *const DEVICE_PROPERTY_UUIDS = "UUIDs";
-static const char *const DEVICE_PROPERTY_MANUFACTURER_DATA = "ManufacturerData";
-static const char *const DEVICE_PROPERTY_SERVICE_DATA = "ServiceData";
-static const char *const DEVICE_PROPERTY_TRUSTED = "Trusted";
-static const char *const DEVICE_PROPERTY_TXPOWER = "TxPower";
-static const char *const DEVICE_PROPERTY_CONNECTED = "Connected";
-static const char *const DEVICE_PROPERTY_SERVICES_RESOLVED = "ServicesResolved";
-
 static const char *const INTERFACE_SERVICE = "org.bluez.GattService1";
 static const char *const INTERFACE_CHARACTERISTIC = "org.bluez.GattCharacteristic1";
 static const char *const INTERFACE_DESCRIPTOR = "org.bluez.GattDescriptor1";
 
+static const char *const GATT_SERVICE_UUID = "00001801-0000-1000-8000-00805f9b34fb";
+static const char *const DATABASE_HASH_CHAR_UUID = "00002b2a-0000-1000-8000-00805f9b34fb";
+
+#define DATABASE_HASH_TIMEOUT_MS 5000
+#define RECONNECT_INITIAL_DELAY_MS 500
+#define RECONNECT_MAX_DELAY_MS 30000
+
+typedef enum NotifyMode {
+    NOTIFY_MODE_START = 1, NOTIFY_MODE_ACQUIRE = 2
+} NotifyMode;
+
 static const char *connection_state_names[] = {
         [BINC_DISCONNECTED] = "DISCONNECTED",
         [BINC_CONNECTED] = "CONNECTED",
@@ -63,46 +63,139 @@ static const char *connection_state_names[] = {
         [BINC_DISCONNECTING]  = "DISCONNECTING"
 };
 
-struct binc_device {
-    GDBusConnection *connection; // Borrowed
-    Adapter *adapter; // Borrowed
-    const char *address; // Owned
-    const char *address_type; // Owned
-    const char *alias; // Owned
-    ConnectionState connection_state;
+typedef enum AddressType {
+    ADDRESS_TYPE_UNKNOWN = 0, ADDRESS_TYPE_PUBLIC = 1, ADDRESS_TYPE_RANDOM = 2
+} AddressType;
+
+static const char *address_type_names[] = {
+        [ADDRESS_TYPE_UNKNOWN] = NULL,
+        [ADDRESS_TYPE_PUBLIC] = "public",
+        [ADDRESS_TYPE_RANDOM] = "random"
+};
+
+#define ADVERTISEMENT_DATA_INLINE_SIZE 32
+
+/*
+ * Manufacturer or service data packed as records of a key, a 16 bit payload length and the payload. The key is the
+ * manufacturer id or the service uuid as an inline Uuid value. Typical advertisements fit in the inline buffer.
+ */
+typedef struct binc_advertisement_data {
+    guint8 *bytes; // Owned, NULL while the records fit in inline_bytes
+    guint16 length;
+    guint16 capacity;
+    guint8 inline_bytes[ADVERTISEMENT_DATA_INLINE_SIZE];
+    GHashTable *table; // Owned, only built when asked for by the public getters
+} AdvertisementData;
+
+#define ADVERTISED_UUIDS_INLINE_COUNT 2
+
+/*
+ * The advertised service uuids as values. Most devices advertise one or two, which fit in the inline array. They are
+ * not interned, any device nearby could otherwise grow the pool without bounds.
+ */
+typedef struct binc_advertised_uuids {
+    Uuid *values; // Owned, NULL while the uuids fit in inline_values
+    guint count;
+    Uuid inline_values[ADVERTISED_UUIDS_INLINE_COUNT];
+    GList *strings; // Owned, lowercase 128-bit form, only built when asked for by binc_device_get_uuids()
+} AdvertisedUuids;
+
+/*
+ * Everything needed once a device is connected to, allocated on first use so scanned devices stay small
+ */
+typedef struct binc_device_session {
     gboolean services_resolved;
     gboolean service_discovery_started;
-    gboolean paired;
-    BondingState bondingState;
-    const char *path; // Owned
-    const char *name; // Owned
-    short rssi;
-    gboolean trusted;
-    short txpower;
-    GHashTable *manufacturer_data; // Owned
-    GHashTable *service_data; // Owned
-    GList *uuids; // Owned
     guint mtu;
 
-    guint device_prop_changed;
+    gboolean tracking_properties;
+    gboolean auto_reconnect;
+    gboolean disconnect_requested;
+    gboolean link_lost; // Set between losing the link and reconnecting automatically
+    guint reconnect_attempts;
+    guint reconnect_timeout;
+    GHashTable *notify_subscriptions; // Owned, CharacteristicKey -> NotifyMode, restarted after reconnecting
     ConnectionStateChangedCallback connection_state_callback;
     ServicesResolvedCallback services_resolved_callback;
+    ServiceChangedCallback service_changed_callback;
+    GHashTable *pending_service_changes; // Owned, Service -> ServiceChange, owns the services that were removed
+    guint service_changes_idle;
     BondingStateChangedCallback bonding_state_callback;
     GHashTable *services; // Owned
     GList *services_list; // Owned
     GHashTable *characteristics; // Owned
     GHashTable *descriptors; // Owned
-    gboolean is_central;
+    GHashTable *service_index; // Owned
+    GHashTable *characteristic_index; // Owned
+    guint gatt_generation;
+    gboolean gatt_from_cache;
+    GByteArray *gatt_cache_db_hash; // Owned
 
     OnReadCallback on_read_callback;
     OnWriteCallback on_write_callback;
+    OnWriteChannelStateChangedCallback on_write_channel_callback;
     OnNotifyCallback on_notify_callback;
     OnNotifyingStateChangedCallback on_notify_state_callback;
     OnDescReadCallback on_read_desc_cb;
     OnDescWriteCallback on_write_desc_cb;
+    OperationQueue *operation_queue; // Owned
+    GCancellable *cancellable; // Owned, cancelled when the device is freed so replies of pending calls leave it alone
+} DeviceSession;
+
+struct binc_device {
+    GDBusConnection *connection; // Borrowed
+    Adapter *adapter; // Borrowed
+    guint64 address_value; // 48 bit address, most significant byte first
+    char address[BINC_ADDRESS_STRING_LENGTH];
+    guint8 address_type;
+    guint8 bondingState;
+    guint8 connection_state;
+    gboolean paired;
+    gboolean trusted;
+    gboolean is_central;
+    short rssi;
+    short txpower;
+    const char *path; // Owned
+    const char *alias; // Interned
+    const char *name; // Interned
+    AdvertisementData manufacturer_data;
+    AdvertisementData service_data;
+    AdvertisedUuids uuids;
+    gint64 last_seen; // Monotonic time in microseconds
+    DiscoveryReport discovery_report;
+
+    DeviceSession *session; // Owned, NULL until the device is used for more than scanning
     void *user_data; // Borrowed
 };
 
+/*
+ * Key of the characteristic index. Interned uuids are unique, so keys are hashed and compared by pointer.
+ */
+typedef struct binc_characteristic_key {
+    const Uuid *service_uuid; // Interned
+    const Uuid *characteristic_uuid; // Interned
+} CharacteristicKey;
+
+struct binc_characteristic_handle {
+    Device *device; // Borrowed
+    Uuid service_uuid; // Not interned, the handle may outlive every attribute with this uuid
+    Uuid characteristic_uuid;
+    Characteristic *characteristic; // Borrowed
+    guint generation;
+};
+
+static guint characteristic_key_hash(gconstpointer key) {
+    const CharacteristicKey *characteristic_key = (const CharacteristicKey *) key;
+    return g_direct_hash(characteristic_key->service_uuid) * 31 +
+           g_direct_hash(characteristic_key->characteristic_uuid);
+}
+
+static gboolean characteristic_key_equal(gconstpointer a, gconstpointer b) {
+    const CharacteristicKey *key_a = (const CharacteristicKey *) a;
+    const CharacteristicKey *key_b = (const CharacteristicKey *) b;
+    return key_a->characteristic_uuid == key_b->characteristic_uuid && key_a->service_uuid == key_b->service_uuid;
+}
+
 
 Device *binc_device_create(const char *path, Adapter *adapter) {
     g_assert(path != NULL);
@@ -117,83 +210,219 @@ Device *binc_device_create(const char *path, Adapter *adapter) {
     device->connection_state = BINC_DISCONNECTED;
     device->rssi = -255;
     device->txpower = -255;
-    device->mtu = 23;
+    device->last_seen = g_get_monotonic_time();
+    device->session = NULL;
     device->user_data = NULL;
     return device;
 }
 
-static void binc_device_free_uuids(Device *device) {
-    if (device->uuids != NULL) {
-        g_list_free_full(device->uuids, g_free);
-        device->uuids = NULL;
+static DeviceSession *binc_device_get_session(Device *device) {
+    if (device->session == NULL) {
+        DeviceSession *session = g_new0(DeviceSession, 1);
+        session->mtu = 23;
+        session->operation_queue = binc_operation_queue_create();
+        session->cancellable = g_cancellable_new();
+        session->pending_service_changes = g_hash_table_new(g_direct_hash, g_direct_equal);
+        session->notify_subscriptions = g_hash_table_new_full(characteristic_key_hash, characteristic_key_equal,
+                                                              g_free, NULL);
+        device->session = session;
+    }
+    return device->session;
+}
+
+static const Uuid *advertised_uuids_values(const AdvertisedUuids *uuids) {
+    return uuids->values != NULL ? uuids->values : uuids->inline_values;
+}
+
+static void advertised_uuids_free(AdvertisedUuids *uuids) {
+    if (uuids->strings != NULL) {
+        g_list_free_full(uuids->strings, g_free);
+        uuids->strings = NULL;
     }
+    g_free(uuids->values);
+    uuids->values = NULL;
+    uuids->count = 0;
 }
 
 static void byte_array_free(GByteArray *byteArray) { g_byte_array_free(byteArray, TRUE); }
 
-static void binc_device_free_manufacturer_data(Device *device) {
-    g_assert(device != NULL);
+static guint8 *advertisement_data_bytes(const AdvertisementData *data) {
+    return data->bytes != NULL ? data->bytes : (guint8 *) data->inline_bytes;
+}
 
-    if (device->manufacturer_data != NULL) {
-        g_hash_table_destroy(device->manufacturer_data);
-        device->manufacturer_data = NULL;
+static void advertisement_data_clear(AdvertisementData *data) {
+    if (data->table != NULL) {
+        g_hash_table_destroy(data->table);
+        data->table = NULL;
     }
+    data->length = 0;
 }
 
-static void binc_device_free_service_data(Device *device) {
-    g_assert(device != NULL);
+static void advertisement_data_free(AdvertisementData *data) {
+    advertisement_data_clear(data);
+    g_free(data->bytes);
+    data->bytes = NULL;
+    data->capacity = 0;
+}
+
+static void advertisement_data_append(AdvertisementData *data, gconstpointer key, gsize key_size,
+                                      const guint8 *payload, gsize payload_length) {
+    gsize record_size = key_size + sizeof(guint16) + payload_length;
+    if (data->length + record_size > G_MAXUINT16) {
+        log_debug(TAG, "ignoring %lu bytes of advertisement data", (unsigned long) payload_length);
+        return;
+    }
 
-    if (device->service_data != NULL) {
-        g_hash_table_destroy(device->service_data);
-        device->service_data = NULL;
+    gsize capacity = data->bytes != NULL ? data->capacity : ADVERTISEMENT_DATA_INLINE_SIZE;
+    if (data->length + record_size > capacity) {
+        capacity = MIN(MAX(capacity * 2, data->length + record_size), G_MAXUINT16);
+        guint8 *bytes = g_malloc(capacity);
+        memcpy(bytes, advertisement_data_bytes(data), data->length);
+        g_free(data->bytes);
+        data->bytes = bytes;
+        data->capacity = (guint16) capacity;
     }
+
+    guint8 *record = advertisement_data_bytes(data) + data->length;
+    guint16 length = (guint16) payload_length;
+    memcpy(record, key, key_size);
+    memcpy(record + key_size, &length, sizeof(guint16));
+    memcpy(record + key_size + sizeof(guint16), payload, payload_length);
+    data->length += (guint16) record_size;
 }
 
-void binc_device_free(Device *device) {
-    g_assert(device != NULL);
+static gboolean advertisement_data_next(const AdvertisementData *data, gsize key_size, gsize *offset,
+                                        const guint8 **key, const guint8 **payload, guint16 *payload_length) {
+    if (*offset >= data->length) return FALSE;
 
-    log_debug(TAG, "freeing %s", device->path);
+    const guint8 *record = advertisement_data_bytes(data) + *offset;
+    memcpy(payload_length, record + key_size, sizeof(guint16));
+    *key = record;
+    *payload = record + key_size + sizeof(guint16);
+    *offset += key_size + sizeof(guint16) + *payload_length;
+    return TRUE;
+}
+
+static const guint8 *advertisement_data_lookup(const AdvertisementData *data, gconstpointer key, gsize key_size,
+                                               gsize *length) {
+    gsize offset = 0;
+    const guint8 *record_key, *payload;
+    guint16 payload_length;
+    while (advertisement_data_next(data, key_size, &offset, &record_key, &payload, &payload_length)) {
+        if (memcmp(record_key, key, key_size) == 0) {
+            if (length != NULL) *length = payload_length;
+            return payload;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Check whether the record at offset has this key and payload, and move offset past it
+ */
+static gboolean advertisement_data_match_next(const AdvertisementData *data, gsize *offset, gconstpointer key,
+                                              gsize key_size, const guint8 *payload, gsize payload_length) {
+    const guint8 *record_key, *record_payload;
+    guint16 record_length;
+    if (!advertisement_data_next(data, key_size, offset, &record_key, &record_payload, &record_length)) return FALSE;
+
+    return record_length == payload_length && memcmp(record_key, key, key_size) == 0 &&
+           memcmp(record_payload, payload, payload_length) == 0;
+}
 
-    if (device->device_prop_changed != 0) {
-        g_dbus_connection_signal_unsubscribe(device->connection, device->device_prop_changed);
-        device->device_prop_changed = 0;
+static void binc_internal_free_removed_services(GHashTable *changes);
+
+static void binc_device_free_session(Device *device) {
+    DeviceSession *session = device->session;
+    if (session == NULL) return;
+
+    g_cancellable_cancel(session->cancellable);
+    g_object_unref(session->cancellable);
+    session->cancellable = NULL;
+
+    binc_operation_queue_free(session->operation_queue);
+    session->operation_queue = NULL;
+
+    if (session->service_changes_idle != 0) {
+        binc_source_remove(session->service_changes_idle);
+        session->service_changes_idle = 0;
     }
+    binc_internal_free_removed_services(session->pending_service_changes);
+    g_hash_table_destroy(session->pending_service_changes);
+    session->pending_service_changes = NULL;
 
-    g_free((char *) device->path);
-    device->path = NULL;
-    g_free((char *) device->address_type);
-    device->address_type = NULL;
-    g_free((char *) device->address);
-    device->address = NULL;
-    g_free((char *) device->alias);
-    device->alias = NULL;
-    g_free((char *) device->name);
-    device->name = NULL;
+    if (session->reconnect_timeout != 0) {
+        binc_source_remove(session->reconnect_timeout);
+        session->reconnect_timeout = 0;
+    }
+    g_hash_table_destroy(session->notify_subscriptions);
+    session->notify_subscriptions = NULL;
+
+    if (session->characteristic_index != NULL) {
+        g_hash_table_destroy(session->characteristic_index);
+        session->characteristic_index = NULL;
+    }
+
+    if (session->service_index != NULL) {
+        g_hash_table_destroy(session->service_index);
+        session->service_index = NULL;
+    }
+
+    if (session->descriptors != NULL) {
+        g_hash_table_destroy(session->descriptors);
+        session->descriptors = NULL;
+    }
+
+    if (session->characteristics != NULL) {
+        g_hash_table_destroy(session->characteristics);
+        session->characteristics = NULL;
+    }
 
-    if (device->descriptors != NULL) {
-        g_hash_table_destroy(device->descriptors);
-        device->descriptors = NULL;
+    if (session->services != NULL) {
+        g_hash_table_destroy(session->services);
+        session->services = NULL;
     }
 
-    if (device->characteristics != NULL) {
-        g_hash_table_destroy(device->characteristics);
-        device->characteristics = NULL;
+    if (session->services_list != NULL) {
+        g_list_free(session->services_list);
+        session->services_list = NULL;
     }
 
-    if (device->services != NULL) {
-        g_hash_table_destroy(device->services);
-        device->services = NULL;
+    if (session->gatt_cache_db_hash != NULL) {
+        g_byte_array_free(session->gatt_cache_db_hash, TRUE);
+        session->gatt_cache_db_hash = NULL;
     }
 
-    binc_device_free_manufacturer_data(device);
-    binc_device_free_service_data(device);
-    binc_device_free_uuids(device);
+    g_free(session);
+    device->session = NULL;
+}
+
+void binc_device_free(Device *device) {
+    g_assert(device != NULL);
+
+    log_debug(TAG, "freeing %s", device->path);
+
+    // Fail the pending operations while the device is still intact, their callbacks often use it
+    if (device->session != NULL) {
+        binc_operation_queue_clear(device->session->operation_queue);
+    }
+    binc_device_free_session(device);
 
-    if (device->services_list != NULL) {
-        g_list_free(device->services_list);
-        device->services_list = NULL;
+    g_free((char *) device->path);
+    device->path = NULL;
+    if (device->alias != NULL) {
+        g_ref_string_release((char *) device->alias);
+        device->alias = NULL;
+    }
+    if (device->name != NULL) {
+        g_ref_string_release((char *) device->name);
+        device->name = NULL;
     }
 
+    advertisement_data_free(&device->manufacturer_data);
+    advertisement_data_free(&device->service_data);
+    advertised_uuids_free(&device->uuids);
+
     device->connection = NULL;
     device->adapter = NULL;
     g_free(device);
@@ -204,26 +433,32 @@ char *binc_device_to_string(const Device *device) {
 
     // First build up uuids string
     GString *uuids = g_string_new("[");
-    if (g_list_length(device->uuids) > 0) {
-        for (GList *iterator = device->uuids; iterator; iterator = iterator->next) {
-            g_string_append_printf(uuids, "%s, ", (char *) iterator->data);
+    if (device->uuids.count > 0) {
+        const Uuid *values = advertised_uuids_values(&device->uuids);
+        for (guint i = 0; i < device->uuids.count; i++) {
+            char uuid_string[BINC_UUID_STRING_LENGTH];
+            binc_uuid_to_string(&values[i], uuid_string);
+            g_string_append_printf(uuids, "%s, ", uuid_string);
         }
         g_string_truncate(uuids, uuids->len - 2);
     }
     g_string_append(uuids, "]");
 
+    gsize offset;
+    const guint8 *key, *payload;
+    guint16 payload_length;
+
     // Build up manufacturer data string
     GString *manufacturer_data = g_string_new("[");
-    if (device->manufacturer_data != NULL && g_hash_table_size(device->manufacturer_data) > 0) {
-        GHashTableIter iter;
-        int *key;
-        gpointer value;
-        g_hash_table_iter_init(&iter, device->manufacturer_data);
-        while (g_hash_table_iter_next(&iter, (gpointer) &key, &value)) {
-            GByteArray *byteArray = (GByteArray *) value;
-            GString *byteArrayString = g_byte_array_as_hex(byteArray);
-            gint keyInt = *key;
-            g_string_append_printf(manufacturer_data, "%04X -> %s, ", keyInt, byteArrayString->str);
+    if (device->manufacturer_data.length > 0) {
+        offset = 0;
+        while (advertisement_data_next(&device->manufacturer_data, sizeof(guint16), &offset, &key, &payload,
+                                       &payload_length)) {
+            guint16 manufacturer_id;
+            memcpy(&manufacturer_id, key, sizeof(guint16));
+            GByteArray view = {(guint8 *) payload, payload_length};
+            GString *byteArrayString = g_byte_array_as_hex(&view);
+            g_string_append_printf(manufacturer_data, "%04X -> %s, ", manufacturer_id, byteArrayString->str);
             g_string_free(byteArrayString, TRUE);
         }
         g_string_truncate(manufacturer_data, manufacturer_data->len - 2);
@@ -232,14 +467,17 @@ char *binc_device_to_string(const Device *device) {
 
     // Build up service data string
     GString *service_data = g_string_new("[");
-    if (device->service_data != NULL && g_hash_table_size(device->service_data) > 0) {
-        GHashTableIter iter;
-        gpointer key, value;
-        g_hash_table_iter_init(&iter, device->service_data);
-        while (g_hash_table_iter_next(&iter, &key, &value)) {
-            GByteArray *byteArray = (GByteArray *) value;
-            GString *byteArrayString = g_byte_array_as_hex(byteArray);
-            g_string_append_printf(service_data, "%s -> %s, ", (char *) key, byteArrayString->str);
+    if (device->service_data.length > 0) {
+        offset = 0;
+        while (advertisement_data_next(&device->service_data, sizeof(Uuid), &offset, &key, &payload,
+                                       &payload_length)) {
+            Uuid uuid;
+            char uuid_string[BINC_UUID_STRING_LENGTH];
+            memcpy(&uuid, key, sizeof(Uuid));
+            binc_uuid_to_string(&uuid, uuid_string);
+            GByteArray view = {(guint8 *) payload, payload_length};
+            GString *byteArrayString = g_byte_array_as_hex(&view);
+            g_string_append_printf(service_data, "%s -> %s, ", uuid_string, byteArrayString->str);
             g_string_free(byteArrayString, TRUE);
         }
         g_string_truncate(service_data, service_data->len - 2);
@@ -250,7 +488,7 @@ char *binc_device_to_string(const Device *device) {
             "Device{name='%s', address='%s', address_type=%s, rssi=%d, uuids=%s, manufacturer_data=%s, service_data=%s, paired=%s, txpower=%d path='%s' }",
             device->name,
             device->address,
-            device->address_type,
+            address_type_names[device->address_type],
             device->rssi,
             uuids->str,
             manufacturer_data->str,
@@ -268,49 +506,135 @@ char *binc_device_to_string(const Device *device) {
 
 static void
 binc_on_characteristic_read(Device *device, Characteristic *characteristic, const GByteArray *byteArray, const GError *error) {
-    if (device->on_read_callback != NULL) {
-        device->on_read_callback(device, characteristic, byteArray, error);
+    if (device->session->on_read_callback != NULL) {
+        device->session->on_read_callback(device, characteristic, byteArray, error);
     }
 }
 
 static void
 binc_on_characteristic_write(Device *device, Characteristic *characteristic, const GByteArray *byteArray, const GError *error) {
-    if (device->on_write_callback != NULL) {
-        device->on_write_callback(device, characteristic, byteArray, error);
+    if (device->session->on_write_callback != NULL) {
+        device->session->on_write_callback(device, characteristic, byteArray, error);
+    }
+}
+
+static void binc_on_characteristic_write_channel_state_changed(Device *device, Characteristic *characteristic,
+                                                               WriteChannelState state, const GError *error) {
+    if (device->session->on_write_channel_callback != NULL) {
+        device->session->on_write_channel_callback(device, characteristic, state, error);
     }
 }
 
 static void binc_on_characteristic_notify(Device *device, Characteristic *characteristic, const GByteArray *byteArray) {
-    if (device->on_notify_callback != NULL) {
-        device->on_notify_callback(device, characteristic, byteArray);
+    if (device->session->on_notify_callback != NULL) {
+        device->session->on_notify_callback(device, characteristic, byteArray);
     }
 }
 
+static CharacteristicKey *binc_internal_characteristic_key(Characteristic *characteristic) {
+    Service *service = binc_characteristic_get_service(characteristic);
+    if (service == NULL || binc_characteristic_get_uuid_value(characteristic) == NULL) return NULL;
+
+    CharacteristicKey *key = g_new0(CharacteristicKey, 1);
+    key->service_uuid = binc_service_get_uuid_value(service);
+    key->characteristic_uuid = binc_characteristic_get_uuid_value(characteristic);
+    return key;
+}
+
 static void binc_on_characteristic_notification_state_changed(Device *device, Characteristic *characteristic, const GError *error) {
-    if (device->on_notify_state_callback != NULL) {
-        device->on_notify_state_callback(device, characteristic, error);
+    // Remember what was notifying so it can be restarted after reconnecting
+    if (error == NULL && binc_characteristic_is_notifying(characteristic)) {
+        CharacteristicKey *key = binc_internal_characteristic_key(characteristic);
+        if (key != NULL) {
+            NotifyMode mode = binc_characteristic_is_notify_acquired(characteristic) ? NOTIFY_MODE_ACQUIRE
+                                                                                     : NOTIFY_MODE_START;
+            g_hash_table_replace(device->session->notify_subscriptions, key, GINT_TO_POINTER(mode));
+        }
+    }
+
+    if (device->session->on_notify_state_callback != NULL) {
+        device->session->on_notify_state_callback(device, characteristic, error);
     }
 }
 
 static void binc_on_descriptor_read(Device *device, Descriptor *descriptor, const GByteArray *byteArray, const GError *error) {
-    if (device->on_read_desc_cb != NULL) {
-        device->on_read_desc_cb(device, descriptor, byteArray, error);
+    if (device->session->on_read_desc_cb != NULL) {
+        device->session->on_read_desc_cb(device, descriptor, byteArray, error);
     }
 }
 
 static void binc_on_descriptor_write(Device *device, Descriptor *descriptor, const GByteArray *byteArray, const GError *error) {
-    if (device->on_write_desc_cb != NULL) {
-        device->on_write_desc_cb(device, descriptor, byteArray, error);
+    if (device->session->on_write_desc_cb != NULL) {
+        device->session->on_write_desc_cb(device, descriptor, byteArray, error);
+    }
+}
+
+static gboolean binc_internal_reconnect(gpointer user_data);
+
+static void binc_internal_schedule_reconnect(Device *device) {
+    guint delay = RECONNECT_INITIAL_DELAY_MS;
+    for (guint i = 0; i < device->session->reconnect_attempts && delay < RECONNECT_MAX_DELAY_MS; i++) {
+        delay *= 2;
+    }
+    delay = MIN(delay, RECONNECT_MAX_DELAY_MS);
+    device->session->reconnect_attempts++;
+    device->session->link_lost = TRUE;
+
+    log_debug(TAG, "reconnecting to '%s' (%s) in %u ms", device->name, device->address, delay);
+    if (device->session->reconnect_timeout != 0) {
+        binc_source_remove(device->session->reconnect_timeout);
+    }
+    device->session->reconnect_timeout = binc_timeout_add(delay, binc_internal_reconnect, device);
+}
+
+/*
+ * BlueZ drops all notification sessions with the link, but doesn't always tell, so forget them here so they get
+ * restarted on the kept characteristics
+ */
+static void binc_internal_reset_notifying(Device *device) {
+    if (device->session->characteristics == NULL) return;
+
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, device->session->characteristics);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        Characteristic *characteristic = (Characteristic *) value;
+        if (!binc_characteristic_is_notify_acquired(characteristic)) {
+            binc_characteristic_set_notifying(characteristic, FALSE);
+        }
     }
 }
 
 static void binc_device_internal_set_conn_state(Device *device, ConnectionState state, GError *error) {
+    // A device that was only scanned has nothing to clean up or report on disconnecting
+    if (device->session == NULL && state == BINC_DISCONNECTED) {
+        device->connection_state = state;
+        return;
+    }
+    binc_device_get_session(device);
+
     ConnectionState old_state = device->connection_state;
     device->connection_state = state;
-    if (device->connection_state_callback != NULL) {
+    if (state == BINC_DISCONNECTED) {
+        binc_operation_queue_clear(device->session->operation_queue);
+        binc_operation_queue_set_objects_ready(device->session->operation_queue, TRUE);
+    } else if (state == BINC_CONNECTED) {
+        device->session->reconnect_attempts = 0;
+        binc_operation_queue_set_objects_ready(device->session->operation_queue, device->session->services_resolved);
+    }
+    if (device->session->connection_state_callback != NULL) {
         if (device->connection_state != old_state) {
-            device->connection_state_callback(device, state, error);
+            device->session->connection_state_callback(device, state, error);
+        }
+    }
+
+    // Reconnect after losing the link, and keep trying when a reconnect attempt fails
+    if (state == BINC_DISCONNECTED && old_state != BINC_DISCONNECTED && device->session->auto_reconnect &&
+        !device->session->disconnect_requested && (old_state != BINC_CONNECTING || device->session->reconnect_attempts > 0)) {
+        if (!device->session->link_lost) {
+            binc_internal_reset_notifying(device);
         }
+        binc_internal_schedule_reconnect(device);
     }
 }
 
@@ -332,21 +656,46 @@ static void binc_internal_extract_service(Device *device, const char *object_pat
     }
 
     Service *service = binc_service_create(device, object_path, uuid);
-    g_hash_table_insert(device->services, g_strdup(object_path), service);
+    g_hash_table_insert(device->session->services, g_strdup(object_path), service);
     g_free(uuid);
 }
 
-static void binc_internal_extract_characteristic(Device *device, const char *object_path, GVariant *properties) {
-    g_assert(device != NULL);
-    g_assert(object_path != NULL);
-    g_assert(properties != NULL);
-
+static Characteristic *binc_internal_create_characteristic(Device *device, const char *object_path) {
     Characteristic *characteristic = binc_characteristic_create(device, object_path);
     binc_characteristic_set_read_cb(characteristic, &binc_on_characteristic_read);
     binc_characteristic_set_write_cb(characteristic, &binc_on_characteristic_write);
     binc_characteristic_set_notify_cb(characteristic, &binc_on_characteristic_notify);
+    binc_characteristic_set_write_channel_state_cb(characteristic, &binc_on_characteristic_write_channel_state_changed);
     binc_characteristic_set_notifying_state_change_cb(characteristic,
                                                       &binc_on_characteristic_notification_state_changed);
+    return characteristic;
+}
+
+static void binc_internal_add_characteristic(Device *device, Characteristic *characteristic) {
+    // Get service and link the characteristic to the service
+    Service *service = g_hash_table_lookup(device->session->services,
+                                           binc_characteristic_get_service_path(characteristic));
+    if (service != NULL) {
+        binc_service_add_characteristic(service, characteristic);
+        binc_characteristic_set_service(characteristic, service);
+        g_hash_table_insert(device->session->characteristics, g_strdup(binc_characteristic_get_path(characteristic)),
+                            characteristic);
+
+        char *charString = binc_characteristic_to_string(characteristic);
+        log_debug(TAG, charString);
+        g_free(charString);
+    } else {
+        log_error(TAG, "could not find service %s",
+                  binc_characteristic_get_service_path(characteristic));
+    }
+}
+
+static void binc_internal_extract_characteristic(Device *device, const char *object_path, GVariant *properties) {
+    g_assert(device != NULL);
+    g_assert(object_path != NULL);
+    g_assert(properties != NULL);
+
+    Characteristic *characteristic = binc_internal_create_characteristic(device, object_path);
 
     const char *property_name;
     GVariantIter iter;
@@ -367,25 +716,36 @@ static void binc_internal_extract_characteristic(Device *device, const char *obj
             binc_characteristic_set_notifying(characteristic,
                                               g_variant_get_boolean(property_value));
         } else if (g_str_equal(property_name, "MTU")) {
-            device->mtu = g_variant_get_uint16(property_value);
+            device->session->mtu = g_variant_get_uint16(property_value);
             binc_characteristic_set_mtu(characteristic, g_variant_get_uint16(property_value));
         }
     }
 
-    // Get service and link the characteristic to the service
-    Service *service = g_hash_table_lookup(device->services,
-                                           binc_characteristic_get_service_path(characteristic));
-    if (service != NULL) {
-        binc_service_add_characteristic(service, characteristic);
-        binc_characteristic_set_service(characteristic, service);
-        g_hash_table_insert(device->characteristics, g_strdup(object_path), characteristic);
+    binc_internal_add_characteristic(device, characteristic);
+}
 
-        char *charString = binc_characteristic_to_string(characteristic);
-        log_debug(TAG, charString);
-        g_free(charString);
+static Descriptor *binc_internal_create_descriptor(Device *device, const char *object_path) {
+    Descriptor *descriptor = binc_descriptor_create(device, object_path);
+    binc_descriptor_set_read_cb(descriptor, &binc_on_descriptor_read);
+    binc_descriptor_set_write_cb(descriptor, &binc_on_descriptor_write);
+    return descriptor;
+}
+
+static void binc_internal_add_descriptor(Device *device, Descriptor *descriptor) {
+    // Look up characteristic
+    Characteristic *characteristic = g_hash_table_lookup(device->session->characteristics,
+                                                         binc_descriptor_get_char_path(descriptor));
+    if (characteristic != NULL) {
+        binc_characteristic_add_descriptor(characteristic, descriptor);
+        binc_descriptor_set_char(descriptor, characteristic);
+        g_hash_table_insert(device->session->descriptors, g_strdup(binc_descriptor_get_path(descriptor)), descriptor);
+
+        const char *descString = binc_descriptor_to_string(descriptor);
+        log_debug(TAG, descString);
+        g_free((char *) descString);
     } else {
-        log_error(TAG, "could not find service %s",
-                  binc_characteristic_get_service_path(characteristic));
+        log_error(TAG, "could not find characteristic %s",
+                  binc_descriptor_get_char_path(descriptor));
     }
 }
 
@@ -394,9 +754,7 @@ static void binc_internal_extract_descriptor(Device *device, const char *object_
     g_assert(object_path != NULL);
     g_assert(properties != NULL);
 
-    Descriptor *descriptor = binc_descriptor_create(device, object_path);
-    binc_descriptor_set_read_cb(descriptor, &binc_on_descriptor_read);
-    binc_descriptor_set_write_cb(descriptor, &binc_on_descriptor_write);
+    Descriptor *descriptor = binc_internal_create_descriptor(device, object_path);
 
     const char *property_name;
     GVariantIter iter;
@@ -413,245 +771,855 @@ static void binc_internal_extract_descriptor(Device *device, const char *object_
         }
     }
 
-    // Look up characteristic
-    Characteristic *characteristic = g_hash_table_lookup(device->characteristics,
-                                                         binc_descriptor_get_char_path(descriptor));
-    if (characteristic != NULL) {
-        binc_characteristic_add_descriptor(characteristic, descriptor);
-        binc_descriptor_set_char(descriptor, characteristic);
-        g_hash_table_insert(device->descriptors, g_strdup(object_path), descriptor);
-
-        const char *descString = binc_descriptor_to_string(descriptor);
-        log_debug(TAG, descString);
-        g_free((char *) descString);
-    } else {
-        log_error(TAG, "could not find characteristic %s",
-                  binc_descriptor_get_char_path(descriptor));
-    }
+    binc_internal_add_descriptor(device, descriptor);
 }
 
-static void binc_internal_collect_gatt_tree_cb(__attribute__((unused)) GObject *source_object,
-                                               GAsyncResult *res,
-                                               gpointer user_data) {
-
-    GError *error = NULL;
-    Device *device = (Device *) user_data;
-    g_assert(device != NULL);
-
-    GVariant *result = g_dbus_connection_call_finish(device->connection, res, &error);
-
-    if (result == NULL) {
-        log_error(TAG, "Unable to get result for GetManagedObjects");
-        if (error != NULL) {
-            log_error(TAG, "call failed (error %d: %s)", error->code, error->message);
-            g_clear_error(&error);
-            return;
-        }
+static void binc_internal_build_gatt_index(Device *device) {
+    if (device->session->service_index != NULL) {
+        g_hash_table_destroy(device->session->service_index);
     }
+    device->session->service_index = g_hash_table_new(g_direct_hash, g_direct_equal);
 
-    GVariantIter *iter;
-    const char *object_path;
-    GVariant *ifaces_and_properties;
-    if (result) {
-        if (device->services != NULL) {
-            g_hash_table_destroy(device->services);
+    if (device->session->characteristic_index != NULL) {
+        g_hash_table_destroy(device->session->characteristic_index);
+    }
+    device->session->characteristic_index = g_hash_table_new_full(characteristic_key_hash, characteristic_key_equal,
+                                                         g_free, NULL);
+
+    for (GList *iterator = device->session->services_list; iterator; iterator = iterator->next) {
+        Service *service = (Service *) iterator->data;
+        const Uuid *service_uuid = binc_service_get_uuid_value(service);
+        g_hash_table_insert(device->session->service_index, (gpointer) service_uuid, service);
+
+        for (GList *char_iterator = binc_service_get_characteristics(service); char_iterator;
+             char_iterator = char_iterator->next) {
+            Characteristic *characteristic = (Characteristic *) char_iterator->data;
+            if (binc_characteristic_get_uuid_value(characteristic) == NULL) continue;
+
+            CharacteristicKey *key = g_new0(CharacteristicKey, 1);
+            key->service_uuid = service_uuid;
+            key->characteristic_uuid = binc_characteristic_get_uuid_value(characteristic);
+            g_hash_table_insert(device->session->characteristic_index, key, characteristic);
         }
-        device->services = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                                 g_free, (GDestroyNotify) binc_service_free);
+    }
 
-        if (device->characteristics != NULL) {
-            g_hash_table_destroy(device->characteristics);
-        }
-        device->characteristics = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                                        g_free, (GDestroyNotify) binc_characteristic_free);
+    // Prepared handles look up their characteristic again after this
+    device->session->gatt_generation++;
+}
 
-        if (device->descriptors != NULL) {
-            g_hash_table_destroy(device->descriptors);
-        }
-        device->descriptors = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                                    g_free, (GDestroyNotify) binc_descriptor_free);
-
-        g_assert(g_str_equal(g_variant_get_type_string(result), "(a{oa{sa{sv}}})"));
-        g_variant_get(result, "(a{oa{sa{sv}}})", &iter);
-        while (g_variant_iter_loop(iter, "{&o@a{sa{sv}}}", &object_path, &ifaces_and_properties)) {
-            if (g_str_has_prefix(object_path, device->path)) {
-                const char *interface_name;
-                GVariant *properties;
-                GVariantIter iter2;
-                g_variant_iter_init(&iter2, ifaces_and_properties);
-                while (g_variant_iter_loop(&iter2, "{&s@a{sv}}", &interface_name, &properties)) {
-                    if (g_str_equal(interface_name, INTERFACE_SERVICE)) {
-                        binc_internal_extract_service(device, object_path, properties);
-                    } else if (g_str_equal(interface_name, INTERFACE_CHARACTERISTIC)) {
-                        binc_internal_extract_characteristic(device, object_path, properties);
-                    } else if (g_str_equal(interface_name, INTERFACE_DESCRIPTOR)) {
-                        binc_internal_extract_descriptor(device, object_path, properties);
-
-                    }
-                }
-            }
-        }
+static void binc_internal_reset_gatt_tables(Device *device) {
+    // The whole tree is replaced and reported through the services resolved callback
+    binc_internal_free_removed_services(device->session->pending_service_changes);
+    g_hash_table_remove_all(device->session->pending_service_changes);
 
-        if (iter != NULL) {
-            g_variant_iter_free(iter);
-        }
-        g_variant_unref(result);
+    if (device->session->services != NULL) {
+        g_hash_table_destroy(device->session->services);
     }
+    device->session->services = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                             g_free, (GDestroyNotify) binc_service_free);
 
-    if (device->services_list != NULL) {
-        g_list_free(device->services_list);
+    if (device->session->characteristics != NULL) {
+        g_hash_table_destroy(device->session->characteristics);
     }
-    device->services_list = g_hash_table_get_values(device->services);
+    device->session->characteristics = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                    g_free, (GDestroyNotify) binc_characteristic_free);
 
-    log_debug(TAG, "found %d services", g_list_length(device->services_list));
-    if (device->services_resolved_callback != NULL) {
-        device->services_resolved_callback(device);
+    if (device->session->descriptors != NULL) {
+        g_hash_table_destroy(device->session->descriptors);
     }
+    device->session->descriptors = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                g_free, (GDestroyNotify) binc_descriptor_free);
 }
 
-static void binc_collect_gatt_tree(Device *device) {
-    g_assert(device != NULL);
-
-    device->service_discovery_started = TRUE;
-    g_dbus_connection_call(device->connection,
-                           BLUEZ_DBUS,
-                           "/",
-                           "org.freedesktop.DBus.ObjectManager",
-                           "GetManagedObjects",
-                           NULL,
-                           G_VARIANT_TYPE("(a{oa{sa{sv}}})"),
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
-                           (GAsyncReadyCallback) binc_internal_collect_gatt_tree_cb,
-                           device);
+static void binc_internal_finish_gatt_tree(Device *device) {
+    if (device->session->services_list != NULL) {
+        g_list_free(device->session->services_list);
+    }
+    device->session->services_list = g_hash_table_get_values(device->session->services);
+    binc_internal_build_gatt_index(device);
 }
 
-void binc_device_set_bonding_state_changed_cb(Device *device, BondingStateChangedCallback callback) {
-    g_assert(device != NULL);
-    g_assert(callback != NULL);
+static GList *binc_internal_split_flags(const char *flags) {
+    GList *result = NULL;
+    char **parts = g_strsplit(flags, ",", -1);
+    for (guint i = 0; parts[i] != NULL; i++) {
+        result = g_list_append(result, parts[i]);
+    }
 
-    device->bonding_state_callback = callback;
+    // The list took ownership of the strings
+    g_free(parts);
+    return result;
 }
 
-void binc_device_set_bonding_state(Device *device, BondingState bonding_state) {
-    g_assert(device != NULL);
-
-    BondingState old_state = device->bondingState;
-    device->bondingState = bonding_state;
-    if (device->bonding_state_callback != NULL) {
-        if (device->bondingState != old_state) {
-            device->bonding_state_callback(device, device->bondingState, old_state, NULL);
+static void binc_internal_restore_gatt_entry(GattCacheEntryType type, const char *path, const char *parent_path,
+                                             const Uuid *uuid, const char *flags, gpointer user_data) {
+    Device *device = (Device *) user_data;
+    char *object_path = g_strconcat(device->path, "/", path, NULL);
+    const char *uuid_string = binc_uuid_get_string(binc_uuid_intern(uuid));
+
+    if (type == BINC_GATT_CACHE_SERVICE) {
+        Service *service = binc_service_create(device, object_path, uuid_string);
+        g_hash_table_insert(device->session->services, g_strdup(object_path), service);
+    } else if (type == BINC_GATT_CACHE_CHARACTERISTIC) {
+        char *service_path = g_strconcat(device->path, "/", parent_path, NULL);
+        Characteristic *characteristic = binc_internal_create_characteristic(device, object_path);
+        binc_characteristic_set_uuid(characteristic, uuid_string);
+        binc_characteristic_set_service_path(characteristic, service_path);
+        if (*flags != '\0') {
+            binc_characteristic_set_flags(characteristic, binc_internal_split_flags(flags));
         }
+        binc_internal_add_characteristic(device, characteristic);
+        g_free(service_path);
+    } else {
+        char *char_path = g_strconcat(device->path, "/", parent_path, NULL);
+        Descriptor *descriptor = binc_internal_create_descriptor(device, object_path);
+        binc_descriptor_set_uuid(descriptor, uuid_string);
+        binc_descriptor_set_char_path(descriptor, char_path);
+        binc_internal_add_descriptor(device, descriptor);
+        g_free(char_path);
     }
+    g_free(object_path);
 }
 
-static void binc_device_changed(__attribute__((unused)) GDBusConnection *conn,
-                                __attribute__((unused)) const gchar *sender,
-                                __attribute__((unused)) const gchar *path,
-                                __attribute__((unused)) const gchar *interface,
-                                __attribute__((unused)) const gchar *signal,
-                                GVariant *params,
-                                void *userdata) {
+static gboolean binc_internal_start_notify(const Device *device, Characteristic *characteristic);
 
-    GVariantIter *properties_changed = NULL;
-    GVariantIter *properties_invalidated = NULL;
-    const char *iface = NULL;
-    const char *property_name = NULL;
-    GVariant *property_value = NULL;
+static gboolean binc_internal_acquire_notify(const Device *device, Characteristic *characteristic);
 
-    Device *device = (Device *) userdata;
-    g_assert(device != NULL);
-
-    g_assert(g_str_equal(g_variant_get_type_string(params), "(sa{sv}as)"));
-    g_variant_get(params, "(&sa{sv}as)", &iface, &properties_changed, &properties_invalidated);
-    while (g_variant_iter_loop(properties_changed, "{&sv}", &property_name, &property_value)) {
-        if (g_str_equal(property_name, DEVICE_PROPERTY_CONNECTED)) {
-            binc_device_internal_set_conn_state(device, g_variant_get_boolean(property_value), NULL);
-            if (device->connection_state == BINC_DISCONNECTED) {
-                g_dbus_connection_signal_unsubscribe(device->connection, device->device_prop_changed);
-                device->device_prop_changed = 0;
-            }
-        } else if (g_str_equal(property_name, DEVICE_PROPERTY_SERVICES_RESOLVED)) {
-            device->services_resolved = g_variant_get_boolean(property_value);
-            log_debug(TAG, "ServicesResolved %s", device->services_resolved ? "true" : "false");
-            if (device->services_resolved == TRUE && device->bondingState != BINC_BONDING) {
-                binc_collect_gatt_tree(device);
-            }
+/*
+ * Restart the notifications that were running before the connection was lost, on the characteristics of the
+ * current GATT tree. Characteristics that are already notifying are skipped. Only call this once the services are
+ * resolved, before that BlueZ has not exported the characteristics yet.
+ */
+static void binc_internal_restart_notifications(Device *device) {
+    if (!device->session->auto_reconnect || device->session->characteristic_index == NULL) return;
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, device->session->notify_subscriptions);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        Characteristic *characteristic = g_hash_table_lookup(device->session->characteristic_index, key);
+        if (characteristic == NULL || binc_characteristic_is_notifying(characteristic) ||
+            !binc_characteristic_supports_notify(characteristic)) {
+            continue;
+        }
 
-            if (device->services_resolved == FALSE && device->connection_state == BINC_CONNECTED) {
-                binc_device_internal_set_conn_state(device, BINC_DISCONNECTING, NULL);
-            }
-        } else if (g_str_equal(property_name, DEVICE_PROPERTY_PAIRED)) {
-            device->paired = g_variant_get_boolean(property_value);
-            log_debug(TAG, "Paired %s", device->paired ? "true" : "false");
-            binc_device_set_bonding_state(device, device->paired ? BINC_BONDED : BINC_BOND_NONE);
-
-            // If gatt-tree has not been built yet, start building it
-            if (device->services == NULL && device->services_resolved && !device->service_discovery_started) {
-                binc_collect_gatt_tree(device);
-            }
+        log_debug(TAG, "restarting notify for <%s>", binc_characteristic_get_uuid(characteristic));
+        if (GPOINTER_TO_INT(value) == NOTIFY_MODE_ACQUIRE) {
+            binc_internal_acquire_notify(device, characteristic);
+        } else {
+            binc_internal_start_notify(device, characteristic);
         }
     }
-
-    if (properties_changed != NULL)
-        g_variant_iter_free(properties_changed);
-
-    if (properties_invalidated != NULL)
-        g_variant_iter_free(properties_invalidated);
 }
 
-static void binc_internal_device_connect_cb(__attribute__((unused)) GObject *source_object,
-                                            GAsyncResult *res,
-                                            gpointer user_data) {
+/*
+ * Build the GATT tree from the cache so the device can be used before BlueZ has resolved the services.
+ * The tree is checked against BlueZ, and notifications are restarted, once the services are resolved.
+ */
+static void binc_internal_restore_gatt_tree(Device *device) {
+    // After losing the link the tree of the previous connection is still there, so reuse it like a cached tree
+    gboolean link_lost = device->session->link_lost;
+    device->session->link_lost = FALSE;
+    if (device->session->services != NULL && link_lost) {
+        device->session->gatt_from_cache = TRUE;
+        log_debug(TAG, "reusing %d services of the previous connection", g_list_length(device->session->services_list));
+        if (device->session->services_resolved_callback != NULL) {
+            device->session->services_resolved_callback(device);
+        }
+        return;
+    }
+
+    const char *directory = binc_adapter_get_gatt_cache_directory(device->adapter);
+    if (directory == NULL || device->address[0] == '\0' || device->session->services != NULL) return;
+
+    GattCache *cache = binc_gatt_cache_load(directory, device->address);
+    if (cache == NULL) return;
+
+    binc_internal_reset_gatt_tables(device);
+    binc_gatt_cache_foreach(cache, &binc_internal_restore_gatt_entry, device);
+
+    if (device->session->gatt_cache_db_hash != NULL) {
+        g_byte_array_free(device->session->gatt_cache_db_hash, TRUE);
+        device->session->gatt_cache_db_hash = NULL;
+    }
+    guint db_hash_length = 0;
+    const guint8 *db_hash = binc_gatt_cache_get_db_hash(cache, &db_hash_length);
+    if (db_hash != NULL) {
+        device->session->gatt_cache_db_hash = g_byte_array_sized_new(db_hash_length);
+        g_byte_array_append(device->session->gatt_cache_db_hash, db_hash, db_hash_length);
+    }
+    binc_gatt_cache_free(cache);
+
+    device->session->gatt_from_cache = TRUE;
+    binc_internal_finish_gatt_tree(device);
+
+    log_debug(TAG, "restored %d services from cache", g_list_length(device->session->services_list));
+    if (device->session->services_resolved_callback != NULL) {
+        device->session->services_resolved_callback(device);
+    }
+}
+
+static gboolean binc_internal_read_gatt_db_hash(Device *device, OperationCallback callback) {
+    Characteristic *characteristic = binc_device_get_characteristic(device, GATT_SERVICE_UUID,
+                                                                    DATABASE_HASH_CHAR_UUID);
+    if (characteristic == NULL || !binc_characteristic_supports_read(characteristic)) return FALSE;
+
+    Operation *operation = binc_operation_create(BINC_OPERATION_READ_CHAR, characteristic, BINC_PRIORITY_HIGH);
+    binc_operation_set_callback(operation, callback, device);
+    binc_operation_set_timeout(operation, DATABASE_HASH_TIMEOUT_MS);
+    binc_operation_queue_enqueue(device->session->operation_queue, operation);
+    return TRUE;
+}
+
+static void binc_internal_save_gatt_cache(Device *device, const GByteArray *db_hash) {
+    const char *directory = binc_adapter_get_gatt_cache_directory(device->adapter);
+    if (directory == NULL || device->address[0] == '\0') return;
+
+    binc_gatt_cache_save(directory, device->address, device->path, device->session->services_list, db_hash);
+}
+
+static void binc_internal_save_gatt_cache_cb(__attribute__((unused)) Operation *operation,
+                                             const GByteArray *byteArray,
+                                             const GError *error,
+                                             void *user_data) {
+    // The queue was dropped, possibly because the device is being freed
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) return;
 
-    GError *error = NULL;
     Device *device = (Device *) user_data;
+    binc_internal_save_gatt_cache(device, error == NULL ? byteArray : NULL);
+}
+
+static void binc_internal_update_gatt_cache(Device *device) {
+    if (binc_adapter_get_gatt_cache_directory(device->adapter) == NULL) return;
+
+    // Store the database hash along with the tree when the peripheral exposes it
+    if (!binc_internal_read_gatt_db_hash(device, &binc_internal_save_gatt_cache_cb)) {
+        binc_internal_save_gatt_cache(device, NULL);
+    }
+}
+
+static void binc_internal_reconcile_gatt_tree(Device *device, GHashTable *objects);
+
+static void binc_internal_verify_gatt_db_hash_cb(__attribute__((unused)) Operation *operation,
+                                                 const GByteArray *byteArray,
+                                                 const GError *error,
+                                                 void *user_data) {
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) return;
+
+    Device *device = (Device *) user_data;
+    GByteArray *cached = device->session->gatt_cache_db_hash;
+    device->session->gatt_cache_db_hash = NULL;
+    if (cached == NULL) return;
+
+    if (error != NULL) {
+        log_debug(TAG, "could not read database hash (error %d: %s)", error->code, error->message);
+    } else if (byteArray == NULL || byteArray->len != cached->len ||
+               memcmp(byteArray->data, cached->data, cached->len) != 0) {
+        // Same handles and uuids but a different database, so attribute permissions may have changed
+        log_debug(TAG, "database hash changed, refreshing services");
+        binc_gatt_cache_remove(binc_adapter_get_gatt_cache_directory(device->adapter), device->address);
+        binc_internal_reconcile_gatt_tree(device, binc_adapter_get_gatt_objects(device->adapter, device->path));
+    }
+    g_byte_array_free(cached, TRUE);
+}
+
+typedef void (*GattObjectCallback)(Device *device, const char *interface_name, const char *object_path,
+                                   GVariant *properties, gpointer user_data);
+
+/*
+ * Visit the GATT objects of the device, services first, then characteristics and then descriptors,
+ * so that parents always exist before their children are added
+ */
+static void binc_internal_foreach_gatt_object(Device *device, GHashTable *objects, GattObjectCallback callback,
+                                              gpointer user_data) {
+    if (objects == NULL) return;
+
+    const char *const interfaces[] = {INTERFACE_SERVICE, INTERFACE_CHARACTERISTIC, INTERFACE_DESCRIPTOR};
+    for (guint i = 0; i < G_N_ELEMENTS(interfaces); i++) {
+        GHashTableIter iter;
+        gpointer key, value;
+        g_hash_table_iter_init(&iter, objects);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            GVariant *properties = g_variant_lookup_value((GVariant *) value, interfaces[i],
+                                                          G_VARIANT_TYPE("a{sv}"));
+            if (properties != NULL) {
+                callback(device, interfaces[i], (const char *) key, properties, user_data);
+                g_variant_unref(properties);
+            }
+        }
+    }
+}
+
+static void binc_internal_extract_gatt_object(Device *device, const char *interface_name, const char *object_path,
+                                              GVariant *properties, __attribute__((unused)) gpointer user_data) {
+    if (g_str_equal(interface_name, INTERFACE_SERVICE)) {
+        binc_internal_extract_service(device, object_path, properties);
+    } else if (g_str_equal(interface_name, INTERFACE_CHARACTERISTIC)) {
+        binc_internal_extract_characteristic(device, object_path, properties);
+    } else if (g_str_equal(interface_name, INTERFACE_DESCRIPTOR)) {
+        binc_internal_extract_descriptor(device, object_path, properties);
+    }
+}
+
+typedef struct binc_gatt_tree_match {
+    guint count;
+    gboolean matches;
+} GattTreeMatch;
+
+static void binc_internal_match_gatt_object(Device *device, const char *interface_name, const char *object_path,
+                                            GVariant *properties, gpointer user_data) {
+    GattTreeMatch *match = (GattTreeMatch *) user_data;
+    const Uuid *cached_uuid = NULL;
+
+    if (g_str_equal(interface_name, INTERFACE_SERVICE)) {
+        Service *service = g_hash_table_lookup(device->session->services, object_path);
+        if (service != NULL) cached_uuid = binc_service_get_uuid_value(service);
+    } else if (g_str_equal(interface_name, INTERFACE_CHARACTERISTIC)) {
+        Characteristic *characteristic = g_hash_table_lookup(device->session->characteristics, object_path);
+        if (characteristic != NULL) cached_uuid = binc_characteristic_get_uuid_value(characteristic);
+    } else if (g_str_equal(interface_name, INTERFACE_DESCRIPTOR)) {
+        Descriptor *descriptor = g_hash_table_lookup(device->session->descriptors, object_path);
+        if (descriptor != NULL) cached_uuid = binc_descriptor_get_uuid_value(descriptor);
+    } else {
+        return;
+    }
+
+    match->count++;
+    const char *uuid = NULL;
+    Uuid parsed;
+    if (cached_uuid == NULL || !g_variant_lookup(properties, "UUID", "&s", &uuid) ||
+        !binc_uuid_parse(uuid, &parsed) || binc_uuid_lookup(&parsed) != cached_uuid) {
+        match->matches = FALSE;
+    }
+}
+
+static gboolean binc_internal_gatt_tree_matches(Device *device, GHashTable *objects) {
+    GattTreeMatch match = {0, TRUE};
+    binc_internal_foreach_gatt_object(device, objects, &binc_internal_match_gatt_object, &match);
+    return match.matches && match.count == g_hash_table_size(device->session->services) +
+                                           g_hash_table_size(device->session->characteristics) +
+                                           g_hash_table_size(device->session->descriptors);
+}
+
+static void binc_internal_refresh_gatt_object(Device *device, const char *interface_name, const char *object_path,
+                                              GVariant *properties, __attribute__((unused)) gpointer user_data) {
+    if (!g_str_equal(interface_name, INTERFACE_CHARACTERISTIC)) return;
+
+    Characteristic *characteristic = g_hash_table_lookup(device->session->characteristics, object_path);
+    if (characteristic == NULL) return;
+
+    GVariant *flags = g_variant_lookup_value(properties, "Flags", G_VARIANT_TYPE_STRING_ARRAY);
+    if (flags != NULL) {
+        binc_characteristic_set_flags(characteristic, g_variant_string_array_to_list(flags));
+        g_variant_unref(flags);
+    }
+
+    gboolean notifying;
+    if (g_variant_lookup(properties, "Notifying", "b", &notifying)) {
+        binc_characteristic_set_notifying(characteristic, notifying);
+    }
+
+    guint16 mtu;
+    if (g_variant_lookup(properties, "MTU", "q", &mtu)) {
+        device->session->mtu = mtu;
+        binc_characteristic_set_mtu(characteristic, mtu);
+    }
+}
+
+/*
+ * Build the GATT tree from the objects the adapter mirrors, so no D-Bus call is needed
+ */
+static void binc_collect_gatt_tree(Device *device) {
     g_assert(device != NULL);
 
-    GVariant *value = g_dbus_connection_call_finish(device->connection, res, &error);
+    device->session->service_discovery_started = TRUE;
+    GHashTable *objects = binc_adapter_get_gatt_objects(device->adapter, device->path);
+
+    if (device->session->gatt_from_cache) {
+        device->session->gatt_from_cache = FALSE;
+        if (binc_internal_gatt_tree_matches(device, objects)) {
+            // Keep the objects the application already holds and only pick up their current state
+            log_debug(TAG, "cached services are up to date");
+            binc_internal_foreach_gatt_object(device, objects, &binc_internal_refresh_gatt_object, NULL);
+            binc_internal_restart_notifications(device);
+
+            if (device->session->gatt_cache_db_hash != NULL &&
+                !binc_internal_read_gatt_db_hash(device, &binc_internal_verify_gatt_db_hash_cb)) {
+                g_byte_array_free(device->session->gatt_cache_db_hash, TRUE);
+                device->session->gatt_cache_db_hash = NULL;
+            }
+            return;
+        }
+        log_debug(TAG, "cached services are outdated, updating");
+        if (device->session->gatt_cache_db_hash != NULL) {
+            g_byte_array_free(device->session->gatt_cache_db_hash, TRUE);
+            device->session->gatt_cache_db_hash = NULL;
+        }
+        binc_internal_reconcile_gatt_tree(device, objects);
+        binc_internal_restart_notifications(device);
+        return;
+    }
+
+    // Queued operations point to the objects that are about to be replaced
+    binc_operation_queue_clear(device->session->operation_queue);
+
+    binc_internal_reset_gatt_tables(device);
+    binc_internal_foreach_gatt_object(device, objects, &binc_internal_extract_gatt_object, NULL);
+    binc_internal_finish_gatt_tree(device);
+
+    log_debug(TAG, "found %d services", g_list_length(device->session->services_list));
+    binc_internal_restart_notifications(device);
+    if (device->session->services_resolved_callback != NULL) {
+        device->session->services_resolved_callback(device);
+    }
+
+    binc_internal_update_gatt_cache(device);
+}
+
+/*
+ * Removed services are only freed once their removal has been reported
+ */
+static void binc_internal_free_removed_services(GHashTable *changes) {
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, changes);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        if (GPOINTER_TO_UINT(value) == BINC_SERVICE_REMOVED) {
+            binc_service_free((Service *) key);
+        }
+    }
+}
+
+static gboolean binc_internal_deliver_service_changes(gpointer user_data) {
+    Device *device = (Device *) user_data;
+    device->session->service_changes_idle = 0;
+
+    // Swap the pending changes out first, callbacks may cause new changes
+    GHashTable *changes = device->session->pending_service_changes;
+    device->session->pending_service_changes = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    if (device->session->service_changed_callback != NULL) {
+        GHashTableIter iter;
+        gpointer key, value;
+        g_hash_table_iter_init(&iter, changes);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            device->session->service_changed_callback(device, (Service *) key, (ServiceChange) GPOINTER_TO_UINT(value));
+        }
+    }
+    binc_internal_free_removed_services(changes);
+    g_hash_table_destroy(changes);
+
+    binc_internal_update_gatt_cache(device);
+    return FALSE;
+}
+
+static void binc_internal_schedule_service_changes(Device *device) {
+    if (device->session->service_changes_idle == 0) {
+        device->session->service_changes_idle = binc_idle_add(binc_internal_deliver_service_changes, device);
+    }
+}
+
+static void binc_internal_queue_service_change(Device *device, Service *service, ServiceChange change) {
+    if (service == NULL) return;
+
+    // A service that was added in this batch is reported as added, whatever happened to it afterwards
+    gpointer pending;
+    if (g_hash_table_lookup_extended(device->session->pending_service_changes, service, NULL, &pending) &&
+        GPOINTER_TO_UINT(pending) == BINC_SERVICE_ADDED) {
+        return;
+    }
+
+    g_hash_table_insert(device->session->pending_service_changes, service, GUINT_TO_POINTER(change));
+    binc_internal_schedule_service_changes(device);
+}
+
+/*
+ * Incremental updates only apply to a tree that BlueZ has resolved for the current connection. While connecting,
+ * the objects are collected in one go once the services are resolved.
+ */
+static gboolean binc_internal_gatt_tree_is_live(const Device *device) {
+    return device->session != NULL && device->session->services != NULL && !device->session->gatt_from_cache &&
+           device->session->services_resolved && device->connection_state == BINC_CONNECTED;
+}
+
+void binc_device_gatt_object_added(Device *device, const char *object_path, GVariant *interfaces) {
+    g_assert(device != NULL);
+    g_assert(object_path != NULL);
+    g_assert(interfaces != NULL);
+
+    if (!binc_internal_gatt_tree_is_live(device)) return;
+
+    GVariant *properties = NULL;
+    if ((properties = g_variant_lookup_value(interfaces, INTERFACE_SERVICE, G_VARIANT_TYPE("a{sv}"))) != NULL) {
+        if (!g_hash_table_contains(device->session->services, object_path)) {
+            binc_internal_extract_service(device, object_path, properties);
+            binc_internal_queue_service_change(device, g_hash_table_lookup(device->session->services, object_path),
+                                               BINC_SERVICE_ADDED);
+        }
+    } else if ((properties = g_variant_lookup_value(interfaces, INTERFACE_CHARACTERISTIC,
+                                                    G_VARIANT_TYPE("a{sv}"))) != NULL) {
+        if (!g_hash_table_contains(device->session->characteristics, object_path)) {
+            binc_internal_extract_characteristic(device, object_path, properties);
+            Characteristic *characteristic = g_hash_table_lookup(device->session->characteristics, object_path);
+            if (characteristic != NULL) {
+                binc_internal_queue_service_change(device, binc_characteristic_get_service(characteristic),
+                                                   BINC_SERVICE_MODIFIED);
+            }
+        }
+    } else if ((properties = g_variant_lookup_value(interfaces, INTERFACE_DESCRIPTOR,
+                                                    G_VARIANT_TYPE("a{sv}"))) != NULL) {
+        if (!g_hash_table_contains(device->session->descriptors, object_path)) {
+            binc_internal_extract_descriptor(device, object_path, properties);
+            Descriptor *descriptor = g_hash_table_lookup(device->session->descriptors, object_path);
+            if (descriptor != NULL) {
+                Characteristic *characteristic = binc_descriptor_get_char(descriptor);
+                binc_internal_queue_service_change(device, binc_characteristic_get_service(characteristic),
+                                                   BINC_SERVICE_MODIFIED);
+            }
+        }
+    }
+
+    if (properties != NULL) {
+        g_variant_unref(properties);
+        binc_internal_finish_gatt_tree(device);
+    }
+}
+
+static void binc_internal_remove_descriptor(Device *device, Descriptor *descriptor) {
+    binc_operation_queue_drop_target(device->session->operation_queue, descriptor);
+    binc_characteristic_remove_descriptor(binc_descriptor_get_char(descriptor), descriptor);
+    g_hash_table_remove(device->session->descriptors, binc_descriptor_get_path(descriptor));
+}
+
+static void binc_internal_remove_characteristic(Device *device, Characteristic *characteristic) {
+    GList *descriptors = g_list_copy(binc_characteristic_get_descriptors(characteristic));
+    for (GList *iterator = descriptors; iterator; iterator = iterator->next) {
+        binc_internal_remove_descriptor(device, (Descriptor *) iterator->data);
+    }
+    g_list_free(descriptors);
+
+    binc_operation_queue_drop_target(device->session->operation_queue, characteristic);
+    binc_service_remove_characteristic(binc_characteristic_get_service(characteristic), characteristic);
+    g_hash_table_remove(device->session->characteristics, binc_characteristic_get_path(characteristic));
+}
+
+static void binc_internal_remove_service(Device *device, Service *service) {
+    GList *characteristics = g_list_copy(binc_service_get_characteristics(service));
+    for (GList *iterator = characteristics; iterator; iterator = iterator->next) {
+        binc_internal_remove_characteristic(device, (Characteristic *) iterator->data);
+    }
+    g_list_free(characteristics);
+
+    // The pending changes take over the service until its removal is reported
+    const char *object_path = binc_service_get_path(service);
+    gpointer path = NULL;
+    g_hash_table_lookup_extended(device->session->services, object_path, &path, NULL);
+    g_hash_table_steal(device->session->services, object_path);
+    g_free(path);
+
+    // A service that was added in this batch was never reported, so there is nothing to report at all
+    gpointer pending;
+    if (g_hash_table_lookup_extended(device->session->pending_service_changes, service, NULL, &pending) &&
+        GPOINTER_TO_UINT(pending) == BINC_SERVICE_ADDED) {
+        g_hash_table_remove(device->session->pending_service_changes, service);
+        binc_service_free(service);
+    } else {
+        g_hash_table_insert(device->session->pending_service_changes, service,
+                            GUINT_TO_POINTER(BINC_SERVICE_REMOVED));
+    }
+
+    // Also when there is nothing left to report, the cache has to be updated
+    binc_internal_schedule_service_changes(device);
+}
+
+void binc_device_gatt_object_removed(Device *device, const char *object_path) {
+    g_assert(device != NULL);
+    g_assert(object_path != NULL);
+
+    if (!binc_internal_gatt_tree_is_live(device)) return;
+
+    Service *service = NULL;
+    Characteristic *characteristic = NULL;
+    Descriptor *descriptor = NULL;
+    if ((descriptor = g_hash_table_lookup(device->session->descriptors, object_path)) != NULL) {
+        characteristic = binc_descriptor_get_char(descriptor);
+        binc_internal_queue_service_change(device, binc_characteristic_get_service(characteristic),
+                                           BINC_SERVICE_MODIFIED);
+        binc_internal_remove_descriptor(device, descriptor);
+    } else if ((characteristic = g_hash_table_lookup(device->session->characteristics, object_path)) != NULL) {
+        binc_internal_queue_service_change(device, binc_characteristic_get_service(characteristic),
+                                           BINC_SERVICE_MODIFIED);
+        binc_internal_remove_characteristic(device, characteristic);
+    } else if ((service = g_hash_table_lookup(device->session->services, object_path)) != NULL) {
+        binc_internal_remove_service(device, service);
+    } else {
+        return;
+    }
+
+    binc_internal_finish_gatt_tree(device);
+}
+
+/*
+ * Whether BlueZ exports an object at object_path with the interface and uuid of the object we hold
+ */
+static gboolean binc_internal_gatt_object_exported(GHashTable *objects, const char *object_path,
+                                                   const char *interface_name, const Uuid *uuid) {
+    GVariant *interfaces = objects != NULL ? g_hash_table_lookup(objects, object_path) : NULL;
+    if (interfaces == NULL) return FALSE;
+
+    GVariant *properties = g_variant_lookup_value(interfaces, interface_name, G_VARIANT_TYPE("a{sv}"));
+    if (properties == NULL) return FALSE;
+
+    const char *uuid_string = NULL;
+    Uuid parsed;
+    gboolean exported = g_variant_lookup(properties, "UUID", "&s", &uuid_string) &&
+                        binc_uuid_parse(uuid_string, &parsed) && binc_uuid_equal(&parsed, uuid);
+    g_variant_unref(properties);
+    return exported;
+}
+
+static void binc_internal_add_gatt_object(Device *device, const char *interface_name, const char *object_path,
+                                          GVariant *properties, __attribute__((unused)) gpointer user_data) {
+    if (g_str_equal(interface_name, INTERFACE_SERVICE)) {
+        if (g_hash_table_contains(device->session->services, object_path)) return;
+
+        binc_internal_extract_service(device, object_path, properties);
+        binc_internal_queue_service_change(device, g_hash_table_lookup(device->session->services, object_path),
+                                           BINC_SERVICE_ADDED);
+    } else if (g_str_equal(interface_name, INTERFACE_CHARACTERISTIC)) {
+        if (g_hash_table_contains(device->session->characteristics, object_path)) return;
+
+        binc_internal_extract_characteristic(device, object_path, properties);
+        Characteristic *characteristic = g_hash_table_lookup(device->session->characteristics, object_path);
+        if (characteristic != NULL) {
+            binc_internal_queue_service_change(device, binc_characteristic_get_service(characteristic),
+                                               BINC_SERVICE_MODIFIED);
+        }
+    } else if (g_str_equal(interface_name, INTERFACE_DESCRIPTOR)) {
+        if (g_hash_table_contains(device->session->descriptors, object_path)) return;
+
+        binc_internal_extract_descriptor(device, object_path, properties);
+        Descriptor *descriptor = g_hash_table_lookup(device->session->descriptors, object_path);
+        if (descriptor != NULL) {
+            Characteristic *characteristic = binc_descriptor_get_char(descriptor);
+            binc_internal_queue_service_change(device, binc_characteristic_get_service(characteristic),
+                                               BINC_SERVICE_MODIFIED);
+        }
+    }
+}
+
+/*
+ * Bring a restored tree in line with the objects BlueZ exports. The objects that are still there stay valid, the
+ * differences are reported through the ServiceChangedCallback like changes made while connected.
+ */
+static void binc_internal_reconcile_gatt_tree(Device *device, GHashTable *objects) {
+    // Children go first, the lists are collected per level since removing a parent frees its children
+    GList *stale = NULL;
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, device->session->descriptors);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        Descriptor *descriptor = (Descriptor *) value;
+        if (!binc_internal_gatt_object_exported(objects, binc_descriptor_get_path(descriptor), INTERFACE_DESCRIPTOR,
+                                                binc_descriptor_get_uuid_value(descriptor))) {
+            stale = g_list_prepend(stale, descriptor);
+        }
+    }
+    for (GList *iterator = stale; iterator; iterator = iterator->next) {
+        Descriptor *descriptor = (Descriptor *) iterator->data;
+        Characteristic *characteristic = binc_descriptor_get_char(descriptor);
+        binc_internal_queue_service_change(device, binc_characteristic_get_service(characteristic),
+                                           BINC_SERVICE_MODIFIED);
+        binc_internal_remove_descriptor(device, descriptor);
+    }
+    g_list_free(stale);
+
+    stale = NULL;
+    g_hash_table_iter_init(&iter, device->session->characteristics);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        Characteristic *characteristic = (Characteristic *) value;
+        if (!binc_internal_gatt_object_exported(objects, binc_characteristic_get_path(characteristic),
+                                                INTERFACE_CHARACTERISTIC,
+                                                binc_characteristic_get_uuid_value(characteristic))) {
+            stale = g_list_prepend(stale, characteristic);
+        }
+    }
+    for (GList *iterator = stale; iterator; iterator = iterator->next) {
+        Characteristic *characteristic = (Characteristic *) iterator->data;
+        binc_internal_queue_service_change(device, binc_characteristic_get_service(characteristic),
+                                           BINC_SERVICE_MODIFIED);
+        binc_internal_remove_characteristic(device, characteristic);
+    }
+    g_list_free(stale);
+
+    stale = NULL;
+    g_hash_table_iter_init(&iter, device->session->services);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        Service *service = (Service *) value;
+        if (!binc_internal_gatt_object_exported(objects, binc_service_get_path(service), INTERFACE_SERVICE,
+                                                binc_service_get_uuid_value(service))) {
+            stale = g_list_prepend(stale, service);
+        }
+    }
+    for (GList *iterator = stale; iterator; iterator = iterator->next) {
+        binc_internal_remove_service(device, (Service *) iterator->data);
+    }
+    g_list_free(stale);
+
+    binc_internal_foreach_gatt_object(device, objects, &binc_internal_add_gatt_object, NULL);
+    binc_internal_foreach_gatt_object(device, objects, &binc_internal_refresh_gatt_object, NULL);
+    binc_internal_finish_gatt_tree(device);
+
+    // Also when nothing was reported, the cache has to be updated
+    binc_internal_schedule_service_changes(device);
+}
+
+void binc_device_set_bonding_state_changed_cb(Device *device, BondingStateChangedCallback callback) {
+    g_assert(device != NULL);
+    g_assert(callback != NULL);
+
+    binc_device_get_session(device)->bonding_state_callback = callback;
+}
+
+void binc_device_set_bonding_state(Device *device, BondingState bonding_state) {
+    g_assert(device != NULL);
+
+    BondingState old_state = device->bondingState;
+    device->bondingState = bonding_state;
+    if (device->session != NULL && device->session->bonding_state_callback != NULL) {
+        if (device->bondingState != old_state) {
+            device->session->bonding_state_callback(device, device->bondingState, old_state, NULL);
+        }
+    }
+}
+
+typedef struct binc_connect_data {
+    Device *device; // Borrowed, only valid while device_cancellable is not cancelled
+    GCancellable *device_cancellable; // Owned reference, cancelled when the device is freed
+    OnConnectCallback callback;
+    void *user_data; // Borrowed
+} ConnectData;
+
+// The device may be evicted before BlueZ answers, so the reply doesn't refer to it
+static void binc_internal_device_abort_connect_cb(GObject *source_object,
+                                                  GAsyncResult *res,
+                                                  __attribute__((unused)) gpointer user_data) {
+
+    GError *error = NULL;
+    GVariant *value = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), res, &error);
     if (value != NULL) {
         g_variant_unref(value);
     }
 
+    if (error != NULL) {
+        log_debug(TAG, "failed to abort connect (error %d: %s)", error->code, error->message);
+        g_clear_error(&error);
+    }
+}
+
+static void binc_internal_connect_data_free(ConnectData *connect_data) {
+    g_object_unref(connect_data->device_cancellable);
+    g_free(connect_data);
+}
+
+static void binc_internal_device_connect_cb(GObject *source_object,
+                                            GAsyncResult *res,
+                                            gpointer user_data) {
+
+    GError *error = NULL;
+    ConnectData *connect_data = (ConnectData *) user_data;
+    g_assert(connect_data != NULL);
+
+    GVariant *value = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), res, &error);
+    if (value != NULL) {
+        g_variant_unref(value);
+    }
+
+    // The device was freed before BlueZ answered, the caller still gets its outcome but not the device
+    if (g_cancellable_is_cancelled(connect_data->device_cancellable)) {
+        if (connect_data->callback != NULL) {
+            GError *removed = g_error_new(G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "device was removed");
+            connect_data->callback(NULL, removed, connect_data->user_data);
+            g_error_free(removed);
+        }
+        g_clear_error(&error);
+        binc_internal_connect_data_free(connect_data);
+        return;
+    }
+
+    Device *device = connect_data->device;
+    g_assert(device != NULL);
+
     if (error != NULL) {
         log_error(TAG, "Connect failed (error %d: %s)", error->code, error->message);
 
+        // BlueZ keeps trying to connect when we stop waiting for it, so tell it to stop
+        if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT) ||
+            g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_dbus_connection_call(device->connection,
+                                   BLUEZ_DBUS,
+                                   device->path,
+                                   INTERFACE_DEVICE,
+                                   DEVICE_METHOD_DISCONNECT,
+                                   NULL,
+                                   NULL,
+                                   G_DBUS_CALL_FLAGS_NONE,
+                                   -1,
+                                   NULL,
+                                   (GAsyncReadyCallback) binc_internal_device_abort_connect_cb,
+                                   NULL);
+        }
+
         // Maybe don't do this because connection changes may com later? See A&D scale testing
         // Or send the current connection state?
         binc_device_internal_set_conn_state(device, BINC_DISCONNECTED, error);
+    }
 
-        g_clear_error(&error);
+    if (connect_data->callback != NULL) {
+        connect_data->callback(device, error, connect_data->user_data);
     }
+
+    g_clear_error(&error);
+    binc_internal_connect_data_free(connect_data);
 }
 
-static void subscribe_prop_changed(Device *device) {
-    if (device->device_prop_changed == 0) {
-        device->device_prop_changed = g_dbus_connection_signal_subscribe(device->connection,
-                                                                         BLUEZ_DBUS,
-                                                                         "org.freedesktop.DBus.Properties",
-                                                                         "PropertiesChanged",
-                                                                         device->path,
-                                                                         INTERFACE_DEVICE,
-                                                                         G_DBUS_SIGNAL_FLAGS_NONE,
-                                                                         binc_device_changed,
-                                                                         device,
-                                                                         NULL);
-    }
+static void track_properties(Device *device) {
+    binc_device_get_session(device)->tracking_properties = TRUE;
 }
 
-void binc_device_connect(Device *device) {
+void binc_device_connect_with_callback(Device *device, OnConnectCallback callback, void *user_data,
+                                      guint timeout_ms, GCancellable *cancellable) {
     g_assert(device != NULL);
     g_assert(device->path != NULL);
 
     // Don't do anything if we are not disconnected
-    if (device->connection_state != BINC_DISCONNECTED) return;
+    if (device->connection_state != BINC_DISCONNECTED) {
+        if (callback != NULL) {
+            GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_BUSY, "device is %s",
+                                        binc_device_get_connection_state_name(device));
+            callback(device, error, user_data);
+            g_error_free(error);
+        }
+        return;
+    }
 
     log_debug(TAG, "Connecting to '%s' (%s) (%s)", device->name, device->address,
               device->paired ? "BINC_BONDED" : "BINC_BOND_NONE");
 
+    binc_device_get_session(device)->disconnect_requested = FALSE;
+    if (device->session->reconnect_timeout != 0) {
+        binc_source_remove(device->session->reconnect_timeout);
+        device->session->reconnect_timeout = 0;
+    }
+
+    ConnectData *connect_data = g_new0(ConnectData, 1);
+    connect_data->device = device;
+    connect_data->device_cancellable = g_object_ref(device->session->cancellable);
+    connect_data->callback = callback;
+    connect_data->user_data = user_data;
+
     binc_device_internal_set_conn_state(device, BINC_CONNECTING, NULL);
-    subscribe_prop_changed(device);
+    track_properties(device);
     g_dbus_connection_call(device->connection,
                            BLUEZ_DBUS,
                            device->path,
@@ -660,25 +1628,77 @@ void binc_device_connect(Device *device) {
                            NULL,
                            NULL,
                            G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           NULL,
+                           timeout_ms > 0 ? (gint) timeout_ms : -1,
+                           cancellable != NULL ? cancellable : device->session->cancellable,
                            (GAsyncReadyCallback) binc_internal_device_connect_cb,
-                           device);
+                           connect_data);
 }
 
-static void binc_internal_device_pair_cb(__attribute__((unused)) GObject *source_object,
-                                         GAsyncResult *res,
-                                         gpointer user_data) {
+void binc_device_connect(Device *device) {
+    binc_device_connect_with_callback(device, NULL, NULL, 0, NULL);
+}
 
+static gboolean binc_internal_reconnect(gpointer user_data) {
     Device *device = (Device *) user_data;
+    device->session->reconnect_timeout = 0;
+
+    if (device->connection_state == BINC_DISCONNECTED) {
+        binc_device_connect(device);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+void binc_device_set_auto_reconnect(Device *device, gboolean enabled) {
+    g_assert(device != NULL);
+
+    if (!enabled && device->session == NULL) return;
+
+    binc_device_get_session(device)->auto_reconnect = enabled;
+    if (!enabled) {
+        if (device->session->reconnect_timeout != 0) {
+            binc_source_remove(device->session->reconnect_timeout);
+            device->session->reconnect_timeout = 0;
+        }
+        device->session->reconnect_attempts = 0;
+        device->session->link_lost = FALSE;
+    }
+}
+
+gboolean binc_device_get_auto_reconnect(const Device *device) {
+    g_assert(device != NULL);
+    return device->session != NULL && device->session->auto_reconnect;
+}
+
+void binc_device_forget_notify(Device *device, Characteristic *characteristic) {
     g_assert(device != NULL);
+    g_assert(characteristic != NULL);
+
+    CharacteristicKey *key = binc_internal_characteristic_key(characteristic);
+    if (key != NULL) {
+        g_hash_table_remove(device->session->notify_subscriptions, key);
+        g_free(key);
+    }
+}
+
+static void binc_internal_device_pair_cb(GObject *source_object,
+                                         GAsyncResult *res,
+                                         gpointer user_data) {
 
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(device->connection, res, &error);
+    GVariant *value = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), res, &error);
     if (value != NULL) {
         g_variant_unref(value);
     }
 
+    // The device was freed
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_clear_error(&error);
+        return;
+    }
+
+    Device *device = (Device *) user_data;
+    g_assert(device != NULL);
+
     if (error != NULL) {
         log_error(TAG, "failed to call '%s' (error %d: %s)", DEVICE_METHOD_PAIR, error->code, error->message);
         binc_device_internal_set_conn_state(device, BINC_DISCONNECTED, error);
@@ -700,7 +1720,7 @@ void binc_device_pair(Device *device) {
         binc_device_internal_set_conn_state(device, BINC_CONNECTING, NULL);
     }
 
-    subscribe_prop_changed(device);
+    track_properties(device);
     g_dbus_connection_call(device->connection,
                            BLUEZ_DBUS,
                            device->path,
@@ -710,24 +1730,30 @@ void binc_device_pair(Device *device) {
                            NULL,
                            G_DBUS_CALL_FLAGS_NONE,
                            -1,
-                           NULL,
+                           device->session->cancellable,
                            (GAsyncReadyCallback) binc_internal_device_pair_cb,
                            device);
 }
 
-static void binc_internal_device_disconnect_cb(__attribute__((unused)) GObject *source_object,
+static void binc_internal_device_disconnect_cb(GObject *source_object,
                                                GAsyncResult *res,
                                                gpointer user_data) {
 
-    Device *device = (Device *) user_data;
-    g_assert(device != NULL);
-
     GError *error = NULL;
-    GVariant *value = g_dbus_connection_call_finish(device->connection, res, &error);
+    GVariant *value = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), res, &error);
     if (value != NULL) {
         g_variant_unref(value);
     }
 
+    // The device was freed
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_clear_error(&error);
+        return;
+    }
+
+    Device *device = (Device *) user_data;
+    g_assert(device != NULL);
+
     if (error != NULL) {
         log_error(TAG, "failed to call '%s' (error %d: %s)", DEVICE_METHOD_DISCONNECT, error->code, error->message);
         binc_device_internal_set_conn_state(device, BINC_CONNECTED, error);
@@ -739,6 +1765,15 @@ void binc_device_disconnect(Device *device) {
     g_assert(device != NULL);
     g_assert(device->path != NULL);
 
+    // An explicit disconnect also stops reconnecting
+    binc_device_get_session(device)->disconnect_requested = TRUE;
+    device->session->reconnect_attempts = 0;
+    device->session->link_lost = FALSE;
+    if (device->session->reconnect_timeout != 0) {
+        binc_source_remove(device->session->reconnect_timeout);
+        device->session->reconnect_timeout = 0;
+    }
+
     // Don't do anything if we are not connected
     if (device->connection_state != BINC_CONNECTED) return;
 
@@ -754,7 +1789,7 @@ void binc_device_disconnect(Device *device) {
                            NULL,
                            G_DBUS_CALL_FLAGS_NONE,
                            -1,
-                           NULL,
+                           device->session->cancellable,
                            (GAsyncReadyCallback) binc_internal_device_disconnect_cb,
                            device);
 }
@@ -764,36 +1799,48 @@ void binc_device_set_connection_state_change_cb(Device *device, ConnectionStateC
     g_assert(device != NULL);
     g_assert(callback != NULL);
 
-    device->connection_state_callback = callback;
+    binc_device_get_session(device)->connection_state_callback = callback;
 }
 
 GList *binc_device_get_services(const Device *device) {
     g_assert(device != NULL);
-    return device->services_list;
+    return device->session != NULL ? device->session->services_list : NULL;
+}
+
+void binc_device_set_service_changed_cb(Device *device, ServiceChangedCallback callback) {
+    g_assert(device != NULL);
+    binc_device_get_session(device)->service_changed_callback = callback;
+}
+
+gboolean binc_device_is_gatt_cached(const Device *device) {
+    g_assert(device != NULL);
+    return device->session != NULL && device->session->gatt_from_cache;
 }
 
 void binc_device_set_services_resolved_cb(Device *device, ServicesResolvedCallback callback) {
     g_assert(device != NULL);
     g_assert(callback != NULL);
 
-    device->services_resolved_callback = callback;
+    binc_device_get_session(device)->services_resolved_callback = callback;
 }
 
 Service *binc_device_get_service(const Device *device, const char *service_uuid) {
     g_assert(device != NULL);
     g_assert(service_uuid != NULL);
-    g_assert(g_uuid_string_is_valid(service_uuid));
 
-    if (device->services_list != NULL) {
-        for (GList *iterator = device->services_list; iterator; iterator = iterator->next) {
-            Service *service = (Service *) iterator->data;
-            if (g_str_equal(service_uuid, binc_service_get_uuid(service))) {
-                return service;
-            }
-        }
-    }
+    Uuid uuid;
+    if (!binc_uuid_parse(service_uuid, &uuid)) return NULL;
+    return binc_device_get_service_by_uuid(device, &uuid);
+}
 
-    return NULL;
+Service *binc_device_get_service_by_uuid(const Device *device, const Uuid *service_uuid) {
+    g_assert(device != NULL);
+    g_assert(service_uuid != NULL);
+
+    if (device->session == NULL || device->session->service_index == NULL) return NULL;
+
+    const Uuid *interned = binc_uuid_lookup(service_uuid);
+    return interned != NULL ? g_hash_table_lookup(device->session->service_index, interned) : NULL;
 }
 
 Characteristic *
@@ -801,30 +1848,197 @@ binc_device_get_characteristic(const Device *device, const char *service_uuid, c
     g_assert(device != NULL);
     g_assert(service_uuid != NULL);
     g_assert(characteristic_uuid != NULL);
-    g_assert(g_uuid_string_is_valid(service_uuid));
-    g_assert(g_uuid_string_is_valid(characteristic_uuid));
 
-    Service *service = binc_device_get_service(device, service_uuid);
-    if (service != NULL) {
-        return binc_service_get_characteristic(service, characteristic_uuid);
+    Uuid service, characteristic;
+    if (!binc_uuid_parse(service_uuid, &service) || !binc_uuid_parse(characteristic_uuid, &characteristic)) {
+        return NULL;
     }
+    return binc_device_get_characteristic_by_uuid(device, &service, &characteristic);
+}
 
-    return NULL;
+Characteristic *binc_device_get_characteristic_by_path(const Device *device, const char *path) {
+    g_assert(device != NULL);
+    g_assert(path != NULL);
+
+    if (device->session == NULL || device->session->characteristics == NULL) return NULL;
+    return g_hash_table_lookup(device->session->characteristics, path);
+}
+
+Characteristic *binc_device_get_characteristic_by_uuid(const Device *device, const Uuid *service_uuid,
+                                                       const Uuid *characteristic_uuid) {
+    g_assert(device != NULL);
+    g_assert(service_uuid != NULL);
+    g_assert(characteristic_uuid != NULL);
+
+    if (device->session == NULL || device->session->characteristic_index == NULL) return NULL;
+
+    // Uuids that were never interned belong to no attribute
+    CharacteristicKey key = {binc_uuid_lookup(service_uuid), binc_uuid_lookup(characteristic_uuid)};
+    if (key.service_uuid == NULL || key.characteristic_uuid == NULL) return NULL;
+    return g_hash_table_lookup(device->session->characteristic_index, &key);
 }
 
 void binc_device_set_read_char_cb(Device *device, OnReadCallback callback) {
     g_assert(device != NULL);
     g_assert(callback != NULL);
-    device->on_read_callback = callback;
+    binc_device_get_session(device)->on_read_callback = callback;
+}
+
+static gboolean binc_internal_read_char(const Device *device, Characteristic *characteristic) {
+    if (characteristic != NULL && binc_characteristic_supports_read(characteristic)) {
+        Operation *operation = binc_operation_create(BINC_OPERATION_READ_CHAR, characteristic,
+                                                     binc_characteristic_get_priority(characteristic));
+        binc_operation_queue_enqueue(device->session->operation_queue, operation);
+        return TRUE;
+    }
+    return FALSE;
 }
 
 gboolean binc_device_read_char(const Device *device, const char *service_uuid, const char *characteristic_uuid) {
-    g_assert(is_valid_uuid(service_uuid));
-    g_assert(is_valid_uuid(characteristic_uuid));
+    g_assert(device != NULL);
+
+    return binc_internal_read_char(device,
+                                   binc_device_get_characteristic(device, service_uuid, characteristic_uuid));
+}
+
+Operation *binc_device_read_char_with_callback(const Device *device, const char *service_uuid,
+                                              const char *characteristic_uuid, OperationCallback callback,
+                                              void *user_data, guint timeout_ms, GCancellable *cancellable) {
+    g_assert(device != NULL);
+    g_assert(callback != NULL);
+
+    Characteristic *characteristic = binc_device_get_characteristic(device, service_uuid, characteristic_uuid);
+    if (characteristic == NULL || !binc_characteristic_supports_read(characteristic)) return NULL;
+
+    Operation *operation = binc_operation_create(BINC_OPERATION_READ_CHAR, characteristic,
+                                                 binc_characteristic_get_priority(characteristic));
+    binc_operation_set_callback(operation, callback, user_data);
+    binc_operation_set_timeout(operation, timeout_ms);
+    binc_operation_set_cancellable(operation, cancellable);
+    binc_operation_queue_enqueue(device->session->operation_queue, operation);
+    return operation;
+}
+
+typedef struct binc_read_chars_batch ReadCharsBatch;
+
+typedef struct binc_read_chars_item {
+    ReadCharsBatch *batch; // Borrowed
+    guint index;
+} ReadCharsItem;
+
+struct binc_read_chars_batch {
+    Device *device; // Borrowed
+    ReadCharsResult *results; // Owned
+    ReadCharsItem *items; // Owned
+    guint count;
+    guint pending;
+    OnReadCharsCallback callback;
+    void *user_data; // Borrowed
+};
+
+static void binc_internal_read_chars_finish(ReadCharsBatch *batch) {
+    if (batch->callback != NULL) {
+        batch->callback(batch->device, batch->results, batch->count, batch->user_data);
+    }
+
+    for (guint i = 0; i < batch->count; i++) {
+        ReadCharsResult *result = &batch->results[i];
+        g_free((char *) result->service_uuid);
+        g_free((char *) result->characteristic_uuid);
+        if (result->value != NULL) {
+            g_byte_array_free(result->value, TRUE);
+        }
+        if (result->error != NULL) {
+            g_error_free(result->error);
+        }
+    }
+    g_free(batch->results);
+    g_free(batch->items);
+    g_free(batch);
+}
+
+static void binc_internal_read_chars_cb(__attribute__((unused)) Operation *operation, const GByteArray *byteArray,
+                                        const GError *error, gpointer user_data) {
+    ReadCharsItem *item = (ReadCharsItem *) user_data;
+    ReadCharsBatch *batch = item->batch;
+    ReadCharsResult *result = &batch->results[item->index];
+
+    if (error != NULL) {
+        result->error = g_error_copy(error);
+    } else if (byteArray != NULL) {
+        result->value = g_byte_array_sized_new(byteArray->len);
+        g_byte_array_append(result->value, byteArray->data, byteArray->len);
+    }
+
+    batch->pending--;
+    if (batch->pending == 0) {
+        binc_internal_read_chars_finish(batch);
+    }
+}
+
+void binc_device_read_chars(Device *device, const char *const *uuids, guint count, OnReadCharsCallback callback,
+                            void *user_data) {
+    g_assert(device != NULL);
+    g_assert(uuids != NULL);
+    g_assert(count > 0);
+
+    ReadCharsBatch *batch = g_new0(ReadCharsBatch, 1);
+    batch->device = device;
+    batch->results = g_new0(ReadCharsResult, count);
+    batch->items = g_new0(ReadCharsItem, count);
+    batch->count = count;
+    batch->callback = callback;
+    batch->user_data = user_data;
+
+    // Count all reads as pending up front so a read that fails immediately can't finish the batch early
+    batch->pending = count + 1;
+    for (guint i = 0; i < count; i++) {
+        const char *service_uuid = uuids[2 * i];
+        const char *characteristic_uuid = uuids[2 * i + 1];
+
+        ReadCharsResult *result = &batch->results[i];
+        result->service_uuid = g_strdup(service_uuid);
+        result->characteristic_uuid = g_strdup(characteristic_uuid);
+        result->characteristic = binc_device_get_characteristic(device, service_uuid, characteristic_uuid);
+        if (result->characteristic == NULL) {
+            result->error = g_error_new(G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "characteristic <%s> not found",
+                                        characteristic_uuid);
+            batch->pending--;
+            continue;
+        }
+
+        if (!binc_characteristic_supports_read(result->characteristic)) {
+            result->error = g_error_new(G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "characteristic <%s> is not readable",
+                                        characteristic_uuid);
+            batch->pending--;
+            continue;
+        }
+
+        ReadCharsItem *item = &batch->items[i];
+        item->batch = batch;
+        item->index = i;
+        Operation *operation = binc_operation_create(BINC_OPERATION_READ_CHAR, result->characteristic,
+                                                     binc_characteristic_get_priority(result->characteristic));
+        binc_operation_set_callback(operation, binc_internal_read_chars_cb, item);
+        binc_operation_queue_enqueue(device->session->operation_queue, operation);
+    }
+
+    batch->pending--;
+    if (batch->pending == 0) {
+        binc_internal_read_chars_finish(batch);
+    }
+}
+
+gboolean binc_device_read_char_long(const Device *device, const char *service_uuid, const char *characteristic_uuid,
+                                    guint expected_length) {
+    g_assert(device != NULL);
 
     Characteristic *characteristic = binc_device_get_characteristic(device, service_uuid, characteristic_uuid);
     if (characteristic != NULL && binc_characteristic_supports_read(characteristic)) {
-        binc_characteristic_read(characteristic);
+        Operation *operation = binc_operation_create(BINC_OPERATION_READ_CHAR_LONG, characteristic,
+                                                     binc_characteristic_get_priority(characteristic));
+        binc_operation_set_expected_length(operation, expected_length);
+        binc_operation_queue_enqueue(device->session->operation_queue, operation);
         return TRUE;
     }
     return FALSE;
@@ -832,59 +2046,130 @@ gboolean binc_device_read_char(const Device *device, const char *service_uuid, c
 
 gboolean binc_device_read_desc(const Device *device, const char *service_uuid,
                                const char *characteristic_uuid, const char *desc_uuid) {
-    g_assert(is_valid_uuid(service_uuid));
-    g_assert(is_valid_uuid(characteristic_uuid));
-    g_assert(is_valid_uuid(desc_uuid));
+    g_assert(device != NULL);
+    g_assert(desc_uuid != NULL);
+
+    Uuid uuid;
+    if (!binc_uuid_parse(desc_uuid, &uuid)) return FALSE;
 
     Characteristic *characteristic = binc_device_get_characteristic(device, service_uuid, characteristic_uuid);
     if (characteristic == NULL) {
         return FALSE;
     }
 
-    Descriptor *descriptor = binc_characteristic_get_descriptor(characteristic, desc_uuid);
+    Descriptor *descriptor = binc_characteristic_get_descriptor_by_uuid(characteristic, &uuid);
     if (descriptor == NULL) {
         return FALSE;
     }
 
-    binc_descriptor_read(descriptor);
+    Operation *operation = binc_operation_create(BINC_OPERATION_READ_DESC, descriptor,
+                                                 binc_characteristic_get_priority(characteristic));
+    binc_operation_queue_enqueue(device->session->operation_queue, operation);
     return TRUE;
 }
 
 gboolean binc_device_write_desc(const Device *device, const char *service_uuid,
                                 const char *characteristic_uuid, const char *desc_uuid, const GByteArray *byteArray) {
-    g_assert(is_valid_uuid(service_uuid));
-    g_assert(is_valid_uuid(characteristic_uuid));
-    g_assert(is_valid_uuid(desc_uuid));
+    g_assert(device != NULL);
+    g_assert(desc_uuid != NULL);
+
+    Uuid uuid;
+    if (!binc_uuid_parse(desc_uuid, &uuid)) return FALSE;
 
     Characteristic *characteristic = binc_device_get_characteristic(device, service_uuid, characteristic_uuid);
     if (characteristic == NULL) {
         return FALSE;
     }
 
-    Descriptor *descriptor = binc_characteristic_get_descriptor(characteristic, desc_uuid);
+    Descriptor *descriptor = binc_characteristic_get_descriptor_by_uuid(characteristic, &uuid);
     if (descriptor == NULL) {
         return FALSE;
     }
 
-    binc_descriptor_write(descriptor, byteArray);
-    return TRUE;
+    Operation *operation = binc_operation_create(BINC_OPERATION_WRITE_DESC, descriptor,
+                                                 binc_characteristic_get_priority(characteristic));
+    binc_operation_set_value(operation, byteArray, WITH_RESPONSE);
+    binc_operation_queue_enqueue(device->session->operation_queue, operation);
+    return TRUE;
+}
+
+void binc_device_set_write_char_cb(Device *device, OnWriteCallback callback) {
+    g_assert(device != NULL);
+    g_assert(callback != NULL);
+    binc_device_get_session(device)->on_write_callback = callback;
+}
+
+static gboolean binc_internal_write_char(const Device *device, Characteristic *characteristic,
+                                         const GByteArray *byteArray, WriteType writeType) {
+    if (characteristic != NULL && binc_characteristic_supports_write(characteristic, writeType)) {
+        Operation *operation = binc_operation_create(BINC_OPERATION_WRITE_CHAR, characteristic,
+                                                     binc_characteristic_get_priority(characteristic));
+        binc_operation_set_value(operation, byteArray, writeType);
+        binc_operation_queue_enqueue(device->session->operation_queue, operation);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+gboolean binc_device_write_char(const Device *device, const char *service_uuid, const char *characteristic_uuid,
+                                const GByteArray *byteArray, WriteType writeType) {
+    g_assert(device != NULL);
+
+    return binc_internal_write_char(device, binc_device_get_characteristic(device, service_uuid, characteristic_uuid),
+                                    byteArray, writeType);
+}
+
+gboolean binc_device_write_char_long(const Device *device, const char *service_uuid, const char *characteristic_uuid,
+                                     const GByteArray *byteArray) {
+    g_assert(device != NULL);
+
+    Characteristic *characteristic = binc_device_get_characteristic(device, service_uuid, characteristic_uuid);
+    if (characteristic != NULL && binc_characteristic_supports_write(characteristic, WITH_RESPONSE)) {
+        Operation *operation = binc_operation_create(BINC_OPERATION_WRITE_CHAR_LONG, characteristic,
+                                                     binc_characteristic_get_priority(characteristic));
+        binc_operation_set_value(operation, byteArray, WITH_RESPONSE);
+        binc_operation_queue_enqueue(device->session->operation_queue, operation);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+Operation *binc_device_write_char_with_callback(const Device *device, const char *service_uuid,
+                                               const char *characteristic_uuid, const GByteArray *byteArray,
+                                               WriteType writeType, OperationCallback callback, void *user_data,
+                                               guint timeout_ms, GCancellable *cancellable) {
+    g_assert(device != NULL);
+    g_assert(callback != NULL);
+
+    Characteristic *characteristic = binc_device_get_characteristic(device, service_uuid, characteristic_uuid);
+    if (characteristic == NULL || !binc_characteristic_supports_write(characteristic, writeType)) return NULL;
+
+    Operation *operation = binc_operation_create(BINC_OPERATION_WRITE_CHAR, characteristic,
+                                                 binc_characteristic_get_priority(characteristic));
+    binc_operation_set_value(operation, byteArray, writeType);
+    binc_operation_set_callback(operation, callback, user_data);
+    binc_operation_set_timeout(operation, timeout_ms);
+    binc_operation_set_cancellable(operation, cancellable);
+    binc_operation_queue_enqueue(device->session->operation_queue, operation);
+    return operation;
 }
 
-void binc_device_set_write_char_cb(Device *device, OnWriteCallback callback) {
+void binc_device_set_write_channel_state_cb(Device *device, OnWriteChannelStateChangedCallback callback) {
     g_assert(device != NULL);
     g_assert(callback != NULL);
-    device->on_write_callback = callback;
+    binc_device_get_session(device)->on_write_channel_callback = callback;
 }
 
-gboolean binc_device_write_char(const Device *device, const char *service_uuid, const char *characteristic_uuid,
-                                const GByteArray *byteArray, WriteType writeType) {
+gboolean binc_device_acquire_write(const Device *device, const char *service_uuid, const char *characteristic_uuid) {
     g_assert(device != NULL);
-    g_assert(is_valid_uuid(service_uuid));
-    g_assert(is_valid_uuid(characteristic_uuid));
 
     Characteristic *characteristic = binc_device_get_characteristic(device, service_uuid, characteristic_uuid);
-    if (characteristic != NULL && binc_characteristic_supports_write(characteristic, writeType)) {
-        binc_characteristic_write(characteristic, byteArray, writeType);
+    if (characteristic != NULL && binc_characteristic_supports_write(characteristic, WITHOUT_RESPONSE)) {
+        if (binc_characteristic_get_write_channel_state(characteristic) == BINC_WRITE_CHANNEL_CLOSED) {
+            Operation *operation = binc_operation_create(BINC_OPERATION_ACQUIRE_WRITE, characteristic,
+                                                         binc_characteristic_get_priority(characteristic));
+            binc_operation_queue_enqueue(device->session->operation_queue, operation);
+        }
         return TRUE;
     }
     return FALSE;
@@ -893,52 +2178,197 @@ gboolean binc_device_write_char(const Device *device, const char *service_uuid,
 void binc_device_set_notify_char_cb(Device *device, OnNotifyCallback callback) {
     g_assert(device != NULL);
     g_assert(callback != NULL);
-    device->on_notify_callback = callback;
+    binc_device_get_session(device)->on_notify_callback = callback;
 }
 
 void binc_device_set_notify_state_cb(Device *device, OnNotifyingStateChangedCallback callback) {
     g_assert(device != NULL);
     g_assert(callback != NULL);
-    device->on_notify_state_callback = callback;
+    binc_device_get_session(device)->on_notify_state_callback = callback;
+}
+
+static gboolean binc_internal_start_notify(const Device *device, Characteristic *characteristic) {
+    if (characteristic != NULL && binc_characteristic_supports_notify(characteristic)) {
+        Operation *operation = binc_operation_create(BINC_OPERATION_START_NOTIFY, characteristic,
+                                                     binc_characteristic_get_priority(characteristic));
+        binc_operation_queue_enqueue(device->session->operation_queue, operation);
+        return TRUE;
+    }
+    return FALSE;
 }
 
 gboolean binc_device_start_notify(const Device *device, const char *service_uuid, const char *characteristic_uuid) {
     g_assert(device != NULL);
-    g_assert(is_valid_uuid(service_uuid));
-    g_assert(is_valid_uuid(characteristic_uuid));
 
-    Characteristic *characteristic = binc_device_get_characteristic(device, service_uuid, characteristic_uuid);
+    return binc_internal_start_notify(device,
+                                      binc_device_get_characteristic(device, service_uuid, characteristic_uuid));
+}
+
+static gboolean binc_internal_acquire_notify(const Device *device, Characteristic *characteristic) {
     if (characteristic != NULL && binc_characteristic_supports_notify(characteristic)) {
-        binc_characteristic_start_notify(characteristic);
+        if (!binc_characteristic_is_notify_acquired(characteristic)) {
+            Operation *operation = binc_operation_create(BINC_OPERATION_ACQUIRE_NOTIFY, characteristic,
+                                                         binc_characteristic_get_priority(characteristic));
+            binc_operation_queue_enqueue(device->session->operation_queue, operation);
+        }
         return TRUE;
     }
     return FALSE;
 }
 
-gboolean binc_device_stop_notify(const Device *device, const char *service_uuid, const char *characteristic_uuid) {
+gboolean binc_device_acquire_notify(const Device *device, const char *service_uuid, const char *characteristic_uuid) {
     g_assert(device != NULL);
-    g_assert(is_valid_uuid(service_uuid));
-    g_assert(is_valid_uuid(characteristic_uuid));
 
-    Characteristic *characteristic = binc_device_get_characteristic(device, service_uuid, characteristic_uuid);
+    return binc_internal_acquire_notify(device,
+                                        binc_device_get_characteristic(device, service_uuid, characteristic_uuid));
+}
+
+static gboolean binc_internal_stop_notify(const Device *device, Characteristic *characteristic) {
     if (characteristic != NULL && binc_characteristic_supports_notify(characteristic) && binc_characteristic_is_notifying(characteristic)) {
-        binc_characteristic_stop_notify(characteristic);
+        Operation *operation = binc_operation_create(BINC_OPERATION_STOP_NOTIFY, characteristic,
+                                                     binc_characteristic_get_priority(characteristic));
+        binc_operation_queue_enqueue(device->session->operation_queue, operation);
         return TRUE;
     }
     return FALSE;
 }
 
+gboolean binc_device_stop_notify(const Device *device, const char *service_uuid, const char *characteristic_uuid) {
+    g_assert(device != NULL);
+
+    return binc_internal_stop_notify(device,
+                                     binc_device_get_characteristic(device, service_uuid, characteristic_uuid));
+}
+
+static Operation *binc_internal_notify_with_callback(const Device *device, OperationType type,
+                                                    Characteristic *characteristic, OperationCallback callback,
+                                                    void *user_data, guint timeout_ms, GCancellable *cancellable) {
+    Operation *operation = binc_operation_create(type, characteristic, binc_characteristic_get_priority(characteristic));
+    binc_operation_set_callback(operation, callback, user_data);
+    binc_operation_set_timeout(operation, timeout_ms);
+    binc_operation_set_cancellable(operation, cancellable);
+    binc_operation_queue_enqueue(device->session->operation_queue, operation);
+    return operation;
+}
+
+Operation *binc_device_start_notify_with_callback(const Device *device, const char *service_uuid,
+                                                  const char *characteristic_uuid, OperationCallback callback,
+                                                  void *user_data, guint timeout_ms, GCancellable *cancellable) {
+    g_assert(device != NULL);
+    g_assert(callback != NULL);
+
+    Characteristic *characteristic = binc_device_get_characteristic(device, service_uuid, characteristic_uuid);
+    if (characteristic == NULL || !binc_characteristic_supports_notify(characteristic)) return NULL;
+
+    return binc_internal_notify_with_callback(device, BINC_OPERATION_START_NOTIFY, characteristic, callback,
+                                              user_data, timeout_ms, cancellable);
+}
+
+Operation *binc_device_stop_notify_with_callback(const Device *device, const char *service_uuid,
+                                                 const char *characteristic_uuid, OperationCallback callback,
+                                                 void *user_data, guint timeout_ms, GCancellable *cancellable) {
+    g_assert(device != NULL);
+    g_assert(callback != NULL);
+
+    Characteristic *characteristic = binc_device_get_characteristic(device, service_uuid, characteristic_uuid);
+    if (characteristic == NULL || !binc_characteristic_supports_notify(characteristic) ||
+        !binc_characteristic_is_notifying(characteristic)) {
+        return NULL;
+    }
+
+    return binc_internal_notify_with_callback(device, BINC_OPERATION_STOP_NOTIFY, characteristic, callback,
+                                              user_data, timeout_ms, cancellable);
+}
+
+CharacteristicHandle *binc_device_prepare_char(Device *device, const char *service_uuid,
+                                               const char *characteristic_uuid) {
+    g_assert(device != NULL);
+    g_assert(service_uuid != NULL);
+    g_assert(characteristic_uuid != NULL);
+
+    Uuid service, characteristic;
+    if (!binc_uuid_parse(service_uuid, &service) || !binc_uuid_parse(characteristic_uuid, &characteristic)) {
+        return NULL;
+    }
+
+    CharacteristicHandle *handle = g_new0(CharacteristicHandle, 1);
+    handle->device = device;
+    handle->service_uuid = service;
+    handle->characteristic_uuid = characteristic;
+    return handle;
+}
+
+void binc_characteristic_handle_free(CharacteristicHandle *handle) {
+    g_assert(handle != NULL);
+
+    handle->characteristic = NULL;
+    handle->device = NULL;
+    g_free(handle);
+}
+
+Characteristic *binc_characteristic_handle_get_characteristic(CharacteristicHandle *handle) {
+    g_assert(handle != NULL);
+
+    // Only look up the characteristic again when the GATT tree was rebuilt since the last time
+    Device *device = handle->device;
+    if (device->session == NULL) return NULL;
+
+    if (handle->generation != device->session->gatt_generation) {
+        handle->characteristic = binc_device_get_characteristic_by_uuid(device, &handle->service_uuid,
+                                                                        &handle->characteristic_uuid);
+        handle->generation = device->session->gatt_generation;
+    }
+    return handle->characteristic;
+}
+
+gboolean binc_device_read_char_handle(CharacteristicHandle *handle) {
+    g_assert(handle != NULL);
+    return binc_internal_read_char(handle->device, binc_characteristic_handle_get_characteristic(handle));
+}
+
+gboolean binc_device_write_char_handle(CharacteristicHandle *handle, const GByteArray *byteArray,
+                                       WriteType writeType) {
+    g_assert(handle != NULL);
+    return binc_internal_write_char(handle->device, binc_characteristic_handle_get_characteristic(handle),
+                                    byteArray, writeType);
+}
+
+gboolean binc_device_start_notify_handle(CharacteristicHandle *handle) {
+    g_assert(handle != NULL);
+    return binc_internal_start_notify(handle->device, binc_characteristic_handle_get_characteristic(handle));
+}
+
+gboolean binc_device_stop_notify_handle(CharacteristicHandle *handle) {
+    g_assert(handle != NULL);
+    return binc_internal_stop_notify(handle->device, binc_characteristic_handle_get_characteristic(handle));
+}
+
+void binc_device_set_max_operations_in_flight(Device *device, guint max_in_flight) {
+    g_assert(device != NULL);
+    g_assert(max_in_flight > 0);
+    binc_operation_queue_set_max_in_flight(binc_device_get_session(device)->operation_queue, max_in_flight);
+}
+
+guint binc_device_get_operation_queue_depth(const Device *device) {
+    g_assert(device != NULL);
+    return device->session != NULL ? binc_operation_queue_get_depth(device->session->operation_queue) : 0;
+}
+
+guint binc_device_get_operations_in_flight(const Device *device) {
+    g_assert(device != NULL);
+    return device->session != NULL ? binc_operation_queue_get_in_flight(device->session->operation_queue) : 0;
+}
 
 void binc_device_set_read_desc_cb(Device *device, OnDescReadCallback callback) {
     g_assert(device != NULL);
     g_assert(callback != NULL);
-    device->on_read_desc_cb = callback;
+    binc_device_get_session(device)->on_read_desc_cb = callback;
 }
 
 void binc_device_set_write_desc_cb(Device *device, OnDescWriteCallback callback) {
     g_assert(device != NULL);
     g_assert(callback != NULL);
-    device->on_write_desc_cb = callback;
+    binc_device_get_session(device)->on_write_desc_cb = callback;
 }
 
 ConnectionState binc_device_get_connection_state(const Device *device) {
@@ -953,28 +2383,53 @@ const char *binc_device_get_connection_state_name(const Device *device) {
 
 const char *binc_device_get_address(const Device *device) {
     g_assert(device != NULL);
-    return device->address;
+    return device->address[0] != '\0' ? device->address : NULL;
+}
+
+guint64 binc_device_get_address_value(const Device *device) {
+    g_assert(device != NULL);
+    return device->address_value;
 }
 
 void binc_device_set_address(Device *device, const char *address) {
     g_assert(device != NULL);
     g_assert(address != NULL);
 
-    g_free((char *) device->address);
-    device->address = g_strdup(address);
+    if (!binc_address_parse(address, &device->address_value)) {
+        log_debug(TAG, "invalid address '%s'", address);
+        return;
+    }
+    binc_address_format(device->address_value, device->address);
 }
 
 const char *binc_device_get_address_type(const Device *device) {
     g_assert(device != NULL);
-    return device->address_type;
+    return address_type_names[device->address_type];
 }
 
 void binc_device_set_address_type(Device *device, const char *address_type) {
     g_assert(device != NULL);
     g_assert(address_type != NULL);
 
-    g_free((char *) device->address_type);
-    device->address_type = g_strdup(address_type);
+    if (g_str_equal(address_type, address_type_names[ADDRESS_TYPE_PUBLIC])) {
+        device->address_type = ADDRESS_TYPE_PUBLIC;
+    } else if (g_str_equal(address_type, address_type_names[ADDRESS_TYPE_RANDOM])) {
+        device->address_type = ADDRESS_TYPE_RANDOM;
+    } else {
+        device->address_type = ADDRESS_TYPE_UNKNOWN;
+    }
+}
+
+/*
+ * Names and aliases repeat a lot between devices, so they share one copy
+ */
+static void binc_internal_set_interned(const char **field, const char *value) {
+    if (*field != NULL && g_str_equal(*field, value)) return;
+
+    if (*field != NULL) {
+        g_ref_string_release((char *) *field);
+    }
+    *field = g_ref_string_new_intern(value);
 }
 
 const char *binc_device_get_alias(const Device *device) {
@@ -986,8 +2441,7 @@ void binc_device_set_alias(Device *device, const char *alias) {
     g_assert(device != NULL);
     g_assert(alias != NULL);
 
-    g_free((char *) device->alias);
-    device->alias = g_strdup(alias);
+    binc_internal_set_interned(&device->alias, alias);
 }
 
 const char *binc_device_get_name(const Device *device) {
@@ -1000,8 +2454,7 @@ void binc_device_set_name(Device *device, const char *name) {
     g_assert(name != NULL);
     g_assert(strlen(name) > 0);
 
-    g_free((char *) device->name);
-    device->name = g_strdup(name);
+    binc_internal_set_interned(&device->name, name);
 }
 
 const char *binc_device_get_path(const Device *device) {
@@ -1009,14 +2462,6 @@ const char *binc_device_get_path(const Device *device) {
     return device->path;
 }
 
-void binc_device_set_path(Device *device, const char *path) {
-    g_assert(device != NULL);
-    g_assert(path != NULL);
-
-    g_free((char *) device->path);
-    device->path = g_strdup(path);
-}
-
 gboolean binc_device_get_paired(const Device *device) {
     g_assert(device != NULL);
     return device->paired;
@@ -1060,38 +2505,197 @@ void binc_device_set_txpower(Device *device, short txpower) {
 
 GList *binc_device_get_uuids(const Device *device) {
     g_assert(device != NULL);
-    return device->uuids;
+
+    AdvertisedUuids *uuids = (AdvertisedUuids *) &device->uuids;
+    if (uuids->strings == NULL) {
+        const Uuid *values = advertised_uuids_values(uuids);
+        for (guint i = uuids->count; i > 0; i--) {
+            char *uuid_string = g_malloc(BINC_UUID_STRING_LENGTH);
+            binc_uuid_to_string(&values[i - 1], uuid_string);
+            uuids->strings = g_list_prepend(uuids->strings, uuid_string);
+        }
+    }
+    return uuids->strings;
 }
 
-void binc_device_set_uuids(Device *device, GList *uuids) {
+GHashTable *binc_device_get_manufacturer_data(const Device *device) {
     g_assert(device != NULL);
 
-    binc_device_free_uuids(device);
-    device->uuids = uuids;
+    AdvertisementData *data = (AdvertisementData *) &device->manufacturer_data;
+    if (data->length == 0) return NULL;
+
+    if (data->table == NULL) {
+        data->table = g_hash_table_new_full(g_int_hash, g_int_equal, g_free, (GDestroyNotify) byte_array_free);
+
+        gsize offset = 0;
+        const guint8 *key, *payload;
+        guint16 payload_length;
+        while (advertisement_data_next(data, sizeof(guint16), &offset, &key, &payload, &payload_length)) {
+            guint16 manufacturer_id;
+            memcpy(&manufacturer_id, key, sizeof(guint16));
+            int *keyCopy = g_new0 (gint, 1);
+            *keyCopy = manufacturer_id;
+
+            GByteArray *byteArray = g_byte_array_sized_new(payload_length);
+            g_byte_array_append(byteArray, payload, payload_length);
+            g_hash_table_insert(data->table, keyCopy, byteArray);
+        }
+    }
+    return data->table;
 }
 
-GHashTable *binc_device_get_manufacturer_data(const Device *device) {
+const guint8 *binc_device_find_manufacturer_data(const Device *device, guint16 manufacturer_id, gsize *length) {
     g_assert(device != NULL);
-    return device->manufacturer_data;
+    return advertisement_data_lookup(&device->manufacturer_data, &manufacturer_id, sizeof(guint16), length);
 }
 
-void binc_device_set_manufacturer_data(Device *device, GHashTable *manufacturer_data) {
+gboolean binc_device_set_manufacturer_data(Device *device, GVariant *manufacturer_data) {
     g_assert(device != NULL);
+    g_assert(manufacturer_data != NULL);
 
-    binc_device_free_manufacturer_data(device);
-    device->manufacturer_data = manufacturer_data;
+    AdvertisementData *stored = &device->manufacturer_data;
+    GVariantIter iter;
+    GVariant *array;
+    guint16 key;
+    gsize data_length;
+    const guint8 *data;
+
+    // Most advertisements repeat the previous payload, so compare in place before rewriting anything
+    gsize offset = 0;
+    gboolean equal = TRUE;
+    g_variant_iter_init(&iter, manufacturer_data);
+    while (equal && g_variant_iter_next(&iter, "{qv}", &key, &array)) {
+        data = g_variant_get_fixed_array(array, &data_length, sizeof(guint8));
+        equal = advertisement_data_match_next(stored, &offset, &key, sizeof(guint16), data, data_length);
+        g_variant_unref(array);
+    }
+    if (equal && offset == stored->length) return FALSE;
+
+    advertisement_data_clear(stored);
+    g_variant_iter_init(&iter, manufacturer_data);
+    while (g_variant_iter_next(&iter, "{qv}", &key, &array)) {
+        data = g_variant_get_fixed_array(array, &data_length, sizeof(guint8));
+        advertisement_data_append(stored, &key, sizeof(guint16), data, data_length);
+        g_variant_unref(array);
+    }
+    return TRUE;
 }
 
 GHashTable *binc_device_get_service_data(const Device *device) {
     g_assert(device != NULL);
-    return device->service_data;
+
+    AdvertisementData *data = (AdvertisementData *) &device->service_data;
+    if (data->length == 0) return NULL;
+
+    if (data->table == NULL) {
+        data->table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) byte_array_free);
+
+        gsize offset = 0;
+        const guint8 *key, *payload;
+        guint16 payload_length;
+        while (advertisement_data_next(data, sizeof(Uuid), &offset, &key, &payload, &payload_length)) {
+            Uuid uuid;
+            memcpy(&uuid, key, sizeof(Uuid));
+            char *uuid_string = g_malloc(BINC_UUID_STRING_LENGTH);
+            binc_uuid_to_string(&uuid, uuid_string);
+
+            GByteArray *byteArray = g_byte_array_sized_new(payload_length);
+            g_byte_array_append(byteArray, payload, payload_length);
+            g_hash_table_insert(data->table, uuid_string, byteArray);
+        }
+    }
+    return data->table;
+}
+
+const guint8 *binc_device_find_service_data(const Device *device, const char *service_uuid, gsize *length) {
+    g_assert(device != NULL);
+    g_assert(service_uuid != NULL);
+
+    Uuid uuid;
+    if (!binc_uuid_parse(service_uuid, &uuid)) return NULL;
+    return advertisement_data_lookup(&device->service_data, &uuid, sizeof(Uuid), length);
+}
+
+gboolean binc_device_set_service_data(Device *device, GVariant *service_data) {
+    g_assert(device != NULL);
+    g_assert(service_data != NULL);
+
+    AdvertisementData *stored = &device->service_data;
+    GVariantIter iter;
+    GVariant *array;
+    const char *key;
+    gsize data_length;
+    const guint8 *data;
+
+    gsize offset = 0;
+    gboolean equal = TRUE;
+    g_variant_iter_init(&iter, service_data);
+    while (equal && g_variant_iter_next(&iter, "{&sv}", &key, &array)) {
+        Uuid uuid;
+        if (binc_uuid_parse(key, &uuid)) {
+            data = g_variant_get_fixed_array(array, &data_length, sizeof(guint8));
+            equal = advertisement_data_match_next(stored, &offset, &uuid, sizeof(Uuid), data, data_length);
+        }
+        g_variant_unref(array);
+    }
+    if (equal && offset == stored->length) return FALSE;
+
+    advertisement_data_clear(stored);
+    g_variant_iter_init(&iter, service_data);
+    while (g_variant_iter_next(&iter, "{&sv}", &key, &array)) {
+        Uuid uuid;
+        if (binc_uuid_parse(key, &uuid)) {
+            data = g_variant_get_fixed_array(array, &data_length, sizeof(guint8));
+            advertisement_data_append(stored, &uuid, sizeof(Uuid), data, data_length);
+        }
+        g_variant_unref(array);
+    }
+    return TRUE;
 }
 
-void binc_device_set_service_data(Device *device, GHashTable *service_data) {
+GVariant *binc_device_get_advertisement_properties(const Device *device) {
     g_assert(device != NULL);
 
-    binc_device_free_service_data(device);
-    device->service_data = service_data;
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+    if (device->address[0] != '\0') {
+        g_variant_builder_add(&builder, "{sv}", "Address", g_variant_new_string(device->address));
+    }
+
+    gsize offset = 0;
+    const guint8 *key, *payload;
+    guint16 payload_length;
+    if (device->manufacturer_data.length > 0) {
+        GVariantBuilder manufacturer_data;
+        g_variant_builder_init(&manufacturer_data, G_VARIANT_TYPE("a{qv}"));
+        while (advertisement_data_next(&device->manufacturer_data, sizeof(guint16), &offset, &key, &payload,
+                                       &payload_length)) {
+            guint16 manufacturer_id;
+            memcpy(&manufacturer_id, key, sizeof(guint16));
+            g_variant_builder_add(&manufacturer_data, "{qv}", manufacturer_id,
+                                  g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, payload, payload_length,
+                                                            sizeof(guint8)));
+        }
+        g_variant_builder_add(&builder, "{sv}", "ManufacturerData", g_variant_builder_end(&manufacturer_data));
+    }
+
+    offset = 0;
+    if (device->service_data.length > 0) {
+        GVariantBuilder service_data;
+        g_variant_builder_init(&service_data, G_VARIANT_TYPE("a{sv}"));
+        while (advertisement_data_next(&device->service_data, sizeof(Uuid), &offset, &key, &payload,
+                                       &payload_length)) {
+            Uuid uuid;
+            char uuid_string[BINC_UUID_STRING_LENGTH];
+            memcpy(&uuid, key, sizeof(Uuid));
+            binc_uuid_to_string(&uuid, uuid_string);
+            g_variant_builder_add(&service_data, "{sv}", uuid_string,
+                                  g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, payload, payload_length,
+                                                            sizeof(guint8)));
+        }
+        g_variant_builder_add(&builder, "{sv}", "ServiceData", g_variant_builder_end(&service_data));
+    }
+    return g_variant_ref_sink(g_variant_builder_end(&builder));
 }
 
 void binc_device_set_is_central(Device *device, gboolean is_central) {
@@ -1104,6 +2708,78 @@ gboolean binc_device_is_central(const Device *device) {
     return device->is_central;
 }
 
+gint64 binc_device_get_last_seen(const Device *device) {
+    g_assert(device != NULL);
+    return device->last_seen;
+}
+
+void binc_device_set_last_seen(Device *device, gint64 last_seen) {
+    g_assert(device != NULL);
+    device->last_seen = last_seen;
+}
+
+DiscoveryReport *binc_device_get_discovery_report(Device *device) {
+    g_assert(device != NULL);
+    return &device->discovery_report;
+}
+
+static guint32 fnv1a_hash(guint32 hash, const guint8 *bytes, gsize length) {
+    for (gsize i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+guint32 binc_device_get_payload_hash(const Device *device) {
+    g_assert(device != NULL);
+
+    // Names are interned, so hashing the pointer is enough
+    guint32 hash = 2166136261u;
+    hash = fnv1a_hash(hash, (const guint8 *) &device->name, sizeof(device->name));
+    hash = fnv1a_hash(hash, advertisement_data_bytes(&device->manufacturer_data), device->manufacturer_data.length);
+    hash = fnv1a_hash(hash, advertisement_data_bytes(&device->service_data), device->service_data.length);
+    return hash;
+}
+
+static gsize string_size(const char *string) {
+    return string != NULL ? strlen(string) + 1 : 0;
+}
+
+static gsize byte_array_table_size(GHashTable *table) {
+    if (table == NULL) return 0;
+
+    // Each entry also costs a key, a GByteArray header and hash table slots
+    gsize size = 0;
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, table);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        size += sizeof(GByteArray) + ((GByteArray *) value)->len + 4 * sizeof(gpointer);
+    }
+    return size;
+}
+
+static gsize advertisement_data_size(const AdvertisementData *data) {
+    gsize size = data->bytes != NULL ? data->capacity : 0;
+    return size + byte_array_table_size(data->table);
+}
+
+gsize binc_device_get_memory_size(const Device *device) {
+    g_assert(device != NULL);
+
+    // Interned names are shared, but count them anyway as most are unique
+    gsize size = sizeof(Device);
+    size += string_size(device->path) + string_size(device->name) + string_size(device->alias);
+    size += device->uuids.values != NULL ? device->uuids.count * sizeof(Uuid) : 0;
+    size += g_list_length(device->uuids.strings) * (sizeof(GList) + BINC_UUID_STRING_LENGTH);
+    size += advertisement_data_size(&device->manufacturer_data);
+    size += advertisement_data_size(&device->service_data);
+    if (device->session != NULL) {
+        size += sizeof(DeviceSession);
+    }
+    return size;
+}
+
 GDBusConnection *binc_device_get_dbus_connection(const Device *device) {
     g_assert(device != NULL);
     return device->connection;
@@ -1121,88 +2797,240 @@ Adapter *binc_device_get_adapter(const Device *device) {
 
 guint binc_device_get_mtu(const Device *device) {
     g_assert(device != NULL);
-    return device->mtu;
+    return device->session != NULL ? device->session->mtu : 23;
 }
 
 gboolean binc_device_has_service(const Device *device, const char *service_uuid) {
     g_assert(device != NULL);
-    g_assert(g_uuid_string_is_valid(service_uuid));
 
-    if (device->uuids != NULL && g_list_length(device->uuids) > 0) {
-        for (GList *iterator = device->uuids; iterator; iterator = iterator->next) {
-            if (g_str_equal(service_uuid, (char *) iterator->data)) {
-                return TRUE;
-            }
-        }
+    Uuid uuid;
+    if (!binc_uuid_parse(service_uuid, &uuid)) return FALSE;
+    return binc_device_has_service_uuid(device, &uuid);
+}
+
+gboolean binc_device_has_service_uuid(const Device *device, const Uuid *service_uuid) {
+    g_assert(device != NULL);
+    g_assert(service_uuid != NULL);
+
+    const Uuid *values = advertised_uuids_values(&device->uuids);
+    for (guint i = 0; i < device->uuids.count; i++) {
+        if (binc_uuid_equal(&values[i], service_uuid)) return TRUE;
     }
     return FALSE;
 }
 
-void binc_internal_device_update_property(Device *device, const char *property_name, GVariant *property_value) {
-    if (g_str_equal(property_name, DEVICE_PROPERTY_ADDRESS)) {
-        binc_device_set_address(device, g_variant_get_string(property_value, NULL));
-    } else if (g_str_equal(property_name, DEVICE_PROPERTY_ADDRESS_TYPE)) {
-        binc_device_set_address_type(device, g_variant_get_string(property_value, NULL));
-    } else if (g_str_equal(property_name, DEVICE_PROPERTY_ALIAS)) {
-        binc_device_set_alias(device, g_variant_get_string(property_value, NULL));
-    } else if (g_str_equal(property_name, DEVICE_PROPERTY_CONNECTED)) {
-        binc_device_internal_set_conn_state(device, g_variant_get_boolean(property_value) ? BINC_CONNECTED : BINC_DISCONNECTED,
-                                            NULL);
-    } else if (g_str_equal(property_name, DEVICE_PROPERTY_NAME)) {
-        binc_device_set_name(device, g_variant_get_string(property_value, NULL));
-    } else if (g_str_equal(property_name, DEVICE_PROPERTY_PAIRED)) {
-        binc_device_set_paired(device, g_variant_get_boolean(property_value));
-    } else if (g_str_equal(property_name, DEVICE_PROPERTY_RSSI)) {
-        binc_device_set_rssi(device, g_variant_get_int16(property_value));
-    } else if (g_str_equal(property_name, DEVICE_PROPERTY_TRUSTED)) {
-        binc_device_set_trusted(device, g_variant_get_boolean(property_value));
-    } else if (g_str_equal(property_name, DEVICE_PROPERTY_TXPOWER)) {
-        binc_device_set_txpower(device, g_variant_get_int16(property_value));
-    } else if (g_str_equal(property_name, DEVICE_PROPERTY_UUIDS)) {
-        binc_device_set_uuids(device, g_variant_string_array_to_list(property_value));
-    } else if (g_str_equal(property_name, DEVICE_PROPERTY_MANUFACTURER_DATA)) {
-        GVariantIter *iter;
-        g_variant_get(property_value, "a{qv}", &iter);
-
-        GVariant *array;
-        guint16 key;
-        GHashTable *manufacturer_data = g_hash_table_new_full(g_int_hash, g_int_equal,
-                                                              g_free, (GDestroyNotify) byte_array_free);
-        while (g_variant_iter_loop(iter, "{qv}", &key, &array)) {
-            gsize data_length = 0;
-            guint8 *data = (guint8 *) g_variant_get_fixed_array(array, &data_length, sizeof(guint8));
-            GByteArray *byteArray = g_byte_array_sized_new((guint) data_length);
-            g_byte_array_append(byteArray, data, (guint) data_length);
+static gboolean binc_internal_update_address(Device *device, GVariant *value) {
+    const char *address = g_variant_get_string(value, NULL);
+    if (g_ascii_strcasecmp(device->address, address) == 0) return FALSE;
 
-            int *keyCopy = g_new0 (gint, 1);
-            *keyCopy = key;
+    binc_device_set_address(device, address);
+    return TRUE;
+}
+
+static gboolean binc_internal_update_address_type(Device *device, GVariant *value) {
+    const char *address_type = g_variant_get_string(value, NULL);
+    if (g_strcmp0(binc_device_get_address_type(device), address_type) == 0) return FALSE;
+
+    binc_device_set_address_type(device, address_type);
+    return TRUE;
+}
+
+static gboolean binc_internal_update_alias(Device *device, GVariant *value) {
+    const char *alias = g_variant_get_string(value, NULL);
+    if (g_strcmp0(device->alias, alias) == 0) return FALSE;
+
+    binc_device_set_alias(device, alias);
+    return TRUE;
+}
+
+static gboolean binc_internal_update_name(Device *device, GVariant *value) {
+    const char *name = g_variant_get_string(value, NULL);
+    if (g_strcmp0(device->name, name) == 0) return FALSE;
+
+    binc_device_set_name(device, name);
+    return TRUE;
+}
+
+// Only devices we connect to or pair with follow their connection and services
+static gboolean is_tracking_properties(const Device *device) {
+    return device->session != NULL && device->session->tracking_properties;
+}
+
+static gboolean binc_internal_update_connected(Device *device, GVariant *value) {
+    ConnectionState state = g_variant_get_boolean(value) ? BINC_CONNECTED : BINC_DISCONNECTED;
+    ConnectionState old_state = device->connection_state;
+    binc_device_internal_set_conn_state(device, state, NULL);
+
+    if (is_tracking_properties(device)) {
+        if (device->connection_state == BINC_DISCONNECTED) {
+            device->session->tracking_properties = FALSE;
+        } else if (device->connection_state == BINC_CONNECTED) {
+            binc_internal_restore_gatt_tree(device);
+        }
+    }
+    return state != old_state;
+}
+
+static gboolean binc_internal_update_services_resolved(Device *device, GVariant *value) {
+    if (!is_tracking_properties(device)) return FALSE;
+
+    gboolean old_services_resolved = device->session->services_resolved;
+    device->session->services_resolved = g_variant_get_boolean(value);
+    log_debug(TAG, "ServicesResolved %s", device->session->services_resolved ? "true" : "false");
+    if (device->session->services_resolved == TRUE && device->bondingState != BINC_BONDING) {
+        binc_collect_gatt_tree(device);
+    }
+    binc_operation_queue_set_objects_ready(device->session->operation_queue, device->session->services_resolved);
+
+    if (device->session->services_resolved == FALSE && device->connection_state == BINC_CONNECTED) {
+        binc_device_internal_set_conn_state(device, BINC_DISCONNECTING, NULL);
+    }
+    return device->session->services_resolved != old_services_resolved;
+}
+
+static gboolean binc_internal_update_paired(Device *device, GVariant *value) {
+    gboolean paired = g_variant_get_boolean(value);
+    if (paired == device->paired) return FALSE;
+
+    log_debug(TAG, "Paired %s", paired ? "true" : "false");
+    binc_device_set_paired(device, paired);
+
+    // If gatt-tree has not been built yet, start building it
+    if (is_tracking_properties(device) &&
+        (device->session->services == NULL || device->session->gatt_from_cache) &&
+        device->session->services_resolved && !device->session->service_discovery_started) {
+        binc_collect_gatt_tree(device);
+    }
+    return TRUE;
+}
+
+static gboolean binc_internal_update_trusted(Device *device, GVariant *value) {
+    gboolean trusted = g_variant_get_boolean(value);
+    if (trusted == device->trusted) return FALSE;
+
+    device->trusted = trusted;
+    return TRUE;
+}
+
+static gboolean binc_internal_update_rssi(Device *device, GVariant *value) {
+    short rssi = g_variant_get_int16(value);
+    if (rssi == device->rssi) return FALSE;
+
+    device->rssi = rssi;
+    return TRUE;
+}
+
+static gboolean binc_internal_update_txpower(Device *device, GVariant *value) {
+    short txpower = g_variant_get_int16(value);
+    if (txpower == device->txpower) return FALSE;
+
+    device->txpower = txpower;
+    return TRUE;
+}
+
+static gboolean binc_internal_update_uuids(Device *device, GVariant *value) {
+    AdvertisedUuids *uuids = &device->uuids;
+    const gchar *data;
+    GVariantIter iter;
+
+    // Compare against the stored uuids first, so they are only rewritten when they changed
+    const Uuid *values = advertised_uuids_values(uuids);
+    guint count = 0;
+    gboolean equal = TRUE;
+    g_variant_iter_init(&iter, value);
+    while (g_variant_iter_next(&iter, "&s", &data)) {
+        Uuid uuid;
+        if (!binc_uuid_parse(data, &uuid)) continue;
+
+        equal = equal && count < uuids->count && binc_uuid_equal(&values[count], &uuid);
+        count++;
+    }
+    if (equal && count == uuids->count) return FALSE;
+
+    advertised_uuids_free(uuids);
+    if (count > ADVERTISED_UUIDS_INLINE_COUNT) {
+        uuids->values = g_new(Uuid, count);
+    }
 
-            g_hash_table_insert(manufacturer_data, keyCopy, byteArray);
+    Uuid *stored = uuids->values != NULL ? uuids->values : uuids->inline_values;
+    g_variant_iter_init(&iter, value);
+    while (g_variant_iter_next(&iter, "&s", &data)) {
+        if (binc_uuid_parse(data, &stored[uuids->count])) {
+            uuids->count++;
+        }
+    }
+    return TRUE;
+}
+
+typedef gboolean (*DevicePropertyUpdater)(Device *device, GVariant *value);
+
+typedef struct binc_device_property {
+    const char *name;
+    const char *type; // Type string of the value, checked before updating
+    DevicePropertyFlags flag;
+    DevicePropertyUpdater update;
+} DeviceProperty;
+
+static const DeviceProperty device_properties[] = {
+        {"Address",          "s",      BINC_DEVICE_PROPERTY_ADDRESS,           binc_internal_update_address},
+        {"AddressType",      "s",      BINC_DEVICE_PROPERTY_ADDRESS_TYPE,      binc_internal_update_address_type},
+        {"Alias",            "s",      BINC_DEVICE_PROPERTY_ALIAS,             binc_internal_update_alias},
+        {"Name",             "s",      BINC_DEVICE_PROPERTY_NAME,              binc_internal_update_name},
+        {"Connected",        "b",      BINC_DEVICE_PROPERTY_CONNECTED,         binc_internal_update_connected},
+        {"ServicesResolved", "b",      BINC_DEVICE_PROPERTY_SERVICES_RESOLVED, binc_internal_update_services_resolved},
+        {"Paired",           "b",      BINC_DEVICE_PROPERTY_PAIRED,            binc_internal_update_paired},
+        {"Trusted",          "b",      BINC_DEVICE_PROPERTY_TRUSTED,           binc_internal_update_trusted},
+        {"RSSI",             "n",      BINC_DEVICE_PROPERTY_RSSI,              binc_internal_update_rssi},
+        {"TxPower",          "n",      BINC_DEVICE_PROPERTY_TXPOWER,           binc_internal_update_txpower},
+        {"UUIDs",            "as",     BINC_DEVICE_PROPERTY_UUIDS,             binc_internal_update_uuids},
+        {"ManufacturerData", "a{qv}",  BINC_DEVICE_PROPERTY_MANUFACTURER_DATA, binc_device_set_manufacturer_data},
+        {"ServiceData",      "a{sv}",  BINC_DEVICE_PROPERTY_SERVICE_DATA,      binc_device_set_service_data},
+};
+
+/*
+ * Property name -> DeviceProperty, built once and only read afterwards, so it is shared by all threads
+ */
+static GHashTable *binc_internal_device_property_table(void) {
+    static gsize initialized = 0;
+    static GHashTable *table = NULL;
+
+    if (g_once_init_enter(&initialized)) {
+        table = g_hash_table_new(g_str_hash, g_str_equal);
+        for (guint i = 0; i < G_N_ELEMENTS(device_properties); i++) {
+            g_hash_table_insert(table, (gpointer) device_properties[i].name, (gpointer) &device_properties[i]);
         }
-        binc_device_set_manufacturer_data(device, manufacturer_data);
-        g_variant_iter_free(iter);
-    } else if (g_str_equal(property_name, DEVICE_PROPERTY_SERVICE_DATA)) {
-        GVariantIter *iter;
-        g_variant_get(property_value, "a{sv}", &iter);
-
-        GVariant *array;
-        char *key;
-
-        GHashTable *service_data = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                                         g_free, (GDestroyNotify) byte_array_free);
-        while (g_variant_iter_loop(iter, "{sv}", &key, &array)) {
-            gsize data_length = 0;
-            guint8 *data = (guint8 *) g_variant_get_fixed_array(array, &data_length, sizeof(guint8));
-            GByteArray *byteArray = g_byte_array_sized_new((guint) data_length);
-            g_byte_array_append(byteArray, data, (guint) data_length);
-
-            char *keyCopy = g_strdup(key);
-
-            g_hash_table_insert(service_data, keyCopy, byteArray);
+        g_once_init_leave(&initialized, 1);
+    }
+    return table;
+}
+
+DevicePropertyFlags binc_internal_device_update_properties(Device *device, GVariant *properties,
+                                                           DevicePropertyFlags *present) {
+    g_assert(device != NULL);
+    g_assert(properties != NULL);
+
+    GHashTable *table = binc_internal_device_property_table();
+    DevicePropertyFlags changed = BINC_DEVICE_PROPERTY_NONE;
+    DevicePropertyFlags seen = BINC_DEVICE_PROPERTY_NONE;
+
+    const char *property_name;
+    GVariant *property_value;
+    GVariantIter iter;
+    g_variant_iter_init(&iter, properties);
+    while (g_variant_iter_loop(&iter, "{&sv}", &property_name, &property_value)) {
+        const DeviceProperty *property = g_hash_table_lookup(table, property_name);
+        if (property == NULL || !g_str_equal(g_variant_get_type_string(property_value), property->type)) continue;
+
+        seen |= property->flag;
+        if (property->update(device, property_value)) {
+            changed |= property->flag;
         }
-        binc_device_set_service_data(device, service_data);
-        g_variant_iter_free(iter);
     }
+
+    if (present != NULL) {
+        *present = seen;
+    }
+    return changed;
 }
 
 void binc_device_set_user_data(Device *device, void *user_data) {
@@ -23,7 +23,7 @@
 #ifndef BINC_DEVICE_H
 #define BINC_DEVICE_H
 
-#include <glib.h>
+#include <gio/gio.h>
 #include "forward_decl.h"
 #include "characteristic.h"
 #include "descriptor.h"
@@ -40,13 +40,51 @@ typedef enum BondingState {
     BINC_BOND_NONE = 0, BINC_BONDING = 1, BINC_BONDED = 2
 } BondingState;
 
+/**
+ * Flags for the properties of a device that changed, see binc_adapter_set_device_changed_cb()
+ */
+typedef enum DevicePropertyFlags {
+    BINC_DEVICE_PROPERTY_NONE = 0,
+    BINC_DEVICE_PROPERTY_ADDRESS = 1 << 0,
+    BINC_DEVICE_PROPERTY_ADDRESS_TYPE = 1 << 1,
+    BINC_DEVICE_PROPERTY_ALIAS = 1 << 2,
+    BINC_DEVICE_PROPERTY_NAME = 1 << 3,
+    BINC_DEVICE_PROPERTY_CONNECTED = 1 << 4,
+    BINC_DEVICE_PROPERTY_PAIRED = 1 << 5,
+    BINC_DEVICE_PROPERTY_TRUSTED = 1 << 6,
+    BINC_DEVICE_PROPERTY_RSSI = 1 << 7,
+    BINC_DEVICE_PROPERTY_TXPOWER = 1 << 8,
+    BINC_DEVICE_PROPERTY_UUIDS = 1 << 9,
+    BINC_DEVICE_PROPERTY_MANUFACTURER_DATA = 1 << 10,
+    BINC_DEVICE_PROPERTY_SERVICE_DATA = 1 << 11,
+    BINC_DEVICE_PROPERTY_SERVICES_RESOLVED = 1 << 12
+} DevicePropertyFlags;
+
 typedef void (*ConnectionStateChangedCallback)(Device *device, ConnectionState state, const GError *error);
 
 typedef void (*ServicesResolvedCallback)(Device *device);
 
+typedef enum ServiceChange {
+    BINC_SERVICE_ADDED = 0, BINC_SERVICE_REMOVED = 1, BINC_SERVICE_MODIFIED = 2
+} ServiceChange;
+
+typedef void (*ServiceChangedCallback)(Device *device, Service *service, ServiceChange change);
+
 typedef void (*BondingStateChangedCallback)(Device *device, BondingState new_state, BondingState old_state,
                                             const GError *error);
 
+typedef struct binc_read_chars_result {
+    const char *service_uuid; // Owned
+    const char *characteristic_uuid; // Owned
+    Characteristic *characteristic; // Borrowed, NULL if not found
+    GByteArray *value; // Owned, NULL if the read failed
+    GError *error; // Owned, NULL if the read succeeded
+} ReadCharsResult;
+
+typedef void (*OnConnectCallback)(Device *device, const GError *error, void *user_data);
+
+typedef void (*OnReadCharsCallback)(Device *device, const ReadCharsResult *results, guint count, void *user_data);
+
 
 /**
  * Connect to a device asynchronously
@@ -57,6 +95,36 @@ typedef void (*BondingStateChangedCallback)(Device *device, BondingState new_sta
  */
 void binc_device_connect(Device *device);
 
+/**
+ * Connect to a device asynchronously and get called back with the outcome of this connect attempt
+ *
+ * The ConnectionStateChangedCallback is called as usual. When the deadline expires or the cancellable is cancelled,
+ * the attempt is aborted and the callback is called with G_IO_ERROR_TIMED_OUT or G_IO_ERROR_CANCELLED. If the device
+ * is not disconnected, the callback is called right away with G_IO_ERROR_BUSY. When the device is freed before BlueZ
+ * answers, for example because it was removed, the callback gets a NULL device and G_IO_ERROR_NOT_FOUND.
+ *
+ * @param device the device to connect to
+ * @param callback called once with NULL on success or the error, may be NULL
+ * @param user_data passed to the callback
+ * @param timeout_ms deadline in milliseconds, or 0 to wait as long as BlueZ does
+ * @param cancellable optional GCancellable to abort the attempt
+ */
+void binc_device_connect_with_callback(Device *device, OnConnectCallback callback, void *user_data,
+                                       guint timeout_ms, GCancellable *cancellable);
+
+/**
+ * Reconnect automatically when the connection is lost
+ *
+ * Reconnect attempts are retried with an increasing delay until they succeed, the device is disconnected with
+ * binc_device_disconnect() or auto-reconnect is disabled. The services of the previous connection are used right
+ * away: the ServicesResolvedCallback is called as soon as the device is connected again, and the services are checked
+ * in the background like services restored from the GATT cache. The notifications that were running are started
+ * again only after that, once BlueZ has resolved the services, since it has not exported the characteristics before.
+ */
+void binc_device_set_auto_reconnect(Device *device, gboolean enabled);
+
+gboolean binc_device_get_auto_reconnect(const Device *device);
+
 void binc_device_pair(Device *device);
 
 void binc_device_disconnect(Device *device);
@@ -65,37 +133,184 @@ void binc_device_set_read_char_cb(Device *device, OnReadCallback callback);
 
 gboolean binc_device_read_char(const Device *device, const char *service_uuid, const char *characteristic_uuid);
 
+/**
+ * Read a characteristic and get the result on callback instead of the regular OnReadCallback
+ *
+ * The read goes through the device's operation queue. When the deadline expires or the cancellable is cancelled,
+ * the callback is called with G_IO_ERROR_TIMED_OUT or G_IO_ERROR_CANCELLED and the read no longer counts against
+ * the in-flight window. BlueZ is not told, it may still be busy with the characteristic after that.
+ *
+ * @param timeout_ms deadline in milliseconds measured from this call, or 0 for no deadline
+ * @param cancellable optional GCancellable to cancel the read
+ * @return a handle for binc_operation_cancel() that is valid until the callback has been called, or NULL if the
+ * characteristic was not found or does not support read
+ */
+Operation *binc_device_read_char_with_callback(const Device *device, const char *service_uuid,
+                                              const char *characteristic_uuid, OperationCallback callback,
+                                              void *user_data, guint timeout_ms, GCancellable *cancellable);
+
+/**
+ * Read several characteristics with a single completion
+ *
+ * The reads are issued through the device's operation queue, so they run concurrently within the in-flight window.
+ * The callback is called once when all reads have finished, with the results in the same order as requested. The
+ * results are freed when the callback returns. The regular read callback is not called for these reads.
+ *
+ * @param device the device to read from
+ * @param uuids pairs of service uuid and characteristic uuid, so 2 * count strings
+ * @param count the number of characteristics to read
+ * @param callback called with all results
+ * @param user_data passed to the callback
+ */
+void binc_device_read_chars(Device *device, const char *const *uuids, guint count, OnReadCharsCallback callback,
+                            void *user_data);
+
+gboolean binc_device_read_char_long(const Device *device, const char *service_uuid, const char *characteristic_uuid,
+                                    guint expected_length);
+
 void binc_device_set_write_char_cb(Device *device, OnWriteCallback callback);
 
 gboolean binc_device_write_char(const Device *device, const char *service_uuid,
                                 const char *characteristic_uuid, const GByteArray *byteArray, WriteType writeType);
 
+/**
+ * Write a characteristic and get the result on callback instead of the regular OnWriteCallback
+ *
+ * See binc_device_read_char_with_callback() for the meaning of the deadline, cancellable and returned handle.
+ */
+Operation *binc_device_write_char_with_callback(const Device *device, const char *service_uuid,
+                                               const char *characteristic_uuid, const GByteArray *byteArray,
+                                               WriteType writeType, OperationCallback callback, void *user_data,
+                                               guint timeout_ms, GCancellable *cancellable);
+
+gboolean binc_device_write_char_long(const Device *device, const char *service_uuid,
+                                     const char *characteristic_uuid, const GByteArray *byteArray);
+
+void binc_device_set_write_channel_state_cb(Device *device, OnWriteChannelStateChangedCallback callback);
+
+/**
+ * Open a write-without-response channel using AcquireWrite, see binc_characteristic_acquire_write()
+ *
+ * The call goes through the device's operation queue like binc_device_start_notify(). Does nothing if the channel is
+ * already open.
+ */
+gboolean binc_device_acquire_write(const Device *device, const char *service_uuid, const char *characteristic_uuid);
+
 void binc_device_set_notify_char_cb(Device *device, OnNotifyCallback callback);
 
 void binc_device_set_notify_state_cb(Device *device, OnNotifyingStateChangedCallback callback);
 
 gboolean binc_device_start_notify(const Device *device, const char *service_uuid, const char *characteristic_uuid);
 
+/**
+ * Start notifications using AcquireNotify so that notifications bypass the DBus daemon
+ *
+ * See binc_characteristic_acquire_notify(). The call goes through the device's operation queue like
+ * binc_device_start_notify(). Notifications are delivered on the OnNotifyCallback as usual.
+ */
+gboolean binc_device_acquire_notify(const Device *device, const char *service_uuid, const char *characteristic_uuid);
+
 gboolean binc_device_stop_notify(const Device *device, const char *service_uuid, const char *characteristic_uuid);
 
+/**
+ * Start or stop notifications and get the outcome on callback instead of the OnNotifyingStateChangedCallback
+ *
+ * See binc_device_read_char_with_callback() for the meaning of the deadline, cancellable and returned handle.
+ * Notifications themselves are still delivered on the OnNotifyCallback.
+ */
+Operation *binc_device_start_notify_with_callback(const Device *device, const char *service_uuid,
+                                                  const char *characteristic_uuid, OperationCallback callback,
+                                                  void *user_data, guint timeout_ms, GCancellable *cancellable);
+
+Operation *binc_device_stop_notify_with_callback(const Device *device, const char *service_uuid,
+                                                 const char *characteristic_uuid, OperationCallback callback,
+                                                 void *user_data, guint timeout_ms, GCancellable *cancellable);
+
 gboolean binc_device_read_desc(const Device *device, const char *service_uuid,
                                const char *characteristic_uuid, const char *desc_uuid);
 
 gboolean binc_device_write_desc(const Device *device, const char *service_uuid,
                                 const char *characteristic_uuid, const char *desc_uuid, const GByteArray *byteArray);
 
+/**
+ * Resolve a characteristic once so that it can be read, written or subscribed to without any uuid lookups
+ *
+ * The handle can be created before the services are resolved and stays valid when the GATT tree is rebuilt, it then
+ * looks up the characteristic again on first use. The *_handle functions return FALSE while the characteristic is
+ * not found, just like their uuid based counterparts.
+ *
+ * @param device the device, must outlive the handle
+ * @return the handle, free with binc_characteristic_handle_free(), or NULL if a uuid doesn't parse
+ */
+CharacteristicHandle *binc_device_prepare_char(Device *device, const char *service_uuid,
+                                               const char *characteristic_uuid);
+
+void binc_characteristic_handle_free(CharacteristicHandle *handle);
+
+/**
+ * Get the characteristic the handle refers to, or NULL if the device has no such characteristic (yet)
+ */
+Characteristic *binc_characteristic_handle_get_characteristic(CharacteristicHandle *handle);
+
+gboolean binc_device_read_char_handle(CharacteristicHandle *handle);
+
+gboolean binc_device_write_char_handle(CharacteristicHandle *handle, const GByteArray *byteArray, WriteType writeType);
+
+gboolean binc_device_start_notify_handle(CharacteristicHandle *handle);
+
+gboolean binc_device_stop_notify_handle(CharacteristicHandle *handle);
+
+/**
+ * Set how many queued operations may be outstanding at BlueZ at the same time. Use 1 to fully serialize
+ * operations. Operations on the same characteristic or descriptor are always serialized. Defaults to 4.
+ */
+void binc_device_set_max_operations_in_flight(Device *device, guint max_in_flight);
+
+/**
+ * Get the number of operations waiting to be sent, not counting the ones in flight
+ */
+guint binc_device_get_operation_queue_depth(const Device *device);
+
+guint binc_device_get_operations_in_flight(const Device *device);
+
 void binc_device_set_read_desc_cb(Device *device, OnDescReadCallback callback);
 
 void binc_device_set_write_desc_cb(Device *device, OnDescWriteCallback callback);
 
 void binc_device_set_connection_state_change_cb(Device *device, ConnectionStateChangedCallback callback);
 
+/**
+ * Get notified when the services can be used. With services restored from the GATT cache or from the previous
+ * connection this happens right after connecting. When BlueZ has resolved the services, a restored tree that turns
+ * out to be different is updated in place and the differences are reported to the ServiceChangedCallback, the
+ * ServicesResolvedCallback is not called again.
+ */
 void binc_device_set_services_resolved_cb(Device *device, ServicesResolvedCallback callback);
 
+/**
+ * Get notified when the peripheral changes its attribute database while connected, or when services restored from
+ * the GATT cache or the previous connection turn out to differ from what BlueZ resolved
+ *
+ * Only the affected services, characteristics and descriptors are added or removed, all other objects stay valid and
+ * keep their notifications. All changes are reported from the main loop once they have been applied:
+ * BINC_SERVICE_ADDED, BINC_SERVICE_MODIFIED for services whose characteristics or descriptors changed, and
+ * BINC_SERVICE_REMOVED for services that are no longer part of the device. A removed service has no characteristics
+ * left and is freed right after its callback. A service that is added and removed before the changes are reported is
+ * not reported at all.
+ */
+void binc_device_set_service_changed_cb(Device *device, ServiceChangedCallback callback);
+
+/**
+ * Returns TRUE while the services come from the adapter's GATT cache and have not yet been checked against BlueZ
+ */
+gboolean binc_device_is_gatt_cached(const Device *device);
+
 void binc_device_set_bonding_state_changed_cb(Device *device, BondingStateChangedCallback callback);
 
 gboolean binc_device_has_service(const Device *device, const char *service_uuid);
 
+gboolean binc_device_has_service_uuid(const Device *device, const Uuid *service_uuid);
+
 GList *binc_device_get_services(const Device *device);
 
 Service *binc_device_get_service(const Device *device, const char *service_uuid);
@@ -103,12 +318,27 @@ Service *binc_device_get_service(const Device *device, const char *service_uuid)
 Characteristic *binc_device_get_characteristic(const Device *device,
                                                const char *service_uuid, const char *characteristic_uuid);
 
+Service *binc_device_get_service_by_uuid(const Device *device, const Uuid *service_uuid);
+
+Characteristic *binc_device_get_characteristic_by_uuid(const Device *device, const Uuid *service_uuid,
+                                                       const Uuid *characteristic_uuid);
+
 ConnectionState binc_device_get_connection_state(const Device *device);
 
+/**
+ * Get the time the device was last heard of, i.e. created or changed, as monotonic time in microseconds
+ */
+gint64 binc_device_get_last_seen(const Device *device);
+
 const char *binc_device_get_connection_state_name(const Device *device);
 
 const char *binc_device_get_address(const Device *device);
 
+/**
+ * Get the address as a 48 bit value, most significant byte first, e.g. 0x001122334455 for "00:11:22:33:44:55"
+ */
+guint64 binc_device_get_address_value(const Device *device);
+
 const char *binc_device_get_address_type(const Device *device);
 
 const char *binc_device_get_alias(const Device *device);
@@ -125,12 +355,31 @@ gboolean binc_device_get_trusted(const Device *device);
 
 short binc_device_get_txpower(const Device *device);
 
+/**
+ * Get the advertised service uuids in lowercase 128-bit form. The list is built on first use and owned by the device.
+ */
 GList *binc_device_get_uuids(const Device *device);
 
 GHashTable *binc_device_get_manufacturer_data(const Device *device);
 
+/**
+ * Look up the manufacturer data of one manufacturer without building the hash table
+ *
+ * @param length set to the number of bytes found, may be NULL
+ * @return the data, owned by the device and only valid until it advertises again, or NULL if not present
+ */
+const guint8 *binc_device_find_manufacturer_data(const Device *device, guint16 manufacturer_id, gsize *length);
+
 GHashTable *binc_device_get_service_data(const Device *device);
 
+/**
+ * Look up the service data of one service without building the hash table
+ *
+ * @param length set to the number of bytes found, may be NULL
+ * @return the data, owned by the device and only valid until it advertises again, or NULL if not present
+ */
+const guint8 *binc_device_find_service_data(const Device *device, const char *service_uuid, gsize *length);
+
 BondingState binc_device_get_bonding_state(const Device *device);
 
 Adapter *binc_device_get_adapter(const Device *device);
@@ -30,6 +30,49 @@ Device *binc_device_create(const char *path, Adapter *adapter);
 
 void binc_device_free(Device *device);
 
+/**
+ * Apply a GATT object that BlueZ exported while the services are resolved
+ */
+void binc_device_gatt_object_added(Device *device, const char *object_path, GVariant *interfaces);
+
+/**
+ * Remove a GATT object that BlueZ unexported while the services are resolved
+ */
+void binc_device_gatt_object_removed(Device *device, const char *object_path);
+
+Characteristic *binc_device_get_characteristic_by_path(const Device *device, const char *path);
+
+/**
+ * Forget that a characteristic was notifying, so it is not restarted after an automatic reconnect
+ */
+void binc_device_forget_notify(Device *device, Characteristic *characteristic);
+
+void binc_device_set_last_seen(Device *device, gint64 last_seen);
+
+/**
+ * Estimate the memory used by the device, not counting its services
+ */
+gsize binc_device_get_memory_size(const Device *device);
+
+/*
+ * What was last reported about a device as a discovery result, kept by the adapter to throttle discovery results
+ */
+typedef struct binc_discovery_report {
+    guint generation; // Discovery session of the last report, see the adapter
+    gint64 time; // Monotonic time in microseconds
+    guint32 payload_hash;
+    short rssi;
+    gboolean pending; // Waiting in the batch of discovery results
+    gboolean held; // Held back by the minimum interval, delivered when it expires
+} DiscoveryReport;
+
+DiscoveryReport *binc_device_get_discovery_report(Device *device);
+
+/**
+ * Hash of the advertised name, manufacturer data and service data, to tell whether the payload changed
+ */
+guint32 binc_device_get_payload_hash(const Device *device);
+
 GDBusConnection *binc_device_get_dbus_connection(const Device *device);
 
 void binc_device_set_address(Device *device, const char *address);
@@ -42,8 +85,6 @@ void binc_device_set_adapter_path(Device *device, const char *adapter_path);
 
 void binc_device_set_name(Device *device, const char *name);
 
-void binc_device_set_path(Device *device, const char *path);
-
 void binc_device_set_paired(Device *device, gboolean paired);
 
 void binc_device_set_rssi(Device *device, short rssi);
@@ -52,16 +93,26 @@ void binc_device_set_trusted(Device *device, gboolean trusted);
 
 void binc_device_set_txpower(Device *device, short txpower);
 
-void binc_device_set_uuids(Device *device, GList *uuids);
+// Copies the 'a{qv}' ManufacturerData property into the existing buffer, returns FALSE if nothing changed
+gboolean binc_device_set_manufacturer_data(Device *device, GVariant *manufacturer_data);
 
-void binc_device_set_manufacturer_data(Device *device, GHashTable *manufacturer_data);
+// Copies the 'a{sv}' ServiceData property into the existing buffer, returns FALSE if nothing changed
+gboolean binc_device_set_service_data(Device *device, GVariant *service_data);
 
-void binc_device_set_service_data(Device *device, GHashTable *service_data);
+// The stored address, manufacturer data and service data as 'a{sv}' properties, to run a scan filter on. Unref it.
+GVariant *binc_device_get_advertisement_properties(const Device *device);
 
 void binc_device_set_bonding_state(Device *device, BondingState bonding_state);
 
 void binc_device_set_is_central(Device *device, gboolean is_central);
 
-void binc_internal_device_update_property(Device *device, const char *property_name, GVariant *property_value);
+/**
+ * Update the device from a dictionary of org.bluez.Device1 properties
+ *
+ * @param present set to the properties that were in the dictionary, may be NULL
+ * @return the properties that changed value
+ */
+DevicePropertyFlags binc_internal_device_update_properties(Device *device, GVariant *properties,
+                                                           DevicePropertyFlags *present);
 
 #endif //BINC_DEVICE_INTERNAL_H
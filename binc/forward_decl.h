@@ -36,6 +36,16 @@ typedef struct binc_descriptor Descriptor;
 typedef struct binc_service_handler_manager ServiceHandlerManager;
 typedef struct binc_advertisement Advertisement;
 typedef struct binc_application Application;
+typedef struct binc_operation Operation;
+typedef struct binc_operation_queue OperationQueue;
+typedef struct binc_notification_ring NotificationRing;
+typedef struct binc_characteristic_handle CharacteristicHandle;
+typedef struct binc_gatt_cache GattCache;
+typedef struct binc_worker Worker;
+typedef struct binc_shard_set ShardSet;
+typedef struct binc_connection_manager ConnectionManager;
+typedef struct binc_scan_filter ScanFilter;
+typedef struct binc_address_set AddressSet;
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,333 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include "gatt_cache.h"
+#include "service.h"
+#include "characteristic_internal.h"
+#include "descriptor_internal.h"
+#include "service_internal.h"
+#include "logger.h"
+
+static const char *const TAG = "GattCache";
+static const char *const FILE_EXTENSION = ".gatt";
+
+// "BGAT" when read on a little endian machine, files written on a machine with another byte order are rejected
+#define GATT_CACHE_MAGIC 0x54414742u
+#define GATT_CACHE_VERSION 1
+#define GATT_CACHE_MAX_HASH_LENGTH 16
+
+/*
+ * All fields are 32-bit or byte arrays so the records are naturally aligned in a mapping
+ */
+typedef struct binc_gatt_cache_header {
+    guint32 magic;
+    guint32 version;
+    guint32 service_count;
+    guint32 characteristic_count;
+    guint32 descriptor_count;
+    guint32 strings_length;
+    guint32 db_hash_length;
+    guint8 db_hash[GATT_CACHE_MAX_HASH_LENGTH];
+} GattCacheHeader;
+
+typedef struct binc_gatt_cache_record {
+    guint32 path; // Offset in the string table
+    guint32 parent; // Index of the parent service or characteristic record, unused for services
+    guint32 flags; // Offset in the string table, flags are separated by ','
+    guint8 uuid[16]; // Big endian
+} GattCacheRecord;
+
+struct binc_gatt_cache {
+    GMappedFile *file; // Owned
+    const GattCacheHeader *header; // Borrowed from file
+    const GattCacheRecord *records; // Borrowed from file
+    const char *strings; // Borrowed from file
+};
+
+static char *binc_gatt_cache_filename(const char *directory, const char *address) {
+    char *name = g_strconcat(address, FILE_EXTENSION, NULL);
+    char *filename = g_build_filename(directory, name, NULL);
+    g_free(name);
+    return filename;
+}
+
+static void uuid_to_bytes(const Uuid *uuid, guint8 *bytes) {
+    for (guint i = 0; i < 8; i++) {
+        bytes[i] = (guint8) (uuid->msb >> (56 - 8 * i));
+        bytes[8 + i] = (guint8) (uuid->lsb >> (56 - 8 * i));
+    }
+}
+
+static Uuid uuid_from_bytes(const guint8 *bytes) {
+    Uuid uuid = {0, 0};
+    for (guint i = 0; i < 8; i++) {
+        uuid.msb = (uuid.msb << 8) | bytes[i];
+        uuid.lsb = (uuid.lsb << 8) | bytes[8 + i];
+    }
+    return uuid;
+}
+
+static gboolean binc_gatt_cache_is_valid(const GattCache *cache, gsize size) {
+    const GattCacheHeader *header = cache->header;
+    if (size < sizeof(GattCacheHeader)) return FALSE;
+    if (header->magic != GATT_CACHE_MAGIC || header->version != GATT_CACHE_VERSION) return FALSE;
+    if (header->db_hash_length > GATT_CACHE_MAX_HASH_LENGTH) return FALSE;
+
+    guint64 record_count = (guint64) header->service_count + header->characteristic_count + header->descriptor_count;
+    guint64 expected_size = sizeof(GattCacheHeader) + record_count * sizeof(GattCacheRecord) + header->strings_length;
+    if (expected_size != size) return FALSE;
+    if (header->strings_length == 0 || cache->strings[header->strings_length - 1] != '\0') return FALSE;
+
+    for (guint64 i = 0; i < record_count; i++) {
+        const GattCacheRecord *record = &cache->records[i];
+        if (record->path >= header->strings_length || record->flags >= header->strings_length) return FALSE;
+
+        if (i >= header->service_count + header->characteristic_count) {
+            if (record->parent >= header->characteristic_count) return FALSE;
+        } else if (i >= header->service_count) {
+            if (record->parent >= header->service_count) return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+GattCache *binc_gatt_cache_load(const char *directory, const char *address) {
+    g_assert(directory != NULL);
+    g_assert(address != NULL);
+
+    char *filename = binc_gatt_cache_filename(directory, address);
+    GError *error = NULL;
+    GMappedFile *file = g_mapped_file_new(filename, FALSE, &error);
+    if (file == NULL) {
+        log_debug(TAG, "no cache for %s (%s)", address, error->message);
+        g_clear_error(&error);
+        g_free(filename);
+        return NULL;
+    }
+
+    GattCache *cache = g_new0(GattCache, 1);
+    cache->file = file;
+
+    const char *contents = g_mapped_file_get_contents(file);
+    gsize size = g_mapped_file_get_length(file);
+    if (contents != NULL && size >= sizeof(GattCacheHeader)) {
+        cache->header = (const GattCacheHeader *) contents;
+        cache->records = (const GattCacheRecord *) (contents + sizeof(GattCacheHeader));
+        guint64 record_count = (guint64) cache->header->service_count + cache->header->characteristic_count +
+                               cache->header->descriptor_count;
+        if (record_count * sizeof(GattCacheRecord) <= size - sizeof(GattCacheHeader)) {
+            cache->strings = (const char *) (cache->records + record_count);
+        }
+    }
+
+    if (cache->strings == NULL || !binc_gatt_cache_is_valid(cache, size)) {
+        log_error(TAG, "ignoring invalid cache file %s", filename);
+        binc_gatt_cache_free(cache);
+        g_free(filename);
+        return NULL;
+    }
+
+    g_free(filename);
+    return cache;
+}
+
+void binc_gatt_cache_free(GattCache *cache) {
+    g_assert(cache != NULL);
+
+    g_mapped_file_unref(cache->file);
+    cache->file = NULL;
+    cache->header = NULL;
+    cache->records = NULL;
+    cache->strings = NULL;
+    g_free(cache);
+}
+
+void binc_gatt_cache_foreach(const GattCache *cache, GattCacheEntryCallback callback, gpointer user_data) {
+    g_assert(cache != NULL);
+    g_assert(callback != NULL);
+
+    const GattCacheHeader *header = cache->header;
+    const GattCacheRecord *characteristics = cache->records + header->service_count;
+    const GattCacheRecord *descriptors = characteristics + header->characteristic_count;
+
+    for (guint i = 0; i < header->service_count; i++) {
+        const GattCacheRecord *record = &cache->records[i];
+        Uuid uuid = uuid_from_bytes(record->uuid);
+        callback(BINC_GATT_CACHE_SERVICE, cache->strings + record->path, NULL, &uuid,
+                 cache->strings + record->flags, user_data);
+    }
+
+    for (guint i = 0; i < header->characteristic_count; i++) {
+        const GattCacheRecord *record = &characteristics[i];
+        const GattCacheRecord *parent = &cache->records[record->parent];
+        Uuid uuid = uuid_from_bytes(record->uuid);
+        callback(BINC_GATT_CACHE_CHARACTERISTIC, cache->strings + record->path, cache->strings + parent->path,
+                 &uuid, cache->strings + record->flags, user_data);
+    }
+
+    for (guint i = 0; i < header->descriptor_count; i++) {
+        const GattCacheRecord *record = &descriptors[i];
+        const GattCacheRecord *parent = &characteristics[record->parent];
+        Uuid uuid = uuid_from_bytes(record->uuid);
+        callback(BINC_GATT_CACHE_DESCRIPTOR, cache->strings + record->path, cache->strings + parent->path,
+                 &uuid, cache->strings + record->flags, user_data);
+    }
+}
+
+const guint8 *binc_gatt_cache_get_db_hash(const GattCache *cache, guint *length) {
+    g_assert(cache != NULL);
+    g_assert(length != NULL);
+
+    *length = cache->header->db_hash_length;
+    return *length > 0 ? cache->header->db_hash : NULL;
+}
+
+static guint32 add_string(GByteArray *strings, const char *string) {
+    guint32 offset = strings->len;
+    g_byte_array_append(strings, (const guint8 *) string, (guint) strlen(string) + 1);
+    return offset;
+}
+
+static guint32 add_path(GByteArray *strings, const char *device_path, const char *path) {
+    size_t prefix_length = strlen(device_path);
+    g_assert(strncmp(path, device_path, prefix_length) == 0 && path[prefix_length] == '/');
+    return add_string(strings, path + prefix_length + 1);
+}
+
+static guint32 add_flags(GByteArray *strings, GList *flags) {
+    if (flags == NULL) return 0;
+
+    GString *joined = g_string_new(NULL);
+    for (GList *iterator = flags; iterator; iterator = iterator->next) {
+        if (joined->len > 0) {
+            g_string_append_c(joined, ',');
+        }
+        g_string_append(joined, (const char *) iterator->data);
+    }
+    guint32 offset = add_string(strings, joined->str);
+    g_string_free(joined, TRUE);
+    return offset;
+}
+
+static void add_record(GArray *records, guint32 path, guint32 parent, guint32 flags, const Uuid *uuid) {
+    GattCacheRecord record = {path, parent, flags, {0}};
+    uuid_to_bytes(uuid, record.uuid);
+    g_array_append_val(records, record);
+}
+
+gboolean binc_gatt_cache_save(const char *directory, const char *address, const char *device_path,
+                              GList *services, const GByteArray *db_hash) {
+    g_assert(directory != NULL);
+    g_assert(address != NULL);
+    g_assert(device_path != NULL);
+
+    GArray *service_records = g_array_new(FALSE, TRUE, sizeof(GattCacheRecord));
+    GArray *characteristic_records = g_array_new(FALSE, TRUE, sizeof(GattCacheRecord));
+    GArray *descriptor_records = g_array_new(FALSE, TRUE, sizeof(GattCacheRecord));
+    GByteArray *strings = g_byte_array_new();
+
+    // Offset 0 is the empty string, used for entries without flags
+    add_string(strings, "");
+
+    for (GList *iterator = services; iterator; iterator = iterator->next) {
+        Service *service = (Service *) iterator->data;
+        guint32 service_index = service_records->len;
+        add_record(service_records, add_path(strings, device_path, binc_service_get_path(service)), 0, 0,
+                   binc_service_get_uuid_value(service));
+
+        for (GList *char_iterator = binc_service_get_characteristics(service); char_iterator;
+             char_iterator = char_iterator->next) {
+            Characteristic *characteristic = (Characteristic *) char_iterator->data;
+            guint32 characteristic_index = characteristic_records->len;
+            add_record(characteristic_records,
+                       add_path(strings, device_path, binc_characteristic_get_path(characteristic)),
+                       service_index,
+                       add_flags(strings, binc_characteristic_get_flags(characteristic)),
+                       binc_characteristic_get_uuid_value(characteristic));
+
+            for (GList *desc_iterator = binc_characteristic_get_descriptors(characteristic); desc_iterator;
+                 desc_iterator = desc_iterator->next) {
+                Descriptor *descriptor = (Descriptor *) desc_iterator->data;
+                add_record(descriptor_records,
+                           add_path(strings, device_path, binc_descriptor_get_path(descriptor)),
+                           characteristic_index, 0, binc_descriptor_get_uuid_value(descriptor));
+            }
+        }
+    }
+
+    GattCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = GATT_CACHE_MAGIC;
+    header.version = GATT_CACHE_VERSION;
+    header.service_count = service_records->len;
+    header.characteristic_count = characteristic_records->len;
+    header.descriptor_count = descriptor_records->len;
+    header.strings_length = strings->len;
+    if (db_hash != NULL && db_hash->len <= GATT_CACHE_MAX_HASH_LENGTH) {
+        header.db_hash_length = db_hash->len;
+        memcpy(header.db_hash, db_hash->data, db_hash->len);
+    }
+
+    GByteArray *contents = g_byte_array_new();
+    g_byte_array_append(contents, (const guint8 *) &header, sizeof(header));
+    g_byte_array_append(contents, (const guint8 *) service_records->data,
+                        service_records->len * (guint) sizeof(GattCacheRecord));
+    g_byte_array_append(contents, (const guint8 *) characteristic_records->data,
+                        characteristic_records->len * (guint) sizeof(GattCacheRecord));
+    g_byte_array_append(contents, (const guint8 *) descriptor_records->data,
+                        descriptor_records->len * (guint) sizeof(GattCacheRecord));
+    g_byte_array_append(contents, strings->data, strings->len);
+
+    g_array_free(service_records, TRUE);
+    g_array_free(characteristic_records, TRUE);
+    g_array_free(descriptor_records, TRUE);
+    g_byte_array_free(strings, TRUE);
+
+    gboolean result = FALSE;
+    GError *error = NULL;
+    char *filename = binc_gatt_cache_filename(directory, address);
+    if (g_mkdir_with_parents(directory, 0700) != 0) {
+        log_error(TAG, "could not create cache directory %s", directory);
+    } else if (!g_file_set_contents(filename, (const gchar *) contents->data, contents->len, &error)) {
+        log_error(TAG, "could not write %s (%s)", filename, error->message);
+        g_clear_error(&error);
+    } else {
+        log_debug(TAG, "cached %d services of %s", header.service_count, address);
+        result = TRUE;
+    }
+
+    g_free(filename);
+    g_byte_array_free(contents, TRUE);
+    return result;
+}
+
+void binc_gatt_cache_remove(const char *directory, const char *address) {
+    g_assert(directory != NULL);
+    g_assert(address != NULL);
+
+    char *filename = binc_gatt_cache_filename(directory, address);
+    g_remove(filename);
+    g_free(filename);
+}
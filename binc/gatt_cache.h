@@ -0,0 +1,82 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_GATT_CACHE_H
+#define BINC_GATT_CACHE_H
+
+#include <glib.h>
+#include "forward_decl.h"
+#include "uuid.h"
+
+/*
+ * On-disk copy of a device's GATT tree so that it can be rebuilt without waiting for BlueZ. There is one file per
+ * device address. The file is a header followed by fixed size records for services, characteristics and descriptors
+ * and a string table, so it can be used straight from a memory mapping. Paths are stored relative to the device
+ * path so the cache survives moving the device to another adapter. The GATT Database Hash of the device is stored
+ * along with the tree when the device has one.
+ */
+
+typedef enum GattCacheEntryType {
+    BINC_GATT_CACHE_SERVICE = 0, BINC_GATT_CACHE_CHARACTERISTIC = 1, BINC_GATT_CACHE_DESCRIPTOR = 2
+} GattCacheEntryType;
+
+/*
+ * Called for every entry in the cache. Services come first, then characteristics and then descriptors, so the
+ * parent of an entry has always been visited before. Paths are relative to the device path and parent_path is
+ * NULL for services. The strings are only valid during the callback.
+ */
+typedef void (*GattCacheEntryCallback)(GattCacheEntryType type, const char *path, const char *parent_path,
+                                       const Uuid *uuid, const char *flags, gpointer user_data);
+
+/**
+ * Map the cache file of a device
+ *
+ * @return the cache or NULL if there is no valid cache file for address
+ */
+GattCache *binc_gatt_cache_load(const char *directory, const char *address);
+
+void binc_gatt_cache_free(GattCache *cache);
+
+void binc_gatt_cache_foreach(const GattCache *cache, GattCacheEntryCallback callback, gpointer user_data);
+
+/**
+ * Get the GATT Database Hash stored with the tree
+ *
+ * @return the hash or NULL if the device had no Database Hash characteristic
+ */
+const guint8 *binc_gatt_cache_get_db_hash(const GattCache *cache, guint *length);
+
+/**
+ * Write the GATT tree of a device to its cache file, replacing any previous file atomically
+ *
+ * @param device_path the path of the device, stripped from all object paths
+ * @param services the services of the device
+ * @param db_hash the value of the Database Hash characteristic or NULL
+ * @return TRUE if the file was written
+ */
+gboolean binc_gatt_cache_save(const char *directory, const char *address, const char *device_path,
+                              GList *services, const GByteArray *db_hash);
+
+void binc_gatt_cache_remove(const char *directory, const char *address);
+
+#endif //BINC_GATT_CACHE_H
@@ -43,6 +43,9 @@ static struct {
     LogEventCallback logCallback;
 } LogSettings = {TRUE, LOG_DEBUG, NULL, "", MAX_FILE_SIZE, MAX_LOGS, 0, NULL};
 
+// Guards the log file, adapters on worker threads may log concurrently
+G_LOCK_DEFINE_STATIC(log_file);
+
 static const char *log_level_names[] = {
         [LOG_DEBUG] = "DEBUG",
         [LOG_INFO] = "INFO",
@@ -54,6 +57,10 @@ void log_set_level(LogLevel level) {
     LogSettings.level = level;
 }
 
+gboolean log_is_enabled(LogLevel level) {
+    return LogSettings.enabled && LogSettings.level <= level;
+}
+
 void log_set_handler(LogEventCallback callback) {
     LogSettings.logCallback = callback;
 }
@@ -168,12 +175,15 @@ static void rotate_log_file_if_needed(void) {
 }
 
 void log_log_at_level(LogLevel level, const char *tag, const char *format, ...) {
+    G_LOCK(log_file);
+
     // Init fout to stdout if needed
     if (LogSettings.fout == NULL && LogSettings.logCallback == NULL) {
         LogSettings.fout = stdout;
     }
 
     rotate_log_file_if_needed();
+    G_UNLOCK(log_file);
 
     if (LogSettings.level <= level && LogSettings.enabled) {
         char buf[BUFFER_SIZE];
@@ -183,7 +193,9 @@ void log_log_at_level(LogLevel level, const char *tag, const char *format, ...)
         if (LogSettings.logCallback) {
             LogSettings.logCallback(level, tag, buf);
         } else {
+            G_LOCK(log_file);
             log_log(tag, log_level_names[level], buf);
+            G_UNLOCK(log_file);
         }
         va_end(arg);
     }
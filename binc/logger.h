@@ -43,6 +43,11 @@ void log_log_at_level(LogLevel level, const char* tag, const char *format, ...);
 
 void log_set_level(LogLevel level);
 
+/**
+ * Check if a message at this level would be logged. Use it to skip formatting work for messages that are dropped.
+ */
+gboolean log_is_enabled(LogLevel level);
+
 void log_set_filename(const char* filename, unsigned long max_size, unsigned int max_files);
 
 typedef void (*LogEventCallback)(LogLevel level, const char *tag, const char *message);
@@ -0,0 +1,244 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include "long_value.h"
+#include "logger.h"
+#include "utility.h"
+
+static const char *const TAG = "LongValue";
+static const char *const BLUEZ_DBUS = "org.bluez";
+static const char *const METHOD_READ_VALUE = "ReadValue";
+static const char *const METHOD_WRITE_VALUE = "WriteValue";
+static const char *const BLUEZ_ERROR_INVALID_OFFSET = "org.bluez.Error.InvalidOffset";
+
+typedef struct binc_long_value {
+    GDBusConnection *connection; // Borrowed
+    const char *path; // Owned
+    const char *interface; // Borrowed
+    const char *write_type; // Borrowed
+    GCancellable *cancellable; // Owned
+    guint mtu;
+    guint offset;
+    GByteArray *value; // Owned
+    LongValueCallback callback;
+    gpointer user_data; // Borrowed
+} LongValue;
+
+static LongValue *binc_long_value_create(GDBusConnection *connection, const char *path, const char *interface,
+                                         GCancellable *cancellable, LongValueCallback callback,
+                                         gpointer user_data) {
+    LongValue *longValue = g_new0(LongValue, 1);
+    longValue->connection = connection;
+    longValue->path = g_strdup(path);
+    longValue->interface = interface;
+    longValue->cancellable = cancellable != NULL ? g_object_ref(cancellable) : NULL;
+    longValue->callback = callback;
+    longValue->user_data = user_data;
+    return longValue;
+}
+
+static void binc_long_value_complete(LongValue *longValue, const GError *error) {
+    if (longValue->callback != NULL) {
+        longValue->callback(longValue->value, error, longValue->user_data);
+    }
+
+    g_byte_array_free(longValue->value, TRUE);
+    if (longValue->cancellable != NULL) {
+        g_object_unref(longValue->cancellable);
+    }
+    g_free((char *) longValue->path);
+    g_free(longValue);
+}
+
+static gboolean is_invalid_offset_error(const GError *error) {
+    char *remote_error = g_dbus_error_get_remote_error(error);
+    gboolean result = remote_error != NULL && g_str_equal(remote_error, BLUEZ_ERROR_INVALID_OFFSET);
+    g_free(remote_error);
+    return result;
+}
+
+static GVariant *binc_long_value_options(guint offset, const char *type) {
+    GVariantBuilder *builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(builder, "{sv}", "offset", g_variant_new_uint16((guint16) offset));
+    if (type != NULL) {
+        g_variant_builder_add(builder, "{sv}", "type", g_variant_new_string(type));
+    }
+    GVariant *options = g_variant_builder_end(builder);
+    g_variant_builder_unref(builder);
+    return options;
+}
+
+static void binc_long_value_read_next(LongValue *longValue);
+
+static void binc_internal_long_read_cb(__attribute__((unused)) GObject *source_object,
+                                       GAsyncResult *res,
+                                       gpointer user_data) {
+    LongValue *longValue = (LongValue *) user_data;
+    g_assert(longValue != NULL);
+
+    GError *error = NULL;
+    GVariant *value = g_dbus_connection_call_finish(longValue->connection, res, &error);
+    if (value == NULL) {
+        // Reading past the end of a value whose length is an exact multiple of the chunk size
+        if (longValue->offset > 0 && is_invalid_offset_error(error)) {
+            g_clear_error(&error);
+            binc_long_value_complete(longValue, NULL);
+            return;
+        }
+
+        log_debug(TAG, "failed to call '%s' at offset %u (error %d: %s)", METHOD_READ_VALUE, longValue->offset,
+                  error->code, error->message);
+        binc_long_value_complete(longValue, error);
+        g_clear_error(&error);
+        return;
+    }
+
+    GVariant *innerArray = g_variant_get_child_value(value, 0);
+    gsize length = 0;
+    const guint8 *data = g_variant_get_fixed_array(innerArray, &length, sizeof(guint8));
+    g_byte_array_append(longValue->value, data, (guint) length);
+    g_variant_unref(innerArray);
+    g_variant_unref(value);
+
+    // A chunk that filled a whole ATT payload (or the largest value BlueZ assembles itself) may have a tail
+    longValue->offset += (guint) length;
+    gboolean more = length > 0 && (length == longValue->mtu - 1 || length >= BINC_MAX_ATTRIBUTE_LENGTH);
+    if (more && longValue->offset <= G_MAXUINT16) {
+        binc_long_value_read_next(longValue);
+    } else {
+        binc_long_value_complete(longValue, NULL);
+    }
+}
+
+static void binc_long_value_read_next(LongValue *longValue) {
+    g_dbus_connection_call(longValue->connection,
+                           BLUEZ_DBUS,
+                           longValue->path,
+                           longValue->interface,
+                           METHOD_READ_VALUE,
+                           g_variant_new("(@a{sv})", binc_long_value_options(longValue->offset, NULL)),
+                           G_VARIANT_TYPE("(ay)"),
+                           G_DBUS_CALL_FLAGS_NONE,
+                           -1,
+                           longValue->cancellable,
+                           (GAsyncReadyCallback) binc_internal_long_read_cb,
+                           longValue);
+}
+
+void binc_long_value_read(GDBusConnection *connection, const char *path, const char *interface, guint mtu,
+                          guint expected_length, GCancellable *cancellable, LongValueCallback callback,
+                          gpointer user_data) {
+    g_assert(connection != NULL);
+    g_assert(path != NULL);
+    g_assert(interface != NULL);
+    g_assert(mtu > 1);
+
+    LongValue *longValue = binc_long_value_create(connection, path, interface, cancellable, callback, user_data);
+    longValue->mtu = mtu;
+    longValue->value = g_byte_array_sized_new(expected_length > 0 ? expected_length : mtu);
+    binc_long_value_read_next(longValue);
+}
+
+static void binc_long_value_write_next(LongValue *longValue);
+
+static void binc_internal_long_write_cb(__attribute__((unused)) GObject *source_object,
+                                        GAsyncResult *res,
+                                        gpointer user_data) {
+    LongValue *longValue = (LongValue *) user_data;
+    g_assert(longValue != NULL);
+
+    GError *error = NULL;
+    GVariant *value = g_dbus_connection_call_finish(longValue->connection, res, &error);
+    if (value != NULL) {
+        g_variant_unref(value);
+    }
+
+    if (error != NULL) {
+        log_debug(TAG, "failed to call '%s' at offset %u (error %d: %s)", METHOD_WRITE_VALUE, longValue->offset,
+                  error->code, error->message);
+        binc_long_value_complete(longValue, error);
+        g_clear_error(&error);
+        return;
+    }
+
+    longValue->offset += MIN(longValue->value->len - longValue->offset, BINC_MAX_ATTRIBUTE_LENGTH);
+    if (longValue->offset < longValue->value->len) {
+        binc_long_value_write_next(longValue);
+    } else {
+        binc_long_value_complete(longValue, NULL);
+    }
+}
+
+static void binc_long_value_write_next(LongValue *longValue) {
+    // BlueZ turns every chunk into a prepared write itself, so we only have to walk the offsets
+    guint chunk_length = MIN(longValue->value->len - longValue->offset, BINC_MAX_ATTRIBUTE_LENGTH);
+    GVariant *chunk = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, longValue->value->data + longValue->offset,
+                                                chunk_length, sizeof(guint8));
+
+    g_dbus_connection_call(longValue->connection,
+                           BLUEZ_DBUS,
+                           longValue->path,
+                           longValue->interface,
+                           METHOD_WRITE_VALUE,
+                           g_variant_new("(@ay@a{sv})", chunk, binc_long_value_options(longValue->offset, longValue->write_type)),
+                           NULL,
+                           G_DBUS_CALL_FLAGS_NONE,
+                           -1,
+                           longValue->cancellable,
+                           (GAsyncReadyCallback) binc_internal_long_write_cb,
+                           longValue);
+}
+
+static gboolean binc_long_value_fail_too_long(gpointer user_data) {
+    LongValue *longValue = (LongValue *) user_data;
+    GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                                "value of %u bytes is longer than the largest offset of %u", longValue->value->len,
+                                (guint) G_MAXUINT16);
+    binc_long_value_complete(longValue, error);
+    g_error_free(error);
+    return FALSE;
+}
+
+void binc_long_value_write(GDBusConnection *connection, const char *path, const char *interface,
+                           const GByteArray *byteArray, const char *write_type, GCancellable *cancellable,
+                           LongValueCallback callback, gpointer user_data) {
+    g_assert(connection != NULL);
+    g_assert(path != NULL);
+    g_assert(interface != NULL);
+    g_assert(byteArray != NULL);
+    g_assert(byteArray->len > 0);
+
+    LongValue *longValue = binc_long_value_create(connection, path, interface, cancellable, callback, user_data);
+    longValue->write_type = write_type;
+    longValue->value = g_byte_array_sized_new(byteArray->len);
+    g_byte_array_append(longValue->value, byteArray->data, byteArray->len);
+
+    // Offsets are 16 bits, so the tail of a longer value could never be written. Failed from the main loop, like
+    // any other error, so callers never get reentered.
+    if (byteArray->len > G_MAXUINT16) {
+        log_debug(TAG, "value of %u bytes is too long to write", byteArray->len);
+        binc_idle_add(binc_long_value_fail_too_long, longValue);
+        return;
+    }
+    binc_long_value_write_next(longValue);
+}
@@ -0,0 +1,47 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_LONG_VALUE_H
+#define BINC_LONG_VALUE_H
+
+#include <gio/gio.h>
+
+/*
+ * Engine for values that don't fit in a single ATT payload. Reads are repeated at increasing offsets until a
+ * short chunk comes back and writes are split into chunks sent at increasing offsets. In both cases the
+ * callback is called exactly once with the complete value.
+ */
+
+#define BINC_MAX_ATTRIBUTE_LENGTH 512
+
+typedef void (*LongValueCallback)(const GByteArray *byteArray, const GError *error, gpointer user_data);
+
+void binc_long_value_read(GDBusConnection *connection, const char *path, const char *interface, guint mtu,
+                          guint expected_length, GCancellable *cancellable, LongValueCallback callback,
+                          gpointer user_data);
+
+void binc_long_value_write(GDBusConnection *connection, const char *path, const char *interface,
+                           const GByteArray *byteArray, const char *write_type, GCancellable *cancellable,
+                           LongValueCallback callback, gpointer user_data);
+
+#endif //BINC_LONG_VALUE_H
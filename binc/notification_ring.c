@@ -0,0 +1,134 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include "notification_ring.h"
+
+typedef struct binc_notification_slot {
+    gint64 timestamp;
+    guint length;
+    gboolean truncated;
+} NotificationSlot;
+
+struct binc_notification_ring {
+    NotificationSlot *slots; // Owned
+    guint8 *data; // Owned
+    guint capacity;
+    guint max_length;
+
+    // Free running counters, the slot index is counter & (capacity - 1)
+    volatile gint head; // Written by the producer only
+    volatile gint tail; // Written by the consumer only
+    volatile gint overflow_count;
+    volatile gint truncated_count;
+};
+
+NotificationRing *binc_notification_ring_create(guint capacity, guint max_length) {
+    g_assert(capacity > 0);
+    g_assert(capacity <= G_MAXINT / 2);
+    g_assert(max_length > 0);
+
+    guint rounded = 1;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+
+    NotificationRing *ring = g_new0(NotificationRing, 1);
+    ring->capacity = rounded;
+    ring->max_length = max_length;
+    ring->slots = g_new0(NotificationSlot, rounded);
+    ring->data = g_malloc0((gsize) rounded * max_length);
+    return ring;
+}
+
+void binc_notification_ring_free(NotificationRing *ring) {
+    g_assert(ring != NULL);
+
+    g_free(ring->slots);
+    ring->slots = NULL;
+    g_free(ring->data);
+    ring->data = NULL;
+    g_free(ring);
+}
+
+gboolean binc_notification_ring_push(NotificationRing *ring, const GByteArray *byteArray, gint64 timestamp) {
+    g_assert(ring != NULL);
+    g_assert(byteArray != NULL);
+
+    guint head = (guint) ring->head;
+    guint tail = (guint) g_atomic_int_get(&ring->tail);
+    if (head - tail >= ring->capacity) {
+        g_atomic_int_inc(&ring->overflow_count);
+        return FALSE;
+    }
+
+    guint index = head & (ring->capacity - 1);
+    NotificationSlot *slot = &ring->slots[index];
+    slot->timestamp = timestamp;
+    slot->truncated = byteArray->len > ring->max_length;
+    slot->length = MIN(byteArray->len, ring->max_length);
+    if (slot->truncated) {
+        g_atomic_int_inc(&ring->truncated_count);
+    }
+    memcpy(ring->data + (gsize) index * ring->max_length, byteArray->data, slot->length);
+
+    // Publish the slot only after it has been filled
+    g_atomic_int_set(&ring->head, (gint) (head + 1));
+    return TRUE;
+}
+
+guint binc_notification_ring_peek(NotificationRing *ring, NotificationEntry *entries, guint max_entries) {
+    g_assert(ring != NULL);
+    g_assert(entries != NULL);
+
+    guint head = (guint) g_atomic_int_get(&ring->head);
+    guint tail = (guint) ring->tail;
+    guint available = MIN(head - tail, max_entries);
+    for (guint i = 0; i < available; i++) {
+        guint index = (tail + i) & (ring->capacity - 1);
+        entries[i].timestamp = ring->slots[index].timestamp;
+        entries[i].length = ring->slots[index].length;
+        entries[i].truncated = ring->slots[index].truncated;
+        entries[i].data = ring->data + (gsize) index * ring->max_length;
+    }
+    return available;
+}
+
+void binc_notification_ring_consume(NotificationRing *ring, guint count) {
+    g_assert(ring != NULL);
+
+    guint head = (guint) g_atomic_int_get(&ring->head);
+    guint tail = (guint) ring->tail;
+    g_assert(count <= head - tail);
+    g_atomic_int_set(&ring->tail, (gint) (tail + count));
+}
+
+guint binc_notification_ring_get_overflow_count(const NotificationRing *ring) {
+    g_assert(ring != NULL);
+    return (guint) g_atomic_int_get(&ring->overflow_count);
+}
+
+guint binc_notification_ring_get_truncated_count(const NotificationRing *ring) {
+    g_assert(ring != NULL);
+    return (guint) g_atomic_int_get(&ring->truncated_count);
+}
@@ -0,0 +1,89 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_NOTIFICATION_RING_H
+#define BINC_NOTIFICATION_RING_H
+
+#include <glib.h>
+#include "forward_decl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bounded single-producer/single-consumer buffer for notifications. The GLib main loop is the only producer and
+ * one consumer thread drains it, so no locks are needed. Notifications that don't fit are dropped and counted.
+ * Payloads longer than the ring's max_length are cut off, flagged on their entry and counted.
+ */
+
+typedef struct binc_notification_entry {
+    gint64 timestamp; // Wall clock time of reception in microseconds, see g_get_real_time()
+    const guint8 *data; // Borrowed, valid until binc_notification_ring_consume()
+    guint length;
+    gboolean truncated; // The payload was longer than max_length, only the first max_length bytes were stored
+} NotificationEntry;
+
+/**
+ * Create a notification ring
+ *
+ * @param capacity number of notifications the ring can hold, rounded up to a power of 2
+ * @param max_length largest payload that can be stored, longer payloads are truncated and flagged
+ * @return the ring, free with binc_notification_ring_free()
+ */
+NotificationRing *binc_notification_ring_create(guint capacity, guint max_length);
+
+void binc_notification_ring_free(NotificationRing *ring);
+
+/**
+ * Store a notification. Only to be called from the producer side.
+ *
+ * @return TRUE if stored, FALSE if the ring was full and the notification was dropped
+ */
+gboolean binc_notification_ring_push(NotificationRing *ring, const GByteArray *byteArray, gint64 timestamp);
+
+/**
+ * Peek at up to max_entries notifications without copying them. Only to be called from the consumer thread.
+ * The entries stay valid until they are released with binc_notification_ring_consume().
+ *
+ * @return the number of entries filled in
+ */
+guint binc_notification_ring_peek(NotificationRing *ring, NotificationEntry *entries, guint max_entries);
+
+/**
+ * Release the oldest count notifications so the producer can reuse their slots
+ */
+void binc_notification_ring_consume(NotificationRing *ring, guint count);
+
+guint binc_notification_ring_get_overflow_count(const NotificationRing *ring);
+
+/**
+ * Number of notifications that were stored truncated because they were longer than max_length
+ */
+guint binc_notification_ring_get_truncated_count(const NotificationRing *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BINC_NOTIFICATION_RING_H
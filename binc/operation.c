@@ -0,0 +1,592 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include "operation_internal.h"
+#include "characteristic_internal.h"
+#include "descriptor_internal.h"
+#include "logger.h"
+#include "utility.h"
+
+static const char *const TAG = "Operation";
+static const char *const BLUEZ_ERROR_IN_PROGRESS = "org.bluez.Error.InProgress";
+static const char *const DBUS_ERROR_UNKNOWN_OBJECT = "org.freedesktop.DBus.Error.UnknownObject";
+
+#define DEFAULT_MAX_IN_FLIGHT 4
+#define MAX_ATTEMPTS 3
+#define RETRY_DELAY_MS 50
+
+static const char *operation_type_names[] = {
+        [BINC_OPERATION_READ_CHAR] = "READ_CHAR",
+        [BINC_OPERATION_READ_CHAR_LONG] = "READ_CHAR_LONG",
+        [BINC_OPERATION_WRITE_CHAR] = "WRITE_CHAR",
+        [BINC_OPERATION_WRITE_CHAR_LONG] = "WRITE_CHAR_LONG",
+        [BINC_OPERATION_START_NOTIFY] = "START_NOTIFY",
+        [BINC_OPERATION_STOP_NOTIFY] = "STOP_NOTIFY",
+        [BINC_OPERATION_READ_DESC] = "READ_DESC",
+        [BINC_OPERATION_WRITE_DESC] = "WRITE_DESC",
+        [BINC_OPERATION_ACQUIRE_NOTIFY] = "ACQUIRE_NOTIFY",
+        [BINC_OPERATION_ACQUIRE_WRITE] = "ACQUIRE_WRITE"
+};
+
+struct binc_operation {
+    OperationType type;
+    gpointer target; // Borrowed
+    GByteArray *value; // Owned
+    WriteType write_type;
+    guint expected_length;
+    OperationPriority priority;
+    guint attempts;
+    guint retry_timeout;
+    OperationCallback callback;
+    gpointer user_data; // Borrowed
+    OperationQueue *queue; // Borrowed, NULL once dropped
+    gboolean in_flight;
+    gboolean call_pending; // A D-Bus call for this operation has not returned yet
+    gboolean waiting_for_objects; // Its object was unknown, waiting for BlueZ to export the GATT objects
+    gboolean dropped;
+    GCancellable *cancellable; // Owned
+    GCancellable *user_cancellable; // Owned
+    gulong user_cancelled_handler;
+    guint timeout_ms;
+    guint deadline_timeout;
+    gboolean timed_out;
+    guint abort_idle;
+};
+
+struct binc_operation_queue {
+    GQueue lanes[BINC_PRIORITY_LANES];
+    GQueue in_flight; // Owned
+    guint max_in_flight;
+    gboolean objects_ready;
+    guint pump_idle;
+};
+
+Operation *binc_operation_create(OperationType type, gpointer target, OperationPriority priority) {
+    g_assert(target != NULL);
+    g_assert(priority < BINC_PRIORITY_LANES);
+
+    Operation *operation = g_new0(Operation, 1);
+    operation->type = type;
+    operation->target = target;
+    operation->priority = priority;
+    operation->cancellable = g_cancellable_new();
+    return operation;
+}
+
+void binc_operation_free(Operation *operation) {
+    g_assert(operation != NULL);
+
+    if (operation->retry_timeout != 0) {
+        binc_source_remove(operation->retry_timeout);
+        operation->retry_timeout = 0;
+    }
+
+    if (operation->deadline_timeout != 0) {
+        binc_source_remove(operation->deadline_timeout);
+        operation->deadline_timeout = 0;
+    }
+
+    if (operation->abort_idle != 0) {
+        binc_source_remove(operation->abort_idle);
+        operation->abort_idle = 0;
+    }
+
+    if (operation->user_cancellable != NULL) {
+        g_cancellable_disconnect(operation->user_cancellable, operation->user_cancelled_handler);
+        g_object_unref(operation->user_cancellable);
+        operation->user_cancellable = NULL;
+    }
+
+    g_object_unref(operation->cancellable);
+    operation->cancellable = NULL;
+
+    if (operation->value != NULL) {
+        g_byte_array_free(operation->value, TRUE);
+        operation->value = NULL;
+    }
+
+    operation->target = NULL;
+    operation->queue = NULL;
+    g_free(operation);
+}
+
+void binc_operation_set_value(Operation *operation, const GByteArray *byteArray, WriteType writeType) {
+    g_assert(operation != NULL);
+    g_assert(byteArray != NULL);
+
+    if (operation->value != NULL) {
+        g_byte_array_free(operation->value, TRUE);
+    }
+    operation->value = g_byte_array_sized_new(byteArray->len);
+    g_byte_array_append(operation->value, byteArray->data, byteArray->len);
+    operation->write_type = writeType;
+}
+
+void binc_operation_set_expected_length(Operation *operation, guint expected_length) {
+    g_assert(operation != NULL);
+    operation->expected_length = expected_length;
+}
+
+void binc_operation_set_callback(Operation *operation, OperationCallback callback, gpointer user_data) {
+    g_assert(operation != NULL);
+    operation->callback = callback;
+    operation->user_data = user_data;
+}
+
+gpointer binc_operation_get_target(const Operation *operation) {
+    g_assert(operation != NULL);
+    return operation->target;
+}
+
+GCancellable *binc_operation_get_cancellable(const Operation *operation) {
+    g_assert(operation != NULL);
+    return operation->cancellable;
+}
+
+void binc_operation_set_timeout(Operation *operation, guint timeout_ms) {
+    g_assert(operation != NULL);
+    g_assert(operation->queue == NULL);
+    operation->timeout_ms = timeout_ms;
+}
+
+void binc_operation_set_cancellable(Operation *operation, GCancellable *cancellable) {
+    g_assert(operation != NULL);
+    g_assert(operation->queue == NULL);
+    g_assert(operation->user_cancellable == NULL);
+
+    if (cancellable != NULL) {
+        operation->user_cancellable = g_object_ref(cancellable);
+    }
+}
+
+static void binc_operation_execute(Operation *operation) {
+    operation->attempts++;
+    operation->call_pending = TRUE;
+    log_debug(TAG, "executing %s (attempt %d)", operation_type_names[operation->type], operation->attempts);
+
+    // The operation itself is passed along with the call, so its reply can never complete another operation
+    switch (operation->type) {
+        case BINC_OPERATION_READ_CHAR:
+            binc_characteristic_read_operation((Characteristic *) operation->target, operation);
+            break;
+        case BINC_OPERATION_READ_CHAR_LONG:
+            binc_characteristic_read_long_operation((Characteristic *) operation->target, operation->expected_length,
+                                                    operation);
+            break;
+        case BINC_OPERATION_WRITE_CHAR:
+            binc_characteristic_write_operation((Characteristic *) operation->target, operation->value,
+                                                operation->write_type, operation);
+            break;
+        case BINC_OPERATION_WRITE_CHAR_LONG:
+            binc_characteristic_write_long_operation((Characteristic *) operation->target, operation->value,
+                                                     operation);
+            break;
+        case BINC_OPERATION_START_NOTIFY:
+            binc_characteristic_start_notify_operation((Characteristic *) operation->target, operation);
+            break;
+        case BINC_OPERATION_STOP_NOTIFY:
+            binc_characteristic_stop_notify_operation((Characteristic *) operation->target, operation);
+            break;
+        case BINC_OPERATION_READ_DESC:
+            binc_descriptor_read_operation((Descriptor *) operation->target, operation);
+            break;
+        case BINC_OPERATION_WRITE_DESC:
+            binc_descriptor_write_operation((Descriptor *) operation->target, operation->value, operation);
+            break;
+        case BINC_OPERATION_ACQUIRE_NOTIFY:
+            binc_characteristic_acquire_notify_operation((Characteristic *) operation->target, operation);
+            break;
+        case BINC_OPERATION_ACQUIRE_WRITE:
+            binc_characteristic_acquire_write_operation((Characteristic *) operation->target, operation);
+            break;
+    }
+}
+
+OperationQueue *binc_operation_queue_create(void) {
+    OperationQueue *queue = g_new0(OperationQueue, 1);
+    for (guint i = 0; i < BINC_PRIORITY_LANES; i++) {
+        g_queue_init(&queue->lanes[i]);
+    }
+    g_queue_init(&queue->in_flight);
+    queue->max_in_flight = DEFAULT_MAX_IN_FLIGHT;
+    queue->objects_ready = TRUE;
+    return queue;
+}
+
+/*
+ * Let go of a dropped operation. One whose call is still running at BlueZ is cancelled and stays around until the
+ * reply comes in, see binc_operation_complete(), because the reply refers to it.
+ */
+static void binc_operation_release(Operation *operation) {
+    operation->queue = NULL;
+    if (!operation->call_pending) {
+        binc_operation_free(operation);
+        return;
+    }
+
+    if (operation->deadline_timeout != 0) {
+        binc_source_remove(operation->deadline_timeout);
+        operation->deadline_timeout = 0;
+    }
+    if (operation->abort_idle != 0) {
+        binc_source_remove(operation->abort_idle);
+        operation->abort_idle = 0;
+    }
+    if (operation->user_cancellable != NULL) {
+        g_cancellable_disconnect(operation->user_cancellable, operation->user_cancelled_handler);
+        g_object_unref(operation->user_cancellable);
+        operation->user_cancellable = NULL;
+    }
+    g_cancellable_cancel(operation->cancellable);
+}
+
+static void binc_operation_queue_drop(GList *dropped, gboolean notify) {
+    if (dropped == NULL) return;
+
+    log_debug(TAG, "dropping %d operations", g_list_length(dropped));
+    for (GList *iterator = dropped; iterator; iterator = iterator->next) {
+        ((Operation *) iterator->data)->dropped = TRUE;
+    }
+
+    if (notify) {
+        GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED, "operation cancelled");
+        for (GList *iterator = dropped; iterator; iterator = iterator->next) {
+            Operation *operation = (Operation *) iterator->data;
+            if (operation->callback != NULL) {
+                operation->callback(operation, NULL, error, operation->user_data);
+            }
+        }
+        g_error_free(error);
+    }
+    g_list_free_full(dropped, (GDestroyNotify) binc_operation_release);
+}
+
+static GList *binc_operation_queue_detach_all(OperationQueue *queue) {
+    GList *dropped = queue->in_flight.head;
+    g_queue_init(&queue->in_flight);
+    for (guint i = 0; i < BINC_PRIORITY_LANES; i++) {
+        dropped = g_list_concat(dropped, queue->lanes[i].head);
+        g_queue_init(&queue->lanes[i]);
+    }
+    return dropped;
+}
+
+void binc_operation_queue_clear(OperationQueue *queue) {
+    g_assert(queue != NULL);
+
+    // Detach everything first, callbacks may queue new operations
+    binc_operation_queue_drop(binc_operation_queue_detach_all(queue), TRUE);
+}
+
+void binc_operation_queue_free(OperationQueue *queue) {
+    g_assert(queue != NULL);
+
+    if (queue->pump_idle != 0) {
+        binc_source_remove(queue->pump_idle);
+        queue->pump_idle = 0;
+    }
+
+    binc_operation_queue_drop(binc_operation_queue_detach_all(queue), FALSE);
+    g_free(queue);
+}
+
+static gboolean binc_operation_queue_is_busy(const OperationQueue *queue, gconstpointer target) {
+    for (GList *iterator = queue->in_flight.head; iterator; iterator = iterator->next) {
+        Operation *operation = (Operation *) iterator->data;
+        if (operation->target == target) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static Operation *binc_operation_queue_next(OperationQueue *queue) {
+    for (guint i = 0; i < BINC_PRIORITY_LANES; i++) {
+        for (GList *iterator = queue->lanes[i].head; iterator; iterator = iterator->next) {
+            Operation *operation = (Operation *) iterator->data;
+
+            // Operations on the same target must not overlap, BlueZ would fail them with InProgress
+            if (!binc_operation_queue_is_busy(queue, operation->target)) {
+                g_queue_delete_link(&queue->lanes[i], iterator);
+                return operation;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void binc_operation_queue_pump(OperationQueue *queue) {
+    Operation *operation = NULL;
+    while (queue->in_flight.length < queue->max_in_flight &&
+           (operation = binc_operation_queue_next(queue)) != NULL) {
+        g_queue_push_tail(&queue->in_flight, operation);
+        operation->in_flight = TRUE;
+        binc_operation_execute(operation);
+    }
+}
+
+static gboolean binc_operation_queue_pump_idle(gpointer user_data) {
+    OperationQueue *queue = (OperationQueue *) user_data;
+    queue->pump_idle = 0;
+    binc_operation_queue_pump(queue);
+    return FALSE;
+}
+
+/*
+ * Pump from the main loop, so it runs after the callbacks that are about to be called. Those may free the queue, which
+ * removes the idle source again.
+ */
+static void binc_operation_queue_schedule_pump(OperationQueue *queue) {
+    if (queue->pump_idle == 0) {
+        queue->pump_idle = binc_idle_add(binc_operation_queue_pump_idle, queue);
+    }
+}
+
+static gboolean binc_operation_queue_finish(OperationQueue *queue, Operation *operation, const GByteArray *byteArray,
+                                            const GError *error) {
+    binc_operation_queue_schedule_pump(queue);
+    gboolean consumed = operation->callback != NULL;
+    if (consumed) {
+        operation->callback(operation, byteArray, error, operation->user_data);
+    }
+    binc_operation_free(operation);
+    return consumed;
+}
+
+static GError *binc_operation_abort_error(const Operation *operation) {
+    if (operation->timed_out) {
+        return g_error_new(G_IO_ERROR, G_IO_ERROR_TIMED_OUT, "operation timed out after %d ms",
+                           operation->timeout_ms);
+    }
+    return g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED, "operation cancelled");
+}
+
+static gboolean binc_operation_finish_aborted(gpointer user_data) {
+    Operation *operation = (Operation *) user_data;
+    OperationQueue *queue = operation->queue;
+    operation->abort_idle = 0;
+
+    // An operation that is running at BlueZ finishes when its cancelled call returns
+    if (operation->call_pending) return FALSE;
+
+    if (operation->in_flight) {
+        if (operation->retry_timeout != 0) {
+            binc_source_remove(operation->retry_timeout);
+            operation->retry_timeout = 0;
+        }
+        operation->waiting_for_objects = FALSE;
+        g_queue_remove(&queue->in_flight, operation);
+    } else {
+        g_queue_remove(&queue->lanes[operation->priority], operation);
+    }
+
+    GError *error = binc_operation_abort_error(operation);
+    binc_operation_queue_finish(queue, operation, NULL, error);
+    g_error_free(error);
+    return FALSE;
+}
+
+static void binc_operation_abort(Operation *operation) {
+    if (operation->dropped) return;
+    g_assert(operation->queue != NULL);
+
+    log_debug(TAG, "aborting %s", operation_type_names[operation->type]);
+    g_cancellable_cancel(operation->cancellable);
+
+    // Operations that are not running at BlueZ are finished from the main loop so callers never get reentered
+    if (!operation->call_pending && operation->abort_idle == 0) {
+        operation->abort_idle = binc_idle_add(binc_operation_finish_aborted, operation);
+    }
+}
+
+static gboolean binc_operation_deadline_expired(gpointer user_data) {
+    Operation *operation = (Operation *) user_data;
+    operation->deadline_timeout = 0;
+    operation->timed_out = TRUE;
+    binc_operation_abort(operation);
+    return FALSE;
+}
+
+static void binc_operation_user_cancelled(GCancellable *cancellable, gpointer user_data) {
+    binc_operation_abort((Operation *) user_data);
+}
+
+void binc_operation_cancel(Operation *operation) {
+    g_assert(operation != NULL);
+    binc_operation_abort(operation);
+}
+
+void binc_operation_queue_enqueue(OperationQueue *queue, Operation *operation) {
+    g_assert(queue != NULL);
+    g_assert(operation != NULL);
+
+    operation->queue = queue;
+    g_queue_push_tail(&queue->lanes[operation->priority], operation);
+
+    if (operation->timeout_ms > 0) {
+        operation->deadline_timeout = binc_timeout_add(operation->timeout_ms, binc_operation_deadline_expired,
+                                                       operation);
+    }
+
+    // Connecting calls the handler right away if the cancellable was already cancelled
+    if (operation->user_cancellable != NULL) {
+        operation->user_cancelled_handler = g_cancellable_connect(operation->user_cancellable,
+                                                                  G_CALLBACK(binc_operation_user_cancelled),
+                                                                  operation, NULL);
+    }
+
+    binc_operation_queue_pump(queue);
+}
+
+static gboolean binc_operation_retry(gpointer user_data) {
+    Operation *operation = (Operation *) user_data;
+    operation->retry_timeout = 0;
+    binc_operation_execute(operation);
+    return FALSE;
+}
+
+static gboolean is_remote_error(const GError *error, const char *name) {
+    if (error == NULL) return FALSE;
+
+    char *remote_error = g_dbus_error_get_remote_error(error);
+    gboolean result = remote_error != NULL && g_str_equal(remote_error, name);
+    g_free(remote_error);
+    return result;
+}
+
+static gboolean is_transient_error(const GError *error) {
+    return is_remote_error(error, BLUEZ_ERROR_IN_PROGRESS) || is_remote_error(error, DBUS_ERROR_UNKNOWN_OBJECT);
+}
+
+gboolean binc_operation_complete(Operation *operation, const GByteArray *byteArray, const GError *error) {
+    g_assert(operation != NULL);
+    g_assert(operation->call_pending);
+
+    operation->call_pending = FALSE;
+
+    // Dropped while its call was running, the target may be gone already
+    if (operation->dropped) {
+        log_debug(TAG, "ignoring reply of dropped %s", operation_type_names[operation->type]);
+        binc_operation_free(operation);
+        return TRUE;
+    }
+
+    OperationQueue *queue = operation->queue;
+
+    // Objects restored from the GATT cache may take BlueZ seconds to export after reconnecting
+    if (!queue->objects_ready && is_remote_error(error, DBUS_ERROR_UNKNOWN_OBJECT) &&
+        !g_cancellable_is_cancelled(operation->cancellable)) {
+        log_debug(TAG, "%s waits for its object to be exported", operation_type_names[operation->type]);
+        operation->waiting_for_objects = TRUE;
+        return TRUE;
+    }
+
+    if (is_transient_error(error) && operation->attempts < MAX_ATTEMPTS &&
+        !g_cancellable_is_cancelled(operation->cancellable)) {
+        log_debug(TAG, "retrying %s (error %d: %s)", operation_type_names[operation->type], error->code,
+                  error->message);
+        operation->retry_timeout = binc_timeout_add(RETRY_DELAY_MS * operation->attempts, binc_operation_retry,
+                                                    operation);
+        return TRUE;
+    }
+
+    g_queue_remove(&queue->in_flight, operation);
+
+    if (operation->timed_out && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        GError *timeout_error = binc_operation_abort_error(operation);
+        gboolean consumed = binc_operation_queue_finish(queue, operation, NULL, timeout_error);
+        g_error_free(timeout_error);
+        return consumed;
+    }
+    return binc_operation_queue_finish(queue, operation, byteArray, error);
+}
+
+void binc_operation_queue_drop_target(OperationQueue *queue, gconstpointer target) {
+    g_assert(queue != NULL);
+    g_assert(target != NULL);
+
+    GList *dropped = NULL;
+    for (guint i = 0; i <= BINC_PRIORITY_LANES; i++) {
+        GQueue *lane = i < BINC_PRIORITY_LANES ? &queue->lanes[i] : &queue->in_flight;
+        GList *iterator = lane->head;
+        while (iterator != NULL) {
+            GList *next = iterator->next;
+            if (((Operation *) iterator->data)->target == target) {
+                g_queue_unlink(lane, iterator);
+                dropped = g_list_concat(dropped, iterator);
+            }
+            iterator = next;
+        }
+    }
+
+    binc_operation_queue_schedule_pump(queue);
+    binc_operation_queue_drop(dropped, TRUE);
+}
+
+void binc_operation_queue_set_objects_ready(OperationQueue *queue, gboolean ready) {
+    g_assert(queue != NULL);
+
+    queue->objects_ready = ready;
+    if (!ready) return;
+
+    // Collect first, executing may complete operations right away
+    GList *waiting = NULL;
+    for (GList *iterator = queue->in_flight.head; iterator; iterator = iterator->next) {
+        Operation *operation = (Operation *) iterator->data;
+        if (operation->waiting_for_objects) {
+            operation->waiting_for_objects = FALSE;
+            waiting = g_list_prepend(waiting, operation);
+        }
+    }
+
+    waiting = g_list_reverse(waiting);
+    for (GList *iterator = waiting; iterator; iterator = iterator->next) {
+        Operation *operation = (Operation *) iterator->data;
+        operation->attempts = 0;
+        binc_operation_execute(operation);
+    }
+    g_list_free(waiting);
+}
+
+void binc_operation_queue_set_max_in_flight(OperationQueue *queue, guint max_in_flight) {
+    g_assert(queue != NULL);
+    g_assert(max_in_flight > 0);
+
+    queue->max_in_flight = max_in_flight;
+    binc_operation_queue_pump(queue);
+}
+
+guint binc_operation_queue_get_depth(const OperationQueue *queue) {
+    g_assert(queue != NULL);
+
+    guint depth = 0;
+    for (guint i = 0; i < BINC_PRIORITY_LANES; i++) {
+        depth += queue->lanes[i].length;
+    }
+    return depth;
+}
+
+guint binc_operation_queue_get_in_flight(const OperationQueue *queue) {
+    g_assert(queue != NULL);
+    return queue->in_flight.length;
+}
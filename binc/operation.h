@@ -0,0 +1,63 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_OPERATION_H
+#define BINC_OPERATION_H
+
+#include <glib.h>
+#include "forward_decl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Operations issued through a Device are queued per device. Operations in a higher priority lane are sent before
+ * any operation in a lower lane, and operations on the same characteristic or descriptor never overlap.
+ */
+typedef enum OperationPriority {
+    BINC_PRIORITY_HIGH = 0, BINC_PRIORITY_NORMAL = 1, BINC_PRIORITY_BULK = 2
+} OperationPriority;
+
+/*
+ * Called once when an operation has finished. The byteArray is only valid during the callback. After the callback
+ * returns the Operation is freed and must no longer be used. When a device is freed, its pending operations fail
+ * with G_IO_ERROR_CANCELLED before anything is torn down; operations queued from those callbacks are dropped
+ * without being called back.
+ */
+typedef void (*OperationCallback)(Operation *operation, const GByteArray *byteArray, const GError *error,
+                                  void *user_data);
+
+/**
+ * Cancel an operation that has not finished yet. Its callback is called with G_IO_ERROR_CANCELLED, or with the
+ * regular result if the operation completed before the cancellation took effect. Must be called from the main loop.
+ *
+ * @param operation the operation to cancel
+ */
+void binc_operation_cancel(Operation *operation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BINC_OPERATION_H
@@ -0,0 +1,128 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_OPERATION_INTERNAL_H
+#define BINC_OPERATION_INTERNAL_H
+
+#include <gio/gio.h>
+#include "forward_decl.h"
+#include "operation.h"
+#include "characteristic.h"
+
+#define BINC_PRIORITY_LANES 3
+
+typedef enum OperationType {
+    BINC_OPERATION_READ_CHAR = 0,
+    BINC_OPERATION_READ_CHAR_LONG = 1,
+    BINC_OPERATION_WRITE_CHAR = 2,
+    BINC_OPERATION_WRITE_CHAR_LONG = 3,
+    BINC_OPERATION_START_NOTIFY = 4,
+    BINC_OPERATION_STOP_NOTIFY = 5,
+    BINC_OPERATION_READ_DESC = 6,
+    BINC_OPERATION_WRITE_DESC = 7,
+    BINC_OPERATION_ACQUIRE_NOTIFY = 8,
+    BINC_OPERATION_ACQUIRE_WRITE = 9
+} OperationType;
+
+OperationQueue *binc_operation_queue_create(void);
+
+/**
+ * Free the queue. Operations that are still queued are dropped without calling their callbacks, so call
+ * binc_operation_queue_clear() first while their callbacks can still use the device.
+ */
+void binc_operation_queue_free(OperationQueue *queue);
+
+Operation *binc_operation_create(OperationType type, gpointer target, OperationPriority priority);
+
+void binc_operation_free(Operation *operation);
+
+/**
+ * Set the value to write. The value is copied so the caller keeps ownership of byteArray.
+ */
+void binc_operation_set_value(Operation *operation, const GByteArray *byteArray, WriteType writeType);
+
+void binc_operation_set_expected_length(Operation *operation, guint expected_length);
+
+/**
+ * Deliver the result of this operation to callback instead of the regular read, write or notify state callbacks
+ */
+void binc_operation_set_callback(Operation *operation, OperationCallback callback, gpointer user_data);
+
+gpointer binc_operation_get_target(const Operation *operation);
+
+/**
+ * The cancellable to pass to the D-Bus calls of this operation
+ */
+GCancellable *binc_operation_get_cancellable(const Operation *operation);
+
+/**
+ * Fail the operation with G_IO_ERROR_TIMED_OUT if it has not finished within timeout_ms after being queued.
+ * A timed out operation that is in flight only stops waiting for its reply and gives up its in-flight slot. BlueZ
+ * keeps the ATT request running, so the next operation on the same attribute may fail with InProgress for a while.
+ */
+void binc_operation_set_timeout(Operation *operation, guint timeout_ms);
+
+/**
+ * Cancel the operation when cancellable is cancelled. The operation keeps a reference to cancellable.
+ */
+void binc_operation_set_cancellable(Operation *operation, GCancellable *cancellable);
+
+/**
+ * Queue an operation and start it right away if the in-flight window allows it. The queue takes ownership.
+ */
+void binc_operation_queue_enqueue(OperationQueue *queue, Operation *operation);
+
+/**
+ * Report the result of the D-Bus call made for operation. Must be called exactly once for every call.
+ *
+ * @return TRUE if the result was consumed: the operation failed with a transient error and will be retried, it was
+ * delivered to the operation's own callback, or the operation was dropped while its call was running, in which
+ * case its target may already be freed. FALSE if the result should be delivered to the regular callbacks.
+ */
+gboolean binc_operation_complete(Operation *operation, const GByteArray *byteArray, const GError *error);
+
+/**
+ * Drop all queued and in-flight operations, for example when the connection is lost. Their callbacks are called
+ * with G_IO_ERROR_CANCELLED, and the replies of calls that are still running are ignored.
+ */
+void binc_operation_queue_clear(OperationQueue *queue);
+
+/**
+ * Drop the queued and in-flight operations on target, for example when the attribute was removed by the peripheral
+ */
+void binc_operation_queue_drop_target(OperationQueue *queue, gconstpointer target);
+
+/**
+ * Tell the queue whether BlueZ has exported the GATT objects of the connection, i.e. whether ServicesResolved is
+ * true. Until then, operations failing with UnknownObject wait instead of failing, and they are retried once the
+ * objects are ready. Their timeout, if any, still applies.
+ */
+void binc_operation_queue_set_objects_ready(OperationQueue *queue, gboolean ready);
+
+void binc_operation_queue_set_max_in_flight(OperationQueue *queue, guint max_in_flight);
+
+guint binc_operation_queue_get_depth(const OperationQueue *queue);
+
+guint binc_operation_queue_get_in_flight(const OperationQueue *queue);
+
+#endif //BINC_OPERATION_INTERNAL_H
@@ -0,0 +1,311 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include "scan_filter.h"
+#include "utility.h"
+#include "uuid.h"
+
+static const char *const DEVICE_PROPERTY_ADDRESS = "Address";
+static const char *const DEVICE_PROPERTY_MANUFACTURER_DATA = "ManufacturerData";
+static const char *const DEVICE_PROPERTY_SERVICE_DATA = "ServiceData";
+
+typedef enum ScanFilterOp {
+    SCAN_FILTER_MANUFACTURER_DATA = 0, SCAN_FILTER_SERVICE_DATA = 1, SCAN_FILTER_ADDRESS_RANGE = 2
+} ScanFilterOp;
+
+/*
+ * One rule of the program. When it fails, evaluation continues at next_group, so a group matches when evaluation
+ * runs off its last rule.
+ */
+typedef struct binc_scan_filter_instruction {
+    ScanFilterOp op;
+    guint next_group;
+    guint16 manufacturer_id;
+    const Uuid *service_uuid; // Interned
+    guint offset; // Of the masked value in the pool, followed by the mask
+    guint length;
+    guint64 first;
+    guint64 last;
+} ScanFilterInstruction;
+
+struct binc_scan_filter {
+    GArray *program; // Owned, ScanFilterInstructions
+    GByteArray *pool; // Owned, values and masks of the rules
+    guint group_start;
+};
+
+typedef enum ScanFilterInputFlags {
+    INPUT_MANUFACTURER_DATA = 1 << 0, INPUT_SERVICE_DATA = 1 << 1, INPUT_ADDRESS = 1 << 2
+} ScanFilterInputFlags;
+
+/*
+ * The properties a program looks at, only extracted when a rule needs them
+ */
+typedef struct binc_scan_filter_input {
+    const char *path; // Borrowed
+    GVariant *properties; // Borrowed
+    gboolean partial; // Only the changed properties, rules on absent properties are undecided
+    guint loaded;
+    GVariant *manufacturer_data; // Owned
+    GVariant *service_data; // Owned
+    gboolean has_address;
+    guint64 address;
+} ScanFilterInput;
+
+ScanFilter *binc_scan_filter_create(void) {
+    ScanFilter *filter = g_new0(ScanFilter, 1);
+    filter->program = g_array_new(FALSE, TRUE, sizeof(ScanFilterInstruction));
+    filter->pool = g_byte_array_new();
+    filter->group_start = 0;
+    return filter;
+}
+
+void binc_scan_filter_free(ScanFilter *filter) {
+    g_assert(filter != NULL);
+
+    g_array_free(filter->program, TRUE);
+    filter->program = NULL;
+    g_byte_array_free(filter->pool, TRUE);
+    filter->pool = NULL;
+    g_free(filter);
+}
+
+static void binc_scan_filter_append(ScanFilter *filter, const ScanFilterInstruction *instruction) {
+    g_array_append_val(filter->program, *instruction);
+
+    // The rules of the current group skip past its end when they fail
+    for (guint i = filter->group_start; i < filter->program->len; i++) {
+        g_array_index(filter->program, ScanFilterInstruction, i).next_group = filter->program->len;
+    }
+}
+
+static guint binc_scan_filter_add_bytes(ScanFilter *filter, const guint8 *value, const guint8 *mask, guint length) {
+    guint offset = filter->pool->len;
+    g_byte_array_set_size(filter->pool, offset + 2 * length);
+
+    // Store the value already masked, so matching is one AND and compare per byte
+    guint8 *masked_value = filter->pool->data + offset;
+    guint8 *stored_mask = masked_value + length;
+    for (guint i = 0; i < length; i++) {
+        stored_mask[i] = mask != NULL ? mask[i] : 0xFF;
+        masked_value[i] = value[i] & stored_mask[i];
+    }
+    return offset;
+}
+
+void binc_scan_filter_add_manufacturer_data(ScanFilter *filter, guint16 manufacturer_id, const guint8 *value,
+                                            const guint8 *mask, guint length) {
+    g_assert(filter != NULL);
+    g_assert(length == 0 || value != NULL);
+
+    ScanFilterInstruction instruction = {0};
+    instruction.op = SCAN_FILTER_MANUFACTURER_DATA;
+    instruction.manufacturer_id = manufacturer_id;
+    instruction.offset = binc_scan_filter_add_bytes(filter, value, mask, length);
+    instruction.length = length;
+    binc_scan_filter_append(filter, &instruction);
+}
+
+void binc_scan_filter_add_service_data(ScanFilter *filter, const char *service_uuid, const guint8 *prefix,
+                                       guint length) {
+    g_assert(filter != NULL);
+    g_assert(service_uuid != NULL);
+    g_assert(length == 0 || prefix != NULL);
+
+    ScanFilterInstruction instruction = {0};
+    instruction.op = SCAN_FILTER_SERVICE_DATA;
+    instruction.service_uuid = binc_uuid_intern_string(service_uuid);
+    g_assert(instruction.service_uuid != NULL);
+    instruction.offset = binc_scan_filter_add_bytes(filter, prefix, NULL, length);
+    instruction.length = length;
+    binc_scan_filter_append(filter, &instruction);
+}
+
+void binc_scan_filter_add_address_range(ScanFilter *filter, guint64 first, guint64 last) {
+    g_assert(filter != NULL);
+    g_assert(first <= last);
+
+    ScanFilterInstruction instruction = {0};
+    instruction.op = SCAN_FILTER_ADDRESS_RANGE;
+    instruction.first = first;
+    instruction.last = last;
+    binc_scan_filter_append(filter, &instruction);
+}
+
+void binc_scan_filter_or(ScanFilter *filter) {
+    g_assert(filter != NULL);
+    filter->group_start = filter->program->len;
+}
+
+static gboolean binc_scan_filter_match_bytes(const ScanFilter *filter, const ScanFilterInstruction *instruction,
+                                             GVariant *value) {
+    if (!g_str_equal(g_variant_get_type_string(value), "ay")) return FALSE;
+
+    gsize length = 0;
+    const guint8 *data = g_variant_get_fixed_array(value, &length, sizeof(guint8));
+    if (length < instruction->length) return FALSE;
+
+    const guint8 *masked_value = filter->pool->data + instruction->offset;
+    const guint8 *mask = masked_value + instruction->length;
+    for (guint i = 0; i < instruction->length; i++) {
+        if ((data[i] & mask[i]) != masked_value[i]) return FALSE;
+    }
+    return TRUE;
+}
+
+static ScanFilterResult absent_input_result(const ScanFilterInput *input) {
+    return input->partial ? BINC_SCAN_FILTER_UNDECIDED : BINC_SCAN_FILTER_NO_MATCH;
+}
+
+static ScanFilterResult to_result(gboolean matched) {
+    return matched ? BINC_SCAN_FILTER_MATCH : BINC_SCAN_FILTER_NO_MATCH;
+}
+
+static ScanFilterResult binc_scan_filter_match_manufacturer_data(const ScanFilter *filter,
+                                                                 const ScanFilterInstruction *instruction,
+                                                                 ScanFilterInput *input) {
+    if (!(input->loaded & INPUT_MANUFACTURER_DATA)) {
+        input->manufacturer_data = g_variant_lookup_value(input->properties, DEVICE_PROPERTY_MANUFACTURER_DATA,
+                                                          G_VARIANT_TYPE("a{qv}"));
+        input->loaded |= INPUT_MANUFACTURER_DATA;
+    }
+    if (input->manufacturer_data == NULL) return absent_input_result(input);
+
+    gboolean matched = FALSE;
+    guint16 manufacturer_id;
+    GVariant *value;
+    GVariantIter iter;
+    g_variant_iter_init(&iter, input->manufacturer_data);
+    while (!matched && g_variant_iter_next(&iter, "{qv}", &manufacturer_id, &value)) {
+        if (manufacturer_id == instruction->manufacturer_id) {
+            matched = binc_scan_filter_match_bytes(filter, instruction, value);
+        }
+        g_variant_unref(value);
+    }
+    return to_result(matched);
+}
+
+static ScanFilterResult binc_scan_filter_match_service_data(const ScanFilter *filter,
+                                                            const ScanFilterInstruction *instruction,
+                                                            ScanFilterInput *input) {
+    if (!(input->loaded & INPUT_SERVICE_DATA)) {
+        input->service_data = g_variant_lookup_value(input->properties, DEVICE_PROPERTY_SERVICE_DATA,
+                                                     G_VARIANT_TYPE("a{sv}"));
+        input->loaded |= INPUT_SERVICE_DATA;
+    }
+    if (input->service_data == NULL) return absent_input_result(input);
+
+    // BlueZ uses the same lowercase 128 bit form as interned uuids
+    GVariant *value = g_variant_lookup_value(input->service_data, binc_uuid_get_string(instruction->service_uuid),
+                                             NULL);
+    if (value == NULL) return BINC_SCAN_FILTER_NO_MATCH;
+
+    gboolean matched = binc_scan_filter_match_bytes(filter, instruction, value);
+    g_variant_unref(value);
+    return to_result(matched);
+}
+
+static ScanFilterResult binc_scan_filter_match_address_range(const ScanFilterInstruction *instruction,
+                                                     ScanFilterInput *input) {
+    if (!(input->loaded & INPUT_ADDRESS)) {
+        const char *address = NULL;
+        if (g_variant_lookup(input->properties, DEVICE_PROPERTY_ADDRESS, "&s", &address)) {
+            input->has_address = binc_address_parse(address, &input->address);
+        } else {
+            input->has_address = binc_address_parse_path(input->path, &input->address);
+        }
+        input->loaded |= INPUT_ADDRESS;
+    }
+    return to_result(input->has_address && input->address >= instruction->first &&
+                     input->address <= instruction->last);
+}
+
+static ScanFilterResult binc_scan_filter_run(const ScanFilter *filter, const char *path, GVariant *properties,
+                                             gboolean partial) {
+    guint count = filter->program->len;
+    if (count == 0) return BINC_SCAN_FILTER_MATCH;
+
+    ScanFilterInput input = {0};
+    input.path = path;
+    input.properties = properties;
+    input.partial = partial;
+
+    // A group with undecided rules and no failed ones makes the filter undecided, unless another group matches
+    ScanFilterResult result = BINC_SCAN_FILTER_NO_MATCH;
+    gboolean group_undecided = FALSE;
+    guint pc = 0;
+    while (pc < count) {
+        const ScanFilterInstruction *instruction = &g_array_index(filter->program, ScanFilterInstruction, pc);
+        ScanFilterResult passed = BINC_SCAN_FILTER_NO_MATCH;
+        switch (instruction->op) {
+            case SCAN_FILTER_MANUFACTURER_DATA:
+                passed = binc_scan_filter_match_manufacturer_data(filter, instruction, &input);
+                break;
+            case SCAN_FILTER_SERVICE_DATA:
+                passed = binc_scan_filter_match_service_data(filter, instruction, &input);
+                break;
+            case SCAN_FILTER_ADDRESS_RANGE:
+                passed = binc_scan_filter_match_address_range(instruction, &input);
+                break;
+        }
+
+        if (passed == BINC_SCAN_FILTER_NO_MATCH) {
+            pc = instruction->next_group;
+            group_undecided = FALSE;
+            continue;
+        }
+
+        group_undecided |= passed == BINC_SCAN_FILTER_UNDECIDED;
+        if (++pc == instruction->next_group) {
+            if (!group_undecided) {
+                result = BINC_SCAN_FILTER_MATCH;
+                break;
+            }
+            result = BINC_SCAN_FILTER_UNDECIDED;
+            group_undecided = FALSE;
+        }
+    }
+
+    if (input.manufacturer_data != NULL) {
+        g_variant_unref(input.manufacturer_data);
+    }
+    if (input.service_data != NULL) {
+        g_variant_unref(input.service_data);
+    }
+    return result;
+}
+
+gboolean binc_scan_filter_matches(const ScanFilter *filter, const char *path, GVariant *properties) {
+    g_assert(filter != NULL);
+    g_assert(properties != NULL);
+
+    return binc_scan_filter_run(filter, path, properties, FALSE) == BINC_SCAN_FILTER_MATCH;
+}
+
+ScanFilterResult binc_scan_filter_check_changed(const ScanFilter *filter, const char *path,
+                                                GVariant *changed_properties) {
+    g_assert(filter != NULL);
+    g_assert(changed_properties != NULL);
+
+    return binc_scan_filter_run(filter, path, changed_properties, TRUE);
+}
@@ -0,0 +1,106 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_SCAN_FILTER_H
+#define BINC_SCAN_FILTER_H
+
+#include <gio/gio.h>
+#include "forward_decl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Filter on what devices advertise, checked on the raw D-Bus properties before the adapter creates a Device. Rules
+ * are added to the current group and all rules of a group must match. binc_scan_filter_or() starts a new group, and
+ * the filter matches when any group matches. Rules are compiled into a flat program as they are added, so matching
+ * needs no allocations besides the GVariant children it looks at.
+ *
+ * For example, iBeacons from Apple or devices with the Eddystone service data:
+ *
+ *     ScanFilter *filter = binc_scan_filter_create();
+ *     binc_scan_filter_add_manufacturer_data(filter, 0x004C, (guint8[]) {0x02, 0x15}, NULL, 2);
+ *     binc_scan_filter_or(filter);
+ *     binc_scan_filter_add_service_data(filter, "0000feaa-0000-1000-8000-00805f9b34fb", NULL, 0);
+ *     binc_adapter_set_scan_filter(adapter, filter);
+ */
+
+ScanFilter *binc_scan_filter_create(void);
+
+void binc_scan_filter_free(ScanFilter *filter);
+
+/**
+ * Require manufacturer data of manufacturer_id that starts with value, comparing only the bits set in mask
+ *
+ * @param value bytes to compare with, may be NULL if length is 0
+ * @param mask bits of value that must match, or NULL to compare all bits
+ * @param length number of bytes in value and mask, 0 to only require the manufacturer id
+ */
+void binc_scan_filter_add_manufacturer_data(ScanFilter *filter, guint16 manufacturer_id, const guint8 *value,
+                                            const guint8 *mask, guint length);
+
+/**
+ * Require service data for service_uuid that starts with prefix, or any service data for it if length is 0
+ */
+void binc_scan_filter_add_service_data(ScanFilter *filter, const char *service_uuid, const guint8 *prefix,
+                                       guint length);
+
+/**
+ * Require an address between first and last, inclusive, as 48 bit values, see binc_address_parse()
+ */
+void binc_scan_filter_add_address_range(ScanFilter *filter, guint64 first, guint64 last);
+
+/**
+ * Start a new group of rules. The filter matches when all rules of at least one group match.
+ */
+void binc_scan_filter_or(ScanFilter *filter);
+
+/**
+ * Check the properties of an org.bluez.Device1 object against the filter. An empty filter matches everything.
+ *
+ * @param path object path of the device, used for the address when properties don't hold it
+ * @param properties 'a{sv}' properties, as in InterfacesAdded or PropertiesChanged
+ */
+gboolean binc_scan_filter_matches(const ScanFilter *filter, const char *path, GVariant *properties);
+
+typedef enum ScanFilterResult {
+    BINC_SCAN_FILTER_NO_MATCH = 0, BINC_SCAN_FILTER_MATCH = 1, BINC_SCAN_FILTER_UNDECIDED = 2
+} ScanFilterResult;
+
+/**
+ * Check the changed properties of a PropertiesChanged signal against the filter. A rule on a property that did not
+ * change can't be decided, so the result is BINC_SCAN_FILTER_UNDECIDED when no group matches but some group has only
+ * undecided rules besides matching ones. Check all properties with binc_scan_filter_matches() to decide then.
+ *
+ * @param path object path of the device, used for the address
+ * @param changed_properties 'a{sv}' changed properties
+ */
+ScanFilterResult binc_scan_filter_check_changed(const ScanFilter *filter, const char *path,
+                                                GVariant *changed_properties);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BINC_SCAN_FILTER_H
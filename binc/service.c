@@ -28,19 +28,19 @@
 struct binc_service {
     Device *device; // Borrowed
     const char *path; // Owned
-    const char* uuid; // Owned
+    const Uuid *uuid; // Interned
     GList *characteristics; // Owned
 };
 
 Service* binc_service_create(Device *device, const char* path, const char* uuid) {
     g_assert(device != NULL);
     g_assert(path != NULL);
-    g_assert(is_valid_uuid(uuid));
 
     Service *service = g_new0(Service, 1);
     service->device = device;
     service->path = g_strdup(path);
-    service->uuid = g_strdup(uuid);
+    service->uuid = binc_uuid_intern_string(uuid);
+    g_assert(service->uuid != NULL);
     service->characteristics = NULL;
     return service;
 }
@@ -51,7 +51,6 @@ void binc_service_free(Service *service) {
     g_free((char*) service->path);
     service->path = NULL;
 
-    g_free((char*) service->uuid);
     service->uuid = NULL;
 
     g_list_free(service->characteristics);
@@ -62,10 +61,20 @@ void binc_service_free(Service *service) {
 }
 
 const char* binc_service_get_uuid(const Service *service) {
+    g_assert(service != NULL);
+    return binc_uuid_get_string(service->uuid);
+}
+
+const Uuid *binc_service_get_uuid_value(const Service *service) {
     g_assert(service != NULL);
     return service->uuid;
 }
 
+const char *binc_service_get_path(const Service *service) {
+    g_assert(service != NULL);
+    return service->path;
+}
+
 Device *binc_service_get_device(const Service *service) {
     g_assert(service != NULL);
     return service->device;
@@ -78,6 +87,13 @@ void binc_service_add_characteristic(Service *service, Characteristic *character
     service->characteristics = g_list_append(service->characteristics, characteristic);
 }
 
+void binc_service_remove_characteristic(Service *service, Characteristic *characteristic) {
+    g_assert(service != NULL);
+    g_assert(characteristic != NULL);
+
+    service->characteristics = g_list_remove(service->characteristics, characteristic);
+}
+
 GList *binc_service_get_characteristics(const Service *service) {
     g_assert(service != NULL);
     return service->characteristics;
@@ -86,14 +102,23 @@ GList *binc_service_get_characteristics(const Service *service) {
 Characteristic *binc_service_get_characteristic(const Service *service, const char* char_uuid) {
     g_assert(service != NULL);
     g_assert(char_uuid != NULL);
-    g_assert(is_valid_uuid(char_uuid));
-
-    if (service->characteristics != NULL) {
-        for (GList *iterator = service->characteristics; iterator; iterator = iterator->next) {
-            Characteristic *characteristic = (Characteristic *) iterator->data;
-            if (g_str_equal(char_uuid, binc_characteristic_get_uuid(characteristic))) {
-                return characteristic;
-            }
+
+    Uuid uuid;
+    if (!binc_uuid_parse(char_uuid, &uuid)) return NULL;
+    return binc_service_get_characteristic_by_uuid(service, &uuid);
+}
+
+Characteristic *binc_service_get_characteristic_by_uuid(const Service *service, const Uuid *char_uuid) {
+    g_assert(service != NULL);
+    g_assert(char_uuid != NULL);
+
+    const Uuid *interned = binc_uuid_lookup(char_uuid);
+    if (interned == NULL) return NULL;
+
+    for (GList *iterator = service->characteristics; iterator; iterator = iterator->next) {
+        Characteristic *characteristic = (Characteristic *) iterator->data;
+        if (binc_characteristic_get_uuid_value(characteristic) == interned) {
+            return characteristic;
         }
     }
     return NULL;
@@ -26,6 +26,7 @@
 
 #include <gio/gio.h>
 #include "forward_decl.h"
+#include "uuid.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,12 +34,16 @@ extern "C" {
 
 const char *binc_service_get_uuid(const Service *service);
 
+const Uuid *binc_service_get_uuid_value(const Service *service);
+
 Device *binc_service_get_device(const Service *service);
 
 GList *binc_service_get_characteristics(const Service *service);
 
 Characteristic *binc_service_get_characteristic(const Service *service, const char *char_uuid);
 
+Characteristic *binc_service_get_characteristic_by_uuid(const Service *service, const Uuid *char_uuid);
+
 #ifdef __cplusplus
 }
 #endif
@@ -28,6 +28,10 @@ Service *binc_service_create(Device *device, const char *path, const char *uuid)
 
 void binc_service_free(Service *service);
 
+const char *binc_service_get_path(const Service *service);
+
 void binc_service_add_characteristic(Service *service, Characteristic *characteristic);
 
+void binc_service_remove_characteristic(Service *service, Characteristic *characteristic);
+
 #endif //BINC_SERVICE_INTERNAL_H
@@ -0,0 +1,258 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include "shard.h"
+#include "adapter.h"
+#include "device.h"
+#include "logger.h"
+#include "worker.h"
+
+static const char *const TAG = "Shard";
+
+typedef struct binc_shard {
+    char *name; // Owned
+    GDBusConnection *connection; // Owned, private to this shard
+    Worker *worker; // Owned
+    Adapter *adapter; // Owned, lives on the worker thread
+} Shard;
+
+struct binc_shard_set {
+    GPtrArray *shards; // Owned
+};
+
+typedef struct binc_shard_call {
+    ShardFunc func;
+    Adapter *adapter;
+    void *user_data;
+} ShardCall;
+
+static void binc_internal_shard_call(void *user_data) {
+    ShardCall *call = (ShardCall *) user_data;
+    call->func(call->adapter, call->user_data);
+}
+
+static void binc_internal_shard_run_sync(const Shard *shard, ShardFunc func, void *user_data) {
+    ShardCall call = {.func = func, .adapter = shard->adapter, .user_data = user_data};
+    binc_worker_invoke_sync(shard->worker, binc_internal_shard_call, &call);
+}
+
+typedef struct binc_shard_create_call {
+    GDBusConnection *connection;
+    const char *name;
+    Adapter *adapter;
+} ShardCreateCall;
+
+static void binc_internal_shard_create_adapter(void *user_data) {
+    ShardCreateCall *call = (ShardCreateCall *) user_data;
+    call->adapter = binc_adapter_get(call->connection, call->name);
+}
+
+static GDBusConnection *binc_internal_open_private_connection(void) {
+    GError *error = NULL;
+    char *address = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+    if (address == NULL) {
+        log_error(TAG, "failed to get system bus address: %s", error->message);
+        g_clear_error(&error);
+        return NULL;
+    }
+
+    GDBusConnection *connection = g_dbus_connection_new_for_address_sync(
+            address,
+            G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+            NULL,
+            NULL,
+            &error);
+    if (connection == NULL) {
+        log_error(TAG, "failed to open connection to system bus: %s", error->message);
+        g_clear_error(&error);
+    }
+    g_free(address);
+    return connection;
+}
+
+static void binc_internal_shard_free_adapter(Adapter *adapter, __attribute__((unused)) void *user_data) {
+    binc_adapter_free(adapter);
+}
+
+static void binc_internal_shard_free(Shard *shard) {
+    if (shard->adapter != NULL) {
+        binc_internal_shard_run_sync(shard, binc_internal_shard_free_adapter, NULL);
+        shard->adapter = NULL;
+    }
+
+    if (shard->worker != NULL) {
+        binc_worker_free(shard->worker);
+        shard->worker = NULL;
+    }
+
+    if (shard->connection != NULL) {
+        g_dbus_connection_close_sync(shard->connection, NULL, NULL);
+        g_object_unref(shard->connection);
+        shard->connection = NULL;
+    }
+
+    g_free(shard->name);
+    g_free(shard);
+}
+
+static Shard *binc_internal_shard_create(const char *name) {
+    Shard *shard = g_new0(Shard, 1);
+    shard->name = g_strdup(name);
+    shard->connection = binc_internal_open_private_connection();
+    if (shard->connection == NULL) {
+        binc_internal_shard_free(shard);
+        return NULL;
+    }
+
+    // The adapter subscribes to its signals on the worker thread, so they are dispatched there
+    char *thread_name = g_strdup_printf("binc-%s", name);
+    shard->worker = binc_worker_create(thread_name);
+    g_free(thread_name);
+
+    ShardCreateCall call = {.connection = shard->connection, .name = name, .adapter = NULL};
+    binc_worker_invoke_sync(shard->worker, binc_internal_shard_create_adapter, &call);
+    shard->adapter = call.adapter;
+    if (shard->adapter == NULL) {
+        log_debug(TAG, "adapter '%s' disappeared", name);
+        binc_internal_shard_free(shard);
+        return NULL;
+    }
+    return shard;
+}
+
+ShardSet *binc_shard_set_create(void) {
+    ShardSet *shardSet = g_new0(ShardSet, 1);
+    shardSet->shards = g_ptr_array_new_with_free_func((GDestroyNotify) binc_internal_shard_free);
+
+    GDBusConnection *connection = binc_internal_open_private_connection();
+    if (connection == NULL) return shardSet;
+
+    GPtrArray *names = binc_adapter_find_all_names(connection);
+    g_dbus_connection_close_sync(connection, NULL, NULL);
+    g_object_unref(connection);
+
+    for (guint i = 0; i < names->len; i++) {
+        Shard *shard = binc_internal_shard_create(g_ptr_array_index(names, i));
+        if (shard != NULL) {
+            g_ptr_array_add(shardSet->shards, shard);
+        }
+    }
+    g_ptr_array_free(names, TRUE);
+
+    log_debug(TAG, "created %d shard%s", shardSet->shards->len, shardSet->shards->len != 1 ? "s" : "");
+    return shardSet;
+}
+
+void binc_shard_set_free(ShardSet *shardSet) {
+    g_assert(shardSet != NULL);
+
+    g_ptr_array_free(shardSet->shards, TRUE);
+    shardSet->shards = NULL;
+    g_free(shardSet);
+}
+
+guint binc_shard_set_get_size(const ShardSet *shardSet) {
+    g_assert(shardSet != NULL);
+    return shardSet->shards->len;
+}
+
+Adapter *binc_shard_set_get_adapter(const ShardSet *shardSet, guint index) {
+    g_assert(shardSet != NULL);
+    g_assert(index < shardSet->shards->len);
+
+    Shard *shard = g_ptr_array_index(shardSet->shards, index);
+    return shard->adapter;
+}
+
+Worker *binc_shard_set_get_worker(const ShardSet *shardSet, guint index) {
+    g_assert(shardSet != NULL);
+    g_assert(index < shardSet->shards->len);
+
+    Shard *shard = g_ptr_array_index(shardSet->shards, index);
+    return shard->worker;
+}
+
+Worker *binc_shard_set_get_worker_by_name(const ShardSet *shardSet, const char *name, Adapter **adapter) {
+    g_assert(shardSet != NULL);
+    g_assert(name != NULL);
+
+    for (guint i = 0; i < shardSet->shards->len; i++) {
+        Shard *shard = g_ptr_array_index(shardSet->shards, i);
+        if (g_str_equal(shard->name, name)) {
+            if (adapter != NULL) *adapter = shard->adapter;
+            return shard->worker;
+        }
+    }
+    return NULL;
+}
+
+void binc_shard_set_foreach(const ShardSet *shardSet, ShardFunc func, void *user_data) {
+    g_assert(shardSet != NULL);
+    g_assert(func != NULL);
+
+    for (guint i = 0; i < shardSet->shards->len; i++) {
+        binc_internal_shard_run_sync(g_ptr_array_index(shardSet->shards, i), func, user_data);
+    }
+}
+
+static void binc_internal_collect_addresses(Adapter *adapter, void *user_data) {
+    GPtrArray *addresses = (GPtrArray *) user_data;
+
+    GList *devices = binc_adapter_get_devices(adapter);
+    for (GList *iterator = devices; iterator; iterator = iterator->next) {
+        g_ptr_array_add(addresses, g_strdup(binc_device_get_address((Device *) iterator->data)));
+    }
+    g_list_free(devices);
+}
+
+GPtrArray *binc_shard_set_get_device_addresses(const ShardSet *shardSet) {
+    g_assert(shardSet != NULL);
+
+    GPtrArray *addresses = g_ptr_array_new_with_free_func(g_free);
+    binc_shard_set_foreach(shardSet, binc_internal_collect_addresses, addresses);
+    return addresses;
+}
+
+static void binc_internal_collect_stats(Adapter *adapter, void *user_data) {
+    ShardSetStats *stats = (ShardSetStats *) user_data;
+
+    stats->adapters++;
+    if (binc_adapter_get_powered_state(adapter)) stats->powered_adapters++;
+    if (binc_adapter_get_discovery_state(adapter) == BINC_DISCOVERY_STARTED) stats->discovering_adapters++;
+
+    GList *devices = binc_adapter_get_devices(adapter);
+    stats->devices += g_list_length(devices);
+    g_list_free(devices);
+
+    GList *connected = binc_adapter_get_connected_devices(adapter);
+    stats->connected_devices += g_list_length(connected);
+    g_list_free(connected);
+}
+
+void binc_shard_set_get_stats(const ShardSet *shardSet, ShardSetStats *stats) {
+    g_assert(shardSet != NULL);
+    g_assert(stats != NULL);
+
+    memset(stats, 0, sizeof(ShardSetStats));
+    binc_shard_set_foreach(shardSet, binc_internal_collect_stats, stats);
+}
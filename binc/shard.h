@@ -0,0 +1,95 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_SHARD_H
+#define BINC_SHARD_H
+
+#include <gio/gio.h>
+#include "forward_decl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A shard set runs every adapter on its own private D-Bus connection and its own Worker thread, so throughput grows
+ * with the number of controllers. Each adapter and its devices must only be used on the worker thread of its shard,
+ * e.g. through binc_worker_submit() or the typed worker requests. The functions below give a combined view over all
+ * shards and can be called from any thread except the shard workers.
+ */
+
+typedef void (*ShardFunc)(Adapter *adapter, void *user_data);
+
+typedef struct binc_shard_set_stats {
+    guint adapters;
+    guint powered_adapters;
+    guint discovering_adapters;
+    guint devices;
+    guint connected_devices;
+} ShardSetStats;
+
+/**
+ * Create a shard for every adapter on the system bus
+ *
+ * @return the shard set, free with binc_shard_set_free()
+ */
+ShardSet *binc_shard_set_create(void);
+
+/**
+ * Free the adapters on their own threads, then stop the workers and close the connections
+ */
+void binc_shard_set_free(ShardSet *shardSet);
+
+guint binc_shard_set_get_size(const ShardSet *shardSet);
+
+Adapter *binc_shard_set_get_adapter(const ShardSet *shardSet, guint index);
+
+Worker *binc_shard_set_get_worker(const ShardSet *shardSet, guint index);
+
+/**
+ * Get the worker that owns the adapter with the given name, e.g. 'hci1'
+ *
+ * @return the worker or NULL if there is no such adapter
+ */
+Worker *binc_shard_set_get_worker_by_name(const ShardSet *shardSet, const char *name, Adapter **adapter);
+
+/**
+ * Run a function for every adapter on the thread that owns it. Shards are visited one after the other and this
+ * returns when all have been visited.
+ */
+void binc_shard_set_foreach(const ShardSet *shardSet, ShardFunc func, void *user_data);
+
+/**
+ * Get the addresses of the devices of all adapters
+ *
+ * @return array of addresses, free with g_ptr_array_free()
+ */
+GPtrArray *binc_shard_set_get_device_addresses(const ShardSet *shardSet);
+
+void binc_shard_set_get_stats(const ShardSet *shardSet, ShardSetStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BINC_SHARD_H
@@ -126,6 +126,39 @@ char *path_to_address(const char *path) {
     return replace_char(address, '_', ':');
 }
 
+gboolean binc_address_parse(const char *address, guint64 *value) {
+    g_assert(value != NULL);
+    if (address == NULL) return FALSE;
+
+    guint64 result = 0;
+    char separator = ':';
+    for (int i = 0; i < 6; i++) {
+        const char *octet = address + i * 3;
+        if (!g_ascii_isxdigit(octet[0]) || !g_ascii_isxdigit(octet[1])) return FALSE;
+        if (i == 0 && octet[2] == '_') separator = '_';
+        if (octet[2] != (i < 5 ? separator : '\0')) return FALSE;
+        result = (result << 8) | (guint64) (g_ascii_xdigit_value(octet[0]) << 4 | g_ascii_xdigit_value(octet[1]));
+    }
+    *value = result;
+    return TRUE;
+}
+
+gboolean binc_address_parse_path(const char *path, guint64 *value) {
+    g_assert(value != NULL);
+    if (path == NULL) return FALSE;
+
+    gsize length = strlen(path);
+    if (length < BINC_ADDRESS_STRING_LENGTH - 1) return FALSE;
+    return binc_address_parse(path + length - (BINC_ADDRESS_STRING_LENGTH - 1), value);
+}
+
+void binc_address_format(guint64 value, char *buffer) {
+    g_assert(buffer != NULL);
+    g_snprintf(buffer, BINC_ADDRESS_STRING_LENGTH, "%02X:%02X:%02X:%02X:%02X:%02X",
+               (guint) (value >> 40) & 0xFF, (guint) (value >> 32) & 0xFF, (guint) (value >> 24) & 0xFF,
+               (guint) (value >> 16) & 0xFF, (guint) (value >> 8) & 0xFF, (guint) value & 0xFF);
+}
+
 /**
  * Get a byte array that wraps the data inside the variant.
  *
@@ -142,4 +175,41 @@ GByteArray *g_variant_get_byte_array(GVariant *variant) {
     size_t data_length = 0;
     guint8 *data = (guint8 *) g_variant_get_fixed_array(variant, &data_length, sizeof(guint8));
     return g_byte_array_new_take(data, data_length);
-}
\ No newline at end of file
+}
+
+const GByteArray *g_variant_get_byte_array_view(GVariant *variant, GByteArray *view) {
+    g_assert(variant != NULL);
+    g_assert(view != NULL);
+    g_assert(g_str_equal(g_variant_get_type_string(variant), "ay"));
+
+    gsize data_length = 0;
+    view->data = (guint8 *) g_variant_get_fixed_array(variant, &data_length, sizeof(guint8));
+    view->len = (guint) data_length;
+    return view;
+}
+
+static guint binc_attach_source(GSource *source, GSourceFunc function, gpointer data) {
+    g_source_set_callback(source, function, data, NULL);
+    guint source_id = g_source_attach(source, g_main_context_get_thread_default());
+    g_source_unref(source);
+    return source_id;
+}
+
+guint binc_timeout_add(guint interval_ms, GSourceFunc function, gpointer data) {
+    return binc_attach_source(g_timeout_source_new(interval_ms), function, data);
+}
+
+guint binc_idle_add(GSourceFunc function, gpointer data) {
+    return binc_attach_source(g_idle_source_new(), function, data);
+}
+
+guint binc_unix_fd_add(gint fd, GIOCondition condition, GUnixFDSourceFunc function, gpointer data) {
+    return binc_attach_source(g_unix_fd_source_new(fd, condition), G_SOURCE_FUNC(function), data);
+}
+
+void binc_source_remove(guint source_id) {
+    GSource *source = g_main_context_find_source_by_id(g_main_context_get_thread_default(), source_id);
+    if (source != NULL) {
+        g_source_destroy(source);
+    }
+}
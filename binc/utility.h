@@ -25,6 +25,7 @@
 #define BINC_UTILITY_H
 
 #include <glib.h>
+#include <glib-unix.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -44,10 +45,55 @@ gboolean is_valid_uuid(const char *uuid);
 
 char *path_to_address(const char *path);
 
+/*
+ * Length of a Bluetooth address as a string like "00:11:22:33:44:55", including the terminating 0
+ */
+#define BINC_ADDRESS_STRING_LENGTH 18
+
+/**
+ * Parse a Bluetooth address like "00:11:22:33:44:55", or "00_11_22_33_44_55" as in object paths, into a 48 bit
+ * value, most significant byte first
+ *
+ * @return TRUE if address is a well formed address, value is untouched otherwise
+ */
+gboolean binc_address_parse(const char *address, guint64 *value);
+
+/**
+ * Parse the address at the end of a device object path like /org/bluez/hci0/dev_00_11_22_33_44_55, without
+ * allocating
+ */
+gboolean binc_address_parse_path(const char *path, guint64 *value);
+
+/**
+ * Format a 48 bit address value as "00:11:22:33:44:55" into buffer, which holds BINC_ADDRESS_STRING_LENGTH chars
+ */
+void binc_address_format(guint64 value, char *buffer);
+
 GByteArray *g_variant_get_byte_array(GVariant *variant);
 
+/**
+ * Point view at the bytes of an 'ay' variant without copying or allocating. The view is only valid while variant
+ * is alive and must not be resized, referenced or freed.
+ */
+const GByteArray *g_variant_get_byte_array_view(GVariant *variant, GByteArray *view);
+
 char* replace_char(char* str, char find, char replace);
 
+/*
+ * Like g_timeout_add(), g_idle_add() and g_unix_fd_add(), but the source is attached to the thread-default main
+ * context, so it runs on the thread that drives the library, see worker.h
+ */
+guint binc_timeout_add(guint interval_ms, GSourceFunc function, gpointer data);
+
+guint binc_idle_add(GSourceFunc function, gpointer data);
+
+guint binc_unix_fd_add(gint fd, GIOCondition condition, GUnixFDSourceFunc function, gpointer data);
+
+/**
+ * Remove a source added with one of the functions above, from the thread it was added on
+ */
+void binc_source_remove(guint source_id);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,213 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include "uuid.h"
+
+#define BASE_UUID_MSB_LOW G_GUINT64_CONSTANT(0x00001000)
+#define BASE_UUID_LSB G_GUINT64_CONSTANT(0x800000805f9b34fb)
+
+typedef struct binc_interned_uuid {
+    Uuid uuid; // Must be first, interned Uuid pointers point here
+    char string[BINC_UUID_STRING_LENGTH];
+} InternedUuid;
+
+/*
+ * Open addressing table of the interned uuids. Lookups probe it without taking the lock, so a slot is never cleared
+ * once it is filled and a table that is replaced when growing is never freed, a reader may still be probing it.
+ */
+typedef struct binc_uuid_table {
+    guint mask;
+    InternedUuid *slots[];
+} UuidTable;
+
+#define UUID_TABLE_INITIAL_SIZE 64
+
+static UuidTable *uuid_table = NULL; // Read atomically, replaced while holding the lock
+static guint uuid_count = 0;
+G_LOCK_DEFINE_STATIC(uuid_pool);
+
+static gint hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static gboolean parse_hex(const char *string, guint length, guint64 *result) {
+    guint64 value = 0;
+    for (guint i = 0; i < length; i++) {
+        gint digit = hex_value(string[i]);
+        if (digit < 0) return FALSE;
+        value = (value << 4) | (guint64) digit;
+    }
+    *result = value;
+    return TRUE;
+}
+
+gboolean binc_uuid_parse(const char *string, Uuid *uuid) {
+    g_assert(uuid != NULL);
+
+    if (string == NULL) return FALSE;
+
+    size_t length = strlen(string);
+    guint64 value = 0;
+    if (length == 4 || length == 8) {
+        if (!parse_hex(string, (guint) length, &value)) return FALSE;
+        *uuid = binc_uuid_from_short((guint32) value);
+        return TRUE;
+    }
+
+    if (length != BINC_UUID_STRING_LENGTH - 1) return FALSE;
+    if (string[8] != '-' || string[13] != '-' || string[18] != '-' || string[23] != '-') return FALSE;
+
+    // Groups are 8-4-4-4-12 hex digits, the first three make up the most significant half
+    guint64 group1, group2, group3, group4, group5;
+    if (!parse_hex(string, 8, &group1) ||
+        !parse_hex(string + 9, 4, &group2) ||
+        !parse_hex(string + 14, 4, &group3) ||
+        !parse_hex(string + 19, 4, &group4) ||
+        !parse_hex(string + 24, 12, &group5)) {
+        return FALSE;
+    }
+
+    uuid->msb = (group1 << 32) | (group2 << 16) | group3;
+    uuid->lsb = (group4 << 48) | group5;
+    return TRUE;
+}
+
+Uuid binc_uuid_from_short(guint32 short_uuid) {
+    Uuid uuid = {((guint64) short_uuid << 32) | BASE_UUID_MSB_LOW, BASE_UUID_LSB};
+    return uuid;
+}
+
+gboolean binc_uuid_is_short(const Uuid *uuid) {
+    g_assert(uuid != NULL);
+    return (uuid->msb & G_GUINT64_CONSTANT(0xFFFFFFFF)) == BASE_UUID_MSB_LOW && uuid->lsb == BASE_UUID_LSB;
+}
+
+guint32 binc_uuid_get_short(const Uuid *uuid) {
+    g_assert(uuid != NULL);
+    g_assert(binc_uuid_is_short(uuid));
+    return (guint32) (uuid->msb >> 32);
+}
+
+void binc_uuid_to_string(const Uuid *uuid, char *buffer) {
+    g_assert(uuid != NULL);
+    g_assert(buffer != NULL);
+
+    g_snprintf(buffer, BINC_UUID_STRING_LENGTH, "%08x-%04x-%04x-%04x-%012" G_GINT64_MODIFIER "x",
+               (guint) (uuid->msb >> 32),
+               (guint) ((uuid->msb >> 16) & 0xFFFF),
+               (guint) (uuid->msb & 0xFFFF),
+               (guint) (uuid->lsb >> 48),
+               uuid->lsb & G_GUINT64_CONSTANT(0xFFFFFFFFFFFF));
+}
+
+gboolean binc_uuid_equal(gconstpointer a, gconstpointer b) {
+    const Uuid *uuid_a = (const Uuid *) a;
+    const Uuid *uuid_b = (const Uuid *) b;
+    return uuid_a->msb == uuid_b->msb && uuid_a->lsb == uuid_b->lsb;
+}
+
+guint binc_uuid_hash(gconstpointer uuid) {
+    const Uuid *value = (const Uuid *) uuid;
+    guint64 folded = value->msb ^ value->lsb;
+    return (guint) (folded ^ (folded >> 32));
+}
+
+static InternedUuid *uuid_table_find(UuidTable *table, const Uuid *uuid) {
+    if (table == NULL) return NULL;
+
+    for (guint i = binc_uuid_hash(uuid) & table->mask;; i = (i + 1) & table->mask) {
+        InternedUuid *interned = g_atomic_pointer_get(&table->slots[i]);
+        if (interned == NULL) return NULL;
+        if (binc_uuid_equal(&interned->uuid, uuid)) return interned;
+    }
+}
+
+static void uuid_table_insert(UuidTable *table, InternedUuid *interned) {
+    guint i = binc_uuid_hash(&interned->uuid) & table->mask;
+    while (table->slots[i] != NULL) {
+        i = (i + 1) & table->mask;
+    }
+
+    // Publish the entry only once it is complete
+    g_atomic_pointer_set(&table->slots[i], interned);
+}
+
+static UuidTable *uuid_table_grow(UuidTable *table) {
+    guint size = table != NULL ? (table->mask + 1) * 2 : UUID_TABLE_INITIAL_SIZE;
+    UuidTable *grown = g_malloc0(sizeof(UuidTable) + size * sizeof(InternedUuid *));
+    grown->mask = size - 1;
+
+    if (table != NULL) {
+        for (guint i = 0; i <= table->mask; i++) {
+            if (table->slots[i] != NULL) {
+                uuid_table_insert(grown, table->slots[i]);
+            }
+        }
+    }
+    return grown;
+}
+
+const Uuid *binc_uuid_lookup(const Uuid *uuid) {
+    g_assert(uuid != NULL);
+
+    InternedUuid *interned = uuid_table_find(g_atomic_pointer_get(&uuid_table), uuid);
+    return interned != NULL ? &interned->uuid : NULL;
+}
+
+const Uuid *binc_uuid_intern(const Uuid *uuid) {
+    const Uuid *found = binc_uuid_lookup(uuid);
+    if (found != NULL) return found;
+
+    G_LOCK(uuid_pool);
+    InternedUuid *interned = uuid_table_find(uuid_table, uuid);
+    if (interned == NULL) {
+        // Keep the table at most half full so probe sequences stay short
+        if (uuid_table == NULL || (uuid_count + 1) * 2 > uuid_table->mask + 1) {
+            g_atomic_pointer_set(&uuid_table, uuid_table_grow(uuid_table));
+        }
+
+        interned = g_new0(InternedUuid, 1);
+        interned->uuid = *uuid;
+        binc_uuid_to_string(uuid, interned->string);
+        uuid_table_insert(uuid_table, interned);
+        uuid_count++;
+    }
+    G_UNLOCK(uuid_pool);
+
+    return &interned->uuid;
+}
+
+const Uuid *binc_uuid_intern_string(const char *string) {
+    Uuid uuid;
+    if (!binc_uuid_parse(string, &uuid)) return NULL;
+    return binc_uuid_intern(&uuid);
+}
+
+const char *binc_uuid_get_string(const Uuid *interned) {
+    g_assert(interned != NULL);
+    return ((const InternedUuid *) interned)->string;
+}
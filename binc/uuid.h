@@ -0,0 +1,104 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_UUID_H
+#define BINC_UUID_H
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A 128-bit UUID stored as two integers so that it can be compared and hashed without any string work.
+ * 16-bit and 32-bit Bluetooth UUIDs are stored as their expansion on the Bluetooth base UUID
+ * 00000000-0000-1000-8000-00805f9b34fb.
+ */
+typedef struct binc_uuid {
+    guint64 msb;
+    guint64 lsb;
+} Uuid;
+
+// Size of the buffer needed by binc_uuid_to_string(), including the terminating 0
+#define BINC_UUID_STRING_LENGTH 37
+
+/**
+ * Parse a UUID string. Accepts the full 36 character form in upper or lower case as well as 16-bit and 32-bit
+ * short forms like "180d" or "0000180d".
+ *
+ * @return TRUE if string is a valid UUID
+ */
+gboolean binc_uuid_parse(const char *string, Uuid *uuid);
+
+Uuid binc_uuid_from_short(guint32 short_uuid);
+
+/**
+ * Check if the UUID is based on the Bluetooth base UUID, so it has a 16-bit or 32-bit short form
+ */
+gboolean binc_uuid_is_short(const Uuid *uuid);
+
+guint32 binc_uuid_get_short(const Uuid *uuid);
+
+/**
+ * Write the lowercase 36 character form of uuid into buffer, which must hold BINC_UUID_STRING_LENGTH bytes
+ */
+void binc_uuid_to_string(const Uuid *uuid, char *buffer);
+
+gboolean binc_uuid_equal(gconstpointer a, gconstpointer b);
+
+guint binc_uuid_hash(gconstpointer uuid);
+
+/**
+ * Get the canonical instance of a UUID. Interned UUIDs are never freed and two interned UUIDs are equal if and
+ * only if they are the same pointer, so they can be used with g_direct_hash() and compared with ==.
+ * Thread safe. Only intern UUIDs that are kept, like those of GATT attributes, use binc_uuid_lookup() to find things.
+ */
+const Uuid *binc_uuid_intern(const Uuid *uuid);
+
+/**
+ * Get the canonical instance of a UUID without adding it. Lock free and thread safe.
+ *
+ * @return the interned UUID or NULL if it was never interned, in which case nothing stores it
+ */
+const Uuid *binc_uuid_lookup(const Uuid *uuid);
+
+/**
+ * Parse and intern a UUID string in any form accepted by binc_uuid_parse()
+ *
+ * @return the interned UUID or NULL if string is not a valid UUID
+ */
+const Uuid *binc_uuid_intern_string(const char *string);
+
+/**
+ * Get the lowercase 36 character form of an interned UUID. The string lives as long as the interned UUID.
+ *
+ * @param interned a UUID returned by binc_uuid_intern() or binc_uuid_intern_string()
+ */
+const char *binc_uuid_get_string(const Uuid *interned);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BINC_UUID_H
@@ -0,0 +1,483 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#include "worker.h"
+#include "adapter.h"
+#include "device.h"
+#include "logger.h"
+
+static const char *const TAG = "Worker";
+
+typedef struct binc_worker_task {
+    struct binc_worker_task *next;
+    WorkerFunc func;
+    void *user_data;
+} WorkerTask;
+
+struct binc_worker {
+    GMainContext *context; // Owned
+    GMainLoop *loop; // Owned
+    GThread *thread; // Owned
+    WorkerTask *submitted; // Lock-free stack of submitted tasks, most recent first
+    GQueue in_flight; // Typed requests handed to the adapter and still waiting for their result, oldest first
+};
+
+static void binc_internal_worker_cancel_in_flight(Worker *worker);
+
+static void binc_internal_worker_drop_task(WorkerTask *task);
+
+static gpointer binc_internal_worker_thread(gpointer user_data) {
+    Worker *worker = (Worker *) user_data;
+
+    g_main_context_push_thread_default(worker->context);
+    g_main_loop_run(worker->loop);
+    g_main_context_pop_thread_default(worker->context);
+    return NULL;
+}
+
+Worker *binc_worker_create(const char *name) {
+    Worker *worker = g_new0(Worker, 1);
+    worker->context = g_main_context_new();
+    worker->loop = g_main_loop_new(worker->context, FALSE);
+    worker->submitted = NULL;
+    g_queue_init(&worker->in_flight);
+    worker->thread = g_thread_new(name != NULL ? name : "binc-worker", binc_internal_worker_thread, worker);
+    return worker;
+}
+
+static void binc_internal_worker_quit(void *user_data) {
+    Worker *worker = (Worker *) user_data;
+    g_main_loop_quit(worker->loop);
+}
+
+void binc_worker_free(Worker *worker) {
+    g_assert(worker != NULL);
+    g_assert(!binc_worker_is_current_thread(worker));
+
+    // Quitting through the queue guarantees the loop is running when quit is called
+    binc_worker_submit(worker, binc_internal_worker_quit, worker);
+    g_thread_join(worker->thread);
+    worker->thread = NULL;
+
+    // Nothing dispatches the worker's context anymore, so the requests the adapter still has can't complete later
+    binc_internal_worker_cancel_in_flight(worker);
+
+    // Drop the tasks that didn't run in submission order, the stack holds the most recent task first
+    WorkerTask *ordered = NULL;
+    WorkerTask *task = (WorkerTask *) g_atomic_pointer_get(&worker->submitted);
+    while (task != NULL) {
+        WorkerTask *next = task->next;
+        task->next = ordered;
+        ordered = task;
+        task = next;
+    }
+    worker->submitted = NULL;
+
+    while (ordered != NULL) {
+        WorkerTask *next = ordered->next;
+        binc_internal_worker_drop_task(ordered);
+        ordered = next;
+    }
+
+    g_main_loop_unref(worker->loop);
+    worker->loop = NULL;
+    g_main_context_unref(worker->context);
+    worker->context = NULL;
+    g_free(worker);
+}
+
+GMainContext *binc_worker_get_context(const Worker *worker) {
+    g_assert(worker != NULL);
+    return worker->context;
+}
+
+gboolean binc_worker_is_current_thread(const Worker *worker) {
+    g_assert(worker != NULL);
+    return g_main_context_is_owner(worker->context);
+}
+
+static WorkerTask *binc_internal_worker_take_all(Worker *worker) {
+    WorkerTask *head;
+    do {
+        head = (WorkerTask *) g_atomic_pointer_get(&worker->submitted);
+    } while (!g_atomic_pointer_compare_and_exchange(&worker->submitted, head, NULL));
+    return head;
+}
+
+static gboolean binc_internal_worker_drain(gpointer user_data) {
+    Worker *worker = (Worker *) user_data;
+
+    // The stack holds the most recent task first, so reverse it to run tasks in submission order
+    WorkerTask *ordered = NULL;
+    WorkerTask *task = binc_internal_worker_take_all(worker);
+    while (task != NULL) {
+        WorkerTask *next = task->next;
+        task->next = ordered;
+        ordered = task;
+        task = next;
+    }
+
+    while (ordered != NULL) {
+        WorkerTask *next = ordered->next;
+        ordered->func(ordered->user_data);
+        g_free(ordered);
+        ordered = next;
+    }
+    return G_SOURCE_REMOVE;
+}
+
+void binc_worker_submit(Worker *worker, WorkerFunc func, void *user_data) {
+    g_assert(worker != NULL);
+    g_assert(func != NULL);
+
+    WorkerTask *task = g_new0(WorkerTask, 1);
+    task->func = func;
+    task->user_data = user_data;
+
+    WorkerTask *head;
+    do {
+        head = (WorkerTask *) g_atomic_pointer_get(&worker->submitted);
+        task->next = head;
+    } while (!g_atomic_pointer_compare_and_exchange(&worker->submitted, head, task));
+
+    // Only the producer that finds the stack empty wakes up the worker, a drain is already pending otherwise
+    if (head == NULL) {
+        GSource *source = g_idle_source_new();
+        g_source_set_priority(source, G_PRIORITY_DEFAULT);
+        g_source_set_callback(source, binc_internal_worker_drain, worker, NULL);
+        g_source_attach(source, worker->context);
+        g_source_unref(source);
+    }
+}
+
+typedef struct binc_worker_sync_call {
+    WorkerFunc func;
+    void *user_data;
+    GMutex mutex;
+    GCond cond;
+    gboolean done;
+} WorkerSyncCall;
+
+static void binc_internal_worker_sync_call(void *user_data) {
+    WorkerSyncCall *call = (WorkerSyncCall *) user_data;
+    call->func(call->user_data);
+
+    g_mutex_lock(&call->mutex);
+    call->done = TRUE;
+    g_cond_signal(&call->cond);
+    g_mutex_unlock(&call->mutex);
+}
+
+void binc_worker_invoke_sync(Worker *worker, WorkerFunc func, void *user_data) {
+    g_assert(worker != NULL);
+    g_assert(func != NULL);
+    g_assert(!binc_worker_is_current_thread(worker));
+
+    WorkerSyncCall call = {.func = func, .user_data = user_data, .done = FALSE};
+    g_mutex_init(&call.mutex);
+    g_cond_init(&call.cond);
+
+    binc_worker_submit(worker, binc_internal_worker_sync_call, &call);
+
+    g_mutex_lock(&call.mutex);
+    while (!call.done) {
+        g_cond_wait(&call.cond, &call.mutex);
+    }
+    g_mutex_unlock(&call.mutex);
+
+    g_cond_clear(&call.cond);
+    g_mutex_clear(&call.mutex);
+}
+
+typedef struct binc_worker_default_adapter {
+    GDBusConnection *connection;
+    Adapter *adapter;
+} WorkerDefaultAdapter;
+
+static void binc_internal_worker_get_default_adapter(void *user_data) {
+    WorkerDefaultAdapter *request = (WorkerDefaultAdapter *) user_data;
+    request->adapter = binc_adapter_get_default(request->connection);
+}
+
+Adapter *binc_worker_get_default_adapter(Worker *worker, GDBusConnection *dbusConnection) {
+    g_assert(worker != NULL);
+    g_assert(dbusConnection != NULL);
+
+    WorkerDefaultAdapter request = {.connection = dbusConnection, .adapter = NULL};
+    binc_worker_invoke_sync(worker, binc_internal_worker_get_default_adapter, &request);
+    return request.adapter;
+}
+
+typedef enum WorkerRequestType {
+    WORKER_CONNECT = 0, WORKER_READ_CHAR = 1, WORKER_WRITE_CHAR = 2, WORKER_START_NOTIFY = 3, WORKER_STOP_NOTIFY = 4
+} WorkerRequestType;
+
+typedef struct binc_worker_request {
+    WorkerRequestType type;
+    Worker *worker; // Borrowed
+    GList *in_flight_link; // Link in the worker's in-flight requests while the adapter has the request
+    Adapter *adapter; // Borrowed, only used on the worker thread
+    char *address; // Owned
+    char *service_uuid; // Owned
+    char *characteristic_uuid; // Owned
+    GByteArray *value; // Owned
+    WriteType write_type;
+    guint timeout_ms;
+    WorkerResultCallback callback;
+    void *user_data;
+    GMainContext *callback_context; // Owned
+} WorkerRequest;
+
+typedef struct binc_worker_result {
+    WorkerRequest *request; // Owned
+    GByteArray *value; // Owned
+    GError *error; // Owned
+} WorkerResult;
+
+static void binc_internal_worker_request_free(WorkerRequest *request) {
+    g_free(request->address);
+    g_free(request->service_uuid);
+    g_free(request->characteristic_uuid);
+    if (request->value != NULL) {
+        g_byte_array_free(request->value, TRUE);
+    }
+    if (request->callback_context != NULL) {
+        g_main_context_unref(request->callback_context);
+    }
+    g_free(request);
+}
+
+static gboolean binc_internal_worker_deliver_result(gpointer user_data) {
+    WorkerResult *result = (WorkerResult *) user_data;
+    WorkerRequest *request = result->request;
+    request->callback(request->address, result->value, result->error, request->user_data);
+    return G_SOURCE_REMOVE;
+}
+
+static void binc_internal_worker_result_free(gpointer user_data) {
+    WorkerResult *result = (WorkerResult *) user_data;
+    binc_internal_worker_request_free(result->request);
+    if (result->value != NULL) {
+        g_byte_array_free(result->value, TRUE);
+    }
+    g_clear_error(&result->error);
+    g_free(result);
+}
+
+static void binc_internal_worker_complete(WorkerRequest *request, const GByteArray *value, const GError *error) {
+    if (request->in_flight_link != NULL) {
+        g_queue_delete_link(&request->worker->in_flight, request->in_flight_link);
+        request->in_flight_link = NULL;
+    }
+
+    if (request->callback == NULL) {
+        binc_internal_worker_request_free(request);
+        return;
+    }
+
+    if (request->callback_context == NULL) {
+        request->callback(request->address, value, error, request->user_data);
+        binc_internal_worker_request_free(request);
+        return;
+    }
+
+    // The value and error are only valid during this call, so copy them for the other context
+    WorkerResult *result = g_new0(WorkerResult, 1);
+    result->request = request;
+    if (value != NULL) {
+        result->value = g_byte_array_sized_new(value->len);
+        g_byte_array_append(result->value, value->data, value->len);
+    }
+    result->error = error != NULL ? g_error_copy(error) : NULL;
+    g_main_context_invoke_full(request->callback_context, G_PRIORITY_DEFAULT,
+                               binc_internal_worker_deliver_result, result, binc_internal_worker_result_free);
+}
+
+static void binc_internal_worker_not_found(WorkerRequest *request, const char *what, const char *name) {
+    GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "%s <%s> not found", what, name);
+    binc_internal_worker_complete(request, NULL, error);
+    g_error_free(error);
+}
+
+static void binc_internal_worker_connect_cb(Device *device, const GError *error, void *user_data) {
+    binc_internal_worker_complete((WorkerRequest *) user_data, NULL, error);
+}
+
+static void binc_internal_worker_operation_cb(Operation *operation, const GByteArray *byteArray,
+                                              const GError *error, void *user_data) {
+    binc_internal_worker_complete((WorkerRequest *) user_data, byteArray, error);
+}
+
+static void binc_internal_worker_run_request(void *user_data) {
+    WorkerRequest *request = (WorkerRequest *) user_data;
+
+    Device *device = binc_adapter_get_device_by_address(request->adapter, request->address);
+    if (device == NULL) {
+        binc_internal_worker_not_found(request, "device", request->address);
+        return;
+    }
+
+    // Tracked before dispatching, the callback may be called right away
+    g_queue_push_tail(&request->worker->in_flight, request);
+    request->in_flight_link = request->worker->in_flight.tail;
+
+    Operation *operation = NULL;
+    switch (request->type) {
+        case WORKER_CONNECT:
+            binc_device_connect_with_callback(device, binc_internal_worker_connect_cb, request,
+                                              request->timeout_ms, NULL);
+            return;
+        case WORKER_READ_CHAR:
+            operation = binc_device_read_char_with_callback(device, request->service_uuid,
+                                                            request->characteristic_uuid,
+                                                            binc_internal_worker_operation_cb, request,
+                                                            request->timeout_ms, NULL);
+            break;
+        case WORKER_WRITE_CHAR:
+            operation = binc_device_write_char_with_callback(device, request->service_uuid,
+                                                             request->characteristic_uuid, request->value,
+                                                             request->write_type, binc_internal_worker_operation_cb,
+                                                             request, request->timeout_ms, NULL);
+            break;
+        case WORKER_START_NOTIFY:
+            operation = binc_device_start_notify_with_callback(device, request->service_uuid,
+                                                               request->characteristic_uuid,
+                                                               binc_internal_worker_operation_cb, request,
+                                                               request->timeout_ms, NULL);
+            break;
+        case WORKER_STOP_NOTIFY:
+            operation = binc_device_stop_notify_with_callback(device, request->service_uuid,
+                                                              request->characteristic_uuid,
+                                                              binc_internal_worker_operation_cb, request,
+                                                              request->timeout_ms, NULL);
+            break;
+    }
+
+    if (operation == NULL) {
+        log_debug(TAG, "characteristic %s not usable on '%s'", request->characteristic_uuid, request->address);
+        binc_internal_worker_not_found(request, "characteristic", request->characteristic_uuid);
+    }
+}
+
+/*
+ * Typed requests that never ran still own their request and their submitter may be waiting on the result
+ */
+static void binc_internal_worker_drop_task(WorkerTask *task) {
+    if (task->func == binc_internal_worker_run_request) {
+        GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED, "worker was freed");
+        binc_internal_worker_complete((WorkerRequest *) task->user_data, NULL, error);
+        g_error_free(error);
+    }
+    g_free(task);
+}
+
+/*
+ * Complete the requests the adapter never finished, the operations of a freed adapter are dropped without a callback
+ */
+static void binc_internal_worker_cancel_in_flight(Worker *worker) {
+    if (g_queue_is_empty(&worker->in_flight)) return;
+
+    log_debug(TAG, "cancelling %u requests in flight", g_queue_get_length(&worker->in_flight));
+    GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED, "worker was freed");
+    while (!g_queue_is_empty(&worker->in_flight)) {
+        binc_internal_worker_complete((WorkerRequest *) g_queue_peek_head(&worker->in_flight), NULL, error);
+    }
+    g_error_free(error);
+}
+
+static void binc_internal_worker_submit_request(Worker *worker, WorkerRequestType type, Adapter *adapter,
+                                                const char *address, const char *service_uuid,
+                                                const char *characteristic_uuid, const GByteArray *value,
+                                                WriteType writeType, guint timeout_ms,
+                                                WorkerResultCallback callback, void *user_data,
+                                                GMainContext *callback_context) {
+    g_assert(worker != NULL);
+    g_assert(adapter != NULL);
+    g_assert(address != NULL);
+
+    WorkerRequest *request = g_new0(WorkerRequest, 1);
+    request->type = type;
+    request->worker = worker;
+    request->adapter = adapter;
+    request->address = g_strdup(address);
+    request->service_uuid = g_strdup(service_uuid);
+    request->characteristic_uuid = g_strdup(characteristic_uuid);
+    if (value != NULL) {
+        request->value = g_byte_array_sized_new(value->len);
+        g_byte_array_append(request->value, value->data, value->len);
+    }
+    request->write_type = writeType;
+    request->timeout_ms = timeout_ms;
+    request->callback = callback;
+    request->user_data = user_data;
+    request->callback_context = callback_context != NULL ? g_main_context_ref(callback_context) : NULL;
+    binc_worker_submit(worker, binc_internal_worker_run_request, request);
+}
+
+void binc_worker_connect(Worker *worker, Adapter *adapter, const char *address, guint timeout_ms,
+                         WorkerResultCallback callback, void *user_data, GMainContext *callback_context) {
+    binc_internal_worker_submit_request(worker, WORKER_CONNECT, adapter, address, NULL, NULL, NULL,
+                                        WITH_RESPONSE, timeout_ms, callback, user_data, callback_context);
+}
+
+void binc_worker_read_char(Worker *worker, Adapter *adapter, const char *address, const char *service_uuid,
+                           const char *characteristic_uuid, guint timeout_ms,
+                           WorkerResultCallback callback, void *user_data, GMainContext *callback_context) {
+    g_assert(service_uuid != NULL);
+    g_assert(characteristic_uuid != NULL);
+    binc_internal_worker_submit_request(worker, WORKER_READ_CHAR, adapter, address, service_uuid,
+                                        characteristic_uuid, NULL, WITH_RESPONSE, timeout_ms, callback, user_data,
+                                        callback_context);
+}
+
+void binc_worker_write_char(Worker *worker, Adapter *adapter, const char *address, const char *service_uuid,
+                            const char *characteristic_uuid, const GByteArray *value, WriteType writeType,
+                            guint timeout_ms, WorkerResultCallback callback, void *user_data,
+                            GMainContext *callback_context) {
+    g_assert(service_uuid != NULL);
+    g_assert(characteristic_uuid != NULL);
+    g_assert(value != NULL);
+    binc_internal_worker_submit_request(worker, WORKER_WRITE_CHAR, adapter, address, service_uuid,
+                                        characteristic_uuid, value, writeType, timeout_ms, callback, user_data,
+                                        callback_context);
+}
+
+void binc_worker_start_notify(Worker *worker, Adapter *adapter, const char *address, const char *service_uuid,
+                              const char *characteristic_uuid, guint timeout_ms,
+                              WorkerResultCallback callback, void *user_data, GMainContext *callback_context) {
+    g_assert(service_uuid != NULL);
+    g_assert(characteristic_uuid != NULL);
+    binc_internal_worker_submit_request(worker, WORKER_START_NOTIFY, adapter, address, service_uuid,
+                                        characteristic_uuid, NULL, WITH_RESPONSE, timeout_ms, callback, user_data,
+                                        callback_context);
+}
+
+void binc_worker_stop_notify(Worker *worker, Adapter *adapter, const char *address, const char *service_uuid,
+                             const char *characteristic_uuid, guint timeout_ms,
+                             WorkerResultCallback callback, void *user_data, GMainContext *callback_context) {
+    g_assert(service_uuid != NULL);
+    g_assert(characteristic_uuid != NULL);
+    binc_internal_worker_submit_request(worker, WORKER_STOP_NOTIFY, adapter, address, service_uuid,
+                                        characteristic_uuid, NULL, WITH_RESPONSE, timeout_ms, callback, user_data,
+                                        callback_context);
+}
@@ -0,0 +1,123 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+#ifndef BINC_WORKER_H
+#define BINC_WORKER_H
+
+#include <gio/gio.h>
+#include "forward_decl.h"
+#include "characteristic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A worker runs binc on a dedicated thread with its own GMainContext. Adapters created through the worker receive
+ * all D-Bus signals, replies and timers on that thread, so slow application code on other threads can't delay BLE I/O.
+ *
+ * Other threads hand work to the worker with binc_worker_submit() or one of the typed requests below. Submission is
+ * lock-free and never blocks. Devices, services and characteristics are owned by the worker thread, so the typed
+ * requests identify the device by address and the characteristic by uuid.
+ *
+ * All adapters on the same GDBusConnection must live on the same thread. Use a ShardSet to run adapters on separate
+ * threads, each with its own connection.
+ */
+
+typedef void (*WorkerFunc)(void *user_data);
+
+/*
+ * Called once when a typed request has finished. The value is only set for reads and only valid during the callback.
+ */
+typedef void (*WorkerResultCallback)(const char *address, const GByteArray *value, const GError *error,
+                                     void *user_data);
+
+/**
+ * Create a worker and start its thread
+ *
+ * @param name name of the thread, used for debugging
+ * @return the worker, free with binc_worker_free()
+ */
+Worker *binc_worker_create(const char *name);
+
+/**
+ * Stop the worker thread and wait for it to finish. Tasks that were submitted but not run yet are dropped. Typed
+ * requests that did not complete yet, whether they never ran or are still waiting for BlueZ, complete with
+ * G_IO_ERROR_CANCELLED, on their callback_context or else on the calling thread.
+ * Adapters created on the worker must be freed before, using binc_worker_invoke_sync().
+ */
+void binc_worker_free(Worker *worker);
+
+GMainContext *binc_worker_get_context(const Worker *worker);
+
+gboolean binc_worker_is_current_thread(const Worker *worker);
+
+/**
+ * Run a function on the worker thread. Can be called from any thread. Functions run in submission order.
+ */
+void binc_worker_submit(Worker *worker, WorkerFunc func, void *user_data);
+
+/**
+ * Run a function on the worker thread and wait until it has returned. Must not be called from the worker thread.
+ */
+void binc_worker_invoke_sync(Worker *worker, WorkerFunc func, void *user_data);
+
+/**
+ * Get the default adapter, created on the worker thread so all of its callbacks run there
+ *
+ * @return the adapter or NULL if there is none
+ */
+Adapter *binc_worker_get_default_adapter(Worker *worker, GDBusConnection *dbusConnection);
+
+/*
+ * Typed requests. They can be called from any thread and are executed on the worker thread against the device with
+ * the given address. The callback runs on callback_context, or on the worker thread if callback_context is NULL.
+ * If the device or characteristic is not known, the callback gets G_IO_ERROR_NOT_FOUND.
+ * See binc_device_read_char_with_callback() for the meaning of timeout_ms.
+ */
+
+void binc_worker_connect(Worker *worker, Adapter *adapter, const char *address, guint timeout_ms,
+                         WorkerResultCallback callback, void *user_data, GMainContext *callback_context);
+
+void binc_worker_read_char(Worker *worker, Adapter *adapter, const char *address, const char *service_uuid,
+                           const char *characteristic_uuid, guint timeout_ms,
+                           WorkerResultCallback callback, void *user_data, GMainContext *callback_context);
+
+void binc_worker_write_char(Worker *worker, Adapter *adapter, const char *address, const char *service_uuid,
+                            const char *characteristic_uuid, const GByteArray *value, WriteType writeType,
+                            guint timeout_ms, WorkerResultCallback callback, void *user_data,
+                            GMainContext *callback_context);
+
+void binc_worker_start_notify(Worker *worker, Adapter *adapter, const char *address, const char *service_uuid,
+                              const char *characteristic_uuid, guint timeout_ms,
+                              WorkerResultCallback callback, void *user_data, GMainContext *callback_context);
+
+void binc_worker_stop_notify(Worker *worker, Adapter *adapter, const char *address, const char *service_uuid,
+                             const char *characteristic_uuid, guint timeout_ms,
+                             WorkerResultCallback callback, void *user_data, GMainContext *callback_context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BINC_WORKER_H
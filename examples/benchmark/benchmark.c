@@ -0,0 +1,192 @@
+/*
+ *   Copyright (c) 2022 Martijn van Welie
+ *
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ *
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ *
+ */
+
+/*
+ * Measures the notification delivery path: a PropertiesChanged payload with a Value is handed to a characteristic
+ * that is notifying, the same way the adapter routes it. Reports the time and the number of heap allocations per
+ * notification, counted by wrapping the glibc allocator.
+ *
+ * Uses the default adapter only to create a device object, nothing is sent to BlueZ or any peripheral.
+ *
+ * Usage: benchmark [notifications]
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "adapter.h"
+#include "characteristic.h"
+#include "characteristic_internal.h"
+#include "device_internal.h"
+#include "logger.h"
+#include "notification_ring.h"
+
+#define TAG "Benchmark"
+#define DEFAULT_NOTIFICATIONS 1000000
+#define PAYLOAD_LENGTH 20
+#define RING_CAPACITY 256
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static gboolean counting = FALSE;
+static guint64 allocations = 0;
+static guint64 bytes_received = 0;
+
+void *malloc(size_t size) {
+    if (counting) allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    if (counting) allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (counting) allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+static void on_notify(__attribute__((unused)) Device *device,
+                      __attribute__((unused)) Characteristic *characteristic,
+                      const GByteArray *byteArray) {
+    bytes_received += byteArray->len;
+}
+
+static GVariant *create_changed_properties(void) {
+    guint8 payload[PAYLOAD_LENGTH];
+    for (guint i = 0; i < PAYLOAD_LENGTH; i++) {
+        payload[i] = (guint8) i;
+    }
+
+    GVariantBuilder *builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(builder, "{sv}", "Value",
+                          g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, payload, PAYLOAD_LENGTH, sizeof(guint8)));
+    GVariant *changed_properties = g_variant_ref_sink(g_variant_builder_end(builder));
+    g_variant_builder_unref(builder);
+    return changed_properties;
+}
+
+/*
+ * Signals arrive as serialized data, which GVariant unpacks into child instances while iterating
+ */
+static GVariant *serialize(GVariant *value) {
+    GBytes *bytes = g_variant_get_data_as_bytes(value);
+    GVariant *serialized = g_variant_ref_sink(g_variant_new_from_bytes(g_variant_get_type(value), bytes, TRUE));
+    g_bytes_unref(bytes);
+    return serialized;
+}
+
+static void drain_ring(NotificationRing *ring) {
+    NotificationEntry entries[RING_CAPACITY];
+    guint count;
+    while ((count = binc_notification_ring_peek(ring, entries, RING_CAPACITY)) > 0) {
+        for (guint i = 0; i < count; i++) {
+            bytes_received += entries[i].length;
+        }
+        binc_notification_ring_consume(ring, count);
+    }
+}
+
+static void run(const char *name, Characteristic *characteristic, GVariant *changed_properties,
+                NotificationRing *ring, guint notifications) {
+    // Warm up first, so state that is allocated once is not counted
+    binc_characteristic_handle_properties_changed(characteristic, changed_properties);
+    if (ring != NULL) drain_ring(ring);
+
+    allocations = 0;
+    bytes_received = 0;
+    gint64 elapsed = 0;
+    for (guint done = 0; done < notifications;) {
+        // Consumers drain the ring outside of the measurement, it only holds RING_CAPACITY notifications
+        guint batch = ring != NULL ? MIN(RING_CAPACITY, notifications - done) : notifications - done;
+        gint64 start = g_get_monotonic_time();
+        counting = TRUE;
+        for (guint i = 0; i < batch; i++) {
+            binc_characteristic_handle_properties_changed(characteristic, changed_properties);
+        }
+        counting = FALSE;
+        elapsed += g_get_monotonic_time() - start;
+
+        if (ring != NULL) drain_ring(ring);
+        done += batch;
+    }
+
+    printf("%-24s %9u notifications %8.1f ns/notification %6.2f allocations/notification %10lu bytes\n",
+           name, notifications, (double) elapsed * 1000.0 / notifications, (double) allocations / notifications,
+           (unsigned long) bytes_received);
+}
+
+int main(int argc, char **argv) {
+    guint notifications = argc == 2 ? (guint) strtoul(argv[1], NULL, 10) : DEFAULT_NOTIFICATIONS;
+    if (notifications == 0) {
+        fprintf(stderr, "usage: %s [notifications]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Debug logging formats every notification, measure the path as it runs in production
+    log_enabled(TRUE);
+    log_set_level(LOG_INFO);
+
+    GDBusConnection *dbusConnection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, NULL);
+    Adapter *adapter = dbusConnection != NULL ? binc_adapter_get_default(dbusConnection) : NULL;
+    if (adapter == NULL) {
+        log_error(TAG, "no adapter found");
+        return EXIT_FAILURE;
+    }
+
+    char *device_path = g_strdup_printf("%s/dev_00_00_00_00_00_01", binc_adapter_get_path(adapter));
+    char *char_path = g_strdup_printf("%s/service0001/char0002", device_path);
+    Device *device = binc_device_create(device_path, adapter);
+    Characteristic *characteristic = binc_characteristic_create(device, char_path);
+    binc_characteristic_set_uuid(characteristic, "00002a37-0000-1000-8000-00805f9b34fb");
+    binc_characteristic_set_flags(characteristic, g_list_append(NULL, g_strdup("notify")));
+    binc_characteristic_set_notify_cb(characteristic, &on_notify);
+    binc_characteristic_set_notifying(characteristic, TRUE);
+
+    GVariant *changed_properties = create_changed_properties();
+    GVariant *serialized = serialize(changed_properties);
+
+    run("callback", characteristic, changed_properties, NULL, notifications);
+    run("callback, serialized", characteristic, serialized, NULL, notifications);
+
+    NotificationRing *ring = binc_notification_ring_create(RING_CAPACITY, PAYLOAD_LENGTH);
+    binc_characteristic_set_notify_ring(characteristic, ring);
+    run("ring", characteristic, changed_properties, ring, notifications);
+    run("ring, serialized", characteristic, serialized, ring, notifications);
+    binc_characteristic_set_notify_ring(characteristic, NULL);
+    binc_notification_ring_free(ring);
+
+    g_variant_unref(serialized);
+    g_variant_unref(changed_properties);
+    binc_characteristic_free(characteristic);
+    binc_device_free(device);
+    g_free(char_path);
+    g_free(device_path);
+    binc_adapter_free(adapter);
+    g_dbus_connection_close_sync(dbusConnection, NULL, NULL);
+    g_object_unref(dbusConnection);
+    return EXIT_SUCCESS;
+}
@@ -30,6 +30,7 @@
 #include "device.h"
 #include "logger.h"
 #include "agent.h"
+#include "connection_manager.h"
 #include "parser.h"
 
 #define TAG "Main"
@@ -51,6 +52,7 @@
 
 GMainLoop *loop = NULL;
 Adapter *default_adapter = NULL;
+ConnectionManager *connection_manager = NULL;
 Agent *agent = NULL;
 char *bledevnameprefix = NULL;
 int tries = 0;
@@ -274,45 +276,80 @@ void on_read(Device *device, Characteristic *characteristic, const GByteArray *b
         return;
     }
     log_debug(TAG, "on_read %s", uuid);
+}
 
-    if (byteArray == NULL) return;
+/* characteristics read when services are resolved, results come back in this order */
+enum {
+    READ_MANUFACTURER, READ_MODEL, READ_TEMPERATURE, READ_PRESSURE, READ_HUMIDITY, READ_BATTERY, READ_COUNT
+};
 
-    Parser *parser = parser_create(byteArray, LITTLE_ENDIAN);
-    if (g_str_equal(uuid, DIS_MANUFACTURER_CHAR)) {
-        GString *manufacturer = parser_get_string(parser);
-        log_debug(TAG, "manufacturer = %s", manufacturer->str);
-        g_string_free(manufacturer, TRUE);
-    } else if (g_str_equal(uuid, DIS_MODEL_CHAR)) {
-        GString *model = parser_get_string(parser);
-        log_debug(TAG, "model = %s", model->str);
-        g_string_free(model, TRUE);
-    } else if (g_str_equal(uuid, TEMPERATURE_CHAR_UUID)) {
-        log_debug(TAG, "Temperature to parse...");
-        int16_t temp = parser_get_sint16(parser);
-        log_debug(TAG, "temp = %d", temp);
-        bledev_set_temp(device, temp);
-        fail = 0;
-    } else if (g_str_equal(uuid, PRESSURE_CHAR_UUID)) {
-        log_debug(TAG, "Pressure to parse...");
-        uint32_t pres = parser_get_uint32(parser);
-        log_debug(TAG, "pres = %d", pres);
-        bledev_set_pres(device,pres);
-        fail = 0;
-    } else if (g_str_equal(uuid, HUMIDITY_CHAR_UUID)) {
-        log_debug(TAG, "Humidity to parse...");
-        uint16_t humi = parser_get_uint16(parser);
-        log_debug(TAG, "hum = %d", humi);
-        bledev_set_humi(device,humi);
-        fail = 0;
-    } else if (g_str_equal(uuid, BATVAL_CHAR_UUID)) {
-        log_debug(TAG, "Battery Level to parse...");
-        uint16_t humi = parser_get_uint16(parser);
-        log_debug(TAG, "bat = %d", humi);
-        bledev_set_batl(device,humi);
-        fail = 0;
+static const char *const read_uuids[2 * READ_COUNT] = {
+        DIS_SERVICE, DIS_MANUFACTURER_CHAR,
+        DIS_SERVICE, DIS_MODEL_CHAR,
+        HTS_SERVICE_UUID, TEMPERATURE_CHAR_UUID,
+        HTS_SERVICE_UUID, PRESSURE_CHAR_UUID,
+        HTS_SERVICE_UUID, HUMIDITY_CHAR_UUID,
+        BAT_SERVICE_UUID, BATVAL_CHAR_UUID
+};
+
+void on_read_chars(Device *device, const ReadCharsResult *results, guint count, void *user_data) {
+    for (guint i = 0; i < count; i++) {
+        const ReadCharsResult *result = &results[i];
+        if (result->error != NULL) {
+            log_debug(TAG, "failed to read '%s' (error %d: %s)", result->characteristic_uuid, result->error->code,
+                      result->error->message);
+            continue;
+        }
+
+        Parser *parser = parser_create(result->value, LITTLE_ENDIAN);
+        switch (i) {
+            case READ_MANUFACTURER: {
+                GString *manufacturer = parser_get_string(parser);
+                log_debug(TAG, "manufacturer = %s", manufacturer->str);
+                g_string_free(manufacturer, TRUE);
+                break;
+            }
+            case READ_MODEL: {
+                GString *model = parser_get_string(parser);
+                log_debug(TAG, "model = %s", model->str);
+                g_string_free(model, TRUE);
+                break;
+            }
+            case READ_TEMPERATURE: {
+                int16_t temp = parser_get_sint16(parser);
+                log_debug(TAG, "temp = %d", temp);
+                bledev_set_temp(device, temp);
+                fail = 0;
+                break;
+            }
+            case READ_PRESSURE: {
+                uint32_t pres = parser_get_uint32(parser);
+                log_debug(TAG, "pres = %d", pres);
+                bledev_set_pres(device, pres);
+                fail = 0;
+                break;
+            }
+            case READ_HUMIDITY: {
+                uint16_t humi = parser_get_uint16(parser);
+                log_debug(TAG, "hum = %d", humi);
+                bledev_set_humi(device, humi);
+                fail = 0;
+                break;
+            }
+            case READ_BATTERY: {
+                uint16_t batl = parser_get_uint16(parser);
+                log_debug(TAG, "bat = %d", batl);
+                bledev_set_batl(device, batl);
+                fail = 0;
+                break;
+            }
+            default:
+                break;
+        }
+        parser_free(parser);
     }
+
     bledev_write_info(device);
-    parser_free(parser);
     if (all_bledev_done()) {
         tries = MAXTRIES; /* Done exit in the next loop */
     }
@@ -333,14 +370,9 @@ void on_desc_read(Device *device, Descriptor *descriptor, const GByteArray *byte
 void on_services_resolved(Device *device) {
     log_debug(TAG, "'%s' services resolved", binc_device_get_name(device));
 
-    binc_device_read_char(device, DIS_SERVICE, DIS_MANUFACTURER_CHAR);
-    binc_device_read_char(device, DIS_SERVICE, DIS_MODEL_CHAR);
     // binc_device_start_notify(device, HTS_SERVICE_UUID, TEMPERATURE_CHAR_UUID);
-    binc_device_read_char(device, HTS_SERVICE_UUID, TEMPERATURE_CHAR_UUID);
-    binc_device_read_char(device, HTS_SERVICE_UUID, PRESSURE_CHAR_UUID);
-    binc_device_read_char(device, HTS_SERVICE_UUID, HUMIDITY_CHAR_UUID);
     // binc_device_read_desc(device, HTS_SERVICE_UUID, TEMPERATURE_CHAR_UUID, CUD_CHAR);
-    binc_device_read_char(device, BAT_SERVICE_UUID, BATVAL_CHAR_UUID);
+    binc_device_read_chars(device, read_uuids, READ_COUNT, &on_read_chars, NULL);
 }
 
 gboolean on_request_authorization(Device *device) {
@@ -378,7 +410,7 @@ void on_scan_result(Adapter *adapter, Device *device) {
         binc_device_set_notify_char_cb(device, &on_notify);
         binc_device_set_notify_state_cb(device, &on_notification_state_changed);
         binc_device_set_read_desc_cb(device, &on_desc_read);
-        binc_device_connect(device);
+        binc_connection_manager_connect(connection_manager, device, BINC_PRIORITY_NORMAL, NULL, NULL);
     } else {
         log_debug(TAG,"ignoring...");
     }
@@ -456,6 +488,11 @@ gboolean callback(gpointer data) {
     log_debug(TAG, "callback calling bledev_disconnect");
     bledev_disconnect();
 
+    if (connection_manager != NULL) {
+        binc_connection_manager_free(connection_manager);
+        connection_manager = NULL;
+    }
+
     if (default_adapter != NULL) {
         /* XXX: stop discovery */
         binc_adapter_stop_discovery(default_adapter);
@@ -505,6 +542,9 @@ int main(int argc, char **argv) {
     if (default_adapter != NULL) {
         log_info(TAG, "using adapter '%s'", binc_adapter_get_name(default_adapter));
 
+        // Connect to at most 2 sensors at the same time
+        connection_manager = binc_connection_manager_create(default_adapter, 2);
+
         // Register an agent and set callbacks
         agent = binc_agent_create(default_adapter, "/org/bluez/BincAgent", KEYBOARD_DISPLAY);
         binc_agent_set_request_authorization_cb(agent, &on_request_authorization);